@@ -0,0 +1,57 @@
+#ifndef MINIVM_ANALYSIS_BITSET_H_
+#define MINIVM_ANALYSIS_BITSET_H_
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace minivm::analysis {
+
+// fixed-size set of small integers, for data-flow analyses
+class BitSet {
+ public:
+  BitSet() : size_(0) {}
+  BitSet(std::size_t size) : size_(size), words_((size + 63) / 64, 0) {}
+
+  // check if the specific element is in the set
+  bool test(std::size_t i) const {
+    return (words_[i / 64] >> (i % 64)) & 1;
+  }
+  // add the specific element to the set
+  void set(std::size_t i) { words_[i / 64] |= std::uint64_t(1) << (i % 64); }
+  // remove the specific element from the set
+  void reset(std::size_t i) {
+    words_[i / 64] &= ~(std::uint64_t(1) << (i % 64));
+  }
+
+  // add all elements of another set, returns 'true' if changed
+  bool Union(const BitSet &rhs) {
+    bool changed = false;
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+      auto word = words_[i] | rhs.words_[i];
+      if (word != words_[i]) changed = true;
+      words_[i] = word;
+    }
+    return changed;
+  }
+  // remove all elements of another set
+  void Subtract(const BitSet &rhs) {
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+      words_[i] &= ~rhs.words_[i];
+    }
+  }
+
+  // getters
+  std::size_t size() const { return size_; }
+
+  bool operator==(const BitSet &rhs) const { return words_ == rhs.words_; }
+  bool operator!=(const BitSet &rhs) const { return !(*this == rhs); }
+
+ private:
+  std::size_t size_;
+  std::vector<std::uint64_t> words_;
+};
+
+}  // namespace minivm::analysis
+
+#endif  // MINIVM_ANALYSIS_BITSET_H_
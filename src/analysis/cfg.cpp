@@ -0,0 +1,156 @@
+#include "analysis/cfg.h"
+
+#include <algorithm>
+#include <utility>
+#include <cassert>
+
+#include "analysis/effect.h"
+
+using namespace minivm::analysis;
+using namespace minivm::vm;
+
+std::vector<FuncRange> minivm::analysis::GetFuncRanges(
+    const VMInstContainer &cont) {
+  // NOTE: all functions are placed before the entry point
+  auto entry_pc = cont.FindPC(kVMEntry);
+  assert(entry_pc);
+  auto func_pcs = cont.func_pcs();
+  std::vector<VMAddr> pcs(func_pcs.begin(), func_pcs.end());
+  std::sort(pcs.begin(), pcs.end());
+  std::vector<FuncRange> ranges;
+  for (std::size_t i = 0; i < pcs.size(); ++i) {
+    ranges.push_back({pcs[i], i + 1 < pcs.size() ? pcs[i + 1] : *entry_pc});
+  }
+  return ranges;
+}
+
+FuncRange minivm::analysis::GetEntryRange(const VMInstContainer &cont) {
+  auto entry_pc = cont.FindPC(kVMEntry);
+  assert(entry_pc);
+  return {*entry_pc, static_cast<VMAddr>(cont.inst_count())};
+}
+
+ControlFlowGraph::ControlFlowGraph(const VMInstContainer &cont,
+                                   FuncRange range)
+    : range_(range) {
+  assert(range_.begin < range_.end);
+  BuildBlocks(cont);
+  BuildEdges(cont);
+  ComputeRPO();
+}
+
+ControlFlowGraph::ControlFlowGraph(
+    const std::vector<std::vector<BlockId>> &succs)
+    : range_({0, 0}) {
+  assert(!succs.empty());
+  blocks_.assign(succs.size(), {0, 0, {}, {}, false});
+  for (BlockId id = 0; id < succs.size(); ++id) {
+    for (const auto &succ : succs[id]) {
+      AddEdge(id, succ);
+      blocks_[succ].is_target = true;
+    }
+  }
+  ComputeRPO();
+}
+
+void ControlFlowGraph::BuildBlocks(const VMInstContainer &cont) {
+  // find all leaders
+  auto len = range_.end - range_.begin;
+  std::vector<bool> leaders(len, false), targets(len, false);
+  auto mark = [this, &leaders, &targets](VMAddr pc, bool is_target) {
+    if (pc < range_.begin || pc >= range_.end) return;
+    leaders[pc - range_.begin] = true;
+    if (is_target) targets[pc - range_.begin] = true;
+  };
+  mark(range_.begin, false);
+  for (auto pc = range_.begin; pc < range_.end; ++pc) {
+    auto inst = cont.GetOrigInst(pc);
+    switch (static_cast<InstOp>(inst.op)) {
+      case InstOp::Bnz: case InstOp::Jmp: {
+        mark(inst.opr, true);
+        mark(pc + 1, false);
+        break;
+      }
+      case InstOp::Ret: case InstOp::Error: {
+        mark(pc + 1, false);
+        break;
+      }
+      default:;
+    }
+  }
+  // create blocks
+  block_ids_.resize(len);
+  for (VMAddr i = 0; i < len; ++i) {
+    if (leaders[i]) {
+      if (!blocks_.empty()) blocks_.back().end = range_.begin + i;
+      blocks_.push_back({range_.begin + i, range_.end, {}, {}, targets[i]});
+    }
+    block_ids_[i] = blocks_.size() - 1;
+  }
+}
+
+void ControlFlowGraph::BuildEdges(const VMInstContainer &cont) {
+  auto in_range = [this](VMAddr pc) {
+    return pc >= range_.begin && pc < range_.end;
+  };
+  for (BlockId id = 0; id < blocks_.size(); ++id) {
+    auto last = blocks_[id].end - 1, next = blocks_[id].end;
+    auto inst = cont.GetOrigInst(last);
+    switch (static_cast<InstOp>(inst.op)) {
+      case InstOp::Jmp: {
+        // register branches fall through or jump to the target
+        // held by the following 'Jmp'
+        if (last > range_.begin &&
+            IsRegBranch(static_cast<InstOp>(cont.GetOrigInst(last - 1).op)) &&
+            in_range(next)) {
+          AddEdge(id, FindBlock(next));
+        }
+        if (in_range(inst.opr)) AddEdge(id, FindBlock(inst.opr));
+        break;
+      }
+      case InstOp::Bnz: {
+        if (in_range(next)) AddEdge(id, FindBlock(next));
+        if (in_range(inst.opr)) AddEdge(id, FindBlock(inst.opr));
+        break;
+      }
+      case InstOp::Ret: case InstOp::Error: break;
+      default: {
+        if (in_range(next)) AddEdge(id, FindBlock(next));
+        break;
+      }
+    }
+  }
+}
+
+void ControlFlowGraph::AddEdge(BlockId from, BlockId to) {
+  auto &succs = blocks_[from].succs;
+  if (std::find(succs.begin(), succs.end(), to) != succs.end()) return;
+  succs.push_back(to);
+  blocks_[to].preds.push_back(from);
+}
+
+void ControlFlowGraph::ComputeRPO() {
+  // iterative depth-first search, get post order first
+  rpo_index_.assign(blocks_.size(), kNoBlock);
+  std::vector<bool> visited(blocks_.size(), false);
+  std::vector<std::pair<BlockId, std::size_t>> stack;
+  stack.push_back({0, 0});
+  visited[0] = true;
+  while (!stack.empty()) {
+    auto &[id, i] = stack.back();
+    const auto &succs = blocks_[id].succs;
+    if (i < succs.size()) {
+      auto succ = succs[i++];
+      if (!visited[succ]) {
+        visited[succ] = true;
+        stack.push_back({succ, 0});
+      }
+    }
+    else {
+      rpo_.push_back(id);
+      stack.pop_back();
+    }
+  }
+  std::reverse(rpo_.begin(), rpo_.end());
+  for (std::uint32_t i = 0; i < rpo_.size(); ++i) rpo_index_[rpo_[i]] = i;
+}
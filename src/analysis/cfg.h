@@ -0,0 +1,89 @@
+#ifndef MINIVM_ANALYSIS_CFG_H_
+#define MINIVM_ANALYSIS_CFG_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+
+namespace minivm::analysis {
+
+// address range of a function, instructions in ['begin', 'end')
+struct FuncRange {
+  vm::VMAddr begin, end;
+};
+
+// get address ranges of all functions, sorted by address
+// the entry point is not included
+std::vector<FuncRange> GetFuncRanges(const vm::VMInstContainer &cont);
+// get address range of the entry point
+FuncRange GetEntryRange(const vm::VMInstContainer &cont);
+
+// identifier of basic blocks
+using BlockId = std::uint32_t;
+// invalid block id
+constexpr BlockId kNoBlock = static_cast<BlockId>(-1);
+
+// basic block, instructions in ['begin', 'end')
+struct BasicBlock {
+  vm::VMAddr begin, end;
+  // successors & predecessors
+  std::vector<BlockId> succs, preds;
+  // set if the block is the target of any branches
+  bool is_target;
+};
+
+// control flow graph of a function
+// blocks are numbered by their addresses, the first one is the entry
+// instructions are read by 'GetOrigInst', so superinstructions and
+// breakpoints are transparent, and the 'Jmp' holding target of a register
+// branch ('BxxRR') is the last instruction of the branch's block
+class ControlFlowGraph {
+ public:
+  ControlFlowGraph(const vm::VMInstContainer &cont, FuncRange range);
+  // build from successors of each block, for functions in other
+  // representations, blocks contain no Gopher instructions
+  ControlFlowGraph(const std::vector<std::vector<BlockId>> &succs);
+
+  // get id of the block that contains the specific pc address
+  BlockId FindBlock(vm::VMAddr pc) const {
+    return block_ids_[pc - range_.begin];
+  }
+  // check if the specific pc address is the first instruction of a block
+  bool IsLeader(vm::VMAddr pc) const {
+    return blocks_[FindBlock(pc)].begin == pc;
+  }
+  // check if the specific block is reachable from the entry
+  bool IsReachable(BlockId id) const { return rpo_index_[id] != kNoBlock; }
+
+  // getters
+  FuncRange range() const { return range_; }
+  const std::vector<BasicBlock> &blocks() const { return blocks_; }
+  const BasicBlock &block(BlockId id) const { return blocks_[id]; }
+  // all reachable blocks in reverse post order
+  const std::vector<BlockId> &rpo() const { return rpo_; }
+  // index of the specific block in reverse post order
+  std::uint32_t rpo_index(BlockId id) const { return rpo_index_[id]; }
+
+ private:
+  // split instructions into basic blocks
+  void BuildBlocks(const vm::VMInstContainer &cont);
+  // add edges between basic blocks
+  void BuildEdges(const vm::VMInstContainer &cont);
+  // add an edge between the specific blocks
+  void AddEdge(BlockId from, BlockId to);
+  // compute reverse post order
+  void ComputeRPO();
+
+  FuncRange range_;
+  std::vector<BasicBlock> blocks_;
+  // id of block of each instruction
+  std::vector<BlockId> block_ids_;
+  std::vector<BlockId> rpo_;
+  std::vector<std::uint32_t> rpo_index_;
+};
+
+}  // namespace minivm::analysis
+
+#endif  // MINIVM_ANALYSIS_CFG_H_
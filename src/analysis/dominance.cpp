@@ -0,0 +1,101 @@
+#include "analysis/dominance.h"
+
+#include <utility>
+
+using namespace minivm::analysis;
+
+namespace {
+
+// invalid order number
+constexpr std::uint32_t kNoOrder = static_cast<std::uint32_t>(-1);
+
+}  // namespace
+
+DominatorTree::DominatorTree(const ControlFlowGraph &cfg) {
+  ComputeIdoms(cfg);
+  ComputeOrder();
+  ComputeFrontiers(cfg);
+}
+
+void DominatorTree::ComputeIdoms(const ControlFlowGraph &cfg) {
+  idoms_.assign(cfg.blocks().size(), kNoBlock);
+  const auto &rpo = cfg.rpo();
+  auto entry = rpo.front();
+  idoms_[entry] = entry;
+  // find the common dominator of two blocks
+  auto intersect = [this, &cfg](BlockId a, BlockId b) {
+    while (a != b) {
+      while (cfg.rpo_index(a) > cfg.rpo_index(b)) a = idoms_[a];
+      while (cfg.rpo_index(b) > cfg.rpo_index(a)) b = idoms_[b];
+    }
+    return a;
+  };
+  // iterate until nothing changes, which takes two passes
+  // if the control flow graph is reducible
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (std::size_t i = 1; i < rpo.size(); ++i) {
+      auto id = rpo[i];
+      auto new_idom = kNoBlock;
+      for (const auto &pred : cfg.block(id).preds) {
+        // skip unprocessed and unreachable predecessors
+        if (idoms_[pred] == kNoBlock) continue;
+        new_idom = new_idom == kNoBlock ? pred : intersect(pred, new_idom);
+      }
+      if (idoms_[id] != new_idom) {
+        idoms_[id] = new_idom;
+        changed = true;
+      }
+    }
+  }
+  idoms_[entry] = kNoBlock;
+  // build the tree
+  children_.assign(idoms_.size(), {});
+  for (BlockId id = 0; id < idoms_.size(); ++id) {
+    if (idoms_[id] != kNoBlock) children_[idoms_[id]].push_back(id);
+  }
+}
+
+void DominatorTree::ComputeOrder() {
+  pre_.assign(idoms_.size(), kNoOrder);
+  post_.assign(idoms_.size(), kNoOrder);
+  std::uint32_t pre = 0, post = 0;
+  std::vector<std::pair<BlockId, std::size_t>> stack;
+  stack.push_back({0, 0});
+  pre_[0] = pre++;
+  while (!stack.empty()) {
+    auto &[id, i] = stack.back();
+    if (i < children_[id].size()) {
+      auto child = children_[id][i++];
+      pre_[child] = pre++;
+      stack.push_back({child, 0});
+    }
+    else {
+      post_[id] = post++;
+      stack.pop_back();
+    }
+  }
+}
+
+void DominatorTree::ComputeFrontiers(const ControlFlowGraph &cfg) {
+  frontiers_.assign(idoms_.size(), {});
+  for (const auto &id : cfg.rpo()) {
+    const auto &preds = cfg.block(id).preds;
+    if (preds.size() < 2) continue;
+    for (const auto &pred : preds) {
+      if (!cfg.IsReachable(pred)) continue;
+      // walk up from the predecessor to the immediate dominator
+      for (auto runner = pred; runner != idoms_[id];
+           runner = idoms_[runner]) {
+        auto &frontier = frontiers_[runner];
+        if (!frontier.empty() && frontier.back() == id) break;
+        frontier.push_back(id);
+      }
+    }
+  }
+}
+
+bool DominatorTree::Dominates(BlockId a, BlockId b) const {
+  if (pre_[a] == kNoOrder || pre_[b] == kNoOrder) return false;
+  return pre_[a] <= pre_[b] && post_[b] <= post_[a];
+}
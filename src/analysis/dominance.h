@@ -0,0 +1,49 @@
+#ifndef MINIVM_ANALYSIS_DOMINANCE_H_
+#define MINIVM_ANALYSIS_DOMINANCE_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "analysis/cfg.h"
+
+namespace minivm::analysis {
+
+// dominator tree of a control flow graph, with dominance frontiers
+// computed by the iterative algorithm of Cooper, Harvey and Kennedy,
+// only reachable blocks are included
+class DominatorTree {
+ public:
+  DominatorTree(const ControlFlowGraph &cfg);
+
+  // check if block 'a' dominates block 'b' (in constant time)
+  bool Dominates(BlockId a, BlockId b) const;
+
+  // get immediate dominator of the specific block,
+  // returns 'kNoBlock' for the entry and unreachable blocks
+  BlockId idom(BlockId id) const { return idoms_[id]; }
+  // get children of the specific block in the dominator tree
+  const std::vector<BlockId> &children(BlockId id) const {
+    return children_[id];
+  }
+  // get dominance frontier of the specific block
+  const std::vector<BlockId> &frontier(BlockId id) const {
+    return frontiers_[id];
+  }
+
+ private:
+  // compute immediate dominators
+  void ComputeIdoms(const ControlFlowGraph &cfg);
+  // number all blocks by a depth-first search on the dominator tree
+  void ComputeOrder();
+  // compute dominance frontiers
+  void ComputeFrontiers(const ControlFlowGraph &cfg);
+
+  std::vector<BlockId> idoms_;
+  std::vector<std::vector<BlockId>> children_, frontiers_;
+  // pre-order & post-order numbers in the dominator tree
+  std::vector<std::uint32_t> pre_, post_;
+};
+
+}  // namespace minivm::analysis
+
+#endif  // MINIVM_ANALYSIS_DOMINANCE_H_
@@ -0,0 +1,161 @@
+#include "analysis/effect.h"
+
+using namespace minivm::analysis;
+using namespace minivm::vm;
+
+namespace {
+
+// get location of the i-th register id of register instructions
+inline Loc RegOprLoc(std::uint32_t opr, std::size_t i) {
+  return {LocKind::Reg, GetRegOpr(opr, i)};
+}
+
+}  // namespace
+
+Effect minivm::analysis::GetEffect(const VMUnpackedInst &inst) {
+  Effect effect = {};
+  auto use = [&effect](Loc loc) { effect.uses[effect.use_count++] = loc; };
+  switch (static_cast<InstOp>(inst.op)) {
+    case InstOp::LdSlot: use({LocKind::Slot, inst.opr}); break;
+    case InstOp::LdGlobal: use({LocKind::Global, inst.opr}); break;
+    case InstOp::LdReg: use({LocKind::Reg, inst.opr}); break;
+    case InstOp::VarSlot: case InstOp::ArrSlot: case InstOp::StSlot:
+    case InstOp::StSlotP: {
+      effect.def = {LocKind::Slot, inst.opr};
+      break;
+    }
+    case InstOp::VarGlobal: case InstOp::ArrGlobal: case InstOp::StGlobal:
+    case InstOp::StGlobalP: {
+      effect.def = {LocKind::Global, inst.opr};
+      break;
+    }
+    case InstOp::StReg: case InstOp::StRegP: {
+      effect.def = {LocKind::Reg, inst.opr};
+      break;
+    }
+    case InstOp::Call: case InstOp::CallExt: effect.call = true; break;
+    case InstOp::Ret: case InstOp::Error: effect.exit = true; break;
+    case InstOp::MovRR: {
+      effect.def = RegOprLoc(inst.opr, 0);
+      use(RegOprLoc(inst.opr, 1));
+      break;
+    }
+    case InstOp::MovRI: effect.def = RegOprLoc(inst.opr, 0); break;
+    case InstOp::LAndRRR: case InstOp::LOrRRR: case InstOp::EqRRR:
+    case InstOp::NeRRR: case InstOp::GtRRR: case InstOp::LtRRR:
+    case InstOp::GeRRR: case InstOp::LeRRR: case InstOp::AddRRR:
+    case InstOp::SubRRR: case InstOp::MulRRR: case InstOp::DivRRR:
+    case InstOp::ModRRR: {
+      effect.def = RegOprLoc(inst.opr, 0);
+      use(RegOprLoc(inst.opr, 1));
+      use(RegOprLoc(inst.opr, 2));
+      break;
+    }
+    case InstOp::LAndRRI: case InstOp::LOrRRI: case InstOp::EqRRI:
+    case InstOp::NeRRI: case InstOp::GtRRI: case InstOp::LtRRI:
+    case InstOp::GeRRI: case InstOp::LeRRI: case InstOp::AddRRI:
+    case InstOp::SubRRI: case InstOp::MulRRI: case InstOp::DivRRI:
+    case InstOp::ModRRI: {
+      effect.def = RegOprLoc(inst.opr, 0);
+      use(RegOprLoc(inst.opr, 1));
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      use(RegOprLoc(inst.opr, 0));
+      use(RegOprLoc(inst.opr, 1));
+      break;
+    }
+    default:;
+  }
+  return effect;
+}
+
+std::optional<Loc> minivm::analysis::GetLoadLoc(const VMUnpackedInst &inst) {
+  switch (static_cast<InstOp>(inst.op)) {
+    case InstOp::LdSlot: return Loc{LocKind::Slot, inst.opr};
+    case InstOp::LdGlobal: return Loc{LocKind::Global, inst.opr};
+    case InstOp::LdReg: return Loc{LocKind::Reg, inst.opr};
+    default: return {};
+  }
+}
+
+std::optional<Loc> minivm::analysis::GetStoreLoc(const VMUnpackedInst &inst) {
+  switch (static_cast<InstOp>(inst.op)) {
+    case InstOp::StSlot: case InstOp::StSlotP: {
+      return Loc{LocKind::Slot, inst.opr};
+    }
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      return Loc{LocKind::Global, inst.opr};
+    }
+    case InstOp::StReg: case InstOp::StRegP: {
+      return Loc{LocKind::Reg, inst.opr};
+    }
+    default: return {};
+  }
+}
+
+bool minivm::analysis::IsStoreKeep(InstOp op) {
+  return op == InstOp::StSlotP || op == InstOp::StGlobalP ||
+         op == InstOp::StRegP;
+}
+
+InstOp minivm::analysis::GetLoadOp(LocKind kind) {
+  switch (kind) {
+    case LocKind::Slot: return InstOp::LdSlot;
+    case LocKind::Global: return InstOp::LdGlobal;
+    default: return InstOp::LdReg;
+  }
+}
+
+InstOp minivm::analysis::GetStoreOp(LocKind kind, bool keep) {
+  switch (kind) {
+    case LocKind::Slot: return keep ? InstOp::StSlotP : InstOp::StSlot;
+    case LocKind::Global: return keep ? InstOp::StGlobalP : InstOp::StGlobal;
+    default: return keep ? InstOp::StRegP : InstOp::StReg;
+  }
+}
+
+bool minivm::analysis::IsRegBranch(InstOp op) {
+  switch (op) {
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      return true;
+    }
+    default: return false;
+  }
+}
+
+bool minivm::analysis::IsPureUnary(InstOp op) {
+  return op == InstOp::LNot || op == InstOp::Neg || op == InstOp::ImmHi;
+}
+
+bool minivm::analysis::IsPureBinary(InstOp op) {
+  switch (op) {
+    case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+    case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+    case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::And:
+    case InstOp::Shl: case InstOp::Shr: {
+      // 'Div' and 'Mod' may raise errors
+      return true;
+    }
+    default: return false;
+  }
+}
+
+bool minivm::analysis::IsPureRegOp(InstOp op) {
+  switch (op) {
+    case InstOp::MovRR: case InstOp::MovRI: case InstOp::LAndRRR:
+    case InstOp::LOrRRR: case InstOp::EqRRR: case InstOp::NeRRR:
+    case InstOp::GtRRR: case InstOp::LtRRR: case InstOp::GeRRR:
+    case InstOp::LeRRR: case InstOp::AddRRR: case InstOp::SubRRR:
+    case InstOp::MulRRR: case InstOp::LAndRRI: case InstOp::LOrRRI:
+    case InstOp::EqRRI: case InstOp::NeRRI: case InstOp::GtRRI:
+    case InstOp::LtRRI: case InstOp::GeRRI: case InstOp::LeRRI:
+    case InstOp::AddRRI: case InstOp::SubRRI: case InstOp::MulRRI: {
+      // 'DivR*' and 'ModR*' may raise errors
+      return true;
+    }
+    default: return false;
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef MINIVM_ANALYSIS_EFFECT_H_
+#define MINIVM_ANALYSIS_EFFECT_H_
+
+#include <optional>
+#include <cstdint>
+
+#include "vm/define.h"
+
+namespace minivm::analysis {
+
+// kind of storage locations
+enum class LocKind : std::uint8_t { Slot, Global, Reg };
+
+// storage location that can be accessed by Gopher instructions,
+// a frame slot, a global slot or a static register
+struct Loc {
+  LocKind kind;
+  std::uint32_t index;
+
+  // get the unique key of location, for hashing
+  std::uint64_t key() const {
+    return (static_cast<std::uint64_t>(kind) << 32) | index;
+  }
+
+  bool operator==(const Loc &rhs) const {
+    return kind == rhs.kind && index == rhs.index;
+  }
+  bool operator!=(const Loc &rhs) const { return !(*this == rhs); }
+};
+
+// effects of an instruction on storage locations
+// effects on the operand stack and memory pool are not included
+struct Effect {
+  // locations read by the instruction
+  Loc uses[2];
+  std::uint32_t use_count;
+  // location written by the instruction
+  std::optional<Loc> def;
+  // set if the instruction calls a function, which may read or write
+  // all static registers and global slots
+  bool call;
+  // set if the instruction exits from the current function, callers
+  // may read all static registers and global slots after that
+  bool exit;
+};
+
+// get effects of the specific instruction (before fusion)
+Effect GetEffect(const vm::VMUnpackedInst &inst);
+
+// get location loaded by the specific instruction ('LdSlot', 'LdGlobal'
+// or 'LdReg'), returns null if the instruction is not a load
+std::optional<Loc> GetLoadLoc(const vm::VMUnpackedInst &inst);
+// get location stored by the specific instruction ('St*' or 'St*P'),
+// returns null if the instruction is not a store
+std::optional<Loc> GetStoreLoc(const vm::VMUnpackedInst &inst);
+// check if the specific store instruction keeps the stored value
+// on the operand stack ('St*P')
+bool IsStoreKeep(vm::InstOp op);
+// get opcode of instruction that loads the specific kind of location
+vm::InstOp GetLoadOp(LocKind kind);
+// get opcode of instruction that stores the specific kind of location
+vm::InstOp GetStoreOp(LocKind kind, bool keep);
+
+// check if the specific instruction is a register branch ('BxxRR'),
+// the following 'Jmp' holds its target
+bool IsRegBranch(vm::InstOp op);
+// check if the specific instruction only computes a value from the top
+// value of the operand stack, and has no other side effects
+bool IsPureUnary(vm::InstOp op);
+// check if the specific instruction only computes a value from the top
+// two values of the operand stack, and has no other side effects
+bool IsPureBinary(vm::InstOp op);
+// check if the specific register instruction only computes a value to
+// the destination register, and has no other side effects
+bool IsPureRegOp(vm::InstOp op);
+
+}  // namespace minivm::analysis
+
+#endif  // MINIVM_ANALYSIS_EFFECT_H_
@@ -0,0 +1,132 @@
+#include "analysis/liveness.h"
+
+#include <deque>
+#include <utility>
+
+using namespace minivm::analysis;
+using namespace minivm::vm;
+
+Liveness::Liveness(const VMInstContainer &cont,
+                   const ControlFlowGraph &cfg) {
+  CollectLocs(cont, cfg);
+  ComputeLocalSets(cont, cfg);
+  Solve(cfg);
+}
+
+void Liveness::CollectLocs(const VMInstContainer &cont,
+                           const ControlFlowGraph &cfg) {
+  auto add = [this](Loc loc) {
+    if (loc_ids_.insert({loc.key(), locs_.size()}).second) {
+      locs_.push_back(loc);
+    }
+  };
+  auto range = cfg.range();
+  for (auto pc = range.begin; pc < range.end; ++pc) {
+    auto effect = GetEffect(cont.GetOrigInst(pc));
+    for (std::uint32_t i = 0; i < effect.use_count; ++i) {
+      add(effect.uses[i]);
+    }
+    if (effect.def) add(*effect.def);
+  }
+  escaped_ = BitSet(locs_.size());
+  all_ = BitSet(locs_.size());
+  for (std::uint32_t i = 0; i < locs_.size(); ++i) {
+    if (locs_[i].kind != LocKind::Slot) escaped_.set(i);
+    all_.set(i);
+  }
+}
+
+void Liveness::ComputeLocalSets(const VMInstContainer &cont,
+                                const ControlFlowGraph &cfg) {
+  const auto &blocks = cfg.blocks();
+  gens_.assign(blocks.size(), BitSet(locs_.size()));
+  kills_.assign(blocks.size(), BitSet(locs_.size()));
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    auto &gen = gens_[id], &kill = kills_[id];
+    // add locations that are not defined in the block before
+    auto gen_all = [&gen, &kill](const BitSet &locs) {
+      auto exposed = locs;
+      exposed.Subtract(kill);
+      gen.Union(exposed);
+    };
+    for (auto pc = blocks[id].begin; pc < blocks[id].end; ++pc) {
+      auto inst = cont.GetOrigInst(pc);
+      auto effect = GetEffect(inst);
+      for (std::uint32_t i = 0; i < effect.use_count; ++i) {
+        auto loc = FindLoc(effect.uses[i]);
+        if (!kill.test(loc)) gen.set(loc);
+      }
+      if (effect.call) gen_all(escaped_);
+      if (effect.exit) {
+        gen_all(static_cast<InstOp>(inst.op) == InstOp::Ret ? escaped_
+                                                             : all_);
+      }
+      if (effect.def) kill.set(FindLoc(*effect.def));
+    }
+  }
+}
+
+void Liveness::Solve(const ControlFlowGraph &cfg) {
+  const auto &blocks = cfg.blocks();
+  live_in_ = gens_;
+  live_out_.assign(blocks.size(), BitSet(locs_.size()));
+  // visit blocks in post order first, then unreachable blocks
+  std::deque<BlockId> worklist(cfg.rpo().rbegin(), cfg.rpo().rend());
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    if (!cfg.IsReachable(id)) worklist.push_back(id);
+  }
+  std::vector<bool> in_worklist(blocks.size(), true);
+  while (!worklist.empty()) {
+    auto id = worklist.front();
+    worklist.pop_front();
+    in_worklist[id] = false;
+    // out = union of successors' in, in = gen + (out - kill)
+    auto &out = live_out_[id];
+    for (const auto &succ : blocks[id].succs) out.Union(live_in_[succ]);
+    auto in = out;
+    in.Subtract(kills_[id]);
+    in.Union(gens_[id]);
+    if (in == live_in_[id]) continue;
+    live_in_[id] = std::move(in);
+    for (const auto &pred : blocks[id].preds) {
+      if (!in_worklist[pred]) {
+        in_worklist[pred] = true;
+        worklist.push_back(pred);
+      }
+    }
+  }
+  // release local sets
+  gens_.clear();
+  kills_.clear();
+}
+
+std::uint32_t Liveness::FindLoc(Loc loc) const {
+  auto it = loc_ids_.find(loc.key());
+  return it != loc_ids_.end() ? it->second : kNoLoc;
+}
+
+bool Liveness::IsLiveIn(BlockId id, Loc loc) const {
+  auto i = FindLoc(loc);
+  return i != kNoLoc && live_in_[id].test(i);
+}
+
+bool Liveness::IsLiveOut(BlockId id, Loc loc) const {
+  auto i = FindLoc(loc);
+  return i != kNoLoc && live_out_[id].test(i);
+}
+
+void Liveness::Transfer(const VMUnpackedInst &inst, BitSet &live) const {
+  auto effect = GetEffect(inst);
+  if (effect.exit) {
+    live = static_cast<InstOp>(inst.op) == InstOp::Ret ? escaped_ : all_;
+  }
+  if (effect.call) live.Union(escaped_);
+  if (effect.def) {
+    auto loc = FindLoc(*effect.def);
+    if (loc != kNoLoc) live.reset(loc);
+  }
+  for (std::uint32_t i = 0; i < effect.use_count; ++i) {
+    auto loc = FindLoc(effect.uses[i]);
+    if (loc != kNoLoc) live.set(loc);
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef MINIVM_ANALYSIS_LIVENESS_H_
+#define MINIVM_ANALYSIS_LIVENESS_H_
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+#include "analysis/cfg.h"
+#include "analysis/effect.h"
+#include "analysis/bitset.h"
+
+namespace minivm::analysis {
+
+// invalid location index
+constexpr std::uint32_t kNoLoc = static_cast<std::uint32_t>(-1);
+
+// liveness of storage locations (frame slots, global slots and static
+// registers) accessed by a function
+// calls are treated as reading all static registers and global slots,
+// so are returns, and errors are treated as reading all locations
+class Liveness {
+ public:
+  Liveness(const vm::VMInstContainer &cont, const ControlFlowGraph &cfg);
+
+  // get index of the specific location in live sets,
+  // returns 'kNoLoc' if the location is never accessed by the function
+  std::uint32_t FindLoc(Loc loc) const;
+  // check if the specific location is live at the entry of a block
+  bool IsLiveIn(BlockId id, Loc loc) const;
+  // check if the specific location is live at the exit of a block
+  bool IsLiveOut(BlockId id, Loc loc) const;
+  // update the specific live set backward through an instruction
+  void Transfer(const vm::VMUnpackedInst &inst, BitSet &live) const;
+
+  // getters
+  const std::vector<Loc> &locs() const { return locs_; }
+  const BitSet &live_in(BlockId id) const { return live_in_[id]; }
+  const BitSet &live_out(BlockId id) const { return live_out_[id]; }
+
+ private:
+  // collect all accessed locations
+  void CollectLocs(const vm::VMInstContainer &cont,
+                   const ControlFlowGraph &cfg);
+  // compute upward-exposed uses & definitions of each block
+  void ComputeLocalSets(const vm::VMInstContainer &cont,
+                        const ControlFlowGraph &cfg);
+  // solve data-flow equations
+  void Solve(const ControlFlowGraph &cfg);
+
+  std::vector<Loc> locs_;
+  std::unordered_map<std::uint64_t, std::uint32_t> loc_ids_;
+  // locations that may be read by callees and callers, and all locations
+  BitSet escaped_, all_;
+  // upward-exposed uses & definitions of blocks
+  std::vector<BitSet> gens_, kills_;
+  std::vector<BitSet> live_in_, live_out_;
+};
+
+}  // namespace minivm::analysis
+
+#endif  // MINIVM_ANALYSIS_LIVENESS_H_
@@ -0,0 +1,91 @@
+#include "analysis/loop.h"
+
+#include <algorithm>
+
+using namespace minivm::analysis;
+
+LoopInfo::LoopInfo(const ControlFlowGraph &cfg, const DominatorTree &dom) {
+  FindLoops(cfg, dom);
+  loop_ids_.assign(cfg.blocks().size(), kNoLoop);
+  BuildTree();
+}
+
+void LoopInfo::FindLoops(const ControlFlowGraph &cfg,
+                         const DominatorTree &dom) {
+  // the last loop that visited each block
+  std::vector<LoopId> visited(cfg.blocks().size(), kNoLoop);
+  std::vector<BlockId> worklist;
+  for (const auto &header : cfg.rpo()) {
+    // find back edges
+    std::vector<BlockId> latches;
+    for (const auto &pred : cfg.block(header).preds) {
+      if (dom.Dominates(header, pred)) latches.push_back(pred);
+    }
+    if (latches.empty()) continue;
+    // collect blocks that reach latches without passing the header
+    LoopId id = loops_.size();
+    auto &loop = loops_.emplace_back();
+    loop.header = header;
+    loop.latches = latches;
+    loop.parent = kNoLoop;
+    loop.blocks.push_back(header);
+    visited[header] = id;
+    auto visit = [&](BlockId block) {
+      if (visited[block] == id || !cfg.IsReachable(block)) return;
+      visited[block] = id;
+      loop.blocks.push_back(block);
+      worklist.push_back(block);
+    };
+    for (const auto &latch : latches) visit(latch);
+    while (!worklist.empty()) {
+      auto block = worklist.back();
+      worklist.pop_back();
+      for (const auto &pred : cfg.block(block).preds) visit(pred);
+    }
+  }
+  // sort loops by size, inner loops are always smaller
+  std::stable_sort(loops_.begin(), loops_.end(),
+                   [](const Loop &l, const Loop &r) {
+                     return l.blocks.size() < r.blocks.size();
+                   });
+}
+
+void LoopInfo::BuildTree() {
+  for (LoopId id = 0; id < loops_.size(); ++id) {
+    for (const auto &block : loops_[id].blocks) {
+      auto inner = loop_ids_[block];
+      if (inner == kNoLoop) {
+        loop_ids_[block] = id;
+        continue;
+      }
+      // the outermost loop found so far is nested in the current loop
+      while (loops_[inner].parent != kNoLoop) inner = loops_[inner].parent;
+      if (inner != id) loops_[inner].parent = id;
+    }
+  }
+  // compute depths, outer loops come first in reverse order
+  for (auto it = loops_.rbegin(); it != loops_.rend(); ++it) {
+    it->depth = it->parent == kNoLoop ? 1 : loops_[it->parent].depth + 1;
+  }
+}
+
+bool LoopInfo::Contains(LoopId loop, BlockId id) const {
+  for (auto cur = loop_ids_[id]; cur != kNoLoop; cur = loops_[cur].parent) {
+    if (cur == loop) return true;
+  }
+  return false;
+}
+
+BlockId LoopInfo::FindPreheader(const ControlFlowGraph &cfg,
+                                LoopId loop) const {
+  auto preheader = kNoBlock;
+  for (const auto &pred : cfg.block(loops_[loop].header).preds) {
+    if (!cfg.IsReachable(pred) || Contains(loop, pred)) continue;
+    if (preheader != kNoBlock) return kNoBlock;
+    preheader = pred;
+  }
+  if (preheader == kNoBlock || cfg.block(preheader).succs.size() != 1) {
+    return kNoBlock;
+  }
+  return preheader;
+}
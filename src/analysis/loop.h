@@ -0,0 +1,64 @@
+#ifndef MINIVM_ANALYSIS_LOOP_H_
+#define MINIVM_ANALYSIS_LOOP_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "analysis/cfg.h"
+#include "analysis/dominance.h"
+
+namespace minivm::analysis {
+
+// identifier of loops
+using LoopId = std::uint32_t;
+// invalid loop id
+constexpr LoopId kNoLoop = static_cast<LoopId>(-1);
+
+// natural loop, back edges with the same header are merged
+struct Loop {
+  // header of loop, which dominates all blocks in the loop
+  BlockId header;
+  // all blocks in the loop (including the header and inner loops)
+  std::vector<BlockId> blocks;
+  // sources of back edges
+  std::vector<BlockId> latches;
+  // the innermost loop that contains the current loop
+  LoopId parent;
+  // nesting depth, 1 for outermost loops
+  std::uint32_t depth;
+};
+
+// natural loops of a control flow graph
+// loops are sorted by size, so inner loops come before outer loops
+class LoopInfo {
+ public:
+  LoopInfo(const ControlFlowGraph &cfg, const DominatorTree &dom);
+
+  // get the innermost loop that contains the specific block
+  // returns 'kNoLoop' if the block is not in any loop
+  LoopId FindLoop(BlockId id) const { return loop_ids_[id]; }
+  // check if the specific loop contains the specific block
+  bool Contains(LoopId loop, BlockId id) const;
+  // get the preheader of the specific loop, which is the only predecessor
+  // of the header outside the loop, and whose only successor is the header
+  // returns 'kNoBlock' if not found
+  BlockId FindPreheader(const ControlFlowGraph &cfg, LoopId loop) const;
+
+  // getters
+  const std::vector<Loop> &loops() const { return loops_; }
+  const Loop &loop(LoopId id) const { return loops_[id]; }
+
+ private:
+  // find all natural loops by back edges
+  void FindLoops(const ControlFlowGraph &cfg, const DominatorTree &dom);
+  // build the loop nesting tree
+  void BuildTree();
+
+  std::vector<Loop> loops_;
+  // innermost loop of each block
+  std::vector<LoopId> loop_ids_;
+};
+
+}  // namespace minivm::analysis
+
+#endif  // MINIVM_ANALYSIS_LOOP_H_
@@ -46,6 +46,47 @@ constexpr const char *kStackSize = "StackSize()";
 // breakpoint
 constexpr const char *kBreakpoint = "Break()";
 
+// get C operator of the specific binary operation
+const char *GetOperator(InstOp opcode) {
+  switch (opcode) {
+    case InstOp::LAnd: case InstOp::LAndRRR: case InstOp::LAndRRI:
+      return "&&";
+    case InstOp::LOr: case InstOp::LOrRRR: case InstOp::LOrRRI:
+      return "||";
+    case InstOp::Eq: case InstOp::EqRRR: case InstOp::EqRRI:
+    case InstOp::BeqRR:
+      return "==";
+    case InstOp::Ne: case InstOp::NeRRR: case InstOp::NeRRI:
+    case InstOp::BneRR:
+      return "!=";
+    case InstOp::Gt: case InstOp::GtRRR: case InstOp::GtRRI:
+    case InstOp::BgtRR:
+      return ">";
+    case InstOp::Lt: case InstOp::LtRRR: case InstOp::LtRRI:
+    case InstOp::BltRR:
+      return "<";
+    case InstOp::Ge: case InstOp::GeRRR: case InstOp::GeRRI:
+    case InstOp::BgeRR:
+      return ">=";
+    case InstOp::Le: case InstOp::LeRRR: case InstOp::LeRRI:
+    case InstOp::BleRR:
+      return "<=";
+    case InstOp::Add: case InstOp::AddRRR: case InstOp::AddRRI:
+      return "+";
+    case InstOp::Sub: case InstOp::SubRRR: case InstOp::SubRRI:
+      return "-";
+    case InstOp::Mul: case InstOp::MulRRR: case InstOp::MulRRI:
+      return "*";
+    case InstOp::Div: case InstOp::DivRRR: case InstOp::DivRRI:
+      return "/";
+    case InstOp::Mod: case InstOp::ModRRR: case InstOp::ModRRI:
+      return "%";
+    case InstOp::And:
+      return "&";
+    default: assert(false); return "";
+  }
+}
+
 }  // namespace
 
 std::optional<std::string> CCodeGen::GetSymbol(SymId sym_id, VMAddr pc) {
@@ -74,8 +115,35 @@ std::optional<std::string> CCodeGen::GetSymbol(SymId sym_id, VMAddr pc) {
   }
 }
 
+std::optional<std::string> CCodeGen::GetSymbol(const VMUnpackedInst &inst,
+                                               VMAddr pc) {
+  switch (static_cast<InstOp>(inst.op)) {
+    case InstOp::VarSlot: case InstOp::ArrSlot: case InstOp::LdSlot:
+    case InstOp::StSlot: case InstOp::StSlotP: {
+      // get symbol id from slot table
+      auto slots = cont().FindSlotTable(pc);
+      if (!slots || inst.opr >= slots->size()) {
+        LogError("invalid frame slot", pc);
+        return {};
+      }
+      return GetSymbol((*slots)[inst.opr], pc);
+    }
+    case InstOp::VarGlobal: case InstOp::ArrGlobal: case InstOp::LdGlobal:
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      // get symbol id from global slot table
+      const auto &slots = cont().global_slots();
+      if (inst.opr >= slots.size()) {
+        LogError("invalid global slot", pc);
+        return {};
+      }
+      return GetSymbol(slots[inst.opr], pc);
+    }
+    default: return GetSymbol(inst.opr, pc);
+  }
+}
+
 bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
-                            const VMInst &inst) {
+                            const VMUnpackedInst &inst) {
   // generate pc info
   oss << kIndent << "// pc: " << pc << '\n';
   // generate line info
@@ -91,17 +159,17 @@ bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
   // generate instruction
   auto opcode = static_cast<InstOp>(inst.op);
   switch (opcode) {
-    case InstOp::Var: {
+    case InstOp::Var: case InstOp::VarSlot: {
       // get symbol of variable
-      auto sym = GetSymbol(inst.opr, pc);
+      auto sym = GetSymbol(inst, pc);
       if (!sym) return false;
       // emit C code
       oss << kIndent << "vmopr_t " << *sym << ";\n";
       break;
     }
-    case InstOp::Arr: {
+    case InstOp::Arr: case InstOp::ArrSlot: {
       // get symbol of array
-      auto sym = GetSymbol(inst.opr, pc);
+      auto sym = GetSymbol(inst, pc);
       if (!sym) return false;
       // emit C code
       oss << kIndent << "vmaddr_t " << *sym << " = pool_sp;\n";
@@ -113,9 +181,9 @@ bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
           << kStackPop << "));\n";
       break;
     }
-    case InstOp::LdVar: {
+    case InstOp::LdVar: case InstOp::LdSlot: case InstOp::LdGlobal: {
       // get symbol of variable
-      auto sym = GetSymbol(inst.opr, pc);
+      auto sym = GetSymbol(inst, pc);
       if (!sym) return false;
       // emit C code
       oss << kIndent << kStackPush << '(' << *sym << ");\n";
@@ -133,17 +201,17 @@ bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
       oss << kIndent << "}\n";
       break;
     }
-    case InstOp::StVar: {
+    case InstOp::StVar: case InstOp::StSlot: case InstOp::StGlobal: {
       // get symbol of variable
-      auto sym = GetSymbol(inst.opr, pc);
+      auto sym = GetSymbol(inst, pc);
       if (!sym) return false;
       // emit C code
       oss << kIndent << *sym << " = " << kStackPop << ";\n";
       break;
     }
-    case InstOp::StVarP: {
+    case InstOp::StVarP: case InstOp::StSlotP: case InstOp::StGlobalP: {
       // get symbol of variable
-      auto sym = GetSymbol(inst.opr, pc);
+      auto sym = GetSymbol(inst, pc);
       if (!sym) return false;
       // emit C code
       oss << kIndent << *sym << " = " << kStackPeek << ";\n";
@@ -200,6 +268,10 @@ bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
       oss << kIndent << "goto " << kLabelFuncEnd << ";\n";
       break;
     }
+    case InstOp::Enter: {
+      // parameters are handled in function header
+      break;
+    }
     case InstOp::Break: {
       oss << kIndent << kBreakpoint << ";\n";
       break;
@@ -218,9 +290,54 @@ bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
       oss << kIndent << kStackClear << ";\n";
       break;
     }
+    case InstOp::MovRR: {
+      oss << kIndent << "regs[" << GetRegOpr(inst.opr, 0) << "] = regs["
+          << GetRegOpr(inst.opr, 1) << "];\n";
+      break;
+    }
+    case InstOp::MovRI: {
+      oss << kIndent << "regs[" << GetRegOpr(inst.opr, 0)
+          << "] = (vmopr_t)" << GetRegImm(inst.opr, 1) << ";\n";
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      // branch target is stored in the following 'Jmp',
+      // which will be generated as the body of this 'if' statement
+      oss << kIndent << "if (regs[" << GetRegOpr(inst.opr, 0) << "] "
+          << GetOperator(opcode) << " regs[" << GetRegOpr(inst.opr, 1)
+          << "])\n";
+      break;
+    }
     default: {
       // arithmetic & logical operations
-      if (opcode == InstOp::LNot || opcode == InstOp::Neg) {
+      if (opcode >= InstOp::LAndRRR && opcode <= InstOp::ModRRR) {
+        // register & register
+        oss << kIndent << "regs[" << GetRegOpr(inst.opr, 0) << "] = regs["
+            << GetRegOpr(inst.opr, 1) << "] " << GetOperator(opcode)
+            << " regs[" << GetRegOpr(inst.opr, 2) << "];\n";
+      }
+      else if (opcode >= InstOp::LAndRRI && opcode <= InstOp::ModRRI) {
+        // register & immediate
+        oss << kIndent << "regs[" << GetRegOpr(inst.opr, 0) << "] = regs["
+            << GetRegOpr(inst.opr, 1) << "] " << GetOperator(opcode)
+            << " (vmopr_t)" << GetRegImm(inst.opr, 2) << ";\n";
+      }
+      else if (opcode == InstOp::Shl || opcode == InstOp::Shr) {
+        // shift operation, by the lower 5 bits of the count
+        oss << kIndent << "{\n";
+        oss << kIndent2 << "vmopr_t rhs = " << kStackPop << " & 31;\n";
+        oss << kIndent2 << kStackPoke << '(';
+        if (opcode == InstOp::Shl) {
+          oss << "(vmopr_t)((uint32_t)" << kStackPeek << " << rhs)";
+        }
+        else {
+          oss << kStackPeek << " >> rhs";
+        }
+        oss << ");\n";
+        oss << kIndent << "}\n";
+      }
+      else if (opcode == InstOp::LNot || opcode == InstOp::Neg) {
         // unary operation
         oss << kIndent << kStackPush << '(';
         oss << "-!"[opcode == InstOp::LNot];
@@ -230,24 +347,8 @@ bool CCodeGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
         // binary operation
         oss << kIndent << "{\n";
         oss << kIndent2 << "vmopr_t rhs = " << kStackPop << ";\n";
-        oss << kIndent2 << kStackPoke << '(' << kStackPeek << ' ';
-        switch (opcode) {
-          case InstOp::LAnd: oss << "&&"; break;
-          case InstOp::LOr: oss << "||"; break;
-          case InstOp::Eq: oss << "=="; break;
-          case InstOp::Ne: oss << "!="; break;
-          case InstOp::Gt: oss << ">"; break;
-          case InstOp::Lt: oss << "<"; break;
-          case InstOp::Ge: oss << ">="; break;
-          case InstOp::Le: oss << "<="; break;
-          case InstOp::Add: oss << '+'; break;
-          case InstOp::Sub: oss << '-'; break;
-          case InstOp::Mul: oss << '*'; break;
-          case InstOp::Div: oss << '/'; break;
-          case InstOp::Mod: oss << '%'; break;
-          default: assert(false);
-        }
-        oss << " rhs);\n";
+        oss << kIndent2 << kStackPoke << '(' << kStackPeek << ' '
+            << GetOperator(opcode) << " rhs);\n";
         oss << kIndent << "}\n";
       }
     }
@@ -304,18 +405,18 @@ void CCodeGen::GenerateOnEntry(VMAddr pc, const FuncBody &func) {
     // generate instructions
     switch (static_cast<InstOp>(inst.op)) {
       // global variables
-      case InstOp::Var: {
+      case InstOp::VarGlobal: {
         // get symbol of variable
-        auto sym = GetSymbol(inst.opr, pc);
+        auto sym = GetSymbol(inst, pc);
         if (!sym) return;
         // emit C code
         global_ << "static vmopr_t " << *sym << ";\n";
         break;
       }
       // global arrays
-      case InstOp::Arr: {
+      case InstOp::ArrGlobal: {
         // get symbol of array
-        auto sym = GetSymbol(inst.opr, pc);
+        auto sym = GetSymbol(inst, pc);
         if (!sym) return;
         // emit C code
         global_ << "static vmaddr_t " << *sym << ";\n";
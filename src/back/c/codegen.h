@@ -28,10 +28,13 @@ class CCodeGen : public CodeGenerator {
  private:
   // get symbol name for C code generation
   std::optional<std::string> GetSymbol(vm::SymId sym_id, vm::VMAddr pc);
+  // get symbol name of operand, frame slots are converted to symbols
+  std::optional<std::string> GetSymbol(const vm::VMUnpackedInst &inst,
+                                       vm::VMAddr pc);
   // push value to stack
   // generate instruction
   bool GenerateInst(std::ostringstream &oss, vm::VMAddr pc,
-                    const vm::VMInst &inst);
+                    const vm::VMUnpackedInst &inst);
 
   // generate Tigger mode code
   bool tigger_mode_;
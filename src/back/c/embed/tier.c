@@ -0,0 +1,65 @@
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t vmopr_t;
+typedef uint32_t vmaddr_t;
+
+// status of native functions, must be consistent with 'NativeStatus'
+enum {
+  kStatusError,
+  kStatusRet,
+  kStatusRetValue,
+  kStatusNoEntry,
+  kStatusNoStack,
+};
+
+// context of native functions, must be consistent with 'TierContext'
+typedef struct VMTierContext VMTierContext;
+typedef int (*VMNativeFunc)(VMTierContext *ctx, const vmopr_t *params,
+                            vmaddr_t count, vmaddr_t entry, vmopr_t *ret);
+struct VMTierContext {
+  void *vm;
+  vmopr_t *gp;
+  vmopr_t *regs;
+  size_t stack_left;
+  void *(*get_addr)(void *vm, vmopr_t id);
+  vmopr_t (*alloc)(void *vm, vmopr_t size, _Bool init);
+  uint32_t (*save_state)(void *vm);
+  void (*restore_state)(void *vm, uint32_t state);
+  int (*call_ext)(void *vm, vmaddr_t pc, uint32_t sym, const vmopr_t *params,
+                  vmaddr_t count, vmopr_t *ret);
+  int (*call_vm)(void *vm, vmaddr_t pc, vmaddr_t func, const vmopr_t *params,
+                 vmaddr_t count, vmopr_t *ret);
+  void (*error)(void *vm, vmaddr_t pc, uint32_t code);
+  VMNativeFunc *funcs;
+};
+
+// read the i-th parameter, or the i-th slot when entering at a label
+#define PARAM(i) ((i) < count ? params[i] : (vmopr_t)0xdeadc0de)
+// log error and exit
+#define ERROR(pc, code)                \
+  do {                                 \
+    ctx->error(ctx->vm, (pc), (code)); \
+    return kStatusError;               \
+  } while (0)
+// reserve native stack for the current function, the caller
+// runs the function by the interpreter if the stack has run out
+#define ENTER(size)                                      \
+  do {                                                   \
+    if (ctx->stack_left < (size)) return kStatusNoStack; \
+    ctx->stack_left -= (size);                           \
+  } while (0)
+#define LEAVE(size) ctx->stack_left += (size)
+// get address of memory pool
+#define ADDR(ptr, id, pc)                           \
+  do {                                              \
+    ptr = (vmopr_t *)ctx->get_addr(ctx->vm, (id));  \
+    if (!ptr) ERROR(pc, ERR_INVALID_MEM_POOL_ADDR); \
+  } while (0)
+// arithmetic operations that wrap around on overflow
+#define ADD(a, b) ((vmopr_t)((uint32_t)(a) + (uint32_t)(b)))
+#define SUB(a, b) ((vmopr_t)((uint32_t)(a) - (uint32_t)(b)))
+#define MUL(a, b) ((vmopr_t)((uint32_t)(a) * (uint32_t)(b)))
+// shift operations, by the lower 5 bits of the count
+#define SHL(a, b) ((vmopr_t)((uint32_t)(a) << ((b) & 31)))
+#define SHR(a, b) ((vmopr_t)(a) >> ((b) & 31))
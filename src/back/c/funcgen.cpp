@@ -0,0 +1,482 @@
+#include "back/c/funcgen.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+#include "xstl/embed.h"
+
+using namespace minivm::back::c;
+using namespace minivm::vm;
+
+// embbedded C code snippets
+XSTL_EMBED_STR(kCCodeTier, "back/c/embed/tier.c");
+#ifdef LET_CMAKE_KNOW_THERE_IS_AN_EMBEDDED_FILE
+#include "back/c/embed/tier.c"
+#endif
+
+namespace {
+
+// indention
+constexpr const char *kIndent = "  ";
+// indention x2
+constexpr const char *kIndent2 = "    ";
+// prefix of label
+constexpr const char *kPrefixLabel = "label";
+// prefix of function
+constexpr const char *kPrefixFunc = "VMFunc";
+// prefix of slot
+constexpr const char *kPrefixSlot = "s";
+// prefix of temporary
+constexpr const char *kPrefixTemp = "t";
+// label of function end
+constexpr const char *kLabelFuncEnd = "label_end";
+// function for registering all generated functions
+constexpr const char *kRegisterFunc = "VMTierRegister";
+// parameter list of functions
+constexpr const char *kFuncParams =
+    "(VMTierContext *ctx, const vmopr_t *params, vmaddr_t count, "
+    "vmaddr_t entry, vmopr_t *ret)";
+// estimated size of native stack frame, excluding slots & temporaries
+constexpr std::size_t kFrameSize = 128;
+
+// get the C expression of the specific binary operation
+std::string GetBinaryExpr(InstOp opcode, const std::string &lhs,
+                          const std::string &rhs) {
+  const char *op;
+  switch (opcode) {
+    case InstOp::LAnd: op = "&&"; break;
+    case InstOp::LOr: op = "||"; break;
+    case InstOp::Eq: op = "=="; break;
+    case InstOp::Ne: op = "!="; break;
+    case InstOp::Gt: op = ">"; break;
+    case InstOp::Lt: op = "<"; break;
+    case InstOp::Ge: op = ">="; break;
+    case InstOp::Le: op = "<="; break;
+    case InstOp::Div: op = "/"; break;
+    case InstOp::Mod: op = "%"; break;
+    case InstOp::And: op = "&"; break;
+    // signed overflow is undefined in C
+    case InstOp::Add: return "ADD(" + lhs + ", " + rhs + ")";
+    case InstOp::Sub: return "SUB(" + lhs + ", " + rhs + ")";
+    case InstOp::Mul: return "MUL(" + lhs + ", " + rhs + ")";
+    case InstOp::Shl: return "SHL(" + lhs + ", " + rhs + ")";
+    case InstOp::Shr: return "SHR(" + lhs + ", " + rhs + ")";
+    default: assert(false); return "";
+  }
+  return lhs + ' ' + op + ' ' + rhs;
+}
+
+// get the base operation of register instructions
+InstOp GetRegOp(InstOp opcode) {
+  static const InstOp kOps[] = {
+      InstOp::LAnd, InstOp::LOr, InstOp::Eq,  InstOp::Ne,  InstOp::Gt,
+      InstOp::Lt,   InstOp::Ge,  InstOp::Le,  InstOp::Add, InstOp::Sub,
+      InstOp::Mul,  InstOp::Div, InstOp::Mod,
+  };
+  static const InstOp kBranchOps[] = {
+      InstOp::Eq, InstOp::Ne, InstOp::Lt, InstOp::Le, InstOp::Gt, InstOp::Ge,
+  };
+  if (opcode >= InstOp::LAndRRR && opcode <= InstOp::ModRRR) {
+    return kOps[static_cast<int>(opcode) - static_cast<int>(InstOp::LAndRRR)];
+  }
+  if (opcode >= InstOp::LAndRRI && opcode <= InstOp::ModRRI) {
+    return kOps[static_cast<int>(opcode) - static_cast<int>(InstOp::LAndRRI)];
+  }
+  assert(opcode >= InstOp::BeqRR && opcode <= InstOp::BgeRR);
+  return kBranchOps[static_cast<int>(opcode) -
+                    static_cast<int>(InstOp::BeqRR)];
+}
+
+// get string of register
+std::string Reg(std::uint32_t reg_id) {
+  return "regs[" + std::to_string(reg_id) + "]";
+}
+
+// get string of immediate
+std::string Imm(VMOpr imm) {
+  return "(vmopr_t)" + std::to_string(static_cast<std::uint32_t>(imm)) +
+         'u';
+}
+
+}  // namespace
+
+std::string CFuncGen::Top(std::size_t i) const {
+  return kPrefixTemp + std::to_string(depth_ - 1 - i);
+}
+
+std::string CFuncGen::Push() {
+  ++depth_;
+  max_depth_ = std::max(max_depth_, depth_);
+  return Top(0);
+}
+
+bool CFuncGen::LogLabel(VMAddr label) {
+  auto ret = label_depths_.insert({label, depth_});
+  return ret.second || ret.first->second == depth_;
+}
+
+void CFuncGen::GenerateCall(std::ostringstream &oss,
+                            const std::string &call,
+                            const std::string &fallback) {
+  // pass all values on the stack as parameters
+  oss << kIndent << "{\n";
+  oss << kIndent2 << "vmopr_t args[] = {";
+  for (std::size_t i = 0; i < depth_; ++i) {
+    if (i) oss << ", ";
+    oss << kPrefixTemp << i;
+  }
+  if (!depth_) oss << '0';
+  oss << "};\n";
+  if (fallback.empty()) {
+    oss << kIndent2 << "if (!" << call << ") return kStatusError;\n";
+  }
+  else {
+    oss << kIndent2 << "status = " << call << ";\n";
+    oss << kIndent2 << "if (status == kStatusNoStack) status = " << fallback
+        << ";\n";
+    oss << kIndent2 << "if (!status) return kStatusError;\n";
+  }
+  oss << kIndent << "}\n";
+  // the return value of Eeyore functions is pushed to the stack,
+  // and Tigger functions return values by registers
+  depth_ = 0;
+  if (!tigger_mode_) oss << kIndent << Push() << " = rv;\n";
+}
+
+bool CFuncGen::GenerateInst(std::ostringstream &oss, VMAddr pc,
+                            const VMUnpackedInst &inst) {
+  // generate label, and get stack depth of it
+  auto is_label = IsLabel(pc);
+  if (is_label) {
+    if (!reachable_) {
+      // only reachable by jumps
+      auto it = label_depths_.find(pc);
+      depth_ = it != label_depths_.end() ? it->second : 0;
+      reachable_ = true;
+    }
+    if (!LogLabel(pc)) return false;
+    oss << kPrefixLabel << pc << ":\n";
+  }
+  if (!reachable_) return true;
+  auto reg_branch = reg_branch_;
+  reg_branch_ = false;
+  // generate instruction
+  auto opcode = static_cast<InstOp>(inst.op);
+  auto opr = std::to_string(inst.opr);
+  switch (opcode) {
+    case InstOp::Var: case InstOp::Arr: case InstOp::LdVar:
+    case InstOp::StVar: case InstOp::StVarP: {
+      // symbols should have been resolved when sealing the container
+      oss << kIndent << "ERROR(" << pc << ", ERR_SYMBOL_NOT_FOUND);\n";
+      reachable_ = false;
+      break;
+    }
+    case InstOp::VarSlot: {
+      oss << kIndent << kPrefixSlot << opr << " = (vmopr_t)0xdeadc0de;\n";
+      break;
+    }
+    case InstOp::ArrSlot: case InstOp::ArrGlobal: {
+      if (depth_ < 1) return false;
+      auto is_slot = opcode == InstOp::ArrSlot;
+      oss << kIndent;
+      if (is_slot) {
+        oss << kPrefixSlot << opr;
+      }
+      else {
+        oss << "gp[" << opr << ']';
+      }
+      oss << " = ctx->alloc(ctx->vm, " << Top(0) << ", " << !is_slot
+          << ");\n";
+      --depth_;
+      has_arr_ = true;
+      break;
+    }
+    case InstOp::VarGlobal: {
+      oss << kIndent << "gp[" << opr << "] = 0;\n";
+      break;
+    }
+    case InstOp::Ld: {
+      if (depth_ < 1) return false;
+      oss << kIndent << "ADDR(ptr, " << Top(0) << ", " << pc << ");\n";
+      oss << kIndent << Top(0) << " = *ptr;\n";
+      break;
+    }
+    case InstOp::St: {
+      if (depth_ < 2) return false;
+      oss << kIndent << "ADDR(ptr, " << Top(0) << ", " << pc << ");\n";
+      oss << kIndent << "*ptr = " << Top(1) << ";\n";
+      depth_ -= 2;
+      break;
+    }
+    case InstOp::LdSlot: {
+      oss << kIndent << Push() << " = " << kPrefixSlot << opr << ";\n";
+      break;
+    }
+    case InstOp::LdGlobal: {
+      oss << kIndent << Push() << " = gp[" << opr << "];\n";
+      break;
+    }
+    case InstOp::LdReg: {
+      oss << kIndent << Push() << " = " << Reg(inst.opr) << ";\n";
+      break;
+    }
+    case InstOp::StSlot: case InstOp::StSlotP: {
+      if (depth_ < 1) return false;
+      oss << kIndent << kPrefixSlot << opr << " = " << Top(0) << ";\n";
+      if (opcode == InstOp::StSlot) --depth_;
+      break;
+    }
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      if (depth_ < 1) return false;
+      oss << kIndent << "gp[" << opr << "] = " << Top(0) << ";\n";
+      if (opcode == InstOp::StGlobal) --depth_;
+      break;
+    }
+    case InstOp::StReg: case InstOp::StRegP: {
+      if (depth_ < 1) return false;
+      oss << kIndent << Reg(inst.opr) << " = " << Top(0) << ";\n";
+      if (opcode == InstOp::StReg) --depth_;
+      break;
+    }
+    case InstOp::Imm: {
+      oss << kIndent << Push() << " = " << Imm(ExtendImm(inst.opr))
+          << ";\n";
+      break;
+    }
+    case InstOp::ImmHi: {
+      if (depth_ < 1) return false;
+      constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+      constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
+      oss << kIndent << Top(0) << " = (vmopr_t)(((uint32_t)" << Top(0)
+          << " & " << kMaskLo << "u) | "
+          << ((inst.opr & kMaskHi) << kVMInstImmLen) << "u);\n";
+      break;
+    }
+    case InstOp::Bnz: {
+      if (depth_ < 1) return false;
+      oss << kIndent << "if (" << Top(0) << ") goto " << kPrefixLabel
+          << opr << ";\n";
+      --depth_;
+      if (!LogLabel(inst.opr)) return false;
+      break;
+    }
+    case InstOp::Jmp: {
+      // the body of the last register branch if 'reg_branch' is set
+      oss << kIndent << "goto " << kPrefixLabel << opr << ";\n";
+      if (!LogLabel(inst.opr)) return false;
+      if (!reg_branch) reachable_ = false;
+      break;
+    }
+    case InstOp::Call: {
+      // call directly if the callee is in the same unit,
+      // otherwise call through the function table
+      std::ostringstream call;
+      if (funcs_.count(inst.opr)) {
+        call << kPrefixFunc << opr;
+      }
+      else {
+        call << "ctx->funcs[" << opr << ']';
+      }
+      call << "(ctx, args, " << depth_ << ", 0, &rv)";
+      // the callee is run by the interpreter if the native stack has
+      // run out, the interpreter does not consume the native stack
+      std::ostringstream fallback;
+      fallback << "ctx->call_vm(ctx->vm, " << pc << ", " << opr
+               << ", args, " << depth_ << ", &rv)";
+      GenerateCall(oss, call.str(), fallback.str());
+      break;
+    }
+    case InstOp::CallExt: {
+      std::ostringstream call;
+      call << "ctx->call_ext(ctx->vm, " << pc << ", " << opr << ", args, "
+           << depth_ << ", &rv)";
+      GenerateCall(oss, call.str(), "");
+      break;
+    }
+    case InstOp::Ret: {
+      // Tigger functions return values by registers
+      if (depth_ > (tigger_mode_ ? 0 : 1)) return false;
+      if (depth_) {
+        oss << kIndent << "*ret = " << Top(0) << ";\n";
+        oss << kIndent << "status = kStatusRetValue;\n";
+      }
+      else {
+        oss << kIndent << "status = kStatusRet;\n";
+      }
+      oss << kIndent << "goto " << kLabelFuncEnd << ";\n";
+      reachable_ = false;
+      break;
+    }
+    case InstOp::Error: {
+      oss << kIndent << "ERROR(" << pc << ", " << opr << ");\n";
+      reachable_ = false;
+      break;
+    }
+    case InstOp::LNot: case InstOp::Neg: {
+      if (depth_ < 1) return false;
+      oss << kIndent << Top(0) << " = ";
+      if (opcode == InstOp::LNot) {
+        oss << '!' << Top(0);
+      }
+      else {
+        oss << "(vmopr_t)-(uint32_t)" << Top(0);
+      }
+      oss << ";\n";
+      break;
+    }
+    case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+    case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+    case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::Div:
+    case InstOp::Mod: case InstOp::And: case InstOp::Shl: case InstOp::Shr: {
+      if (depth_ < 2) return false;
+      oss << kIndent << Top(1) << " = "
+          << GetBinaryExpr(opcode, Top(1), Top(0)) << ";\n";
+      --depth_;
+      break;
+    }
+    case InstOp::Pop: {
+      if (depth_ < 1) return false;
+      if (is_label) oss << kIndent << ";\n";
+      --depth_;
+      break;
+    }
+    case InstOp::Clear: {
+      if (is_label) oss << kIndent << ";\n";
+      depth_ = 0;
+      break;
+    }
+    case InstOp::MovRR: {
+      oss << kIndent << Reg(GetRegOpr(inst.opr, 0)) << " = "
+          << Reg(GetRegOpr(inst.opr, 1)) << ";\n";
+      break;
+    }
+    case InstOp::MovRI: {
+      oss << kIndent << Reg(GetRegOpr(inst.opr, 0)) << " = "
+          << Imm(GetRegImm(inst.opr, 1)) << ";\n";
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      // branch target is stored in the following 'Jmp',
+      // which will be generated as the body of this 'if' statement
+      oss << kIndent << "if ("
+          << GetBinaryExpr(GetRegOp(opcode), Reg(GetRegOpr(inst.opr, 0)),
+                           Reg(GetRegOpr(inst.opr, 1)))
+          << ")\n";
+      reg_branch_ = true;
+      break;
+    }
+    default: {
+      if (opcode >= InstOp::LAndRRR && opcode <= InstOp::ModRRR) {
+        // register & register
+        oss << kIndent << Reg(GetRegOpr(inst.opr, 0)) << " = "
+            << GetBinaryExpr(GetRegOp(opcode), Reg(GetRegOpr(inst.opr, 1)),
+                             Reg(GetRegOpr(inst.opr, 2)))
+            << ";\n";
+      }
+      else if (opcode >= InstOp::LAndRRI && opcode <= InstOp::ModRRI) {
+        // register & immediate
+        oss << kIndent << Reg(GetRegOpr(inst.opr, 0)) << " = "
+            << GetBinaryExpr(GetRegOp(opcode), Reg(GetRegOpr(inst.opr, 1)),
+                             Imm(GetRegImm(inst.opr, 2)))
+            << ";\n";
+      }
+      else {
+        // 'Enter' in the middle of function, breakpoints, etc.
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void CFuncGen::Reset() {
+  generated_.clear();
+  failed_funcs_.clear();
+  code_.str("");
+  code_.clear();
+}
+
+void CFuncGen::GenerateOnFunc(VMAddr pc, const FuncBody &func) {
+  if (!funcs_.count(pc)) return;
+  // the first instruction must be 'Enter'
+  if (func.empty() || static_cast<InstOp>(func[0].op) != InstOp::Enter) {
+    failed_funcs_.insert(pc);
+    return;
+  }
+  auto slot_count = func[0].opr;
+  // generate function body
+  depth_ = max_depth_ = 0;
+  reachable_ = true;
+  reg_branch_ = false;
+  has_arr_ = false;
+  label_depths_.clear();
+  std::ostringstream body;
+  for (std::size_t i = 1; i < func.size(); ++i) {
+    if (!GenerateInst(body, pc + i, func[i])) {
+      failed_funcs_.insert(pc);
+      return;
+    }
+  }
+  // generate function header, all slots are read from parameters,
+  // which are slots of the current frame when entering at a label
+  auto frame_size = kFrameSize + (slot_count + max_depth_) * 4;
+  code_ << "static int " << kPrefixFunc << pc << kFuncParams << " {\n";
+  for (std::uint32_t i = 0; i < slot_count; ++i) {
+    code_ << kIndent << "vmopr_t " << kPrefixSlot << i << " = PARAM(" << i
+          << ");\n";
+  }
+  for (std::size_t i = 0; i < max_depth_; ++i) {
+    code_ << kIndent << "vmopr_t " << kPrefixTemp << i << ";\n";
+  }
+  code_ << kIndent << "vmopr_t *gp = ctx->gp, *regs = ctx->regs, *ptr;\n";
+  code_ << kIndent << "vmopr_t rv;\n";
+  code_ << kIndent << "int status;\n";
+  if (has_arr_) code_ << kIndent << "uint32_t pool_state;\n";
+  code_ << kIndent << "ENTER(" << frame_size << ");\n";
+  if (has_arr_) {
+    code_ << kIndent << "pool_state = ctx->save_state(ctx->vm);\n";
+  }
+  // generate entries, only labels with empty stack can be entered
+  code_ << kIndent << "switch (entry) {\n";
+  code_ << kIndent2 << "case 0: break;\n";
+  for (const auto &[label, depth] : label_depths_) {
+    if (depth || !IsLabel(label)) continue;
+    code_ << kIndent2 << "case " << label << ": goto " << kPrefixLabel
+          << label << ";\n";
+  }
+  code_ << kIndent2 << "default: status = kStatusNoEntry; goto "
+        << kLabelFuncEnd << ";\n";
+  code_ << kIndent << "}\n\n";
+  // generate function body & return
+  code_ << body.str() << '\n';
+  code_ << kLabelFuncEnd << ":\n";
+  if (has_arr_) {
+    code_ << kIndent << "ctx->restore_state(ctx->vm, pool_state);\n";
+  }
+  code_ << kIndent << "LEAVE(" << frame_size << ");\n";
+  code_ << kIndent << "(void)gp, (void)regs, (void)ptr, (void)rv;\n";
+  code_ << kIndent << "return status;\n";
+  code_ << "}\n\n";
+  generated_.push_back(pc);
+}
+
+void CFuncGen::Dump(std::ostream &os) const {
+  // error codes & code snippets
+  os << "#define ERR_SYMBOL_NOT_FOUND " << kVMErrorSymbolNotFound << '\n';
+  os << "#define ERR_INVALID_MEM_POOL_ADDR " << kVMErrorInvalidMemPoolAddr
+     << '\n';
+  os << kCCodeTier << '\n';
+  // declarations & definitions
+  for (const auto &pc : generated_) {
+    os << "static int " << kPrefixFunc << pc << kFuncParams << ";\n";
+  }
+  os << '\n' << code_.str();
+  // register all generated functions to the function table
+  os << "void " << kRegisterFunc << "(VMNativeFunc *funcs) {\n";
+  for (const auto &pc : generated_) {
+    os << kIndent << "funcs[" << pc << "] = " << kPrefixFunc << pc << ";\n";
+  }
+  os << "}\n";
+}
@@ -0,0 +1,79 @@
+#ifndef MINIVM_BACK_C_FUNCGEN_H_
+#define MINIVM_BACK_C_FUNCGEN_H_
+
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <utility>
+#include <cstddef>
+
+#include "back/codegen.h"
+
+namespace minivm::back::c {
+
+// C code generator for tiered execution
+// generates native functions for the specific Gopher functions, which
+// run on the state of a VM instance (global segment, static registers
+// and memory pool), local slots and the operand stack are mapped to
+// C variables, and external functions are called through the VM
+class CFuncGen : public CodeGenerator {
+ public:
+  CFuncGen(const vm::VMInstContainer &cont, bool tigger_mode,
+           std::unordered_set<vm::VMAddr> funcs)
+      : CodeGenerator(cont), tigger_mode_(tigger_mode),
+        funcs_(std::move(funcs)) {}
+
+  void Dump(std::ostream &os) const override;
+
+  // getter, functions that can not be compiled
+  const std::unordered_set<vm::VMAddr> &failed_funcs() const {
+    return failed_funcs_;
+  }
+
+ protected:
+  void Reset() override;
+  void GenerateOnFunc(vm::VMAddr pc, const FuncBody &func) override;
+  void GenerateOnEntry(vm::VMAddr, const FuncBody &) override {}
+
+ private:
+  // generate instruction
+  bool GenerateInst(std::ostringstream &oss, vm::VMAddr pc,
+                    const vm::VMUnpackedInst &inst);
+  // generate function call, parameters are all values on the stack
+  // 'fallback' is called instead if 'call' finds no native stack
+  void GenerateCall(std::ostringstream &oss, const std::string &call,
+                    const std::string &fallback);
+  // update stack depth of the specific label
+  // returns 'false' if the depth is not consistent
+  bool LogLabel(vm::VMAddr label);
+  // get the temporary of the i-th value from the top of stack
+  std::string Top(std::size_t i) const;
+  // push a new value to stack, returns its temporary
+  std::string Push();
+
+  // generate Tigger mode code
+  bool tigger_mode_;
+  // functions to be generated
+  std::unordered_set<vm::VMAddr> funcs_;
+  // functions that have been generated/failed to generate
+  std::vector<vm::VMAddr> generated_;
+  std::unordered_set<vm::VMAddr> failed_funcs_;
+  // generated function definitions
+  std::ostringstream code_;
+  // current depth & maximum depth of stack
+  std::size_t depth_, max_depth_;
+  // set if the current instruction is reachable
+  bool reachable_;
+  // set if the last instruction is a register branch
+  bool reg_branch_;
+  // set if the current function allocates memory in memory pool
+  bool has_arr_;
+  // stack depths of labels in the current function
+  std::unordered_map<vm::VMAddr, std::size_t> label_depths_;
+};
+
+}  // namespace minivm::back::c
+
+#endif  // MINIVM_BACK_C_FUNCGEN_H_
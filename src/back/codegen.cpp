@@ -1,59 +1,42 @@
 #include "back/codegen.h"
 
 #include <iostream>
-#include <cassert>
 #include <cstddef>
 
 #include "xstl/style.h"
+#include "analysis/cfg.h"
 
 using namespace minivm::back;
 using namespace minivm::vm;
+using namespace minivm::analysis;
 
 void CodeGenerator::CollectLabelInfo() {
-  // traverse all instructions
-  for (VMAddr i = 0; i < cont_.inst_count(); ++i) {
-    const auto &inst = cont_.insts()[i];
-    // handle by opcode
-    switch (static_cast<InstOp>(inst.op)) {
-      case InstOp::Bnz: {
-        // in-block label
-        labels_.insert(inst.opr);
-        break;
-      }
-      case InstOp::Jmp: {
-        // check if is the first instruction (Jmp kVMEntry)
-        if (!i) {
-          // treat 'kVMEntry' as the entry function
-          entry_pc_ = inst.opr;
-        }
-        else {
-          // in-block label
-          labels_.insert(inst.opr);
-        }
-        break;
-      }
-      // ignore all other instructions
-      default:;
+  // labels are blocks that are targets of branches
+  auto collect = [this](FuncRange range) {
+    ControlFlowGraph cfg(cont_, range);
+    for (const auto &block : cfg.blocks()) {
+      if (block.is_target) labels_.insert(block.begin);
     }
-  }
+  };
+  for (const auto &range : GetFuncRanges(cont_)) collect(range);
+  collect(GetEntryRange(cont_));
 }
 
 void CodeGenerator::BuildFunctions() {
-  FuncBody *cur_func = nullptr;
-  // traverse all instructions
-  // except the first instruction (Jmp kVMEntry)
-  assert(static_cast<InstOp>(cont_.insts()->op) == InstOp::Jmp);
-  for (VMAddr i = 1; i < cont_.inst_count(); ++i) {
-    // check if is boundary of a function
-    if (i == entry_pc_) {
-      cur_func = &entry_func_;
-    }
-    else if (cont_.func_pcs().count(i)) {
-      cur_func = &funcs_.emplace_back(i, FuncBody()).second;
+  // push instructions to functions, except the first instruction
+  // (Jmp kVMEntry), superinstructions are not used, let the C compiler
+  // do the job
+  auto build = [this](FuncRange range, FuncBody &func) {
+    for (auto pc = range.begin; pc < range.end; ++pc) {
+      func.push_back(cont_.GetOrigInst(pc));
     }
-    // push instruction to the current function
-    cur_func->push_back(cont_.insts()[i]);
+  };
+  for (const auto &range : GetFuncRanges(cont_)) {
+    build(range, funcs_.emplace_back(range.begin, FuncBody()).second);
   }
+  auto entry = GetEntryRange(cont_);
+  entry_pc_ = entry.begin;
+  build(entry, entry_func_);
 }
 
 void CodeGenerator::LogError(std::string_view message, vm::VMAddr pc) {
@@ -28,7 +28,7 @@ class CodeGenerator {
 
  protected:
   // function body
-  using FuncBody = std::vector<vm::VMInst>;
+  using FuncBody = std::vector<vm::VMUnpackedInst>;
 
   // check if there is a label on the specific address
   bool IsLabel(vm::VMAddr addr) const { return labels_.count(addr); }
@@ -412,35 +412,40 @@ void MiniDebugger::PrintStackInfo() {
   }
 }
 
-void MiniDebugger::PrintEnv(const VM::EnvPtr &env) {
-  if (env->empty()) {
+void MiniDebugger::PrintEnv(const VMOpr *env, std::size_t size,
+                            const VMInstContainer::SlotTable *slots) {
+  // get count of named slots
+  auto count = slots ? std::min(slots->size(), size) : 0;
+  if (!count) {
     std::cout << "  <empty>" << std::endl;
   }
   else {
-    for (const auto &[sym_id, val] : *env) {
-      auto sym = vm_.sym_pool().FindSymbol(sym_id);
+    for (std::size_t i = 0; i < count; ++i) {
+      auto sym = vm_.sym_pool().FindSymbol((*slots)[i]);
       assert(sym);
-      std::cout << "  " << *sym << " = " << val << std::endl;
+      std::cout << "  " << *sym << " = " << env[i] << std::endl;
     }
   }
 }
 
 void MiniDebugger::PrintEnvInfo() {
-  const auto &[env, addr] = vm_.env_addr_pair();
-  std::cout << "return address: " << addr << std::endl;
+  const auto &frames = vm_.frames();
+  const auto &global_env = vm_.global_env();
+  std::cout << "return address: " << frames.ret_addr() << std::endl;
   std::cout << "current environment:" << std::endl;
-  PrintEnv(env);
+  PrintEnv(frames.fp(), frames.slot_count(),
+           vm_.cont().FindSlotTable(vm_.pc()));
   std::cout << "global environment:" << std::endl;
-  PrintEnv(vm_.global_env());
+  PrintEnv(global_env.data(), global_env.size(),
+           &vm_.cont().global_slots());
 }
 
 void MiniDebugger::PrintRegInfo() {
   // print PC
   std::cout << "current PC address: " << vm_.pc() << std::endl;
   // check if in Tigger mode
-  const auto &env = vm_.env_addr_pair().first;
   auto id = vm_.sym_pool().FindId(kVMFrame);
-  if (!id || env->find(*id) == env->end()) {
+  if (!id || !vm_.GetLocalAddr(*id)) {
     return LogError("MiniVM may not currently run in Tigger mode, "
                     "static registers should not be used.");
   }
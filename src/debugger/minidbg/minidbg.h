@@ -4,6 +4,7 @@
 #include <string_view>
 #include <optional>
 #include <unordered_map>
+#include <cstddef>
 #include <cstdint>
 
 #include "debugger/debugger.h"
@@ -89,7 +90,8 @@ class MiniDebugger : public DebuggerBase {
   // print operand stack info
   void PrintStackInfo();
   // print environment info
-  void PrintEnv(const vm::VM::EnvPtr &env);
+  void PrintEnv(const vm::VMOpr *env, std::size_t size,
+                const vm::VMInstContainer::SlotTable *slots);
   void PrintEnvInfo();
   // print static register info
   void PrintRegInfo();
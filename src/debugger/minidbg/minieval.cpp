@@ -20,12 +20,9 @@ std::optional<VMOpr> MiniEvaluator::GetSymVal(std::string_view sym) {
   auto id = vm_.sym_pool().FindId(sym);
   if (!id) return {};
   // try to find in current environment
-  const auto &env = vm_.env_addr_pair().first;
-  auto it = env->find(*id);
-  if (it != env->end()) return it->second;
+  if (auto ptr = vm_.GetLocalAddr(*id)) return *ptr;
   // try to find in global environment
-  it = vm_.global_env()->find(*id);
-  if (it != vm_.global_env()->end()) return it->second;
+  if (auto ptr = vm_.GetGlobalAddr(*id)) return *ptr;
   return {};
 }
 
@@ -35,9 +32,8 @@ std::optional<VMOpr> MiniEvaluator::GetRegVal(std::string_view reg) {
   }
   else {
     // check if in Tigger mode
-    const auto &env = vm_.env_addr_pair().first;
     auto id = vm_.sym_pool().FindId(kVMFrame);
-    if (!id || env->find(*id) == env->end()) return {};
+    if (!id || !vm_.GetLocalAddr(*id)) return {};
     // find register by name
     for (RegId i = 0; i < TOKEN_COUNT(TOKEN_REGISTERS); ++i) {
       if (kRegNames[i] == reg) return vm_.regs(i);
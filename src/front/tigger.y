@@ -120,17 +120,11 @@ FullExpression
 Expression
   : Reg '=' Reg BinOp Reg {
     CONT().LogLineNum(@$.first_line);
-    CONT().PushLdReg($3);
-    CONT().PushLdReg($5);
-    CONT().PushOp(GetBinaryOp(CONT(), $4));
-    CONT().PushStReg($1);
+    CONT().PushRegOp(GetBinaryOp(CONT(), $4), $1, $3, $5);
   }
   | Reg '=' Reg BinOp NUM {
     CONT().LogLineNum(@$.first_line);
-    CONT().PushLdReg($3);
-    CONT().PushLoad($5);
-    CONT().PushOp(GetBinaryOp(CONT(), $4));
-    CONT().PushStReg($1);
+    CONT().PushRegOpImm(GetBinaryOp(CONT(), $4), $1, $3, $5);
   }
   | Reg '=' OP Reg {
     CONT().LogLineNum(@$.first_line);
@@ -146,13 +140,11 @@ Expression
   }
   | Reg '=' Reg {
     CONT().LogLineNum(@$.first_line);
-    CONT().PushLdReg($3);
-    CONT().PushStReg($1);
+    CONT().PushRegMove($1, $3);
   }
   | Reg '=' NUM {
     CONT().LogLineNum(@$.first_line);
-    CONT().PushLoad($3);
-    CONT().PushStReg($1);
+    CONT().PushRegImm($1, $3);
   }
   | Reg '[' NUM ']' '=' Reg {
     CONT().LogLineNum(@$.first_line);
@@ -172,10 +164,7 @@ Expression
   }
   | IF Reg LOGICOP Reg GOTO LABEL {
     CONT().LogLineNum(@$.first_line);
-    CONT().PushLdReg($2);
-    CONT().PushLdReg($4);
-    CONT().PushOp(GetBinaryOp(CONT(), $3));
-    CONT().PushBnz($6);
+    CONT().PushRegBranch(GetBinaryOp(CONT(), $3), $2, $4, $6);
   }
   | GOTO LABEL {
     CONT().LogLineNum(@$.first_line);
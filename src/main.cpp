@@ -5,15 +5,21 @@
 #include <ostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdint>
 
 #include "xstl/argparse.h"
 
 #include "version.h"
 #include "vm/symbol.h"
 #include "vm/instcont.h"
+#include "vm/regcode.h"
 #include "back/c/codegen.h"
 #include "front/wrapper.h"
 #include "vm/vm.h"
+#include "vm/extmod.h"
+#include "opt/passman.h"
+#include "analysis/cfg.h"
+#include "ssa/lifter.h"
 #include "vmconf.h"
 #ifndef NO_DEBUGGER
 #include "debugger/minidbg/minidbg.h"
@@ -21,6 +27,9 @@
 
 using namespace std;
 using namespace minivm::vm;
+using namespace minivm::opt;
+using namespace minivm::ssa;
+using namespace minivm::analysis;
 using namespace minivm::back::c;
 using namespace minivm::front;
 using namespace minivm::debugger::minidbg;
@@ -38,13 +47,34 @@ xstl::ArgParser GetArgp() {
 #endif
   argp.AddOption<string>("output", "o", "output file, default to stdout",
                          "");
+  argp.AddOption<bool>("opt-0", "O0",
+                       "disable optimizations of Gopher (default)", false);
+  argp.AddOption<bool>("opt-1", "O1",
+                       "remove redundant loads/stores and thread jumps",
+                       false);
+  argp.AddOption<bool>("opt-2", "O2",
+                       "enable all optimizations of Gopher", false);
   argp.AddOption<bool>("dump-gopher", "dg", "dump Gopher to output",
                        false);
+  argp.AddOption<bool>("dump-ssa", "ds",
+                       "dump SSA form of all functions to output", false);
   // TODO: implement this option
   argp.AddOption<bool>("dump-bytecode", "db", "dump bytecode to output",
                        false);
   argp.AddOption<bool>("compile", "c", "compile input file to C code",
                        false);
+  argp.AddOption<bool>("register", "r",
+                       "run Eeyore with the register-based engine", false);
+  argp.AddOption<bool>("jit", "j",
+                       "run with the JIT compiler (x86-64 only)", false);
+  argp.AddOption<bool>("tiered", "ti",
+                       "compile hot functions to native code by the "
+                       "system C compiler", false);
+  argp.AddOption<bool>("trace", "tr",
+                       "record and compile hot loops to traces", false);
+  argp.AddOption<string>("load-ext", "le",
+                         "load native extension module (shared object)",
+                         "");
   return argp;
 }
 
@@ -76,10 +106,61 @@ void ParseArgument(xstl::ArgParser &argp, int argc, const char *argv[]) {
   }
 }
 
+// get optimization level, the highest one wins
+std::uint32_t GetOptLevel(xstl::ArgParser &argp) {
+  if (argp.GetValue<bool>("opt-2")) return 2;
+  if (argp.GetValue<bool>("opt-1")) return 1;
+  return 0;
+}
+
+// dump SSA form of all functions, or the reason why failed
+void DumpSSA(const VMInstContainer &cont, bool tigger_mode, ostream &os) {
+  Lifter lifter(cont, tigger_mode);
+  for (const auto &range : GetFuncRanges(cont)) {
+    if (auto func = lifter.Lift(range)) {
+      func->Dump(os);
+    }
+    else {
+      os << "function at pc " << range.begin << ": can not be lifted"
+         << endl;
+    }
+  }
+}
+
+optional<VMOpr> RunEngine(xstl::ArgParser &argp, VM &vm,
+                          const VMInstContainer &cont, bool tigger_mode) {
+  if (argp.GetValue<bool>("jit")) {
+    // fall back to the interpreters if the host is not supported
+    JitCode code(cont);
+    if (code.Translate()) return vm.Run(code);
+  }
+  if (argp.GetValue<bool>("tiered")) {
+    TieredCompiler tier(cont, tigger_mode);
+    return vm.Run(tier);
+  }
+  if (argp.GetValue<bool>("trace")) {
+    TraceCompiler trace(cont);
+    return vm.Run(trace);
+  }
+  // the register-based engine assumes that the stack depths of all
+  // functions are known, otherwise the stack-based engine is used
+  if (!tigger_mode && argp.GetValue<bool>("register") && vm.verified()) {
+    // fall back to the stack-based engine if failed to translate
+    RegCode code(cont);
+    if (code.Translate()) return vm.Run(code);
+  }
+  return vm.Run();
+}
+
 optional<VMOpr> RunVM(xstl::ArgParser &argp, string_view file, ostream &os,
                       Parser parser, VMInit vm_init, bool tigger_mode) {
   SymbolPool symbols;
   VMInstContainer cont(symbols, file);
+  // optimize instructions when sealing the container
+  PassManager pass_man(GetOptLevel(argp), tigger_mode);
+  cont.set_opt_callback([&pass_man](VMInstContainer &cont) {
+    pass_man.Run(cont);
+  });
   // parse input file
   if (!parser(file, cont)) return {};
   if (argp.GetValue<bool>("dump-gopher")) {
@@ -87,6 +168,11 @@ optional<VMOpr> RunVM(xstl::ArgParser &argp, string_view file, ostream &os,
     cont.Dump(os);
     return 0;
   }
+  else if (argp.GetValue<bool>("dump-ssa")) {
+    // dump SSA form
+    DumpSSA(cont, tigger_mode, os);
+    return 0;
+  }
   else if (argp.GetValue<bool>("compile")) {
     // compile to C code
     CCodeGen gen(cont, tigger_mode);
@@ -99,8 +185,14 @@ optional<VMOpr> RunVM(xstl::ArgParser &argp, string_view file, ostream &os,
   std::optional<VMOpr> ret;
   VM vm(symbols, cont);
   vm_init(vm);
+  // load native extension module, which must outlive the execution
+  ExtModuleLoader ext_loader(vm);
+  auto ext = argp.GetValue<string>("load-ext");
+  if (!ext.empty() && !ext_loader.Load(ext)) return {};
+  // reject malformed input before running
+  if (!vm.Verify()) return {};
 #ifdef NO_DEBUGGER
-  ret = vm.Run();
+  ret = RunEngine(argp, vm, cont, tigger_mode);
 #else
   if (argp.GetValue<bool>("debug")) {
     // debug mode
@@ -117,7 +209,7 @@ optional<VMOpr> RunVM(xstl::ArgParser &argp, string_view file, ostream &os,
     }
   }
   else {
-    ret = vm.Run();
+    ret = RunEngine(argp, vm, cont, tigger_mode);
   }
 #endif
   return ret ? *ret : static_cast<VMOpr>(vm.error_code());
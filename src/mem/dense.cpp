@@ -1,5 +1,8 @@
 #include "mem/dense.h"
 
+#include <new>
+#include <limits>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
@@ -11,10 +14,22 @@ void DenseMemoryPool::FreeMems() {
 }
 
 MemId DenseMemoryPool::Allocate(std::uint32_t size, bool init) {
-  // allocate memory
+  constexpr auto kMaxSize = std::numeric_limits<std::uint32_t>::max();
+  // allocate memory, throw 'std::bad_alloc' if out of memory,
+  // just like 'new' in the sparse memory pool
   auto id = mem_size_;
-  mem_size_ += size;
-  mems_ = reinterpret_cast<std::uint8_t *>(std::realloc(mems_, mem_size_));
+  if (size > kMaxSize - mem_size_) throw std::bad_alloc();
+  auto new_size = mem_size_ + size;
+  // grow the buffer if necessary, doubling must not overflow
+  if (new_size > capacity_) {
+    auto capacity = capacity_ > kMaxSize / 2 ? kMaxSize : capacity_ * 2;
+    capacity = std::max(new_size, capacity);
+    auto mems = std::realloc(mems_, capacity);
+    if (!mems) throw std::bad_alloc();
+    mems_ = reinterpret_cast<std::uint8_t *>(mems);
+    capacity_ = capacity;
+  }
+  mem_size_ = new_size;
   std::memset(mems_ + id, init ? 0 : 0x98, size);
   return id;
 }
@@ -24,12 +39,11 @@ void *DenseMemoryPool::GetAddress(MemId id) {
   return mems_ + id;
 }
 
-void DenseMemoryPool::SaveState() {
-  states_.push(mem_size_);
+MemState DenseMemoryPool::SaveState() {
+  return mem_size_;
 }
 
-void DenseMemoryPool::RestoreState() {
-  auto last_size = states_.top();
-  states_.pop();
-  mems_ = reinterpret_cast<std::uint8_t *>(std::realloc(mems_, last_size));
+void DenseMemoryPool::RestoreState(MemState state) {
+  // just drop all allocated memories after the saved state
+  mem_size_ = state;
 }
@@ -1,8 +1,6 @@
 #ifndef MINIVM_MEM_DENSE_H_
 #define MINIVM_MEM_DENSE_H_
 
-#include <vector>
-#include <stack>
 #include <cstdint>
 
 #include "mem/pool.h"
@@ -10,16 +8,17 @@
 namespace minivm::mem {
 
 // dense memory pool
-// all memory will be allocated contiguously in one place
+// all memory will be allocated contiguously in one place,
+// and the buffer will be reused after restoring states
 class DenseMemoryPool : public MemoryPoolInterface {
  public:
-  DenseMemoryPool() : mems_(nullptr), mem_size_(0) {}
+  DenseMemoryPool() : mems_(nullptr), mem_size_(0), capacity_(0) {}
   ~DenseMemoryPool() { FreeMems(); }
 
   MemId Allocate(std::uint32_t size, bool init) override;
   void *GetAddress(MemId id) override;
-  void SaveState() override;
-  void RestoreState() override;
+  MemState SaveState() override;
+  void RestoreState(MemState state) override;
 
  private:
   // free all allocated memories
@@ -29,8 +28,8 @@ class DenseMemoryPool : public MemoryPoolInterface {
   std::uint8_t *mems_;
   // size of allocated memories
   std::uint32_t mem_size_;
-  // stack of saved states
-  std::stack<std::uint32_t> states_;
+  // capacity of the buffer
+  std::uint32_t capacity_;
 };
 
 }  // namespace minivm::mem
@@ -8,6 +8,8 @@ namespace minivm::mem {
 
 // type of memory id
 using MemId = std::uint32_t;
+// type of memory pool state
+using MemState = std::uint32_t;
 
 // interface of memory pool
 class MemoryPoolInterface {
@@ -25,10 +27,10 @@ class MemoryPoolInterface {
   // handle size of allocated memory only
   // don't care about the contents of memory
   //
-  // save current state
-  virtual void SaveState() = 0;
-  // restore the previous state
-  virtual void RestoreState() = 0;
+  // save current state, returns the saved state
+  virtual MemState SaveState() = 0;
+  // restore to the specific saved state
+  virtual void RestoreState(MemState state) = 0;
 };
 
 // pointer to memory pool
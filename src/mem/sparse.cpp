@@ -38,14 +38,13 @@ void *SparseMemoryPool::GetAddress(MemId id) {
   return it->second.get() + (id - it->first);
 }
 
-void SparseMemoryPool::SaveState() {
-  states_.push(mem_size_);
+MemState SparseMemoryPool::SaveState() {
+  return mem_size_;
 }
 
-void SparseMemoryPool::RestoreState() {
+void SparseMemoryPool::RestoreState(MemState state) {
   // restore to the previous memory size
-  mem_size_ = states_.top();
-  states_.pop();
+  mem_size_ = state;
   // remove all allocated memory after current state
   auto it = mems_.find(mem_size_);
   if (it == mems_.end()) return;
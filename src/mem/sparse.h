@@ -4,7 +4,6 @@
 #include <memory>
 #include <functional>
 #include <map>
-#include <stack>
 #include <cstdint>
 
 #include "mem/pool.h"
@@ -19,8 +18,8 @@ class SparseMemoryPool : public MemoryPoolInterface {
 
   MemId Allocate(std::uint32_t size, bool init) override;
   void *GetAddress(MemId id) override;
-  void SaveState() override;
-  void RestoreState() override;
+  MemState SaveState() override;
+  void RestoreState(MemState state) override;
 
  private:
   using BytesPtr = std::unique_ptr<std::uint8_t[]>;
@@ -29,8 +28,6 @@ class SparseMemoryPool : public MemoryPoolInterface {
   std::map<MemId, BytesPtr, std::greater<MemId>> mems_;
   // size of all allocated memory
   std::uint32_t mem_size_;
-  // stack of saved states
-  std::stack<std::uint32_t> states_;
 };
 
 }  // namespace minivm::mem
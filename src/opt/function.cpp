@@ -0,0 +1,34 @@
+#include "opt/function.h"
+
+#include "analysis/effect.h"
+
+using namespace minivm::opt;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+Function::Function(VMInstContainer &cont, FuncRange range,
+                   std::vector<bool> &removed)
+    : cont_(cont), begin_(range.begin), end_(range.end), removed_(removed),
+      cfg_(cont, range), slot_count_(0), changed_(false) {
+  // slot count is filled in 'Enter' during slot allocation
+  if (op(begin_) == InstOp::Enter) slot_count_ = inst(begin_).opr;
+}
+
+bool Function::IsCarrier(VMAddr pc) const {
+  return op(pc) == InstOp::Jmp && pc > begin_ && IsRegBranch(op(pc - 1));
+}
+
+VMAddr Function::Skip(VMAddr pc) const {
+  while (pc < end_ && removed_[pc]) ++pc;
+  return pc;
+}
+
+void Function::Replace(VMAddr pc, InstOp op, std::uint32_t opr) {
+  cont_.SetInst(pc, op, opr);
+  changed_ = true;
+}
+
+void Function::Remove(VMAddr pc) {
+  removed_[pc] = true;
+  changed_ = true;
+}
@@ -0,0 +1,72 @@
+#ifndef MINIVM_OPT_FUNCTION_H_
+#define MINIVM_OPT_FUNCTION_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+#include "analysis/cfg.h"
+
+namespace minivm::opt {
+
+// view of a function being optimized, which contains instructions
+// in range ['begin', 'end') of the instruction container
+// instructions are removed lazily by the pass manager after the current
+// pass finishes, removed instructions should be treated as absent
+class Function {
+ public:
+  Function(vm::VMInstContainer &cont, analysis::FuncRange range,
+           std::vector<bool> &removed);
+
+  // get the instruction on the specific pc address
+  vm::VMUnpackedInst inst(vm::VMAddr pc) const {
+    return cont_.GetOrigInst(pc);
+  }
+  // get opcode of the instruction on the specific pc address
+  vm::InstOp op(vm::VMAddr pc) const {
+    return static_cast<vm::InstOp>(cont_.insts()[pc].op);
+  }
+  // check if the instruction on the specific pc address is removed
+  bool removed(vm::VMAddr pc) const { return removed_[pc]; }
+  // check if the instruction on the specific pc address is the first
+  // instruction of a basic block, the control flow graph is built before
+  // the current pass, so leaders may be conservative after control flow
+  // is changed
+  bool IsLeader(vm::VMAddr pc) const { return cfg_.IsLeader(pc); }
+  // check if the instruction on the specific pc address is a 'Jmp' that
+  // holds target of the preceding register branch, which is never
+  // executed, and must not be removed or moved
+  bool IsCarrier(vm::VMAddr pc) const;
+  // get pc of the first remaining instruction at or after the specific
+  // pc address, returns 'end' if not found
+  vm::VMAddr Skip(vm::VMAddr pc) const;
+  // get pc of the next remaining instruction after the specific pc
+  // address, returns 'end' if not found
+  vm::VMAddr Next(vm::VMAddr pc) const { return Skip(pc + 1); }
+
+  // replace the instruction on the specific pc address
+  void Replace(vm::VMAddr pc, vm::InstOp op, std::uint32_t opr);
+  // remove the instruction on the specific pc address
+  void Remove(vm::VMAddr pc);
+
+  // getters
+  const vm::VMInstContainer &cont() const { return cont_; }
+  const analysis::ControlFlowGraph &cfg() const { return cfg_; }
+  vm::VMAddr begin() const { return begin_; }
+  vm::VMAddr end() const { return end_; }
+  std::uint32_t slot_count() const { return slot_count_; }
+  bool changed() const { return changed_; }
+
+ private:
+  vm::VMInstContainer &cont_;
+  vm::VMAddr begin_, end_;
+  std::vector<bool> &removed_;
+  analysis::ControlFlowGraph cfg_;
+  std::uint32_t slot_count_;
+  bool changed_;
+};
+
+}  // namespace minivm::opt
+
+#endif  // MINIVM_OPT_FUNCTION_H_
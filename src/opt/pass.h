@@ -0,0 +1,29 @@
+#ifndef MINIVM_OPT_PASS_H_
+#define MINIVM_OPT_PASS_H_
+
+#include "opt/function.h"
+#include "ssa/ir.h"
+
+namespace minivm::opt {
+
+// interface of optimization passes on Gopher functions
+class PassInterface {
+ public:
+  virtual ~PassInterface() = default;
+
+  // run on the specific function, changes are recorded by the function
+  virtual void Run(Function &func) = 0;
+};
+
+// interface of optimization passes on SSA functions
+class SSAPassInterface {
+ public:
+  virtual ~SSAPassInterface() = default;
+
+  // run on the specific function, the function is modified in place
+  virtual void Run(ssa::Function &func) = 0;
+};
+
+}  // namespace minivm::opt
+
+#endif  // MINIVM_OPT_PASS_H_
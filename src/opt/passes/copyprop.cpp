@@ -0,0 +1,180 @@
+#include "opt/passes/passes.h"
+
+using namespace minivm::opt;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+namespace {
+
+// mask of immediate operands
+constexpr std::uint32_t kImmMask = (1u << kVMInstImmLen) - 1;
+
+// replace the i-th register id of register instructions
+inline std::uint32_t SetRegOpr(std::uint32_t opr, std::size_t i,
+                               RegId reg_id) {
+  constexpr auto kRegMask = (1u << kVMInstRegLen) - 1;
+  auto shift = i * kVMInstRegLen;
+  return (opr & ~(kRegMask << shift)) | (reg_id << shift);
+}
+
+// check if the location key belongs to a frame slot
+inline bool IsSlotKey(std::uint64_t key) {
+  return static_cast<LocKind>(key >> 32) == LocKind::Slot;
+}
+
+}  // namespace
+
+void CopyPropPass::Run(Function &func) {
+  copies_.clear();
+  users_.clear();
+  // previous instruction in the current basic block
+  auto last = func.end();
+  for (auto pc = func.Skip(func.begin()); pc < func.end();
+       pc = func.Next(pc)) {
+    if (func.IsLeader(pc)) {
+      copies_.clear();
+      users_.clear();
+      last = func.end();
+    }
+    Substitute(func, pc);
+    // update copies
+    auto inst = func.inst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    auto effect = GetEffect(inst);
+    if (effect.call) KillCallClobbered();
+    if (effect.def) {
+      auto dst = *effect.def;
+      Kill(dst);
+      if (GetStoreLoc(inst) && last != func.end()) {
+        // 'LdX y; StX x' or 'Imm c; StX x'
+        auto prev = func.inst(last);
+        if (auto src = GetLoadLoc(prev)) {
+          if (*src != dst) AddCopy(dst, {false, *src, 0});
+        }
+        else if (static_cast<InstOp>(prev.op) == InstOp::Imm) {
+          AddCopy(dst, {true, {}, ExtendImm(prev.opr)});
+        }
+      }
+      else if (op == InstOp::MovRR) {
+        // 'x0' is always zero
+        auto src = GetRegOpr(inst.opr, 1);
+        if (!src) {
+          AddCopy(dst, {true, {}, 0});
+        }
+        else if (src != dst.index) {
+          AddCopy(dst, {false, {LocKind::Reg, src}, 0});
+        }
+      }
+      else if (op == InstOp::MovRI) {
+        AddCopy(dst, {true, {}, GetRegImm(inst.opr, 1)});
+      }
+    }
+    last = pc;
+  }
+}
+
+void CopyPropPass::AddCopy(Loc dst, const Copy &src) {
+  copies_[dst.key()] = src;
+  if (!src.is_imm) users_[src.loc.key()].push_back(dst.key());
+}
+
+void CopyPropPass::Kill(Loc loc) {
+  copies_.erase(loc.key());
+  auto it = users_.find(loc.key());
+  if (it == users_.end()) return;
+  for (const auto &dst : it->second) {
+    auto copy = copies_.find(dst);
+    if (copy != copies_.end() && !copy->second.is_imm &&
+        copy->second.loc == loc) {
+      copies_.erase(copy);
+    }
+  }
+  users_.erase(it);
+}
+
+void CopyPropPass::KillCallClobbered() {
+  // callees can not access frame slots of the caller
+  for (auto it = copies_.begin(); it != copies_.end();) {
+    const auto &src = it->second;
+    if (!IsSlotKey(it->first) ||
+        (!src.is_imm && src.loc.kind != LocKind::Slot)) {
+      it = copies_.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+void CopyPropPass::Substitute(Function &func, VMAddr pc) {
+  auto inst = func.inst(pc);
+  auto op = static_cast<InstOp>(inst.op);
+  // substitute loads
+  if (auto loc = GetLoadLoc(inst)) {
+    auto it = copies_.find(loc->key());
+    if (it == copies_.end()) return;
+    const auto &src = it->second;
+    if (src.is_imm) {
+      func.Replace(pc, InstOp::Imm, src.imm & kImmMask);
+    }
+    else {
+      func.Replace(pc, GetLoadOp(src.loc.kind), src.loc.index);
+    }
+    return;
+  }
+  // substitute register operands
+  auto opr = inst.opr;
+  auto subst = [this, &opr](std::size_t i) {
+    opr = SetRegOpr(opr, i, FindRegCopy(GetRegOpr(opr, i)));
+  };
+  switch (op) {
+    case InstOp::MovRR: {
+      // try to convert to 'MovRI'
+      auto it = copies_.find(Loc{LocKind::Reg, GetRegOpr(opr, 1)}.key());
+      if (it != copies_.end() && it->second.is_imm &&
+          IsPackableImm(it->second.imm, 1)) {
+        return func.Replace(
+            pc, InstOp::MovRI,
+            PackRegOpr({GetRegOpr(opr, 0)}, it->second.imm));
+      }
+      subst(1);
+      break;
+    }
+    case InstOp::LAndRRR: case InstOp::LOrRRR: case InstOp::EqRRR:
+    case InstOp::NeRRR: case InstOp::GtRRR: case InstOp::LtRRR:
+    case InstOp::GeRRR: case InstOp::LeRRR: case InstOp::AddRRR:
+    case InstOp::SubRRR: case InstOp::MulRRR: case InstOp::DivRRR:
+    case InstOp::ModRRR: {
+      subst(1);
+      subst(2);
+      break;
+    }
+    case InstOp::LAndRRI: case InstOp::LOrRRI: case InstOp::EqRRI:
+    case InstOp::NeRRI: case InstOp::GtRRI: case InstOp::LtRRI:
+    case InstOp::GeRRI: case InstOp::LeRRI: case InstOp::AddRRI:
+    case InstOp::SubRRI: case InstOp::MulRRI: case InstOp::DivRRI:
+    case InstOp::ModRRI: {
+      subst(1);
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      subst(0);
+      subst(1);
+      break;
+    }
+    default:;
+  }
+  if (opr != inst.opr) func.Replace(pc, op, opr);
+}
+
+RegId CopyPropPass::FindRegCopy(RegId reg_id) const {
+  auto it = copies_.find(Loc{LocKind::Reg, reg_id}.key());
+  if (it == copies_.end()) return reg_id;
+  const auto &src = it->second;
+  if (src.is_imm || src.loc.kind != LocKind::Reg ||
+      !IsPackableReg(src.loc.index)) {
+    return reg_id;
+  }
+  return src.loc.index;
+}
@@ -0,0 +1,80 @@
+#include "opt/passes/passes.h"
+
+using namespace minivm::opt;
+using namespace minivm::ssa;
+using namespace minivm::analysis;
+
+void DeadCodePass::Run(ssa::Function &func) {
+  // replace trivial phis by their operands, only users of replaced phis
+  // are revisited, and all replaced phis are removed at once
+  auto users = func.GetUsers();
+  std::vector<bool> replaced(func.insts().size(), false);
+  std::vector<InstId> worklist;
+  for (const auto &block : func.blocks()) {
+    for (const auto &id : block.insts) {
+      if (func.inst(id).op != Op::Phi) break;
+      worklist.push_back(id);
+    }
+  }
+  bool changed = false;
+  while (!worklist.empty()) {
+    auto id = worklist.back();
+    worklist.pop_back();
+    const auto &inst = func.inst(id);
+    if (replaced[id] || (inst.var && inst.var->kind != LocKind::Slot)) {
+      continue;
+    }
+    auto same = kNoInst;
+    bool trivial = true;
+    for (const auto &opr : inst.oprs) {
+      if (opr == id || opr == same) continue;
+      if (same != kNoInst) {
+        trivial = false;
+        break;
+      }
+      same = opr;
+    }
+    if (!trivial || same == kNoInst) continue;
+    replaced[id] = true;
+    changed = true;
+    for (const auto &user : users[id]) {
+      if (replaced[user]) continue;
+      auto &user_inst = func.inst(user);
+      for (auto &opr : user_inst.oprs) {
+        if (opr == id) opr = same;
+      }
+      users[same].push_back(user);
+      if (user_inst.op == Op::Phi) worklist.push_back(user);
+    }
+  }
+  if (changed) func.RemoveInsts(replaced);
+  // remove values that are not used by instructions with side effects,
+  // directly or indirectly, including cycles of unused phis
+  std::vector<bool> live(func.insts().size(), false);
+  for (const auto &block : func.blocks()) {
+    for (const auto &id : block.insts) {
+      if (!HasSideEffect(func.inst(id).op)) continue;
+      live[id] = true;
+      worklist.push_back(id);
+    }
+  }
+  while (!worklist.empty()) {
+    auto id = worklist.back();
+    worklist.pop_back();
+    for (const auto &opr : func.inst(id).oprs) {
+      if (live[opr]) continue;
+      live[opr] = true;
+      worklist.push_back(opr);
+    }
+  }
+  std::vector<bool> removed(func.insts().size(), false);
+  changed = false;
+  for (const auto &block : func.blocks()) {
+    for (const auto &id : block.insts) {
+      if (live[id]) continue;
+      removed[id] = true;
+      changed = true;
+    }
+  }
+  if (changed) func.RemoveInsts(removed);
+}
@@ -0,0 +1,45 @@
+#include "opt/passes/passes.h"
+
+#include "analysis/liveness.h"
+
+using namespace minivm::opt;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+void DeadStorePass::Run(Function &func) {
+  const auto &cfg = func.cfg();
+  Liveness liveness(func.cont(), cfg);
+  for (BlockId id = 0; id < cfg.blocks().size(); ++id) {
+    // scan backward from the exit of the block
+    const auto &block = cfg.block(id);
+    auto live = liveness.live_out(id);
+    for (auto pc = block.end; pc-- > block.begin;) {
+      if (func.removed(pc)) continue;
+      auto inst = func.inst(pc);
+      auto def = GetEffect(inst).def;
+      if (def && !live.test(liveness.FindLoc(*def))) {
+        RemoveStore(func, pc);
+        if (func.removed(pc)) continue;
+        inst = func.inst(pc);
+      }
+      liveness.Transfer(inst, live);
+    }
+  }
+}
+
+void DeadStorePass::RemoveStore(Function &func, VMAddr pc) {
+  auto op = func.op(pc);
+  if (GetStoreLoc(func.inst(pc))) {
+    // the stored value is still popped
+    if (IsStoreKeep(op)) {
+      func.Remove(pc);
+    }
+    else {
+      func.Replace(pc, InstOp::Pop, 0);
+    }
+  }
+  else if (IsPureRegOp(op)) {
+    // 'VarSlot' is kept, since the C backend declares variables by it
+    func.Remove(pc);
+  }
+}
@@ -0,0 +1,189 @@
+#include "opt/passes/passes.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "analysis/dominance.h"
+
+using namespace minivm::opt;
+using namespace minivm::ssa;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+void GlobalValueNumberingPass::Run(ssa::Function &func) {
+  auto count = func.insts().size();
+  leaders_.resize(count);
+  std::iota(leaders_.begin(), leaders_.end(), 0);
+  removed_.assign(count, false);
+  exprs_.clear();
+  expr_log_.clear();
+  exit_loads_.assign(func.blocks().size(), {});
+  FindLocalArrays(func);
+  // walk the dominator tree in pre-order
+  struct Frame {
+    BlockId id;
+    std::size_t next_child, log_size;
+  };
+  DominatorTree dom(func.BuildCFG());
+  std::vector<Frame> stack;
+  auto enter = [&](BlockId id) {
+    stack.push_back({id, 0, expr_log_.size()});
+    VisitBlock(func, id);
+  };
+  enter(0);
+  while (!stack.empty()) {
+    auto &frame = stack.back();
+    const auto &children = dom.children(frame.id);
+    if (frame.next_child < children.size()) {
+      enter(children[frame.next_child++]);
+    }
+    else {
+      // expressions of the block are no longer available
+      while (expr_log_.size() > frame.log_size) {
+        exprs_.erase(expr_log_.back());
+        expr_log_.pop_back();
+      }
+      stack.pop_back();
+    }
+  }
+  // replace operands by leaders, including operands of phis from blocks
+  // that are visited later
+  if (std::find(removed_.begin(), removed_.end(), true) == removed_.end()) {
+    return;
+  }
+  for (const auto &block : func.blocks()) {
+    for (const auto &id : block.insts) {
+      for (auto &opr : func.inst(id).oprs) opr = leaders_[opr];
+    }
+  }
+  func.RemoveInsts(removed_);
+}
+
+void GlobalValueNumberingPass::FindLocalArrays(const ssa::Function &func) {
+  const auto &insts = func.insts();
+  local_arrays_.assign(insts.size(), false);
+  auto users = func.GetUsers();
+  // check if the specific value is only used as an address
+  auto is_addr = [&](InstId value) {
+    const auto &value_users = users[value];
+    return std::all_of(
+        value_users.begin(), value_users.end(), [&](InstId user) {
+          const auto &inst = insts[user];
+          return (inst.op == Op::Ld && inst.oprs[0] == value) ||
+                 (inst.op == Op::St && inst.oprs[1] == value &&
+                  inst.oprs[0] != value);
+        });
+  };
+  for (InstId id = 0; id < insts.size(); ++id) {
+    if (insts[id].block == kNoBlock || insts[id].op != Op::ArrSlot) continue;
+    // the address can only be offset, and then used as an address
+    local_arrays_[id] = std::all_of(
+        users[id].begin(), users[id].end(), [&](InstId user) {
+          const auto &inst = insts[user];
+          if (inst.op != Op::Add) return is_addr(id);
+          return inst.oprs[0] != inst.oprs[1] && is_addr(user);
+        });
+  }
+}
+
+void GlobalValueNumberingPass::VisitBlock(ssa::Function &func, BlockId id) {
+  // available loads are inherited from the only predecessor, which is
+  // also the immediate dominator
+  std::vector<AvailLoad> loads;
+  const auto &preds = func.block(id).preds;
+  if (preds.size() == 1) loads = exit_loads_[preds.front()];
+  auto replace = [this](InstId value, InstId leader) {
+    leaders_[value] = leader;
+    removed_[value] = true;
+  };
+  for (const auto &inst_id : func.block(id).insts) {
+    auto &inst = func.inst(inst_id);
+    for (auto &opr : inst.oprs) opr = leaders_[opr];
+    switch (inst.op) {
+      case Op::Ld: {
+        auto addr = inst.oprs[0];
+        auto it = std::find_if(
+            loads.begin(), loads.end(),
+            [addr](const AvailLoad &load) { return load.addr == addr; });
+        if (it != loads.end()) {
+          replace(inst_id, it->value);
+        }
+        else {
+          loads.push_back({addr, inst_id, GetMemRef(func, addr)});
+        }
+        break;
+      }
+      case Op::St: {
+        // the stored value is forwarded to the following loads
+        auto ref = GetMemRef(func, inst.oprs[1]);
+        Invalidate(loads, ref);
+        loads.push_back({inst.oprs[1], inst.oprs[0], ref});
+        break;
+      }
+      case Op::Call: case Op::CallExt: {
+        Invalidate(loads, {});
+        break;
+      }
+      default: {
+        auto key = GetExprKey(inst);
+        if (!key) break;
+        auto [it, inserted] = exprs_.insert({*key, inst_id});
+        if (inserted) {
+          expr_log_.push_back(*key);
+        }
+        else {
+          replace(inst_id, it->second);
+        }
+        break;
+      }
+    }
+  }
+  exit_loads_[id] = std::move(loads);
+}
+
+std::optional<GlobalValueNumberingPass::ExprKey>
+GlobalValueNumberingPass::GetExprKey(const ssa::Inst &inst) const {
+  if (inst.op == Op::Const) {
+    return ExprKey(inst.op, inst.imm, kNoInst, kNoInst);
+  }
+  if (IsUnary(inst.op)) {
+    auto imm = inst.op == Op::ImmHi ? inst.imm : 0;
+    return ExprKey(inst.op, imm, inst.oprs[0], kNoInst);
+  }
+  if (IsBinary(inst.op)) {
+    // divisions are also numbered, since the dominating one raises
+    // the same error first
+    auto lhs = inst.oprs[0], rhs = inst.oprs[1];
+    if (IsCommutative(inst.op) && lhs > rhs) std::swap(lhs, rhs);
+    return ExprKey(inst.op, 0, lhs, rhs);
+  }
+  return {};
+}
+
+GlobalValueNumberingPass::MemRef GlobalValueNumberingPass::GetMemRef(
+    const ssa::Function &func, InstId addr) const {
+  if (local_arrays_[addr]) return {addr, 0, true};
+  const auto &inst = func.inst(addr);
+  if (inst.op == Op::Add) {
+    for (std::size_t i = 0; i < 2; ++i) {
+      auto base = inst.oprs[i];
+      if (!local_arrays_[base]) continue;
+      const auto &offset = func.inst(inst.oprs[1 - i]);
+      if (offset.op == Op::Const) return {base, offset.imm, true};
+      return {base, 0, false};
+    }
+  }
+  return {kNoInst, 0, false};
+}
+
+void GlobalValueNumberingPass::Invalidate(
+    std::vector<AvailLoad> &loads, const std::optional<MemRef> &ref) const {
+  auto may_alias = [&ref](const AvailLoad &load) {
+    // calls and stores to other memory never modify local arrays
+    if (!ref || ref->base == kNoInst) return load.ref.base == kNoInst;
+    if (load.ref.base != ref->base) return false;
+    return !ref->exact || !load.ref.exact || load.ref.offset == ref->offset;
+  };
+  loads.erase(std::remove_if(loads.begin(), loads.end(), may_alias),
+              loads.end());
+}
@@ -0,0 +1,53 @@
+#include "opt/passes/passes.h"
+
+using namespace minivm::opt;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+namespace {
+
+// maximum length of jump chains to be followed, for breaking cycles
+constexpr std::size_t kMaxChainLen = 16;
+
+}  // namespace
+
+void JumpThreadingPass::Run(Function &func) {
+  for (auto pc = func.Skip(func.begin()); pc < func.end();
+       pc = func.Next(pc)) {
+    auto op = func.op(pc);
+    if (op != InstOp::Bnz && op != InstOp::Jmp) continue;
+    // redirect to the final target
+    auto target = Resolve(func, func.inst(pc).opr);
+    if (target != func.inst(pc).opr) func.Replace(pc, op, target);
+    // targets of register branches are never removed
+    if (func.IsCarrier(pc)) continue;
+    if (target == func.Next(pc)) {
+      // 'Bnz' still pops the condition
+      if (op == InstOp::Jmp) {
+        func.Remove(pc);
+      }
+      else {
+        func.Replace(pc, InstOp::Pop, 0);
+      }
+    }
+    else if (op == InstOp::Jmp && target < func.end() &&
+             func.op(target) == InstOp::Ret) {
+      func.Replace(pc, InstOp::Ret, 0);
+    }
+  }
+}
+
+VMAddr JumpThreadingPass::Resolve(const Function &func,
+                                  VMAddr target) const {
+  for (std::size_t i = 0; i < kMaxChainLen; ++i) {
+    target = func.Skip(target);
+    if (target >= func.end() || func.op(target) != InstOp::Jmp ||
+        func.IsCarrier(target)) {
+      break;
+    }
+    auto next = func.inst(target).opr;
+    if (next == target) break;
+    target = next;
+  }
+  return target;
+}
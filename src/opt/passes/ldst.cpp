@@ -0,0 +1,59 @@
+#include "opt/passes/passes.h"
+
+using namespace minivm::opt;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+void LoadStorePass::Run(Function &func) {
+  for (auto pc = func.Skip(func.begin()); pc < func.end();
+       pc = func.Next(pc)) {
+    auto inst = func.inst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    if (op == InstOp::MovRR &&
+        GetRegOpr(inst.opr, 0) == GetRegOpr(inst.opr, 1)) {
+      func.Remove(pc);
+      continue;
+    }
+    // get the next instruction in the same basic block
+    auto next = func.Next(pc);
+    if (next >= func.end() || func.IsLeader(next)) continue;
+    auto next_inst = func.inst(next);
+    auto next_op = static_cast<InstOp>(next_inst.op);
+    if (auto loc = GetStoreLoc(inst)) {
+      if (!IsStoreKeep(op) && GetLoadLoc(next_inst) == loc) {
+        // 'StX x; LdX x'
+        func.Replace(pc, GetStoreOp(loc->kind, true), inst.opr);
+        func.Remove(next);
+      }
+      else if (IsStoreKeep(op) && next_op == InstOp::Pop) {
+        // 'StXP x; Pop'
+        func.Replace(pc, GetStoreOp(loc->kind, false), inst.opr);
+        func.Remove(next);
+      }
+    }
+    else if (auto loc = GetLoadLoc(inst)) {
+      if (GetStoreLoc(next_inst) == loc) {
+        // 'LdX x; StX x' or 'LdX x; StXP x'
+        if (!IsStoreKeep(next_op)) func.Remove(pc);
+        func.Remove(next);
+      }
+      else if (next_op == InstOp::Pop) {
+        // 'LdX x; Pop'
+        func.Remove(pc);
+        func.Remove(next);
+      }
+    }
+    else if (next_op == InstOp::Pop) {
+      if (op == InstOp::Imm) {
+        func.Remove(pc);
+        func.Remove(next);
+      }
+      else if (IsPureUnary(op)) {
+        func.Remove(pc);
+      }
+      else if (IsPureBinary(op)) {
+        func.Replace(pc, InstOp::Pop, 0);
+      }
+    }
+  }
+}
@@ -0,0 +1,242 @@
+#include "opt/passes/passes.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "analysis/dominance.h"
+
+using namespace minivm::opt;
+using namespace minivm::ssa;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+void LoopOptPass::Run(ssa::Function &func) {
+  CreatePreheaders(func);
+  auto cfg = func.BuildCFG();
+  DominatorTree dom(cfg);
+  loops_.emplace(cfg, dom);
+  rpo_ = cfg.rpo();
+  // inner loops come first
+  for (loop_ = 0; loop_ < loops_->loops().size(); ++loop_) {
+    preheader_ = loops_->FindPreheader(cfg, loop_);
+    if (preheader_ == kNoBlock) continue;
+    HoistInvariants(func);
+    ReduceInductions(func);
+  }
+  loops_.reset();
+}
+
+void LoopOptPass::CreatePreheaders(ssa::Function &func) {
+  auto cfg = func.BuildCFG();
+  DominatorTree dom(cfg);
+  LoopInfo loops(cfg, dom);
+  for (LoopId id = 0; id < loops.loops().size(); ++id) {
+    if (loops.FindPreheader(cfg, id) != kNoBlock) continue;
+    // find the only predecessor outside the loop
+    auto header = loops.loop(id).header;
+    const auto &preds = func.block(header).preds;
+    std::size_t index = preds.size();
+    bool found = true;
+    for (std::size_t i = 0; i < preds.size(); ++i) {
+      if (loops.Contains(id, preds[i])) continue;
+      if (index != preds.size()) found = false;
+      index = i;
+    }
+    if (!found || index == preds.size()) continue;
+    auto pred = preds[index];
+    auto &succs = func.block(pred).succs;
+    if (std::count(succs.begin(), succs.end(), header) != 1) continue;
+    // split the edge, the new block takes the place of the predecessor,
+    // so operands of phis in the header are unchanged
+    auto pc = func.inst(func.block(pred).insts.back()).pc;
+    auto block = func.AddBlock(func.block(header).pc);
+    func.AddInst(block, Op::Jmp, pc);
+    auto &pred_succs = func.block(pred).succs;
+    *std::find(pred_succs.begin(), pred_succs.end(), header) = block;
+    func.block(header).preds[index] = block;
+    func.block(block).preds.push_back(pred);
+    func.block(block).succs.push_back(header);
+  }
+}
+
+bool LoopOptPass::IsInvariant(const ssa::Function &func,
+                              InstId value) const {
+  const auto &inst = func.inst(value);
+  return inst.op == Op::Const || !loops_->Contains(loop_, inst.block);
+}
+
+bool LoopOptPass::IsHoistable(const ssa::Function &func, InstId id) const {
+  const auto &inst = func.inst(id);
+  if (inst.op == Op::Div || inst.op == Op::Mod) {
+    // divisions by constants other than 0 and -1 never raise errors
+    const auto &rhs = func.inst(inst.oprs[1]);
+    if (rhs.op != Op::Const || !rhs.imm || rhs.imm == -1) return false;
+  }
+  else if (inst.op != Op::Const && !IsUnary(inst.op) &&
+           !IsBinary(inst.op)) {
+    return false;
+  }
+  return std::all_of(
+      inst.oprs.begin(), inst.oprs.end(),
+      [this, &func](InstId opr) { return IsInvariant(func, opr); });
+}
+
+void LoopOptPass::HoistInvariants(ssa::Function &func) {
+  // definitions are visited before uses in reverse post-order, so
+  // instructions that only use hoisted values are also hoisted
+  auto &pre_insts = func.block(preheader_).insts;
+  for (const auto &id : rpo_) {
+    if (!loops_->Contains(loop_, id)) continue;
+    auto &insts = func.block(id).insts;
+    std::vector<InstId> kept;
+    for (const auto &inst_id : insts) {
+      if (IsHoistable(func, inst_id)) {
+        pre_insts.insert(pre_insts.end() - 1, inst_id);
+        func.inst(inst_id).block = preheader_;
+      }
+      else {
+        kept.push_back(inst_id);
+      }
+    }
+    insts = std::move(kept);
+  }
+}
+
+void LoopOptPass::FindInductions(const ssa::Function &func) {
+  ivs_.clear();
+  const auto &header = func.block(loops_->loop(loop_).header);
+  for (const auto &id : header.insts) {
+    const auto &phi = func.inst(id);
+    if (phi.op != Op::Phi) break;
+    // all back edges must carry the same value
+    auto init = kNoInst, next = kNoInst;
+    bool valid = true;
+    for (std::size_t i = 0; i < phi.oprs.size(); ++i) {
+      if (header.preds[i] == preheader_) {
+        init = phi.oprs[i];
+      }
+      else if (next == kNoInst || next == phi.oprs[i]) {
+        next = phi.oprs[i];
+      }
+      else {
+        valid = false;
+      }
+    }
+    if (!valid || init == kNoInst || next == kNoInst) continue;
+    // 'next = phi + step', 'next = step + phi' or 'next = phi - step'
+    const auto &inst = func.inst(next);
+    if (inst.op != Op::Add && inst.op != Op::Sub) continue;
+    auto lhs = inst.oprs[0], rhs = inst.oprs[1];
+    if (inst.op == Op::Add && rhs == id) std::swap(lhs, rhs);
+    if (lhs != id || !IsInvariant(func, rhs)) continue;
+    ivs_[id] = {init, next, rhs, inst.op == Op::Sub};
+  }
+}
+
+std::optional<LoopOptPass::Linear> LoopOptPass::GetLinear(
+    const ssa::Function &func, InstId value) const {
+  if (ivs_.count(value)) return Linear{value, kNoInst, false};
+  // 'iv + offset', 'offset + iv' or 'iv - offset'
+  const auto &inst = func.inst(value);
+  if (inst.op != Op::Add && inst.op != Op::Sub) return {};
+  auto lhs = inst.oprs[0], rhs = inst.oprs[1];
+  if (inst.op == Op::Add && ivs_.count(rhs)) std::swap(lhs, rhs);
+  if (!ivs_.count(lhs) || !IsInvariant(func, rhs)) return {};
+  return Linear{lhs, rhs, inst.op == Op::Sub};
+}
+
+void LoopOptPass::ReduceInductions(ssa::Function &func) {
+  FindInductions(func);
+  if (ivs_.empty()) return;
+  // collect multiplications in reverse post-order, reduced values may
+  // be reduced again by the following multiplications
+  std::vector<InstId> muls;
+  for (const auto &id : rpo_) {
+    if (!loops_->Contains(loop_, id)) continue;
+    for (const auto &inst_id : func.block(id).insts) {
+      if (func.inst(inst_id).op == Op::Mul) muls.push_back(inst_id);
+    }
+  }
+  for (const auto &id : muls) ReduceMul(func, id);
+}
+
+void LoopOptPass::ReduceMul(ssa::Function &func, InstId id) {
+  // 'mul = linear * factor' or 'mul = factor * linear'
+  auto linear = GetLinear(func, func.inst(id).oprs[0]);
+  auto factor = func.inst(id).oprs[1];
+  if (!linear) {
+    linear = GetLinear(func, factor);
+    factor = func.inst(id).oprs[0];
+  }
+  if (!linear || !IsInvariant(func, factor)) return;
+  auto iv = ivs_.at(linear->iv);
+  auto pc = func.inst(id).pc;
+  // initial value, computed in the preheader
+  auto init = iv.init;
+  if (linear->offset != kNoInst) {
+    const auto &init_inst = func.inst(init);
+    if (!linear->is_sub && init_inst.op == Op::Const && !init_inst.imm) {
+      init = linear->offset;
+    }
+    else {
+      init = AddToPreheader(func, linear->is_sub ? Op::Sub : Op::Add,
+                            {init, linear->offset});
+    }
+  }
+  init = Multiply(func, init, factor);
+  // step of the new induction variable
+  const auto &step_inst = func.inst(iv.step);
+  auto step = step_inst.op == Op::Const && step_inst.imm == 1
+                  ? factor
+                  : Multiply(func, iv.step, factor);
+  // the new induction variable, which is updated right after the
+  // original one
+  auto header = loops_->loop(loop_).header;
+  auto phi = func.NewInst(Op::Phi, pc);
+  auto next = func.NewInst(iv.is_sub ? Op::Sub : Op::Add, pc);
+  for (const auto &pred : func.block(header).preds) {
+    func.inst(phi).oprs.push_back(pred == preheader_ ? init : next);
+  }
+  func.inst(phi).has_value = true;
+  func.inst(phi).block = header;
+  auto &header_insts = func.block(header).insts;
+  header_insts.insert(header_insts.begin(), phi);
+  auto next_block = func.inst(iv.next).block;
+  func.inst(next).oprs = {phi, step};
+  func.inst(next).has_value = true;
+  func.inst(next).block = next_block;
+  auto &insts = func.block(next_block).insts;
+  insts.insert(std::find(insts.begin(), insts.end(), iv.next) + 1, next);
+  // replace the multiplication, which is removed later if unused
+  func.ReplaceUses(id, phi);
+  ivs_[phi] = {init, next, step, iv.is_sub};
+}
+
+InstId LoopOptPass::AddToPreheader(ssa::Function &func, Op op,
+                                   std::vector<InstId> oprs) {
+  auto id = func.NewInst(op, func.block(preheader_).pc);
+  auto &inst = func.inst(id);
+  inst.oprs = std::move(oprs);
+  inst.has_value = true;
+  inst.block = preheader_;
+  auto &insts = func.block(preheader_).insts;
+  insts.insert(insts.end() - 1, id);
+  return id;
+}
+
+InstId LoopOptPass::Multiply(ssa::Function &func, InstId lhs,
+                             InstId rhs) {
+  const auto &lhs_inst = func.inst(lhs), &rhs_inst = func.inst(rhs);
+  if (lhs_inst.op == Op::Const && rhs_inst.op == Op::Const) {
+    auto value = static_cast<std::uint32_t>(lhs_inst.imm) *
+                 static_cast<std::uint32_t>(rhs_inst.imm);
+    return AddConst(func, value);
+  }
+  return AddToPreheader(func, Op::Mul, {lhs, rhs});
+}
+
+InstId LoopOptPass::AddConst(ssa::Function &func, VMOpr value) {
+  auto id = AddToPreheader(func, Op::Const, {});
+  func.inst(id).imm = value;
+  return id;
+}
@@ -0,0 +1,296 @@
+#ifndef MINIVM_OPT_PASSES_PASSES_H_
+#define MINIVM_OPT_PASSES_PASSES_H_
+
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <optional>
+#include <tuple>
+#include <cstdint>
+
+#include "opt/pass.h"
+#include "analysis/effect.h"
+#include "analysis/loop.h"
+
+namespace minivm::opt {
+
+// copy propagation in basic blocks
+// copies are introduced by 'LdX y; StX x', 'Imm c; StX x' (and 'StXP'),
+// 'MovRR' and 'MovRI', loads of 'x' are replaced by loads of the source,
+// as well as register operands of register instructions
+class CopyPropPass : public PassInterface {
+ public:
+  void Run(Function &func) override;
+
+ private:
+  // source of a copy, a location or an immediate
+  struct Copy {
+    bool is_imm;
+    analysis::Loc loc;
+    vm::VMOpr imm;
+  };
+
+  // record copy 'dst = src'
+  void AddCopy(analysis::Loc dst, const Copy &src);
+  // remove all copies from/to the specific location
+  void Kill(analysis::Loc loc);
+  // remove all copies from/to static registers and global slots
+  void KillCallClobbered();
+  // substitute loads or register operands of the specific instruction
+  void Substitute(Function &func, vm::VMAddr pc);
+  // get register id that holds the same value as the specific register
+  vm::RegId FindRegCopy(vm::RegId reg_id) const;
+
+  // destination -> source
+  std::unordered_map<std::uint64_t, Copy> copies_;
+  // source -> destinations, may contain stale entries
+  std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> users_;
+};
+
+// redundant load/store removal, by peephole rules in basic blocks:
+//  'StX x; LdX x'  -> 'StXP x'
+//  'LdX x; StX x'  -> (removed)
+//  'LdX x; StXP x' -> 'LdX x'
+//  'StXP x; Pop'   -> 'StX x'
+//  'LdX/Imm; Pop'  -> (removed)
+//  'op1; Pop'      -> 'Pop' (pure unary operations)
+//  'op2; Pop'      -> 'Pop; Pop' (pure binary operations)
+//  'MovRR r, r'    -> (removed)
+class LoadStorePass : public PassInterface {
+ public:
+  void Run(Function &func) override;
+};
+
+// dead store elimination
+// stores to locations that are not live after the store are removed,
+// including stores to frame slots that are never read before returning
+class DeadStorePass : public PassInterface {
+ public:
+  void Run(Function &func) override;
+
+ private:
+  // try to remove the specific dead store
+  void RemoveStore(Function &func, vm::VMAddr pc);
+};
+
+// jump threading
+// jumps/branches to jumps are redirected to the final targets, jumps to
+// returns are replaced by returns, and jumps/branches to the next
+// instruction are removed
+class JumpThreadingPass : public PassInterface {
+ public:
+  void Run(Function &func) override;
+
+ private:
+  // get the final target of the specific jump target
+  vm::VMAddr Resolve(const Function &func, vm::VMAddr target) const;
+};
+
+// dead code elimination on SSA functions
+// values that are not used by instructions with side effects (even
+// through cycles of phis) are removed, as well as phis whose operands
+// are all the same value (except phis of escaping locations, which are
+// required by lowering)
+class DeadCodePass : public SSAPassInterface {
+ public:
+  void Run(ssa::Function &func) override;
+};
+
+// sparse conditional constant propagation on SSA functions (Wegman and
+// Zadeck), constant values are folded, branches on constants are
+// replaced by jumps, and blocks that are never reached are removed
+// divisions by zero (or overflowing divisions) are never folded, so
+// they still raise errors at runtime
+class SparseCondConstPass : public SSAPassInterface {
+ public:
+  void Run(ssa::Function &func) override;
+
+ private:
+  // lattice of values
+  enum class ValueKind : std::uint8_t { Undef, Const, Overdef };
+
+  // lattice value
+  struct Value {
+    ValueKind kind;
+    vm::VMOpr value;
+  };
+
+  // mark the edge from block 'from' to its 'index'-th successor as
+  // executable
+  void MarkEdge(const ssa::Function &func, ssa::BlockId from,
+                std::size_t index);
+  // visit the specific instruction
+  void Visit(const ssa::Function &func, ssa::InstId id);
+  // evaluate the specific instruction
+  Value Evaluate(const ssa::Function &func, ssa::InstId id) const;
+  // check if the edge from block 'from' to block 'to' is executable
+  bool IsExecutable(const ssa::Function &func, ssa::BlockId from,
+                    ssa::BlockId to) const;
+  // rewrite the function by the lattice values
+  void Rewrite(ssa::Function &func);
+
+  std::vector<Value> values_;
+  // executable blocks, and executable edges to successors of each block
+  std::vector<bool> exec_blocks_;
+  std::vector<std::vector<bool>> exec_edges_;
+  // users of all values
+  std::vector<std::vector<ssa::InstId>> users_;
+  // worklists of blocks (newly reached) and instructions
+  std::vector<ssa::BlockId> block_list_;
+  std::vector<ssa::InstId> inst_list_;
+};
+
+// global value numbering on SSA functions, by walking the dominator tree
+// values computed by the same operation on the same operands are
+// replaced by the dominating one, and loads are replaced by previous
+// loads or stores of the same address, if there are no intervening
+// stores or calls that may modify the memory
+// arrays whose addresses never escape (e.g. stack frames in Tigger mode)
+// can not be modified by callees, and stores to them with constant
+// offsets only modify the specific elements
+class GlobalValueNumberingPass : public SSAPassInterface {
+ public:
+  void Run(ssa::Function &func) override;
+
+ private:
+  // key of expressions: opcode, immediate and operands
+  using ExprKey = std::tuple<ssa::Op, vm::VMOpr, ssa::InstId, ssa::InstId>;
+
+  // memory accessed by an address, 'base' is the local array, or
+  // 'kNoInst' for other memory, 'offset' is valid if 'exact' is set
+  struct MemRef {
+    ssa::InstId base;
+    vm::VMOpr offset;
+    bool exact;
+  };
+
+  // available value of an address
+  struct AvailLoad {
+    ssa::InstId addr, value;
+    MemRef ref;
+  };
+
+  // find arrays whose addresses are only used by loads and stores
+  void FindLocalArrays(const ssa::Function &func);
+  // visit the specific block
+  void VisitBlock(ssa::Function &func, ssa::BlockId id);
+  // get key of the specific expression, returns null if the expression
+  // can not be numbered
+  std::optional<ExprKey> GetExprKey(const ssa::Inst &inst) const;
+  // get memory accessed by the specific address
+  MemRef GetMemRef(const ssa::Function &func, ssa::InstId addr) const;
+  // remove available loads that may be modified by a store to the
+  // specific memory, or by a call if 'ref' is null
+  void Invalidate(std::vector<AvailLoad> &loads,
+                  const std::optional<MemRef> &ref) const;
+
+  // leaders of all values, removed values are replaced by their leaders
+  std::vector<ssa::InstId> leaders_;
+  std::vector<bool> removed_;
+  // local arrays
+  std::vector<bool> local_arrays_;
+  // available expressions, scoped by the dominator tree, and the log
+  std::map<ExprKey, ssa::InstId> exprs_;
+  std::vector<ExprKey> expr_log_;
+  // available loads at the exit of each block
+  std::vector<std::vector<AvailLoad>> exit_loads_;
+};
+
+// loop optimizations on SSA functions, based on natural loops
+// preheaders are created by splitting the entry edges of loops, pure
+// computations whose operands are defined outside the loop are hoisted
+// to the preheader (loop-invariant code motion), and multiplications of
+// induction variables by loop invariants are replaced by new induction
+// variables that are updated by additions (strength reduction)
+// loops are processed from inner to outer, so values can be hoisted or
+// reduced across multiple levels
+class LoopOptPass : public SSAPassInterface {
+ public:
+  void Run(ssa::Function &func) override;
+
+ private:
+  // basic induction variable, 'phi = phi(init, next)',
+  // 'next = phi +/- step', where 'step' is loop invariant
+  struct Induction {
+    ssa::InstId init, next, step;
+    bool is_sub;
+  };
+
+  // linear function of induction variable, 'iv +/- offset', 'offset'
+  // is 'kNoInst' if the function is the induction variable itself
+  struct Linear {
+    ssa::InstId iv, offset;
+    bool is_sub;
+  };
+
+  // create preheaders for loops whose headers have only one predecessor
+  // outside the loop, which also has other successors
+  void CreatePreheaders(ssa::Function &func);
+  // check if the specific value is invariant in the current loop
+  bool IsInvariant(const ssa::Function &func, ssa::InstId value) const;
+  // check if the specific instruction can be hoisted out of the current
+  // loop, which must be pure and never raise errors
+  bool IsHoistable(const ssa::Function &func, ssa::InstId id) const;
+  // hoist invariant instructions of the current loop to its preheader
+  void HoistInvariants(ssa::Function &func);
+  // find basic induction variables of the current loop
+  void FindInductions(const ssa::Function &func);
+  // get the linear function of the specific value
+  std::optional<Linear> GetLinear(const ssa::Function &func,
+                                  ssa::InstId value) const;
+  // reduce multiplications of induction variables in the current loop
+  void ReduceInductions(ssa::Function &func);
+  // try to reduce the specific multiplication
+  void ReduceMul(ssa::Function &func, ssa::InstId id);
+  // create a new instruction at the end of the preheader (before the
+  // terminator), returns the instruction id
+  ssa::InstId AddToPreheader(ssa::Function &func, ssa::Op op,
+                             std::vector<ssa::InstId> oprs);
+  // create a multiplication in the preheader, constants are folded
+  ssa::InstId Multiply(ssa::Function &func, ssa::InstId lhs,
+                       ssa::InstId rhs);
+  // create a new constant in the preheader
+  ssa::InstId AddConst(ssa::Function &func, vm::VMOpr value);
+
+  // loops of the current function
+  std::optional<analysis::LoopInfo> loops_;
+  // blocks in reverse post-order
+  std::vector<ssa::BlockId> rpo_;
+  // the current loop, and its preheader
+  analysis::LoopId loop_;
+  ssa::BlockId preheader_;
+  // basic induction variables of the current loop
+  std::unordered_map<ssa::InstId, Induction> ivs_;
+};
+
+// strength reduction of divisions and modulo operations by powers of two
+// on SSA functions, which are replaced by arithmetic shifts and masks if
+// the dividends are known to be non-negative
+// signed dividends must be biased by 'divisor - 1' to round towards zero,
+// which takes more dispatches than the division itself in interpreters,
+// so they are kept (the JIT compiler expands them to native shifts)
+// phis are assumed to be non-negative while checking their operands, so
+// induction variables with non-negative initial values and guarded
+// positive steps are also known to be non-negative
+class PowerOfTwoDivPass : public SSAPassInterface {
+ public:
+  void Run(ssa::Function &func) override;
+
+ private:
+  // check if the specific value is known to be non-negative
+  bool IsNonNegative(const ssa::Function &func, ssa::InstId value,
+                     std::uint32_t depth);
+  // check if the specific value is known to be less than 'limit' in the
+  // specific block, by conditions of branches that dominate the block
+  bool IsGuardedBelow(const ssa::Function &func, ssa::InstId value,
+                      std::int64_t limit, ssa::BlockId block) const;
+
+  // dominator tree of the current function
+  std::optional<analysis::DominatorTree> dom_;
+  // phis that are assumed to be non-negative
+  std::vector<bool> assumed_;
+};
+
+}  // namespace minivm::opt
+
+#endif  // MINIVM_OPT_PASSES_PASSES_H_
@@ -0,0 +1,140 @@
+#include "opt/passes/passes.h"
+
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+using namespace minivm::opt;
+using namespace minivm::ssa;
+using namespace minivm::vm;
+
+namespace {
+
+// maximum depth of the non-negative value analysis
+constexpr std::uint32_t kMaxDepth = 8;
+
+}  // namespace
+
+void PowerOfTwoDivPass::Run(ssa::Function &func) {
+  dom_.emplace(func.BuildCFG());
+  assumed_.assign(func.insts().size(), false);
+  for (auto &block : func.blocks()) {
+    std::vector<InstId> insts;
+    for (const auto &id : block.insts) {
+      auto &inst = func.inst(id);
+      if (inst.op == Op::Div || inst.op == Op::Mod) {
+        // 'lhs / 2^k' -> 'lhs >> k', 'lhs % 2^k' -> 'lhs & (2^k - 1)'
+        const auto &rhs = func.inst(inst.oprs[1]);
+        auto divisor = rhs.imm;
+        if (rhs.op == Op::Const && divisor > 1 &&
+            !(divisor & (divisor - 1)) &&
+            IsNonNegative(func, inst.oprs[0], 0)) {
+          std::uint32_t shift = 0;
+          while ((1 << shift) != divisor) ++shift;
+          auto is_div = inst.op == Op::Div;
+          auto pc = inst.pc, block_id = inst.block;
+          auto const_id = func.NewInst(Op::Const, pc);
+          auto &const_inst = func.inst(const_id);
+          const_inst.imm = is_div ? shift : divisor - 1;
+          const_inst.has_value = true;
+          const_inst.block = block_id;
+          insts.push_back(const_id);
+          auto &cur = func.inst(id);
+          cur.op = is_div ? Op::Shr : Op::And;
+          cur.oprs[1] = const_id;
+        }
+      }
+      insts.push_back(id);
+    }
+    block.insts = std::move(insts);
+  }
+  dom_.reset();
+}
+
+bool PowerOfTwoDivPass::IsNonNegative(const ssa::Function &func,
+                                      InstId value,
+                                      std::uint32_t depth) {
+  if (depth > kMaxDepth) return false;
+  const auto &inst = func.inst(value);
+  auto is_non_neg = [&](InstId opr) {
+    return IsNonNegative(func, opr, depth + 1);
+  };
+  switch (inst.op) {
+    case Op::Const: return inst.imm >= 0;
+    case Op::LNot: case Op::LAnd: case Op::LOr: case Op::Eq: case Op::Ne:
+    case Op::Gt: case Op::Lt: case Op::Ge: case Op::Le: {
+      return true;
+    }
+    case Op::And: {
+      return is_non_neg(inst.oprs[0]) || is_non_neg(inst.oprs[1]);
+    }
+    case Op::Shr: case Op::Mod: return is_non_neg(inst.oprs[0]);
+    case Op::Div: {
+      const auto &rhs = func.inst(inst.oprs[1]);
+      return rhs.op == Op::Const && rhs.imm > 0 && is_non_neg(inst.oprs[0]);
+    }
+    case Op::Add: {
+      // sums never overflow if the other operand of a constant is bounded
+      auto lhs = inst.oprs[0], rhs = inst.oprs[1];
+      if (func.inst(lhs).op == Op::Const) std::swap(lhs, rhs);
+      const auto &step = func.inst(rhs);
+      if (step.op != Op::Const || step.imm < 0) return false;
+      std::int64_t limit = std::numeric_limits<VMOpr>::max();
+      return is_non_neg(lhs) &&
+             IsGuardedBelow(func, lhs, limit - step.imm + 1, inst.block);
+    }
+    case Op::Phi: {
+      // the phi is assumed to be non-negative while checking operands,
+      // which holds by induction on iterations if all operands are
+      if (assumed_[value]) return true;
+      assumed_[value] = true;
+      auto ret = std::all_of(inst.oprs.begin(), inst.oprs.end(), is_non_neg);
+      assumed_[value] = false;
+      return ret;
+    }
+    default: return false;
+  }
+}
+
+bool PowerOfTwoDivPass::IsGuardedBelow(const ssa::Function &func,
+                                       InstId value, std::int64_t limit,
+                                       BlockId block) const {
+  if (limit > std::numeric_limits<VMOpr>::max()) return true;
+  // check blocks that dominate the specific block, and are entered only
+  // if the condition of the branch in their only predecessor holds
+  for (auto id = block; id != kNoBlock; id = dom_->idom(id)) {
+    const auto &preds = func.block(id).preds;
+    if (preds.size() != 1) continue;
+    const auto &pred = func.block(preds.front());
+    const auto &term = func.inst(pred.insts.back());
+    if (term.op != Op::Bnz || pred.succs[0] == pred.succs[1]) continue;
+    const auto &cond = func.inst(term.oprs[0]);
+    if (cond.oprs.size() != 2) continue;
+    // normalize the condition to 'value < bound' or 'value <= bound'
+    auto op = cond.op;
+    auto bound = cond.oprs[1];
+    if (cond.oprs[1] == value) {
+      if (op == Op::Gt) op = Op::Lt;
+      else if (op == Op::Ge) op = Op::Le;
+      else if (op == Op::Lt) op = Op::Gt;
+      else if (op == Op::Le) op = Op::Ge;
+      bound = cond.oprs[0];
+    }
+    else if (cond.oprs[0] != value) {
+      continue;
+    }
+    if (pred.succs[1] == id) {
+      if (op == Op::Ge) op = Op::Lt;
+      else if (op == Op::Gt) op = Op::Le;
+      else continue;
+    }
+    if (op != Op::Lt && op != Op::Le) continue;
+    // bounds are not greater than the maximum value
+    const auto &bound_inst = func.inst(bound);
+    std::int64_t max = bound_inst.op == Op::Const
+                           ? bound_inst.imm
+                           : std::numeric_limits<VMOpr>::max();
+    if (op == Op::Lt ? max <= limit : max < limit) return true;
+  }
+  return false;
+}
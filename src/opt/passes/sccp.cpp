@@ -0,0 +1,252 @@
+#include "opt/passes/passes.h"
+
+#include <optional>
+#include <climits>
+#include <cstdint>
+#include <cassert>
+
+using namespace minivm::opt;
+using namespace minivm::ssa;
+using namespace minivm::vm;
+
+namespace {
+
+// fold the specific unary operation
+VMOpr FoldUnary(const Inst &inst, VMOpr opr) {
+  constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+  constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
+  switch (inst.op) {
+    case Op::LNot: return !opr;
+    case Op::Neg: return -static_cast<std::uint32_t>(opr);
+    case Op::ImmHi: {
+      return (opr & kMaskLo) | ((inst.imm & kMaskHi) << kVMInstImmLen);
+    }
+    default: assert(false); return 0;
+  }
+}
+
+// fold the specific binary operation, returns null if the operation
+// raises errors at runtime
+std::optional<VMOpr> FoldBinary(Op op, VMOpr lhs, VMOpr rhs) {
+  auto ul = static_cast<std::uint32_t>(lhs);
+  auto ur = static_cast<std::uint32_t>(rhs);
+  switch (op) {
+    case Op::LAnd: return lhs && rhs;
+    case Op::LOr: return lhs || rhs;
+    case Op::Eq: return lhs == rhs;
+    case Op::Ne: return lhs != rhs;
+    case Op::Gt: return lhs > rhs;
+    case Op::Lt: return lhs < rhs;
+    case Op::Ge: return lhs >= rhs;
+    case Op::Le: return lhs <= rhs;
+    case Op::Add: return ul + ur;
+    case Op::Sub: return ul - ur;
+    case Op::Mul: return ul * ur;
+    case Op::And: return lhs & rhs;
+    case Op::Shl: return ul << (rhs & 31);
+    case Op::Shr: return lhs >> (rhs & 31);
+    case Op::Div: case Op::Mod: {
+      // keep the runtime behavior of invalid divisions
+      if (!rhs || (lhs == INT_MIN && rhs == -1)) return {};
+      return op == Op::Div ? lhs / rhs : lhs % rhs;
+    }
+    default: assert(false); return {};
+  }
+}
+
+}  // namespace
+
+void SparseCondConstPass::Run(ssa::Function &func) {
+  values_.assign(func.insts().size(), {ValueKind::Undef, 0});
+  exec_blocks_.assign(func.blocks().size(), false);
+  exec_edges_.clear();
+  for (const auto &block : func.blocks()) {
+    exec_edges_.push_back(std::vector<bool>(block.succs.size(), false));
+  }
+  users_ = func.GetUsers();
+  block_list_.clear();
+  inst_list_.clear();
+  // propagate from the entry block
+  exec_blocks_[0] = true;
+  block_list_.push_back(0);
+  while (!block_list_.empty() || !inst_list_.empty()) {
+    if (!block_list_.empty()) {
+      auto id = block_list_.back();
+      block_list_.pop_back();
+      for (const auto &inst : func.block(id).insts) Visit(func, inst);
+    }
+    else {
+      auto id = inst_list_.back();
+      inst_list_.pop_back();
+      if (exec_blocks_[func.inst(id).block]) Visit(func, id);
+    }
+  }
+  Rewrite(func);
+}
+
+void SparseCondConstPass::MarkEdge(const ssa::Function &func,
+                                   BlockId from, std::size_t index) {
+  if (exec_edges_[from][index]) return;
+  exec_edges_[from][index] = true;
+  auto to = func.block(from).succs[index];
+  if (!exec_blocks_[to]) {
+    exec_blocks_[to] = true;
+    block_list_.push_back(to);
+  }
+  else {
+    // operands of phis become available
+    for (const auto &id : func.block(to).insts) {
+      if (func.inst(id).op != Op::Phi) break;
+      inst_list_.push_back(id);
+    }
+  }
+}
+
+void SparseCondConstPass::Visit(const ssa::Function &func, InstId id) {
+  const auto &inst = func.inst(id);
+  if (inst.op == Op::Jmp || inst.op == Op::Bnz) {
+    // mark edges to successors
+    const auto &cond = inst.op == Op::Bnz ? values_[inst.oprs[0]]
+                                          : Value{ValueKind::Const, 1};
+    if (cond.kind == ValueKind::Undef) return;
+    auto count = func.block(inst.block).succs.size();
+    for (std::size_t i = 0; i < count; ++i) {
+      if (cond.kind == ValueKind::Overdef || (i == 0) == !!cond.value) {
+        MarkEdge(func, inst.block, i);
+      }
+    }
+    return;
+  }
+  if (!inst.has_value) return;
+  // update lattice value, values can only be lowered
+  auto value = Evaluate(func, id);
+  auto &cur = values_[id];
+  if (value.kind == cur.kind &&
+      (value.kind != ValueKind::Const || value.value == cur.value)) {
+    return;
+  }
+  cur = value;
+  for (const auto &user : users_[id]) inst_list_.push_back(user);
+}
+
+SparseCondConstPass::Value SparseCondConstPass::Evaluate(
+    const ssa::Function &func, InstId id) const {
+  const auto &inst = func.inst(id);
+  switch (inst.op) {
+    case Op::Const: return {ValueKind::Const, inst.imm};
+    case Op::Phi: {
+      // meet of operands from executable edges
+      Value ret = {ValueKind::Undef, 0};
+      const auto &preds = func.block(inst.block).preds;
+      for (std::size_t i = 0; i < inst.oprs.size(); ++i) {
+        if (!IsExecutable(func, preds[i], inst.block)) continue;
+        const auto &opr = values_[inst.oprs[i]];
+        if (opr.kind == ValueKind::Undef) continue;
+        if (opr.kind == ValueKind::Overdef ||
+            (ret.kind == ValueKind::Const && ret.value != opr.value)) {
+          return {ValueKind::Overdef, 0};
+        }
+        ret = opr;
+      }
+      return ret;
+    }
+    default: {
+      if (!IsUnary(inst.op) && !IsBinary(inst.op)) {
+        return {ValueKind::Overdef, 0};
+      }
+      // fold operations whose operands are all constants
+      for (const auto &opr : inst.oprs) {
+        if (values_[opr].kind != ValueKind::Const) return values_[opr];
+      }
+      if (IsUnary(inst.op)) {
+        auto opr = values_[inst.oprs[0]].value;
+        return {ValueKind::Const, FoldUnary(inst, opr)};
+      }
+      auto ret = FoldBinary(inst.op, values_[inst.oprs[0]].value,
+                            values_[inst.oprs[1]].value);
+      if (!ret) return {ValueKind::Overdef, 0};
+      return {ValueKind::Const, *ret};
+    }
+  }
+}
+
+bool SparseCondConstPass::IsExecutable(const ssa::Function &func,
+                                       BlockId from, BlockId to) const {
+  const auto &succs = func.block(from).succs;
+  for (std::size_t i = 0; i < succs.size(); ++i) {
+    if (succs[i] == to && exec_edges_[from][i]) return true;
+  }
+  return false;
+}
+
+void SparseCondConstPass::Rewrite(ssa::Function &func) {
+  auto &blocks = func.blocks();
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    if (!exec_blocks_[id]) continue;
+    // resolve branches on constants
+    auto &term = func.inst(blocks[id].insts.back());
+    if (term.op == Op::Bnz &&
+        values_[term.oprs[0]].kind == ValueKind::Const) {
+      for (std::size_t i = blocks[id].succs.size(); i-- > 0;) {
+        if (!exec_edges_[id][i]) func.RemoveEdge(id, i);
+      }
+      term.op = Op::Jmp;
+      term.oprs.clear();
+    }
+    // replace constant values, new constants of phis are placed
+    // after all phis
+    std::vector<InstId> consts;
+    for (const auto &inst_id : blocks[id].insts) {
+      auto &inst = func.inst(inst_id);
+      const auto &value = values_[inst_id];
+      if (!inst.has_value || inst.op == Op::Const ||
+          value.kind != ValueKind::Const) {
+        continue;
+      }
+      if (inst.op != Op::Phi) {
+        inst.op = Op::Const;
+        inst.imm = value.value;
+        inst.oprs.clear();
+        continue;
+      }
+      auto const_id = func.NewInst(Op::Const, inst.pc);
+      auto &const_inst = func.inst(const_id);
+      const_inst.imm = value.value;
+      const_inst.has_value = true;
+      const_inst.block = id;
+      const_inst.var = func.inst(inst_id).var;
+      consts.push_back(const_id);
+      // escaping operands and phis of escaping locations still use
+      // the phi, which is required by lowering
+      for (const auto &user : users_[inst_id]) {
+        auto &user_inst = func.inst(user);
+        if (user_inst.op == Op::Phi && user_inst.var &&
+            user_inst.var->kind != analysis::LocKind::Slot) {
+          continue;
+        }
+        auto count = user_inst.op == Op::Call ||
+                             user_inst.op == Op::CallExt ||
+                             user_inst.op == Op::Ret
+                         ? user_inst.arg_count
+                         : user_inst.oprs.size();
+        for (std::size_t i = 0; i < count; ++i) {
+          if (user_inst.oprs[i] == inst_id) user_inst.oprs[i] = const_id;
+        }
+      }
+    }
+    if (!consts.empty()) {
+      auto &insts = blocks[id].insts;
+      auto pos = insts.begin();
+      while (func.inst(*pos).op == Op::Phi) ++pos;
+      insts.insert(pos, consts.begin(), consts.end());
+    }
+  }
+  // remove blocks that are never reached
+  std::vector<bool> removed(blocks.size());
+  bool changed = false;
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    removed[id] = !exec_blocks_[id];
+    if (removed[id]) changed = true;
+  }
+  if (changed) func.RemoveBlocks(removed);
+}
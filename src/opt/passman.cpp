@@ -0,0 +1,74 @@
+#include "opt/passman.h"
+
+#include "analysis/cfg.h"
+#include "opt/function.h"
+#include "opt/passes/passes.h"
+#include "ssa/lifter.h"
+#include "ssa/lowering.h"
+
+using namespace minivm::opt;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+namespace {
+
+// maximum rounds of running all passes
+constexpr std::uint32_t kMaxRounds = 4;
+
+}  // namespace
+
+PassManager::PassManager(std::uint32_t opt_level, bool tigger_mode)
+    : opt_level_(opt_level), tigger_mode_(tigger_mode) {
+  if (opt_level_ >= 2) {
+    AddSSAPass<SparseCondConstPass>();
+    AddSSAPass<GlobalValueNumberingPass>();
+    AddSSAPass<LoopOptPass>();
+    AddSSAPass<PowerOfTwoDivPass>();
+    AddSSAPass<DeadCodePass>();
+    AddPass<CopyPropPass>();
+    AddPass<LoadStorePass>();
+    AddPass<DeadStorePass>();
+  }
+  if (opt_level_ >= 1) {
+    AddPass<LoadStorePass>();
+    AddPass<JumpThreadingPass>();
+  }
+}
+
+void PassManager::Run(VMInstContainer &cont) {
+  if (!ssa_passes_.empty()) RunSSAPasses(cont);
+  auto rounds = opt_level_ >= 2 ? kMaxRounds : 1;
+  for (std::uint32_t i = 0; i < rounds; ++i) {
+    bool changed = false;
+    for (const auto &pass : passes_) {
+      if (RunPass(*pass, cont)) changed = true;
+    }
+    if (!changed) break;
+  }
+}
+
+bool PassManager::RunPass(PassInterface &pass, VMInstContainer &cont) {
+  // run on all functions, the entry point is never optimized
+  bool changed = false;
+  std::vector<bool> removed(cont.inst_count(), false);
+  for (const auto &range : GetFuncRanges(cont)) {
+    Function func(cont, range, removed);
+    pass.Run(func);
+    if (func.changed()) changed = true;
+  }
+  if (changed) cont.RemoveInsts(removed);
+  return changed;
+}
+
+void PassManager::RunSSAPasses(VMInstContainer &cont) {
+  ssa::Lifter lifter(cont, tigger_mode_);
+  std::vector<VMInstContainer::FuncCode> funcs;
+  for (const auto &range : GetFuncRanges(cont)) {
+    auto func = lifter.Lift(range);
+    if (!func) continue;
+    for (const auto &pass : ssa_passes_) pass->Run(*func);
+    auto code = ssa::Lowerer(*func, tigger_mode_).Lower();
+    if (code) funcs.push_back(std::move(*code));
+  }
+  if (!funcs.empty()) cont.ReplaceFuncs(funcs);
+}
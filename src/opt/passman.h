@@ -0,0 +1,54 @@
+#ifndef MINIVM_OPT_PASSMAN_H_
+#define MINIVM_OPT_PASSMAN_H_
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "vm/instcont.h"
+#include "opt/pass.h"
+
+namespace minivm::opt {
+
+// pass manager, runs optimization passes on all functions of sealed
+// Gopher instructions (after slot allocation, before fusion)
+class PassManager {
+ public:
+  // create passes of the specific optimization level
+  //  0: no optimizations
+  //  1: redundant load/store removal and jump threading, run once
+  //  2: all passes, run until no more changes are made, functions are
+  //     also optimized in SSA form before other passes
+  PassManager(std::uint32_t opt_level, bool tigger_mode);
+
+  // run all passes on the specific instruction container
+  void Run(vm::VMInstContainer &cont);
+
+ private:
+  // add a new pass
+  template <typename T>
+  void AddPass() {
+    passes_.push_back(std::make_unique<T>());
+  }
+  // add a new SSA pass
+  template <typename T>
+  void AddSSAPass() {
+    ssa_passes_.push_back(std::make_unique<T>());
+  }
+  // run the specific pass on all functions, and remove instructions
+  // returns 'true' if any function changed
+  bool RunPass(PassInterface &pass, vm::VMInstContainer &cont);
+  // lift all functions to SSA form, run all SSA passes, and lower them
+  // back to Gopher, functions that can not be lifted or lowered are
+  // kept unchanged
+  void RunSSAPasses(vm::VMInstContainer &cont);
+
+  std::uint32_t opt_level_;
+  bool tigger_mode_;
+  std::vector<std::unique_ptr<PassInterface>> passes_;
+  std::vector<std::unique_ptr<SSAPassInterface>> ssa_passes_;
+};
+
+}  // namespace minivm::opt
+
+#endif  // MINIVM_OPT_PASSMAN_H_
@@ -0,0 +1,240 @@
+#include "ssa/ir.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace minivm::ssa;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+namespace {
+
+// name of all SSA instructions
+const char *kInstNames[] = {SSA_INSTS(VM_EXPAND_STR_ARRAY)};
+
+// dump the specific location
+void DumpLoc(std::ostream &os, Loc loc) {
+  switch (loc.kind) {
+    case LocKind::Slot: os << "slot " << loc.index; break;
+    case LocKind::Global: os << "global " << loc.index; break;
+    case LocKind::Reg: os << "reg " << loc.index; break;
+    default: assert(false);
+  }
+}
+
+}  // namespace
+
+bool minivm::ssa::IsTerminator(Op op) {
+  return op == Op::Jmp || op == Op::Bnz || op == Op::Ret || op == Op::Error;
+}
+
+bool minivm::ssa::HasSideEffect(Op op) {
+  switch (op) {
+    case Op::StVar: case Op::ArrSlot: case Op::Ld: case Op::St:
+    case Op::Div: case Op::Mod: case Op::Call: case Op::CallExt:
+    case Op::Jmp: case Op::Bnz: case Op::Ret: case Op::Error: {
+      return true;
+    }
+    default: return false;
+  }
+}
+
+bool minivm::ssa::IsUnary(Op op) {
+  return op == Op::LNot || op == Op::Neg || op == Op::ImmHi;
+}
+
+bool minivm::ssa::IsBinary(Op op) {
+  switch (op) {
+    case Op::LAnd: case Op::LOr: case Op::Eq: case Op::Ne: case Op::Gt:
+    case Op::Lt: case Op::Ge: case Op::Le: case Op::Add: case Op::Sub:
+    case Op::Mul: case Op::Div: case Op::Mod: case Op::And: case Op::Shl:
+    case Op::Shr: {
+      return true;
+    }
+    default: return false;
+  }
+}
+
+bool minivm::ssa::IsCommutative(Op op) {
+  switch (op) {
+    case Op::LAnd: case Op::LOr: case Op::Eq: case Op::Ne: case Op::Add:
+    case Op::Mul: case Op::And: {
+      return true;
+    }
+    default: return false;
+  }
+}
+
+BlockId Function::AddBlock(VMAddr pc) {
+  blocks_.push_back({{}, {}, {}, pc});
+  return blocks_.size() - 1;
+}
+
+InstId Function::NewInst(Op op, VMAddr pc) {
+  insts_.push_back({op, 0, {LocKind::Slot, 0}, {}, 0, false, kNoBlock, pc,
+                    {}});
+  return insts_.size() - 1;
+}
+
+InstId Function::AddInst(BlockId block, Op op, VMAddr pc) {
+  auto id = NewInst(op, pc);
+  insts_[id].block = block;
+  blocks_[block].insts.push_back(id);
+  return id;
+}
+
+void Function::AddEdge(BlockId from, BlockId to) {
+  blocks_[from].succs.push_back(to);
+  blocks_[to].preds.push_back(from);
+}
+
+void Function::RemoveEdge(BlockId from, std::size_t index) {
+  auto &succs = blocks_[from].succs;
+  auto &to = blocks_[succs[index]];
+  succs.erase(succs.begin() + index);
+  auto it = std::find(to.preds.begin(), to.preds.end(), from);
+  assert(it != to.preds.end());
+  auto pred_index = it - to.preds.begin();
+  to.preds.erase(it);
+  for (const auto &id : to.insts) {
+    auto &inst = insts_[id];
+    if (inst.op != Op::Phi) break;
+    inst.oprs.erase(inst.oprs.begin() + pred_index);
+  }
+}
+
+void Function::RemoveBlocks(const std::vector<bool> &removed) {
+  assert(!removed[0]);
+  // remove edges from removed blocks
+  for (BlockId id = 0; id < blocks_.size(); ++id) {
+    if (!removed[id]) continue;
+    while (!blocks_[id].succs.empty()) {
+      auto last = blocks_[id].succs.size() - 1;
+      if (removed[blocks_[id].succs[last]]) {
+        blocks_[id].succs.pop_back();
+      }
+      else {
+        RemoveEdge(id, last);
+      }
+    }
+    for (const auto &inst : blocks_[id].insts) insts_[inst].block = kNoBlock;
+  }
+  // renumber remaining blocks
+  std::vector<BlockId> new_ids(blocks_.size(), kNoBlock);
+  std::vector<Block> blocks;
+  for (BlockId id = 0; id < blocks_.size(); ++id) {
+    if (removed[id]) continue;
+    new_ids[id] = blocks.size();
+    blocks.push_back(std::move(blocks_[id]));
+  }
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    auto &block = blocks[id];
+    for (auto &succ : block.succs) {
+      // edges from remaining blocks to removed blocks are not allowed
+      assert(new_ids[succ] != kNoBlock);
+      succ = new_ids[succ];
+    }
+    for (auto &pred : block.preds) pred = new_ids[pred];
+    for (const auto &inst : block.insts) insts_[inst].block = id;
+  }
+  blocks_ = std::move(blocks);
+}
+
+void Function::ReplaceUses(InstId from, InstId to) {
+  for (const auto &block : blocks_) {
+    for (const auto &id : block.insts) {
+      for (auto &opr : insts_[id].oprs) {
+        if (opr == from) opr = to;
+      }
+    }
+  }
+}
+
+void Function::RemoveInsts(const std::vector<bool> &removed) {
+  for (auto &block : blocks_) {
+    auto &insts = block.insts;
+    insts.erase(std::remove_if(insts.begin(), insts.end(),
+                               [&removed](InstId id) {
+                                 return removed[id];
+                               }),
+                insts.end());
+  }
+  for (InstId id = 0; id < insts_.size(); ++id) {
+    if (removed[id]) insts_[id].block = kNoBlock;
+  }
+}
+
+ControlFlowGraph Function::BuildCFG() const {
+  std::vector<std::vector<BlockId>> succs;
+  for (const auto &block : blocks_) succs.push_back(block.succs);
+  return ControlFlowGraph(succs);
+}
+
+std::vector<std::vector<InstId>> Function::GetUsers() const {
+  std::vector<std::vector<InstId>> users(insts_.size());
+  for (const auto &block : blocks_) {
+    for (const auto &id : block.insts) {
+      for (const auto &opr : insts_[id].oprs) users[opr].push_back(id);
+    }
+  }
+  return users;
+}
+
+void Function::Dump(std::ostream &os) const {
+  os << "function at pc " << range_.begin << ", " << slot_count_
+     << " slots:" << std::endl;
+  for (BlockId id = 0; id < blocks_.size(); ++id) {
+    const auto &block = blocks_[id];
+    os << "block " << id << " (pc " << block.pc << "):";
+    if (!block.preds.empty()) {
+      os << " preds";
+      for (const auto &pred : block.preds) os << ' ' << pred;
+    }
+    os << std::endl;
+    for (const auto &inst_id : block.insts) {
+      const auto &inst = insts_[inst_id];
+      os << "  ";
+      if (inst.has_value) os << '%' << inst_id << " = ";
+      os << kInstNames[static_cast<int>(inst.op)];
+      // dump immediates and locations
+      switch (inst.op) {
+        case Op::Const: case Op::ImmHi: case Op::CallExt: case Op::Error: {
+          os << ' ' << inst.imm;
+          break;
+        }
+        case Op::Call: {
+          os << " pc " << inst.imm;
+          break;
+        }
+        case Op::Param: case Op::LdVar: case Op::StVar: case Op::ArrSlot: {
+          os << ' ';
+          DumpLoc(os, inst.loc);
+          break;
+        }
+        default:;
+      }
+      // dump operands
+      for (std::size_t i = 0; i < inst.oprs.size(); ++i) {
+        os << (i ? ", " : " ");
+        if (i == inst.arg_count &&
+            (inst.op == Op::Call || inst.op == Op::CallExt ||
+             inst.op == Op::Ret)) {
+          os << "| ";
+        }
+        os << '%' << inst.oprs[i];
+      }
+      // dump successors
+      if (inst.op == Op::Jmp || inst.op == Op::Bnz) {
+        for (std::size_t i = 0; i < block.succs.size(); ++i) {
+          os << (i || !inst.oprs.empty() ? ", " : " ");
+          os << "block " << block.succs[i];
+        }
+      }
+      if (inst.var) {
+        os << "  ; ";
+        DumpLoc(os, *inst.var);
+      }
+      os << std::endl;
+    }
+  }
+}
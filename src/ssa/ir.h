@@ -0,0 +1,177 @@
+#ifndef MINIVM_SSA_IR_H_
+#define MINIVM_SSA_IR_H_
+
+#include <ostream>
+#include <optional>
+#include <vector>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "analysis/cfg.h"
+#include "analysis/effect.h"
+
+// all SSA instructions
+#define SSA_INSTS(e)                                    \
+  /* values from outside the function */                \
+  e(Const) e(Param) e(LdVar) e(Phi)                     \
+  /* stores to escaping locations */                    \
+  e(StVar)                                              \
+  /* memory pool */                                     \
+  e(ArrSlot) e(Ld) e(St)                                \
+  /* unary operations */                                \
+  e(LNot) e(Neg) e(ImmHi)                               \
+  /* binary operations */                               \
+  e(LAnd) e(LOr) e(Eq) e(Ne) e(Gt) e(Lt) e(Ge) e(Le)    \
+  e(Add) e(Sub) e(Mul) e(Div) e(Mod)                    \
+  e(And) e(Shl) e(Shr)                                  \
+  /* function calls */                                  \
+  e(Call) e(CallExt)                                    \
+  /* terminators */                                     \
+  e(Jmp) e(Bnz) e(Ret) e(Error)
+
+namespace minivm::ssa {
+
+// opcode of SSA instructions
+enum class Op : std::uint8_t { SSA_INSTS(VM_EXPAND_LIST) };
+
+// identifier of instructions, which is also the identifier of the value
+// defined by the instruction
+using InstId = std::uint32_t;
+// invalid instruction id
+constexpr InstId kNoInst = static_cast<InstId>(-1);
+// identifier of basic blocks, same as blocks of the control flow graph
+using analysis::BlockId;
+using analysis::kNoBlock;
+
+// SSA instruction
+//  Const:   'imm' is the value
+//  Param:   value of location 'loc' at the entry of function
+//  LdVar:   value of escaping location 'loc' after the preceding call
+//  Phi:     operand 'i' comes from the i-th predecessor of the block
+//  StVar:   stores operand 0 to escaping location 'loc'
+//  ArrSlot: allocates operand 0 bytes, the address is also stored
+//           to frame slot 'loc'
+//  Ld/St:   loads from address operand 0 / stores operand 0 to
+//           address operand 1
+//  ImmHi:   replaces upper bits of operand 0 by 'imm'
+//  Shl/Shr: shifts operand 0 (arithmetically for 'Shr') by the lower
+//           5 bits of operand 1
+//  Call:    calls function at pc 'imm' with the first 'arg_count'
+//           operands, defines the return value if 'has_value' is set
+//  CallExt: calls external function 'imm' (symbol id) likewise
+//  Bnz:     jumps to the first successor if operand 0 is non-zero,
+//           otherwise to the second successor
+//  Ret:     returns the first 'arg_count' operands on the stack
+//  Error:   raises error 'imm'
+// operands after 'arg_count' of calls and returns are current values of
+// all escaping locations (static registers and global slots accessed by
+// the function, see 'Function::escapes'), which may be read by callees
+// or callers
+struct Inst {
+  Op op;
+  // immediate, pc address, symbol id or error code
+  vm::VMOpr imm;
+  // location of 'Param', 'LdVar', 'StVar' and 'ArrSlot'
+  analysis::Loc loc;
+  std::vector<InstId> oprs;
+  std::uint32_t arg_count;
+  // set if the instruction defines a value
+  bool has_value;
+  // block that contains the instruction
+  BlockId block;
+  // pc address of the original Gopher instruction, for line numbers
+  vm::VMAddr pc;
+  // location that holds the value in the original Gopher code, which is
+  // preferred when lowering
+  std::optional<analysis::Loc> var;
+};
+
+// basic block, phi instructions come first, and a terminator comes last
+struct Block {
+  std::vector<InstId> insts;
+  // successors & predecessors
+  std::vector<BlockId> succs, preds;
+  // pc address of the original Gopher block
+  vm::VMAddr pc;
+};
+
+// check if the specific opcode is a terminator
+bool IsTerminator(Op op);
+// check if the specific instruction has side effects, or may trap,
+// instructions without side effects can be removed if unused
+bool HasSideEffect(Op op);
+// check if the specific opcode is a unary operation
+bool IsUnary(Op op);
+// check if the specific opcode is a binary operation
+bool IsBinary(Op op);
+// check if the specific binary operation is commutative
+bool IsCommutative(Op op);
+
+// SSA function lifted from a Gopher function
+class Function {
+ public:
+  Function(analysis::FuncRange range, std::uint32_t slot_count)
+      : range_(range), slot_count_(slot_count) {}
+
+  // create a new block, returns the block id
+  BlockId AddBlock(vm::VMAddr pc);
+  // create a new instruction, without appending it to any block
+  InstId NewInst(Op op, vm::VMAddr pc);
+  // create a new instruction, and append it to the specific block
+  InstId AddInst(BlockId block, Op op, vm::VMAddr pc);
+  // add an edge between the specific blocks
+  void AddEdge(BlockId from, BlockId to);
+  // remove the edge from block 'from' to its 'index'-th successor, and
+  // the corresponding operands of phis in the successor
+  void RemoveEdge(BlockId from, std::size_t index);
+  // remove all marked blocks ('removed[id]' is set) and their edges,
+  // remaining blocks are renumbered in order, the entry block is never
+  // removed
+  void RemoveBlocks(const std::vector<bool> &removed);
+  // replace all uses of value 'from' by value 'to'
+  void ReplaceUses(InstId from, InstId to);
+  // remove all marked instructions ('removed[id]' is set) from blocks,
+  // ids of remaining instructions are not changed
+  void RemoveInsts(const std::vector<bool> &removed);
+  // build control flow graph of all blocks
+  analysis::ControlFlowGraph BuildCFG() const;
+  // get users of all values, duplicated if a value is used more than
+  // once by an instruction
+  std::vector<std::vector<InstId>> GetUsers() const;
+
+  // dump the function
+  void Dump(std::ostream &os) const;
+
+  // getters
+  analysis::FuncRange range() const { return range_; }
+  std::uint32_t slot_count() const { return slot_count_; }
+  std::vector<Block> &blocks() { return blocks_; }
+  const std::vector<Block> &blocks() const { return blocks_; }
+  Block &block(BlockId id) { return blocks_[id]; }
+  const Block &block(BlockId id) const { return blocks_[id]; }
+  std::vector<Inst> &insts() { return insts_; }
+  const std::vector<Inst> &insts() const { return insts_; }
+  Inst &inst(InstId id) { return insts_[id]; }
+  const Inst &inst(InstId id) const { return insts_[id]; }
+  // escaping locations, escaping operands of calls and returns are
+  // current values of these locations in order
+  std::vector<analysis::Loc> &escapes() { return escapes_; }
+  const std::vector<analysis::Loc> &escapes() const { return escapes_; }
+  // frame slots declared by 'VarSlot' in the original Gopher code
+  std::vector<std::uint32_t> &decl_slots() { return decl_slots_; }
+  const std::vector<std::uint32_t> &decl_slots() const {
+    return decl_slots_;
+  }
+
+ private:
+  analysis::FuncRange range_;
+  std::uint32_t slot_count_;
+  std::vector<Block> blocks_;
+  std::vector<Inst> insts_;
+  std::vector<analysis::Loc> escapes_;
+  std::vector<std::uint32_t> decl_slots_;
+};
+
+}  // namespace minivm::ssa
+
+#endif  // MINIVM_SSA_IR_H_
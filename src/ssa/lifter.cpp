@@ -0,0 +1,730 @@
+#include "ssa/lifter.h"
+
+#include <algorithm>
+#include <utility>
+#include <cassert>
+
+#include "analysis/effect.h"
+
+using namespace minivm::ssa;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+namespace {
+
+// unknown operand stack depth
+constexpr std::uint32_t kNoDepth = static_cast<std::uint32_t>(-1);
+
+// get SSA opcode of the specific stack operation
+std::optional<Op> GetStackOp(InstOp op) {
+  switch (op) {
+    case InstOp::LNot: return Op::LNot;
+    case InstOp::Neg: return Op::Neg;
+    case InstOp::LAnd: return Op::LAnd;
+    case InstOp::LOr: return Op::LOr;
+    case InstOp::Eq: return Op::Eq;
+    case InstOp::Ne: return Op::Ne;
+    case InstOp::Gt: return Op::Gt;
+    case InstOp::Lt: return Op::Lt;
+    case InstOp::Ge: return Op::Ge;
+    case InstOp::Le: return Op::Le;
+    case InstOp::Add: return Op::Add;
+    case InstOp::Sub: return Op::Sub;
+    case InstOp::Mul: return Op::Mul;
+    case InstOp::Div: return Op::Div;
+    case InstOp::Mod: return Op::Mod;
+    case InstOp::And: return Op::And;
+    case InstOp::Shl: return Op::Shl;
+    case InstOp::Shr: return Op::Shr;
+    default: return {};
+  }
+}
+
+// get SSA opcode of the specific register operation ('xxxRRR', 'xxxRRI'
+// or 'BxxRR'), and check if the second operand is an immediate
+std::optional<std::pair<Op, bool>> GetRegOp(InstOp op) {
+  switch (op) {
+    case InstOp::LAndRRR: return {{Op::LAnd, false}};
+    case InstOp::LOrRRR: return {{Op::LOr, false}};
+    case InstOp::EqRRR: case InstOp::BeqRR: return {{Op::Eq, false}};
+    case InstOp::NeRRR: case InstOp::BneRR: return {{Op::Ne, false}};
+    case InstOp::GtRRR: case InstOp::BgtRR: return {{Op::Gt, false}};
+    case InstOp::LtRRR: case InstOp::BltRR: return {{Op::Lt, false}};
+    case InstOp::GeRRR: case InstOp::BgeRR: return {{Op::Ge, false}};
+    case InstOp::LeRRR: case InstOp::BleRR: return {{Op::Le, false}};
+    case InstOp::AddRRR: return {{Op::Add, false}};
+    case InstOp::SubRRR: return {{Op::Sub, false}};
+    case InstOp::MulRRR: return {{Op::Mul, false}};
+    case InstOp::DivRRR: return {{Op::Div, false}};
+    case InstOp::ModRRR: return {{Op::Mod, false}};
+    case InstOp::LAndRRI: return {{Op::LAnd, true}};
+    case InstOp::LOrRRI: return {{Op::LOr, true}};
+    case InstOp::EqRRI: return {{Op::Eq, true}};
+    case InstOp::NeRRI: return {{Op::Ne, true}};
+    case InstOp::GtRRI: return {{Op::Gt, true}};
+    case InstOp::LtRRI: return {{Op::Lt, true}};
+    case InstOp::GeRRI: return {{Op::Ge, true}};
+    case InstOp::LeRRI: return {{Op::Le, true}};
+    case InstOp::AddRRI: return {{Op::Add, true}};
+    case InstOp::SubRRI: return {{Op::Sub, true}};
+    case InstOp::MulRRI: return {{Op::Mul, true}};
+    case InstOp::DivRRI: return {{Op::Div, true}};
+    case InstOp::ModRRI: return {{Op::Mod, true}};
+    default: return {};
+  }
+}
+
+// check if the specific location is the zero register 'x0'
+inline bool IsZeroReg(Loc loc) {
+  return loc.kind == LocKind::Reg && !loc.index;
+}
+
+}  // namespace
+
+Lifter::Lifter(const VMInstContainer &cont, bool tigger_mode)
+    : cont_(cont), tigger_mode_(tigger_mode) {
+  // compute return depths of all functions until nothing changes
+  auto ranges = GetFuncRanges(cont_);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto &range : ranges) {
+      if (ret_depths_.count(range.begin)) continue;
+      ComputeDepths(range, false);
+      if (ret_depths_.count(range.begin)) changed = true;
+    }
+  }
+}
+
+std::optional<std::vector<std::uint32_t>> Lifter::ComputeDepths(
+    FuncRange range, bool strict) {
+  std::vector<std::uint32_t> depths(range.end - range.begin, kNoDepth);
+  std::vector<VMAddr> worklist;
+  auto propagate = [&](VMAddr target, std::uint32_t depth) {
+    if (target < range.begin || target >= range.end) return false;
+    auto &cur = depths[target - range.begin];
+    if (cur == kNoDepth) {
+      cur = depth;
+      worklist.push_back(target);
+    }
+    return cur == depth;
+  };
+  propagate(range.begin, 0);
+  std::optional<std::uint32_t> ret_depth;
+  while (!worklist.empty()) {
+    auto pc = worklist.back();
+    worklist.pop_back();
+    auto depth = depths[pc - range.begin];
+    auto inst = cont_.GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    // get count of popped and pushed values
+    std::uint32_t pop = 0, push = 0;
+    bool fall = true;
+    std::optional<VMAddr> target;
+    switch (op) {
+      case InstOp::ArrSlot: case InstOp::StSlot: case InstOp::StGlobal:
+      case InstOp::StReg: case InstOp::Pop: {
+        pop = 1;
+        break;
+      }
+      case InstOp::Ld: case InstOp::StSlotP: case InstOp::StGlobalP:
+      case InstOp::StRegP: case InstOp::ImmHi: case InstOp::LNot:
+      case InstOp::Neg: {
+        pop = push = 1;
+        break;
+      }
+      case InstOp::LdReg: case InstOp::LdSlot: case InstOp::LdGlobal:
+      case InstOp::Imm: {
+        push = 1;
+        break;
+      }
+      case InstOp::St: pop = 2; break;
+      case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+      case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+      case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::Div:
+      case InstOp::Mod: case InstOp::And: case InstOp::Shl: case InstOp::Shr: {
+        pop = 2;
+        push = 1;
+        break;
+      }
+      case InstOp::Bnz: {
+        pop = 1;
+        target = static_cast<VMAddr>(inst.opr);
+        break;
+      }
+      case InstOp::Jmp: {
+        fall = false;
+        target = static_cast<VMAddr>(inst.opr);
+        break;
+      }
+      case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+      case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+        target = pc + 2;
+        break;
+      }
+      case InstOp::Clear: pop = depth; break;
+      case InstOp::Call: {
+        pop = depth;
+        auto it = ret_depths_.find(inst.opr);
+        if (it != ret_depths_.end()) {
+          push = it->second;
+        }
+        else if (strict) {
+          return {};
+        }
+        else {
+          fall = false;
+        }
+        break;
+      }
+      case InstOp::CallExt: {
+        pop = depth;
+        push = tigger_mode_ ? 0 : 1;
+        break;
+      }
+      case InstOp::Ret: {
+        // only zero or one return value is supported
+        if (depth > 1 || (ret_depth && *ret_depth != depth)) return {};
+        ret_depth = depth;
+        fall = false;
+        break;
+      }
+      case InstOp::Error: fall = false; break;
+      case InstOp::VarSlot: case InstOp::Enter: case InstOp::MovRR:
+      case InstOp::MovRI: {
+        break;
+      }
+      default: {
+        // symbol references, breakpoints and superinstructions
+        // are not supported
+        if (!GetRegOp(op)) return {};
+        break;
+      }
+    }
+    if (depth < pop) return {};
+    auto next = depth - pop + push;
+    if (target && !propagate(*target, next)) return {};
+    if (fall && !propagate(pc + 1, next)) return {};
+  }
+  if (ret_depth) ret_depths_.insert({range.begin, *ret_depth});
+  return depths;
+}
+
+std::optional<Function> Lifter::Lift(FuncRange range) {
+  if (static_cast<InstOp>(cont_.GetOrigInst(range.begin).op) !=
+      InstOp::Enter) {
+    return {};
+  }
+  auto depths = ComputeDepths(range, true);
+  if (!depths) return {};
+  ControlFlowGraph cfg(cont_, range);
+  if (!cfg.block(0).preds.empty()) return {};
+  DominatorTree dom(cfg);
+  Liveness liveness(cont_, cfg);
+  // initialize states
+  func_.emplace(range, cont_.GetOrigInst(range.begin).opr);
+  locs_ = liveness.locs();
+  loc_ids_.clear();
+  escapes_.clear();
+  for (std::uint32_t i = 0; i < locs_.size(); ++i) {
+    loc_ids_.insert({locs_[i].key(), i});
+    if (locs_[i].kind != LocKind::Slot && !IsZeroReg(locs_[i])) {
+      escapes_.push_back(i);
+      func_->escapes().push_back(locs_[i]);
+    }
+  }
+  phi_locs_.clear();
+  cur_values_.assign(locs_.size(), {});
+  rename_log_.clear();
+  params_.clear();
+  // build SSA form
+  BuildBlocks(cfg);
+  InsertPhis(cfg, dom, liveness, *depths);
+  if (!Rename(cfg, dom)) return {};
+  RemoveTrivialPhis();
+  // sort declared slots
+  auto &decls = func_->decl_slots();
+  std::sort(decls.begin(), decls.end());
+  decls.erase(std::unique(decls.begin(), decls.end()), decls.end());
+  auto func = std::move(*func_);
+  func_.reset();
+  return func;
+}
+
+void Lifter::BuildBlocks(const ControlFlowGraph &cfg) {
+  // create blocks for all reachable blocks, in address order
+  block_ids_.assign(cfg.blocks().size(), kNoBlock);
+  for (BlockId id = 0; id < cfg.blocks().size(); ++id) {
+    if (cfg.IsReachable(id)) {
+      block_ids_[id] = func_->AddBlock(cfg.block(id).begin);
+    }
+  }
+  // add edges, the taken edge of a branch comes first
+  for (BlockId id = 0; id < cfg.blocks().size(); ++id) {
+    if (!cfg.IsReachable(id)) continue;
+    const auto &block = cfg.block(id);
+    auto last = cont_.GetOrigInst(block.end - 1);
+    auto op = static_cast<InstOp>(last.op);
+    auto from = block_ids_[id];
+    auto to = [this, &cfg](VMAddr pc) {
+      return block_ids_[cfg.FindBlock(pc)];
+    };
+    bool is_branch =
+        op == InstOp::Bnz ||
+        (op == InstOp::Jmp && block.end - 1 > block.begin &&
+         IsRegBranch(static_cast<InstOp>(
+             cont_.GetOrigInst(block.end - 2).op)));
+    if (is_branch) {
+      auto taken = to(last.opr), fall = to(block.end);
+      func_->AddEdge(from, taken);
+      if (fall != taken) func_->AddEdge(from, fall);
+    }
+    else if (op == InstOp::Jmp) {
+      func_->AddEdge(from, to(last.opr));
+    }
+    else if (op != InstOp::Ret && op != InstOp::Error) {
+      func_->AddEdge(from, to(block.end));
+    }
+  }
+}
+
+void Lifter::InsertPhis(const ControlFlowGraph &cfg,
+                        const DominatorTree &dom, const Liveness &liveness,
+                        const std::vector<std::uint32_t> &depths) {
+  auto block_count = func_->blocks().size();
+  // collect blocks that define each location
+  std::vector<std::vector<BlockId>> def_blocks(locs_.size());
+  for (BlockId id = 0; id < cfg.blocks().size(); ++id) {
+    if (!cfg.IsReachable(id)) continue;
+    const auto &block = cfg.block(id);
+    for (auto pc = block.begin; pc < block.end; ++pc) {
+      auto effect = GetEffect(cont_.GetOrigInst(pc));
+      if (effect.def) {
+        def_blocks[loc_ids_.at(effect.def->key())].push_back(id);
+      }
+      if (effect.call) {
+        for (const auto &i : escapes_) def_blocks[i].push_back(id);
+      }
+    }
+  }
+  // insert phis at the iterated dominance frontier of definitions,
+  // only if the location is live
+  std::vector<std::uint32_t> inserted(cfg.blocks().size(), kNoDepth);
+  std::vector<std::uint32_t> visited(cfg.blocks().size(), kNoDepth);
+  for (std::uint32_t i = 0; i < locs_.size(); ++i) {
+    if (IsZeroReg(locs_[i])) continue;
+    auto worklist = def_blocks[i];
+    for (const auto &id : worklist) visited[id] = i;
+    while (!worklist.empty()) {
+      auto id = worklist.back();
+      worklist.pop_back();
+      for (const auto &df : dom.frontier(id)) {
+        if (inserted[df] == i) continue;
+        inserted[df] = i;
+        if (liveness.IsLiveIn(df, locs_[i])) {
+          auto block = block_ids_[df];
+          auto phi = AddValue(block, Op::Phi, cfg.block(df).begin);
+          auto &inst = func_->inst(phi);
+          inst.oprs.assign(func_->block(block).preds.size(), kNoInst);
+          inst.var = locs_[i];
+          phi_locs_.insert({phi, i});
+        }
+        if (visited[df] != i) {
+          visited[df] = i;
+          worklist.push_back(df);
+        }
+      }
+    }
+  }
+  // insert phis for operand stack entries at join points
+  stack_phis_.assign(block_count, {});
+  exit_stacks_.assign(block_count, {});
+  for (BlockId id = 0; id < cfg.blocks().size(); ++id) {
+    if (!cfg.IsReachable(id)) continue;
+    auto block = block_ids_[id];
+    auto pred_count = func_->block(block).preds.size();
+    if (pred_count < 2) continue;
+    auto depth = depths[cfg.block(id).begin - cfg.range().begin];
+    for (std::uint32_t i = 0; i < depth; ++i) {
+      auto phi = AddValue(block, Op::Phi, cfg.block(id).begin);
+      func_->inst(phi).oprs.assign(pred_count, kNoInst);
+      stack_phis_[block].push_back(phi);
+    }
+  }
+}
+
+bool Lifter::Rename(const ControlFlowGraph &cfg, const DominatorTree &dom) {
+  // walk the dominator tree in pre-order
+  struct Frame {
+    BlockId id;
+    std::size_t next_child, log_size;
+  };
+  std::vector<Frame> stack;
+  auto enter = [&](BlockId id) {
+    auto block = block_ids_[id];
+    stack.push_back({id, 0, rename_log_.size()});
+    // define locations by phis
+    for (const auto &inst : func_->block(block).insts) {
+      auto it = phi_locs_.find(inst);
+      if (it != phi_locs_.end()) {
+        cur_values_[it->second].push_back(inst);
+        rename_log_.push_back(it->second);
+      }
+    }
+    // get operand stack at the entry
+    std::vector<InstId> values;
+    const auto &preds = func_->block(block).preds;
+    if (!stack_phis_[block].empty()) {
+      values = stack_phis_[block];
+    }
+    else if (preds.size() == 1) {
+      values = exit_stacks_[preds.front()];
+    }
+    if (!ConvertBlock(cfg.block(id), block, values)) return false;
+    // fill operands of phis in successors
+    for (const auto &succ : func_->block(block).succs) {
+      const auto &succ_preds = func_->block(succ).preds;
+      auto index = std::find(succ_preds.begin(), succ_preds.end(), block) -
+                   succ_preds.begin();
+      for (const auto &inst : func_->block(succ).insts) {
+        auto it = phi_locs_.find(inst);
+        if (it != phi_locs_.end()) {
+          func_->inst(inst).oprs[index] = ReadLoc(locs_[it->second]);
+        }
+      }
+      const auto &phis = stack_phis_[succ];
+      if (phis.empty()) continue;
+      if (phis.size() != values.size()) return false;
+      for (std::size_t i = 0; i < phis.size(); ++i) {
+        func_->inst(phis[i]).oprs[index] = values[i];
+      }
+    }
+    exit_stacks_[block] = std::move(values);
+    return true;
+  };
+  if (!enter(0)) return false;
+  while (!stack.empty()) {
+    auto &frame = stack.back();
+    const auto &children = dom.children(frame.id);
+    if (frame.next_child < children.size()) {
+      if (!enter(children[frame.next_child++])) return false;
+    }
+    else {
+      // restore current values of locations
+      while (rename_log_.size() > frame.log_size) {
+        cur_values_[rename_log_.back()].pop_back();
+        rename_log_.pop_back();
+      }
+      stack.pop_back();
+    }
+  }
+  // place parameters at the beginning of the entry block
+  std::vector<InstId> params;
+  for (InstId id = 0; id < func_->insts().size(); ++id) {
+    if (func_->inst(id).op == Op::Param) params.push_back(id);
+  }
+  auto &insts = func_->block(0).insts;
+  insts.erase(std::remove_if(insts.begin(), insts.end(),
+                             [this](InstId id) {
+                               return func_->inst(id).op == Op::Param;
+                             }),
+              insts.end());
+  insts.insert(insts.begin(), params.begin(), params.end());
+  return true;
+}
+
+bool Lifter::ConvertBlock(const BasicBlock &block, BlockId id,
+                          std::vector<InstId> &stack) {
+  auto pop = [&stack]() {
+    auto value = stack.back();
+    stack.pop_back();
+    return value;
+  };
+  auto add_op = [this, id](Op op, VMAddr pc,
+                           std::initializer_list<InstId> oprs) {
+    auto value = AddValue(id, op, pc);
+    func_->inst(value).oprs = oprs;
+    return value;
+  };
+  auto read_reg = [this, id](RegId reg_id, VMAddr pc) {
+    // 'x0' is always zero
+    if (!reg_id) return AddConst(id, 0, pc);
+    return ReadLoc({LocKind::Reg, reg_id});
+  };
+  auto add_terminator = [this, id](Op op, VMAddr pc) {
+    return func_->AddInst(id, op, pc);
+  };
+  for (auto pc = block.begin; pc < block.end; ++pc) {
+    auto inst = cont_.GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    switch (op) {
+      case InstOp::Enter: break;
+      case InstOp::VarSlot: {
+        func_->decl_slots().push_back(inst.opr);
+        WriteLoc(id, {LocKind::Slot, inst.opr},
+                 AddConst(id, 0xdeadc0de, pc), pc);
+        break;
+      }
+      case InstOp::ArrSlot: {
+        auto value = add_op(Op::ArrSlot, pc, {pop()});
+        Loc loc = {LocKind::Slot, inst.opr};
+        func_->inst(value).loc = loc;
+        WriteLoc(id, loc, value, pc);
+        break;
+      }
+      case InstOp::Ld: stack.push_back(add_op(Op::Ld, pc, {pop()})); break;
+      case InstOp::St: {
+        auto addr = pop(), value = pop();
+        func_->inst(func_->AddInst(id, Op::St, pc)).oprs = {value, addr};
+        break;
+      }
+      case InstOp::LdSlot: case InstOp::LdGlobal: case InstOp::LdReg: {
+        auto loc = *GetLoadLoc(inst);
+        stack.push_back(IsZeroReg(loc) ? AddConst(id, 0, pc)
+                                       : ReadLoc(loc));
+        break;
+      }
+      case InstOp::StSlot: case InstOp::StSlotP: case InstOp::StGlobal:
+      case InstOp::StGlobalP: case InstOp::StReg: case InstOp::StRegP: {
+        auto loc = *GetStoreLoc(inst);
+        if (IsZeroReg(loc)) return false;
+        auto value = IsStoreKeep(op) ? stack.back() : pop();
+        WriteLoc(id, loc, value, pc);
+        break;
+      }
+      case InstOp::Imm: {
+        stack.push_back(AddConst(id, ExtendImm(inst.opr), pc));
+        break;
+      }
+      case InstOp::ImmHi: {
+        auto value = pop();
+        const auto &lo = func_->inst(value);
+        if (lo.op == Op::Const) {
+          // fold wide immediates
+          stack.push_back(AddConst(id, MergeImm(lo.imm, inst.opr), pc));
+        }
+        else {
+          auto hi = add_op(Op::ImmHi, pc, {value});
+          func_->inst(hi).imm = inst.opr;
+          stack.push_back(hi);
+        }
+        break;
+      }
+      case InstOp::Bnz: {
+        auto cond = pop();
+        if (func_->block(id).succs.size() == 1) {
+          add_terminator(Op::Jmp, pc);
+        }
+        else {
+          func_->inst(add_terminator(Op::Bnz, pc)).oprs = {cond};
+        }
+        break;
+      }
+      case InstOp::Jmp: add_terminator(Op::Jmp, pc); break;
+      case InstOp::Call: case InstOp::CallExt: {
+        bool is_call = op == InstOp::Call;
+        auto call = AddValue(id, is_call ? Op::Call : Op::CallExt, pc);
+        auto &call_inst = func_->inst(call);
+        call_inst.imm = inst.opr;
+        call_inst.oprs = std::move(stack);
+        call_inst.arg_count = call_inst.oprs.size();
+        stack.clear();
+        AddEscapes(call);
+        // calls are known to return
+        auto has_value = is_call ? ret_depths_.at(inst.opr) != 0
+                                 : !tigger_mode_;
+        func_->inst(call).has_value = has_value;
+        if (has_value) stack.push_back(call);
+        ReloadEscapes(id, pc);
+        break;
+      }
+      case InstOp::Ret: {
+        auto ret = add_terminator(Op::Ret, pc);
+        func_->inst(ret).oprs = std::move(stack);
+        func_->inst(ret).arg_count = func_->inst(ret).oprs.size();
+        stack.clear();
+        AddEscapes(ret);
+        break;
+      }
+      case InstOp::Error: {
+        func_->inst(add_terminator(Op::Error, pc)).imm = inst.opr;
+        break;
+      }
+      case InstOp::LNot: case InstOp::Neg: {
+        stack.push_back(add_op(*GetStackOp(op), pc, {pop()}));
+        break;
+      }
+      case InstOp::Pop: pop(); break;
+      case InstOp::Clear: stack.clear(); break;
+      case InstOp::MovRR: case InstOp::MovRI: {
+        auto dst = GetRegOpr(inst.opr, 0);
+        if (!dst) return false;
+        auto value = op == InstOp::MovRR
+                         ? read_reg(GetRegOpr(inst.opr, 1), pc)
+                         : AddConst(id, GetRegImm(inst.opr, 1), pc);
+        WriteLoc(id, {LocKind::Reg, dst}, value, pc);
+        break;
+      }
+      default: {
+        if (auto stack_op = GetStackOp(op)) {
+          // binary operations
+          auto rhs = pop(), lhs = pop();
+          stack.push_back(add_op(*stack_op, pc, {lhs, rhs}));
+          break;
+        }
+        auto reg_op = GetRegOp(op);
+        assert(reg_op);
+        auto lhs_id = GetRegOpr(inst.opr, IsRegBranch(op) ? 0 : 1);
+        auto lhs = read_reg(lhs_id, pc);
+        InstId rhs;
+        if (IsRegBranch(op)) {
+          rhs = read_reg(GetRegOpr(inst.opr, 1), pc);
+        }
+        else if (reg_op->second) {
+          rhs = AddConst(id, GetRegImm(inst.opr, 2), pc);
+        }
+        else {
+          rhs = read_reg(GetRegOpr(inst.opr, 2), pc);
+        }
+        auto value = add_op(reg_op->first, pc, {lhs, rhs});
+        if (IsRegBranch(op)) {
+          // the following 'Jmp' must be the last instruction of the block
+          if (pc + 2 != block.end) return false;
+          if (func_->block(id).succs.size() == 1) {
+            add_terminator(Op::Jmp, pc);
+          }
+          else {
+            func_->inst(add_terminator(Op::Bnz, pc)).oprs = {value};
+          }
+          ++pc;
+        }
+        else {
+          auto dst = GetRegOpr(inst.opr, 0);
+          if (!dst) return false;
+          WriteLoc(id, {LocKind::Reg, dst}, value, pc);
+        }
+        break;
+      }
+    }
+  }
+  // add the terminator if the block falls through
+  const auto &insts = func_->block(id).insts;
+  if (insts.empty() || !IsTerminator(func_->inst(insts.back()).op)) {
+    add_terminator(Op::Jmp, block.end - 1);
+  }
+  return true;
+}
+
+void Lifter::RemoveTrivialPhis() {
+  // find the value that replaces the specific value
+  std::unordered_map<InstId, InstId> replaced;
+  auto find = [&replaced](InstId value) {
+    for (auto it = replaced.find(value); it != replaced.end();
+         it = replaced.find(value)) {
+      value = it->second;
+    }
+    return value;
+  };
+  std::vector<bool> removed(func_->insts().size(), false);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto &block : func_->blocks()) {
+      for (const auto &id : block.insts) {
+        const auto &inst = func_->inst(id);
+        if (inst.op != Op::Phi) break;
+        // phis of escaping locations are kept, since the locations must
+        // hold the values when lowering
+        if (removed[id] || (inst.var && inst.var->kind != LocKind::Slot)) {
+          continue;
+        }
+        // check if all operands are the same value (or the phi itself)
+        auto same = kNoInst;
+        bool trivial = true;
+        for (const auto &opr : inst.oprs) {
+          auto value = find(opr);
+          if (value == id || value == same) continue;
+          if (same != kNoInst) {
+            trivial = false;
+            break;
+          }
+          same = value;
+        }
+        if (!trivial || same == kNoInst) continue;
+        replaced.insert({id, same});
+        removed[id] = true;
+        changed = true;
+      }
+    }
+  }
+  if (replaced.empty()) return;
+  func_->RemoveInsts(removed);
+  for (auto &block : func_->blocks()) {
+    for (const auto &id : block.insts) {
+      for (auto &opr : func_->inst(id).oprs) opr = find(opr);
+    }
+  }
+}
+
+InstId Lifter::ReadLoc(Loc loc) {
+  auto i = loc_ids_.at(loc.key());
+  if (!cur_values_[i].empty()) return cur_values_[i].back();
+  // value at the entry of function
+  auto it = params_.find(i);
+  if (it != params_.end()) return it->second;
+  auto param = func_->NewInst(Op::Param, func_->range().begin);
+  auto &inst = func_->inst(param);
+  inst.loc = loc;
+  inst.has_value = true;
+  inst.block = 0;
+  inst.var = loc;
+  // parameters are moved to the beginning of the entry block later
+  func_->block(0).insts.push_back(param);
+  params_.insert({i, param});
+  return param;
+}
+
+void Lifter::WriteLoc(BlockId id, Loc loc, InstId value, VMAddr pc) {
+  auto i = loc_ids_.at(loc.key());
+  cur_values_[i].push_back(value);
+  rename_log_.push_back(i);
+  // phis of stack entries are not bound to any location
+  auto &inst = func_->inst(value);
+  if (!inst.var && inst.op != Op::Const && inst.op != Op::Phi) {
+    inst.var = loc;
+  }
+  // stores to escaping locations are kept
+  if (loc.kind != LocKind::Slot) {
+    auto store = func_->AddInst(id, Op::StVar, pc);
+    func_->inst(store).loc = loc;
+    func_->inst(store).oprs = {value};
+  }
+}
+
+InstId Lifter::AddValue(BlockId id, Op op, VMAddr pc) {
+  auto value = func_->AddInst(id, op, pc);
+  func_->inst(value).has_value = true;
+  return value;
+}
+
+InstId Lifter::AddConst(BlockId id, VMOpr value, VMAddr pc) {
+  auto inst = AddValue(id, Op::Const, pc);
+  func_->inst(inst).imm = value;
+  return inst;
+}
+
+void Lifter::AddEscapes(InstId inst) {
+  for (const auto &i : escapes_) {
+    auto value = ReadLoc(locs_[i]);
+    func_->inst(inst).oprs.push_back(value);
+  }
+}
+
+void Lifter::ReloadEscapes(BlockId id, VMAddr pc) {
+  for (const auto &i : escapes_) {
+    auto value = AddValue(id, Op::LdVar, pc);
+    auto &inst = func_->inst(value);
+    inst.loc = locs_[i];
+    inst.var = locs_[i];
+    cur_values_[i].push_back(value);
+    rename_log_.push_back(i);
+  }
+}
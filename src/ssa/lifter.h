@@ -0,0 +1,99 @@
+#ifndef MINIVM_SSA_LIFTER_H_
+#define MINIVM_SSA_LIFTER_H_
+
+#include <optional>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+#include "analysis/cfg.h"
+#include "analysis/dominance.h"
+#include "analysis/liveness.h"
+#include "ssa/ir.h"
+
+namespace minivm::ssa {
+
+// lifter of Gopher functions (after slot allocation, before fusion),
+// converts functions to pruned SSA form by the algorithm of Cytron et al.
+// frame slots, global slots, static registers and operand stack entries
+// are all converted to SSA values, loads and stores of memory pool are
+// kept as instructions
+class Lifter {
+ public:
+  Lifter(const vm::VMInstContainer &cont, bool tigger_mode);
+
+  // lift the specific function, returns null if the function can not be
+  // lifted, e.g. the function contains symbol references, or the operand
+  // stack depth is not statically known
+  std::optional<Function> Lift(analysis::FuncRange range);
+
+ private:
+  // compute operand stack depths of all instructions in the specific
+  // function, calls to functions whose return depths are unknown are
+  // treated as never returning if 'strict' is not set
+  // returns null if failed
+  std::optional<std::vector<std::uint32_t>> ComputeDepths(
+      analysis::FuncRange range, bool strict);
+  // create blocks & edges from the control flow graph
+  void BuildBlocks(const analysis::ControlFlowGraph &cfg);
+  // insert phi instructions for locations & stack entries
+  void InsertPhis(const analysis::ControlFlowGraph &cfg,
+                  const analysis::DominatorTree &dom,
+                  const analysis::Liveness &liveness,
+                  const std::vector<std::uint32_t> &depths);
+  // rename all values by walking the dominator tree
+  // returns 'false' if failed
+  bool Rename(const analysis::ControlFlowGraph &cfg,
+              const analysis::DominatorTree &dom);
+  // convert instructions of the specific block to SSA form
+  // returns 'false' if failed
+  bool ConvertBlock(const analysis::BasicBlock &block, BlockId id,
+                    std::vector<InstId> &stack);
+  // remove phi instructions whose operands are all the same value,
+  // except phis of escaping locations
+  void RemoveTrivialPhis();
+
+  // get current value of the specific location
+  InstId ReadLoc(analysis::Loc loc);
+  // update current value of the specific location
+  void WriteLoc(BlockId id, analysis::Loc loc, InstId value,
+                vm::VMAddr pc);
+  // create a new value in the specific block
+  InstId AddValue(BlockId id, Op op, vm::VMAddr pc);
+  // create a new constant in the specific block
+  InstId AddConst(BlockId id, vm::VMOpr value, vm::VMAddr pc);
+  // append current values of escaping locations to operands
+  void AddEscapes(InstId inst);
+  // reload escaping locations after calls
+  void ReloadEscapes(BlockId id, vm::VMAddr pc);
+
+  const vm::VMInstContainer &cont_;
+  bool tigger_mode_;
+  // operand stack depths of all functions when returning
+  std::unordered_map<vm::VMAddr, std::uint32_t> ret_depths_;
+  // states of the function being lifted
+  std::optional<Function> func_;
+  // SSA block of each block in the control flow graph
+  std::vector<BlockId> block_ids_;
+  // all accessed locations, and index of escaping locations
+  std::vector<analysis::Loc> locs_;
+  std::unordered_map<std::uint64_t, std::uint32_t> loc_ids_;
+  std::vector<std::uint32_t> escapes_;
+  // phi instructions of locations
+  std::unordered_map<InstId, std::uint32_t> phi_locs_;
+  // phi instructions of stack entries of each block
+  std::vector<std::vector<InstId>> stack_phis_;
+  // operand stack at the exit of each block
+  std::vector<std::vector<InstId>> exit_stacks_;
+  // current values of locations, and the renaming log
+  std::vector<std::vector<InstId>> cur_values_;
+  std::vector<std::uint32_t> rename_log_;
+  // values of locations at the entry
+  std::unordered_map<std::uint32_t, InstId> params_;
+};
+
+}  // namespace minivm::ssa
+
+#endif  // MINIVM_SSA_LIFTER_H_
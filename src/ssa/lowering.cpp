@@ -0,0 +1,933 @@
+#include "ssa/lowering.h"
+
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+using namespace minivm::ssa;
+using namespace minivm::vm;
+using namespace minivm::analysis;
+
+namespace {
+
+// position of uses by phis, at the end of predecessors
+constexpr std::uint32_t kEndPos = std::numeric_limits<std::uint32_t>::max();
+
+// check if the specific location is a static register or a global slot,
+// which may be accessed by callees and callers
+inline bool IsEscaping(Loc loc) { return loc.kind != LocKind::Slot; }
+
+// check if the specific instruction is a phi of an escaping location
+inline bool IsEscapingPhi(const Inst &inst) {
+  return inst.op == Op::Phi && inst.var && IsEscaping(*inst.var);
+}
+
+// check if operands after 'arg_count' are escaping values
+inline bool HasEscapes(Op op) {
+  return op == Op::Call || op == Op::CallExt || op == Op::Ret;
+}
+
+// get Gopher opcode of the specific unary/binary operation
+InstOp GetStackOp(Op op) {
+  switch (op) {
+    case Op::LNot: return InstOp::LNot;
+    case Op::Neg: return InstOp::Neg;
+    case Op::ImmHi: return InstOp::ImmHi;
+    case Op::LAnd: return InstOp::LAnd;
+    case Op::LOr: return InstOp::LOr;
+    case Op::Eq: return InstOp::Eq;
+    case Op::Ne: return InstOp::Ne;
+    case Op::Gt: return InstOp::Gt;
+    case Op::Lt: return InstOp::Lt;
+    case Op::Ge: return InstOp::Ge;
+    case Op::Le: return InstOp::Le;
+    case Op::Add: return InstOp::Add;
+    case Op::Sub: return InstOp::Sub;
+    case Op::Mul: return InstOp::Mul;
+    case Op::Div: return InstOp::Div;
+    case Op::Mod: return InstOp::Mod;
+    case Op::And: return InstOp::And;
+    case Op::Shl: return InstOp::Shl;
+    case Op::Shr: return InstOp::Shr;
+    default: assert(false); return InstOp::Break;
+  }
+}
+
+// get Gopher opcode of the specific binary operation in register form,
+// 'xxxRRR' or 'xxxRRI', returns null if there is no register form
+std::optional<InstOp> GetRegOp(Op op, bool imm) {
+  switch (op) {
+    case Op::LAnd: return imm ? InstOp::LAndRRI : InstOp::LAndRRR;
+    case Op::LOr: return imm ? InstOp::LOrRRI : InstOp::LOrRRR;
+    case Op::Eq: return imm ? InstOp::EqRRI : InstOp::EqRRR;
+    case Op::Ne: return imm ? InstOp::NeRRI : InstOp::NeRRR;
+    case Op::Gt: return imm ? InstOp::GtRRI : InstOp::GtRRR;
+    case Op::Lt: return imm ? InstOp::LtRRI : InstOp::LtRRR;
+    case Op::Ge: return imm ? InstOp::GeRRI : InstOp::GeRRR;
+    case Op::Le: return imm ? InstOp::LeRRI : InstOp::LeRRR;
+    case Op::Add: return imm ? InstOp::AddRRI : InstOp::AddRRR;
+    case Op::Sub: return imm ? InstOp::SubRRI : InstOp::SubRRR;
+    case Op::Mul: return imm ? InstOp::MulRRI : InstOp::MulRRR;
+    case Op::Div: return imm ? InstOp::DivRRI : InstOp::DivRRR;
+    case Op::Mod: return imm ? InstOp::ModRRI : InstOp::ModRRR;
+    default: return {};
+  }
+}
+
+// get Gopher opcode of register branch of the specific comparison
+std::optional<InstOp> GetRegBranchOp(Op op) {
+  switch (op) {
+    case Op::Eq: return InstOp::BeqRR;
+    case Op::Ne: return InstOp::BneRR;
+    case Op::Gt: return InstOp::BgtRR;
+    case Op::Lt: return InstOp::BltRR;
+    case Op::Ge: return InstOp::BgeRR;
+    case Op::Le: return InstOp::BleRR;
+    default: return {};
+  }
+}
+
+}  // namespace
+
+Lowerer::Lowerer(const Function &func, bool tigger_mode)
+    : func_(func), tigger_mode_(tigger_mode), cfg_(func.BuildCFG()),
+      dom_(cfg_), visit_stamp_(0), temp_count_(0),
+      cur_pc_(func.range().begin) {}
+
+std::optional<VMInstContainer::FuncCode> Lowerer::Lower() {
+  const auto &blocks = func_.blocks();
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    if (!cfg_.IsReachable(id)) return {};
+  }
+  // assign homes
+  CollectUses();
+  ComputeLiveness();
+  ComputeVersionLiveness();
+  homes_.assign(func_.insts().size(), {HomeKind::None, {}});
+  fused_.assign(func_.insts().size(), false);
+  written_.assign(blocks.size(), {});
+  live_.assign(blocks.size(), {});
+  if (!AddFixedOccupants()) return {};
+  AssignHomes();
+  // emit all blocks, and blocks that hold phi copies of branch edges
+  labels_.assign(blocks.size(), 0);
+  EmitEntry();
+  for (BlockId id = 0; id < blocks.size(); ++id) EmitBlock(id);
+  labels_.resize(blocks.size() + edges_.size());
+  for (std::size_t i = 0; i < edges_.size(); ++i) {
+    auto [from, to] = edges_[i];
+    labels_[blocks.size() + i] = insts_.size();
+    reg_values_.clear();
+    cur_pc_ = func_.inst(blocks[from].insts.back()).pc;
+    EmitPhiCopies(from, to);
+    EmitJump(InstOp::Jmp, to);
+  }
+  // backfill jump targets
+  VMInstContainer::FuncCode code;
+  code.begin = func_.range().begin;
+  code.end = func_.range().end;
+  code.temp_count = temp_count_;
+  for (const auto &[index, label] : jumps_) {
+    insts_[index].inst.opr = labels_[label];
+  }
+  for (const auto &inst : insts_) {
+    code.insts.push_back(inst.inst);
+    code.orig_pcs.push_back(inst.pc);
+  }
+  return code;
+}
+
+void Lowerer::CollectUses() {
+  const auto &blocks = func_.blocks();
+  auto count = func_.insts().size();
+  indices_.assign(count, 0);
+  uses_.assign(count, {});
+  users_.assign(count, {});
+  const auto &escapes = func_.escapes();
+  for (std::uint32_t i = 0; i < escapes.size(); ++i) {
+    escape_ids_.insert({escapes[i].key(), i});
+  }
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    const auto &insts = blocks[id].insts;
+    for (std::uint32_t i = 0; i < insts.size(); ++i) indices_[insts[i]] = i;
+  }
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    const auto &insts = blocks[id].insts;
+    for (std::uint32_t i = 0; i < insts.size(); ++i) {
+      const auto &inst = func_.inst(insts[i]);
+      if (inst.op == Op::Phi) {
+        // phis read operands at the end of predecessors
+        for (std::size_t k = 0; k < inst.oprs.size(); ++k) {
+          Point point = {blocks[id].preds[k], kEndPos};
+          uses_[inst.oprs[k]].push_back(point);
+          users_[inst.oprs[k]].push_back(insts[i]);
+          if (IsEscapingPhi(inst)) {
+            auto key = VersionKey(inst.oprs[k],
+                                  escape_ids_.at(inst.var->key()));
+            version_uses_[key].push_back(point);
+          }
+        }
+        continue;
+      }
+      auto escape_begin =
+          HasEscapes(inst.op) ? inst.arg_count : inst.oprs.size();
+      for (std::size_t k = 0; k < inst.oprs.size(); ++k) {
+        Point point = {id, 3 * i + 1};
+        if (k < escape_begin) {
+          uses_[inst.oprs[k]].push_back(point);
+          users_[inst.oprs[k]].push_back(insts[i]);
+        }
+        else {
+          auto key = VersionKey(inst.oprs[k], k - escape_begin);
+          version_uses_[key].push_back(point);
+        }
+      }
+    }
+  }
+}
+
+void Lowerer::ExploreLiveOut(BlockId def, const std::vector<Point> &uses,
+                             std::vector<BlockId> &live_out) {
+  ++visit_stamp_;
+  std::vector<BlockId> worklist;
+  auto add_live_out = [&](BlockId id) {
+    if (visited_[id] == visit_stamp_) return;
+    visited_[id] = visit_stamp_;
+    live_out.push_back(id);
+    worklist.push_back(id);
+  };
+  // walk backward from uses to the definition, values are never used
+  // before definitions in the same block, except by phis
+  for (const auto &use : uses) {
+    if (use.pos == kEndPos) {
+      add_live_out(use.block);
+    }
+    else if (use.block != def) {
+      for (const auto &pred : func_.block(use.block).preds) {
+        add_live_out(pred);
+      }
+    }
+  }
+  while (!worklist.empty()) {
+    auto id = worklist.back();
+    worklist.pop_back();
+    if (id == def) continue;
+    for (const auto &pred : func_.block(id).preds) add_live_out(pred);
+  }
+  std::sort(live_out.begin(), live_out.end());
+}
+
+void Lowerer::ComputeLiveness() {
+  // liveness is computed per value, so the memory usage is proportional
+  // to the total size of live ranges instead of blocks times values
+  auto count = func_.insts().size();
+  visited_.assign(func_.blocks().size(), 0);
+  visit_stamp_ = 0;
+  live_out_.assign(count, {});
+  for (InstId value = 0; value < count; ++value) {
+    auto def = func_.inst(value).block;
+    if (def == kNoBlock || uses_[value].empty()) continue;
+    ExploreLiveOut(def, uses_[value], live_out_[value]);
+  }
+}
+
+void Lowerer::ComputeVersionLiveness() {
+  for (const auto &[key, uses] : version_uses_) {
+    auto def = func_.inst(key >> 32).block;
+    ExploreLiveOut(def, uses, version_live_out_[key]);
+  }
+}
+
+bool Lowerer::IsLiveAfter(InstId value, Point point) const {
+  const auto &live_out = live_out_[value];
+  if (std::binary_search(live_out.begin(), live_out.end(), point.block)) {
+    return true;
+  }
+  for (const auto &use : uses_[value]) {
+    if (use.block == point.block && use.pos > point.pos) return true;
+  }
+  return false;
+}
+
+bool Lowerer::IsVersionLiveAfter(InstId value, std::uint32_t escape,
+                                 Point point) const {
+  auto key = VersionKey(value, escape);
+  auto it = version_live_out_.find(key);
+  if (it == version_live_out_.end()) return false;
+  if (std::binary_search(it->second.begin(), it->second.end(),
+                         point.block)) {
+    return true;
+  }
+  for (const auto &use : version_uses_.at(key)) {
+    if (use.block == point.block && use.pos > point.pos) return true;
+  }
+  return false;
+}
+
+std::vector<BlockId> Lowerer::GetLiveBlocks(Loc loc,
+                                            const Occupant &occ) const {
+  std::vector<BlockId> blocks;
+  auto add = [&blocks](const std::vector<BlockId> &live_out,
+                       const std::vector<Point> &uses) {
+    blocks.insert(blocks.end(), live_out.begin(), live_out.end());
+    for (const auto &use : uses) blocks.push_back(use.block);
+  };
+  if (occ.value == kNoInst) return blocks;
+  if (occ.is_home) add(live_out_[occ.value], uses_[occ.value]);
+  if (occ.is_version) {
+    auto key = VersionKey(occ.value, escape_ids_.at(loc.key()));
+    if (auto it = version_live_out_.find(key);
+        it != version_live_out_.end()) {
+      add(it->second, version_uses_.at(key));
+    }
+  }
+  std::sort(blocks.begin(), blocks.end());
+  blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+  return blocks;
+}
+
+bool Lowerer::Dominates(Point a, Point b) const {
+  if (a.block == b.block) return a.pos <= b.pos;
+  return dom_.Dominates(a.block, b.block);
+}
+
+bool Lowerer::Interferes(Loc loc, const Occupant &a,
+                         const Occupant &b) const {
+  if (a.value == b.value && a.value != kNoInst) return false;
+  // check if the occupant is still needed after the specific point
+  auto is_live = [this, loc](const Occupant &occ, Point point) {
+    if (occ.value == kNoInst) return false;
+    if (occ.is_home && IsLiveAfter(occ.value, point)) return true;
+    return occ.is_version &&
+           IsVersionLiveAfter(occ.value, escape_ids_.at(loc.key()), point);
+  };
+  // the location is occupied by both if one is still needed
+  // when the other one is written
+  return (Dominates(a.point, b.point) && is_live(a, b.point)) ||
+         (Dominates(b.point, a.point) && is_live(b, a.point));
+}
+
+bool Lowerer::AddOccupant(Loc loc, const Occupant &occ) {
+  auto interferes = [&](const std::vector<std::uint32_t> &indices) {
+    for (const auto &i : indices) {
+      const auto &[key, other] = occupants_[i];
+      if (key == loc.key() && Interferes(loc, occ, other)) return true;
+    }
+    return false;
+  };
+  // check occupants live where the new one is written, and occupants
+  // written where the new one is live
+  auto blocks = GetLiveBlocks(loc, occ);
+  if (interferes(live_[occ.point.block])) return false;
+  for (const auto &block : blocks) {
+    if (interferes(written_[block])) return false;
+  }
+  std::uint32_t index = occupants_.size();
+  occupants_.push_back({loc.key(), occ});
+  written_[occ.point.block].push_back(index);
+  for (const auto &block : blocks) live_[block].push_back(index);
+  return true;
+}
+
+bool Lowerer::TryAssign(InstId value, Loc loc) {
+  const auto &inst = func_.inst(value);
+  // frame slots of arrays are only used by their allocations
+  if (loc.kind == LocKind::Slot && inst.op != Op::ArrSlot &&
+      std::find(arr_slots_.begin(), arr_slots_.end(), loc.index) !=
+          arr_slots_.end()) {
+    return false;
+  }
+  Point point = {inst.block, 3 * indices_[value] + 2};
+  if (!AddOccupant(loc, {value, point, true, false})) return false;
+  homes_[value] = {HomeKind::Loc, loc};
+  return true;
+}
+
+void Lowerer::AssignTemp(InstId value) {
+  // first fit
+  for (std::uint32_t i = 0; i < temp_count_; ++i) {
+    if (TryAssign(value, {LocKind::Slot, func_.slot_count() + i})) return;
+  }
+  Loc loc = {LocKind::Slot, func_.slot_count() + temp_count_++};
+  [[maybe_unused]] auto ret = TryAssign(value, loc);
+  assert(ret);
+}
+
+bool Lowerer::AddFixedOccupants() {
+  const auto &blocks = func_.blocks();
+  // declarations of frame slots are placed after parameters
+  std::uint32_t param_count = 0;
+  for (const auto &id : blocks.front().insts) {
+    if (func_.inst(id).op != Op::Param) break;
+    ++param_count;
+  }
+  for (const auto &slot : func_.decl_slots()) {
+    Occupant occ = {kNoInst, {0, 3 * param_count}, false, false};
+    if (!AddOccupant({LocKind::Slot, slot}, occ)) return false;
+  }
+  for (BlockId id = 0; id < blocks.size(); ++id) {
+    const auto &insts = blocks[id].insts;
+    for (std::uint32_t i = 0; i < insts.size(); ++i) {
+      auto value = insts[i];
+      const auto &inst = func_.inst(value);
+      Point read = {id, 3 * i + 1}, write = {id, 3 * i + 2};
+      bool ok = true;
+      switch (inst.op) {
+        case Op::Param: case Op::LdVar: {
+          // the escaping location holds the value
+          if (IsEscaping(inst.loc)) {
+            ok = AddOccupant(inst.loc, {value, write, false, true});
+          }
+          break;
+        }
+        case Op::Phi: {
+          if (IsEscapingPhi(inst)) {
+            ok = AddOccupant(*inst.var, {value, write, false, true});
+          }
+          break;
+        }
+        case Op::StVar: {
+          ok = AddOccupant(inst.loc, {inst.oprs[0], write, false, true});
+          break;
+        }
+        case Op::ArrSlot: {
+          // the address is written to the frame slot
+          ok = AddOccupant(inst.loc, {value, write, false, false});
+          arr_slots_.push_back(inst.loc.index);
+          break;
+        }
+        case Op::Call: case Op::CallExt: {
+          // callees may modify all escaping locations
+          for (const auto &loc : func_.escapes()) {
+            if (!AddOccupant(loc, {value, read, false, false})) ok = false;
+          }
+          break;
+        }
+        default:;
+      }
+      if (!ok) return false;
+    }
+  }
+  return true;
+}
+
+void Lowerer::AssignHomes() {
+  const auto &insts = func_.insts();
+  auto needs_home = [this](InstId value) {
+    const auto &inst = func_.inst(value);
+    return inst.block != kNoBlock && inst.has_value &&
+           inst.op != Op::Const && homes_[value].kind == HomeKind::None &&
+           !uses_[value].empty();
+  };
+  // values that are stored in locations originally, phis of escaping
+  // locations are also stored in the locations
+  for (InstId value = 0; value < insts.size(); ++value) {
+    const auto &inst = insts[value];
+    if (!needs_home(value)) continue;
+    if (inst.op == Op::Param || inst.op == Op::LdVar ||
+        inst.op == Op::ArrSlot) {
+      TryAssign(value, inst.loc);
+    }
+    else if (IsEscapingPhi(inst)) {
+      TryAssign(value, *inst.var);
+    }
+  }
+  // values that are stored to escaping locations
+  for (InstId value = 0; value < insts.size(); ++value) {
+    if (!needs_home(value)) continue;
+    for (const auto &user : users_[value]) {
+      const auto &inst = func_.inst(user);
+      if (inst.op == Op::StVar && TryAssign(value, inst.loc)) break;
+    }
+  }
+  // values on the operand stack
+  for (BlockId id = 0; id < func_.blocks().size(); ++id) {
+    AssignStackHomes(id);
+  }
+  // other values, try the original location first
+  for (InstId value = 0; value < insts.size(); ++value) {
+    if (!needs_home(value)) continue;
+    const auto &var = insts[value].var;
+    if (!var || !TryAssign(value, *var)) AssignTemp(value);
+  }
+}
+
+void Lowerer::AssignStackHomes(BlockId id) {
+  // simulated operand stack, each entry is a value and the index of the
+  // first instruction that computes the value (and its operands)
+  struct Entry {
+    InstId value;
+    std::uint32_t start;
+  };
+  std::vector<Entry> stack;
+  // index of the last call, calls pop the whole operand stack
+  std::optional<std::uint32_t> last_call;
+  const auto &insts = func_.block(id).insts;
+  for (std::uint32_t i = 0; i < insts.size(); ++i) {
+    auto cur = insts[i];
+    const auto &inst = func_.inst(cur);
+    if (inst.op == Op::Phi) continue;
+    auto count = GetStackOprCount(inst);
+    const auto &oprs = inst.oprs;
+    // find the last operand on the stack
+    auto last = count, top = stack.size();
+    for (auto k = count; k-- > 0 && last == count;) {
+      for (auto j = stack.size(); j-- > 0;) {
+        if (stack[j].value == oprs[k]) {
+          last = k;
+          top = j;
+          break;
+        }
+      }
+    }
+    auto start = i;
+    if (last != count) {
+      // values above the operand can not stay on the stack
+      stack.resize(top + 1);
+      // match operands from top to bottom, operands not on the stack
+      // are pushed in advance, before computing the operand above
+      std::vector<std::pair<std::size_t, std::uint32_t>> preloads;
+      auto pos = top;
+      bool ok = true;
+      for (auto k = last; k-- > 0;) {
+        if (pos > 0 && stack[pos - 1].value == oprs[k]) {
+          --pos;
+          continue;
+        }
+        // the preloaded value must be defined before, and must not be
+        // popped by calls
+        auto before = stack[pos].start;
+        const auto &opr = func_.inst(oprs[k]);
+        if ((opr.op != Op::Const && opr.block == id &&
+             indices_[oprs[k]] >= before) ||
+            (last_call && *last_call >= before)) {
+          ok = false;
+          break;
+        }
+        preloads.push_back({k, before});
+      }
+      if (ok) {
+        for (auto j = pos; j <= top; ++j) {
+          homes_[stack[j].value] = {HomeKind::Stack, {}};
+        }
+        start = stack[pos].start;
+        stack.resize(pos);
+        if (!preloads.empty()) {
+          auto &flags = preloaded_[cur];
+          flags.assign(count, false);
+          // group preloads by the instruction they are pushed before,
+          // outer trees push their preloads first
+          std::reverse(preloads.begin(), preloads.end());
+          for (std::size_t b = 0; b < preloads.size();) {
+            auto before = preloads[b].second;
+            std::vector<InstId> values;
+            for (; b < preloads.size() && preloads[b].second == before; ++b) {
+              flags[preloads[b].first] = true;
+              values.push_back(oprs[preloads[b].first]);
+            }
+            auto &list = preloads_[insts[before]];
+            list.insert(list.begin(), values.begin(), values.end());
+          }
+        }
+      }
+    }
+    // values that are not consumed can not stay on the stack
+    // when calling or returning, or at the end of block
+    if (HasEscapes(inst.op) || IsTerminator(inst.op)) stack.clear();
+    if (inst.op == Op::Call || inst.op == Op::CallExt) last_call = i;
+    // remove operands that are not matched
+    for (std::size_t k = 0; k < count; ++k) {
+      for (std::size_t j = 0; j < stack.size(); ++j) {
+        if (stack[j].value == oprs[k]) {
+          stack.erase(stack.begin() + j);
+          break;
+        }
+      }
+    }
+    if (IsStackCandidate(cur)) stack.push_back({cur, start});
+  }
+}
+
+std::size_t Lowerer::GetStackOprCount(const Inst &inst) const {
+  switch (inst.op) {
+    case Op::StVar: case Op::ArrSlot: case Op::Ld: case Op::Bnz: return 1;
+    case Op::St: return 2;
+    case Op::Call: case Op::CallExt: case Op::Ret: return inst.arg_count;
+    default: {
+      if (IsUnary(inst.op)) return 1;
+      if (IsBinary(inst.op)) return 2;
+      return 0;
+    }
+  }
+}
+
+bool Lowerer::IsStackCandidate(InstId value) const {
+  const auto &inst = func_.inst(value);
+  if (!inst.has_value || homes_[value].kind != HomeKind::None) return false;
+  switch (inst.op) {
+    case Op::Const: case Op::Param: case Op::LdVar: case Op::Phi:
+    case Op::ArrSlot: {
+      return false;
+    }
+    default:;
+  }
+  // must be used once by an instruction in the same block
+  if (users_[value].size() != 1) return false;
+  const auto &user = func_.inst(users_[value].front());
+  if (user.op == Op::Phi || user.block != inst.block) return false;
+  auto count = GetStackOprCount(user);
+  return std::find(user.oprs.begin(), user.oprs.begin() + count, value) !=
+         user.oprs.begin() + count;
+}
+
+void Lowerer::Emit(InstOp op, std::uint32_t opr) {
+  VMUnpackedInst inst;
+  inst.op = static_cast<std::uint32_t>(op);
+  inst.opr = opr;
+  insts_.push_back({inst, cur_pc_});
+}
+
+void Lowerer::EmitEntry() {
+  cur_pc_ = func_.range().begin;
+  Emit(InstOp::Enter, func_.slot_count() + temp_count_);
+  for (std::uint32_t i = 0; i < temp_count_; ++i) {
+    Emit(InstOp::VarSlot, func_.slot_count() + i);
+  }
+  // move parameters to their homes, in parallel
+  std::vector<InstId> params;
+  for (const auto &id : func_.block(0).insts) {
+    const auto &inst = func_.inst(id);
+    if (inst.op != Op::Param) break;
+    const auto &home = homes_[id];
+    if (home.kind == HomeKind::Loc && home.loc != inst.loc) {
+      params.push_back(id);
+      Emit(GetLoadOp(inst.loc.kind), inst.loc.index);
+    }
+  }
+  for (auto it = params.rbegin(); it != params.rend(); ++it) {
+    EmitStore(homes_[*it].loc, *it);
+  }
+  for (const auto &slot : func_.decl_slots()) {
+    Emit(InstOp::VarSlot, slot);
+  }
+}
+
+void Lowerer::EmitBlock(BlockId id) {
+  labels_[id] = insts_.size();
+  reg_values_.clear();
+  for (const auto &inst : func_.block(id).insts) {
+    if (IsTerminator(func_.inst(inst).op)) {
+      EmitTerminator(id, inst);
+    }
+    else {
+      EmitInst(inst);
+    }
+  }
+}
+
+void Lowerer::EmitInst(InstId id) {
+  const auto &inst = func_.inst(id);
+  cur_pc_ = inst.pc;
+  // push values of the outer expression in advance
+  auto it = preloads_.find(id);
+  if (it != preloads_.end()) {
+    for (const auto &value : it->second) EmitLoad(value);
+  }
+  switch (inst.op) {
+    case Op::Const: case Op::Param: case Op::Phi: break;
+    case Op::LdVar: {
+      // the escaping location holds the value after calls
+      if (inst.loc.kind == LocKind::Reg) reg_values_[inst.loc.index] = id;
+      const auto &home = homes_[id];
+      if (home.kind == HomeKind::Loc && home.loc != inst.loc) {
+        Emit(GetLoadOp(inst.loc.kind), inst.loc.index);
+        EmitStore(home.loc, id);
+      }
+      break;
+    }
+    case Op::StVar: {
+      auto value = inst.oprs[0];
+      const auto &home = homes_[value];
+      if (home.kind != HomeKind::Loc || home.loc != inst.loc) {
+        EmitCopy(inst.loc, value);
+      }
+      break;
+    }
+    case Op::ArrSlot: {
+      EmitOperands(id, 1);
+      Emit(InstOp::ArrSlot, inst.loc.index);
+      const auto &home = homes_[id];
+      if (home.kind == HomeKind::Loc && home.loc != inst.loc) {
+        Emit(InstOp::LdSlot, inst.loc.index);
+        EmitStore(home.loc, id);
+      }
+      break;
+    }
+    case Op::Ld: {
+      EmitOperands(id, 1);
+      Emit(InstOp::Ld, 0);
+      EmitResult(id);
+      break;
+    }
+    case Op::St: {
+      EmitOperands(id, 2);
+      Emit(InstOp::St, 0);
+      break;
+    }
+    case Op::Call: case Op::CallExt: {
+      EmitOperands(id, inst.arg_count);
+      Emit(inst.op == Op::Call ? InstOp::Call : InstOp::CallExt, inst.imm);
+      // callees may modify static registers
+      reg_values_.clear();
+      if (inst.has_value) {
+        // intrinsics without return values push nothing, so unused
+        // return values are cleared rather than popped
+        if (homes_[id].kind == HomeKind::None) {
+          Emit(InstOp::Clear, 0);
+        }
+        else {
+          EmitResult(id);
+        }
+      }
+      else if (!tigger_mode_) {
+        // the register engine and native code assume that Eeyore calls
+        // always push a return value, so clear it as the frontend does
+        Emit(InstOp::Clear, 0);
+      }
+      break;
+    }
+    default: {
+      if (IsUnary(inst.op)) {
+        EmitOperands(id, 1);
+        Emit(GetStackOp(inst.op), inst.op == Op::ImmHi ? inst.imm : 0);
+        EmitResult(id);
+      }
+      else {
+        assert(IsBinary(inst.op));
+        if (CanFuseBranch(id)) {
+          fused_[id] = true;
+        }
+        else if (!TryEmitRegOp(id)) {
+          EmitOperands(id, 2);
+          Emit(GetStackOp(inst.op), 0);
+          EmitResult(id);
+        }
+      }
+      break;
+    }
+  }
+}
+
+void Lowerer::EmitTerminator(BlockId id, InstId term) {
+  const auto &inst = func_.inst(term);
+  const auto &succs = func_.block(id).succs;
+  cur_pc_ = inst.pc;
+  switch (inst.op) {
+    case Op::Jmp: {
+      EmitPhiCopies(id, succs[0]);
+      if (succs[0] != id + 1) EmitJump(InstOp::Jmp, succs[0]);
+      break;
+    }
+    case Op::Bnz: {
+      // copies of phis on the taken edge are placed in an edge block
+      auto taken = succs[0], fall = succs[1];
+      std::size_t label = taken;
+      if (!GetPhiCopies(id, taken).empty()) {
+        label = func_.blocks().size() + edges_.size();
+        edges_.push_back({id, taken});
+      }
+      auto cond = inst.oprs[0];
+      if (fused_[cond]) {
+        EmitRegBranch(cond, label);
+      }
+      else {
+        EmitOperands(term, 1);
+        EmitJump(InstOp::Bnz, label);
+      }
+      EmitPhiCopies(id, fall);
+      if (fall != id + 1) EmitJump(InstOp::Jmp, fall);
+      break;
+    }
+    case Op::Ret: {
+      EmitOperands(term, inst.arg_count);
+      Emit(InstOp::Ret, 0);
+      break;
+    }
+    case Op::Error: Emit(InstOp::Error, inst.imm); break;
+    default: assert(false);
+  }
+}
+
+void Lowerer::EmitOperands(InstId id, std::size_t count) {
+  const auto &oprs = func_.inst(id).oprs;
+  auto it = preloaded_.find(id);
+  for (std::size_t k = 0; k < count; ++k) {
+    // skip operands that are already on the stack
+    if (it != preloaded_.end() && it->second[k]) continue;
+    if (homes_[oprs[k]].kind == HomeKind::Stack) continue;
+    EmitLoad(oprs[k]);
+  }
+}
+
+void Lowerer::EmitLoad(InstId value) {
+  const auto &inst = func_.inst(value);
+  if (inst.op == Op::Const) return EmitConst(inst.imm);
+  const auto &home = homes_[value];
+  assert(home.kind == HomeKind::Loc);
+  Emit(GetLoadOp(home.loc.kind), home.loc.index);
+}
+
+void Lowerer::EmitConst(VMOpr value) {
+  constexpr auto kLower = -(1 << (kVMInstImmLen - 1));
+  constexpr auto kUpper = (1 << (kVMInstImmLen - 1)) - 1;
+  constexpr auto kLowerMask = (1u << kVMInstImmLen) - 1;
+  constexpr auto kUpperMask = (1u << (32 - kVMInstImmLen)) - 1;
+  if (value >= kLower && value <= kUpper) {
+    Emit(InstOp::Imm, value & kLowerMask);
+  }
+  else {
+    Emit(InstOp::Imm, value & kLowerMask);
+    Emit(InstOp::ImmHi, (value >> kVMInstImmLen) & kUpperMask);
+  }
+}
+
+void Lowerer::EmitStore(Loc loc, InstId value) {
+  Emit(GetStoreOp(loc.kind, false), loc.index);
+  if (loc.kind == LocKind::Reg) reg_values_[loc.index] = value;
+}
+
+void Lowerer::EmitCopy(Loc loc, InstId value) {
+  if (homes_[value].kind != HomeKind::Stack && loc.kind == LocKind::Reg &&
+      IsPackableReg(loc.index)) {
+    // use register moves if possible
+    const auto &inst = func_.inst(value);
+    if (inst.op == Op::Const && IsPackableImm(inst.imm, 1)) {
+      Emit(InstOp::MovRI, PackRegOpr({loc.index}, inst.imm));
+      reg_values_[loc.index] = value;
+      return;
+    }
+    if (auto reg = FindReg(value)) {
+      if (*reg != loc.index) {
+        Emit(InstOp::MovRR, PackRegOpr({loc.index, *reg}, 0));
+      }
+      reg_values_[loc.index] = value;
+      return;
+    }
+  }
+  if (homes_[value].kind != HomeKind::Stack) EmitLoad(value);
+  EmitStore(loc, value);
+}
+
+void Lowerer::EmitResult(InstId id) {
+  const auto &home = homes_[id];
+  switch (home.kind) {
+    case HomeKind::None: Emit(InstOp::Pop, 0); break;
+    case HomeKind::Stack: break;
+    case HomeKind::Loc: EmitStore(home.loc, id); break;
+  }
+}
+
+bool Lowerer::TryEmitRegOp(InstId id) {
+  const auto &inst = func_.inst(id);
+  const auto &home = homes_[id];
+  if (home.kind != HomeKind::Loc || home.loc.kind != LocKind::Reg ||
+      !IsPackableReg(home.loc.index) || preloaded_.count(id) ||
+      !GetRegOp(inst.op, false)) {
+    return false;
+  }
+  auto dst = home.loc.index;
+  auto try_emit = [this, &inst, id, dst](InstId lhs, InstId rhs) {
+    auto lhs_reg = FindReg(lhs);
+    if (!lhs_reg) return false;
+    if (auto rhs_reg = FindReg(rhs)) {
+      Emit(*GetRegOp(inst.op, false),
+           PackRegOpr({dst, *lhs_reg, *rhs_reg}, 0));
+    }
+    else {
+      const auto &rhs_inst = func_.inst(rhs);
+      if (rhs_inst.op != Op::Const || !IsPackableImm(rhs_inst.imm, 2)) {
+        return false;
+      }
+      Emit(*GetRegOp(inst.op, true), PackRegOpr({dst, *lhs_reg},
+                                                rhs_inst.imm));
+    }
+    reg_values_[dst] = id;
+    return true;
+  };
+  auto lhs = inst.oprs[0], rhs = inst.oprs[1];
+  return try_emit(lhs, rhs) || (IsCommutative(inst.op) && try_emit(rhs, lhs));
+}
+
+bool Lowerer::CanFuseBranch(InstId cond) const {
+  const auto &inst = func_.inst(cond);
+  if (homes_[cond].kind != HomeKind::Stack || !GetRegBranchOp(inst.op) ||
+      preloaded_.count(cond)) {
+    return false;
+  }
+  // must be used by the following branch
+  const auto &insts = func_.block(inst.block).insts;
+  auto index = indices_[cond] + 1;
+  if (index >= insts.size()) return false;
+  const auto &next = func_.inst(insts[index]);
+  if (next.op != Op::Bnz || next.oprs[0] != cond) return false;
+  return FindReg(inst.oprs[0]) && FindReg(inst.oprs[1]);
+}
+
+void Lowerer::EmitRegBranch(InstId cond, std::size_t label) {
+  const auto &inst = func_.inst(cond);
+  auto lhs = *FindReg(inst.oprs[0]), rhs = *FindReg(inst.oprs[1]);
+  Emit(*GetRegBranchOp(inst.op), PackRegOpr({lhs, rhs}, 0));
+  EmitJump(InstOp::Jmp, label);
+}
+
+void Lowerer::EmitPhiCopies(BlockId from, BlockId to) {
+  auto copies = GetPhiCopies(from, to);
+  if (copies.size() == 1) {
+    EmitCopy(homes_[copies.front().first].loc, copies.front().second);
+  }
+  else if (!copies.empty()) {
+    // emit copies in parallel
+    for (const auto &[phi, value] : copies) EmitLoad(value);
+    for (auto it = copies.rbegin(); it != copies.rend(); ++it) {
+      EmitStore(homes_[it->first].loc, it->first);
+    }
+  }
+}
+
+std::vector<std::pair<InstId, InstId>> Lowerer::GetPhiCopies(
+    BlockId from, BlockId to) const {
+  std::vector<std::pair<InstId, InstId>> copies;
+  const auto &block = func_.block(to);
+  auto index = std::find(block.preds.begin(), block.preds.end(), from) -
+               block.preds.begin();
+  for (const auto &id : block.insts) {
+    const auto &inst = func_.inst(id);
+    if (inst.op != Op::Phi) break;
+    const auto &home = homes_[id];
+    if (home.kind != HomeKind::Loc) continue;
+    // operands of phis of escaping locations are held by the locations
+    if (IsEscapingPhi(inst) && home.loc == *inst.var) continue;
+    auto value = inst.oprs[index];
+    const auto &opr_home = homes_[value];
+    if (opr_home.kind == HomeKind::Loc && opr_home.loc == home.loc) continue;
+    copies.push_back({id, value});
+  }
+  return copies;
+}
+
+void Lowerer::EmitJump(InstOp op, std::size_t label) {
+  jumps_.push_back({insts_.size(), label});
+  Emit(op, 0);
+}
+
+std::optional<RegId> Lowerer::FindReg(InstId value) const {
+  const auto &home = homes_[value];
+  if (home.kind == HomeKind::Loc && home.loc.kind == LocKind::Reg &&
+      IsPackableReg(home.loc.index)) {
+    return home.loc.index;
+  }
+  for (const auto &[reg, cached] : reg_values_) {
+    if (cached == value && IsPackableReg(reg)) return reg;
+  }
+  return {};
+}
@@ -0,0 +1,213 @@
+#ifndef MINIVM_SSA_LOWERING_H_
+#define MINIVM_SSA_LOWERING_H_
+
+#include <optional>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+#include "analysis/cfg.h"
+#include "analysis/dominance.h"
+#include "analysis/effect.h"
+#include "ssa/ir.h"
+
+namespace minivm::ssa {
+
+// lowering of SSA functions to Gopher instructions
+// each value is assigned a home: constants are rematerialized, values
+// used once by the following instructions stay on the operand stack,
+// and other values are stored in locations (frame slots, global slots
+// or static registers), interference of values sharing a location is
+// checked by dominance and liveness (Budimlic et al.), new frame slots
+// are allocated if the original locations can not be used
+class Lowerer {
+ public:
+  Lowerer(const Function &func, bool tigger_mode);
+
+  // lower the function, returns null if failed
+  std::optional<vm::VMInstContainer::FuncCode> Lower();
+
+ private:
+  // kind of homes
+  enum class HomeKind : std::uint8_t { None, Stack, Loc };
+
+  // home of a value
+  struct Home {
+    HomeKind kind;
+    analysis::Loc loc;
+  };
+
+  // program point, position 'p' of the i-th instruction of a block:
+  //  3i:     before the instruction
+  //  3i + 1: the instruction reads its operands
+  //  3i + 2: the instruction writes its result
+  struct Point {
+    BlockId block;
+    std::uint32_t pos;
+  };
+
+  // value that occupies a location from a point, a value may occupy its
+  // home ('is_home'), or an escaping location that must hold the value
+  // when calling or returning ('is_version')
+  // clobbers of locations (by calls, allocations and declarations) set
+  // neither of the flags, and never interfere with the clobbering value
+  struct Occupant {
+    InstId value;
+    Point point;
+    bool is_home, is_version;
+  };
+
+  // instruction being emitted, with original pc address
+  struct LoweredInst {
+    vm::VMUnpackedInst inst;
+    vm::VMAddr pc;
+  };
+
+  // key of a value held by an escaping location
+  static std::uint64_t VersionKey(InstId value, std::uint32_t escape) {
+    return (static_cast<std::uint64_t>(value) << 32) | escape;
+  }
+
+  // compute positions and uses of all values
+  void CollectUses();
+  // compute blocks (sorted) at whose exits the value defined in block
+  // 'def' is live, by exploring paths from the specific uses to 'def'
+  void ExploreLiveOut(BlockId def, const std::vector<Point> &uses,
+                      std::vector<BlockId> &live_out);
+  // compute liveness of all values
+  void ComputeLiveness();
+  // compute liveness of all versions
+  void ComputeVersionLiveness();
+  // check if the specific value is live after the specific point
+  bool IsLiveAfter(InstId value, Point point) const;
+  // check if the specific value must be held by the specific escaping
+  // location after the specific point
+  bool IsVersionLiveAfter(InstId value, std::uint32_t escape,
+                          Point point) const;
+  // get blocks (sorted) where the specific occupant of the specific
+  // location is live
+  std::vector<BlockId> GetLiveBlocks(analysis::Loc loc,
+                                     const Occupant &occ) const;
+  // check if point 'a' dominates point 'b'
+  bool Dominates(Point a, Point b) const;
+  // check if the specific occupants of the specific location interfere
+  bool Interferes(analysis::Loc loc, const Occupant &a,
+                  const Occupant &b) const;
+  // add an occupant to the specific location
+  // returns 'false' if it interferes with existing occupants
+  bool AddOccupant(analysis::Loc loc, const Occupant &occ);
+  // try to assign the specific location as home of the specific value
+  bool TryAssign(InstId value, analysis::Loc loc);
+  // assign a new frame slot as home of the specific value
+  void AssignTemp(InstId value);
+
+  // add occupants that can not be moved
+  // returns 'false' if any of them interferes
+  bool AddFixedOccupants();
+  // assign homes of all values
+  void AssignHomes();
+  // assign stack homes by simulating the operand stack in each block
+  void AssignStackHomes(BlockId id);
+  // get operands read from the operand stack by the specific instruction
+  std::size_t GetStackOprCount(const Inst &inst) const;
+  // check if the specific value can stay on the operand stack
+  bool IsStackCandidate(InstId value) const;
+
+  // emit instructions
+  void Emit(vm::InstOp op, std::uint32_t opr);
+  // emit the entry of function
+  void EmitEntry();
+  // emit the specific block
+  void EmitBlock(BlockId id);
+  // emit the specific instruction
+  void EmitInst(InstId id);
+  // emit terminator of the specific block
+  void EmitTerminator(BlockId id, InstId term);
+  // push operands of the specific instruction to the operand stack
+  void EmitOperands(InstId id, std::size_t count);
+  // push the specific value to the operand stack
+  void EmitLoad(InstId value);
+  // push the specific constant to the operand stack
+  void EmitConst(vm::VMOpr value);
+  // store the stack top to the specific location
+  void EmitStore(analysis::Loc loc, InstId value);
+  // store the specific value to the specific location
+  void EmitCopy(analysis::Loc loc, InstId value);
+  // store result of the specific instruction to its home
+  void EmitResult(InstId id);
+  // try to emit the specific binary operation as a register instruction
+  bool TryEmitRegOp(InstId id);
+  // check if the specific comparison can be fused into the following
+  // branch, as a register branch
+  bool CanFuseBranch(InstId cond) const;
+  // emit register branch of the specific fused comparison
+  void EmitRegBranch(InstId cond, std::size_t label);
+  // emit copies of phis on the edge 'from' -> 'to'
+  void EmitPhiCopies(BlockId from, BlockId to);
+  // get copies of phis on the edge 'from' -> 'to', each copy is a phi
+  // and the operand copied to the home of the phi
+  std::vector<std::pair<InstId, InstId>> GetPhiCopies(BlockId from,
+                                                      BlockId to) const;
+  // emit jump to the specific label
+  void EmitJump(vm::InstOp op, std::size_t label);
+  // get the static register that holds the specific value
+  std::optional<vm::RegId> FindReg(InstId value) const;
+
+  const Function &func_;
+  bool tigger_mode_;
+  analysis::ControlFlowGraph cfg_;
+  analysis::DominatorTree dom_;
+  // index of each instruction in its block
+  std::vector<std::uint32_t> indices_;
+  // normal uses of all values
+  std::vector<std::vector<Point>> uses_;
+  // uses of versions, by calls, returns and phis of escaping locations,
+  // indexed by 'VersionKey'
+  std::unordered_map<std::uint64_t, std::vector<Point>> version_uses_;
+  // users of all values, escaping uses are not included
+  std::vector<std::vector<InstId>> users_;
+  // blocks (sorted) at whose exits values are live
+  std::vector<std::vector<BlockId>> live_out_;
+  // blocks (sorted) at whose exits versions are live
+  std::unordered_map<std::uint64_t, std::vector<BlockId>> version_live_out_;
+  // the last exploration that visited each block, and the current one
+  std::vector<std::uint32_t> visited_;
+  std::uint32_t visit_stamp_;
+  // homes of all values
+  std::vector<Home> homes_;
+  // occupants of all locations, with keys of locations
+  std::vector<std::pair<std::uint64_t, Occupant>> occupants_;
+  // indices of occupants written and live in each block, occupants may
+  // interfere only if one is live in the block where the other is written
+  std::vector<std::vector<std::uint32_t>> written_, live_;
+  // index of escaping locations, and frame slots of arrays
+  std::unordered_map<std::uint64_t, std::uint32_t> escape_ids_;
+  std::vector<std::uint32_t> arr_slots_;
+  // count of allocated frame slots
+  std::uint32_t temp_count_;
+  // values pushed before the specific instruction in advance, because
+  // operands on the stack must be pushed in order
+  std::unordered_map<InstId, std::vector<InstId>> preloads_;
+  // operands that are pushed in advance
+  std::unordered_map<InstId, std::vector<bool>> preloaded_;
+  // comparisons fused into register branches
+  std::vector<bool> fused_;
+  // emitted instructions
+  std::vector<LoweredInst> insts_;
+  vm::VMAddr cur_pc_;
+  // labels (instruction index) of all blocks & edge blocks
+  std::vector<std::size_t> labels_;
+  // edges whose phi copies are placed in edge blocks
+  std::vector<std::pair<BlockId, BlockId>> edges_;
+  // jumps to be backfilled, instruction index and label
+  std::vector<std::pair<std::size_t, std::size_t>> jumps_;
+  // values held by static registers when emitting the current block
+  std::unordered_map<vm::RegId, InstId> reg_values_;
+};
+
+}  // namespace minivm::ssa
+
+#endif  // MINIVM_SSA_LOWERING_H_
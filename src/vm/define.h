@@ -3,20 +3,28 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <initializer_list>
 
 // all supported VM instructions
 // for more details, see `src/vm/README.md`
 #define VM_INSTS(e)                                     \
   /* memory allocation */                               \
-  e(Var) e(Arr)                                         \
+  e(Var) e(Arr) e(VarSlot) e(ArrSlot)                   \
+  e(VarGlobal) e(ArrGlobal)                             \
   /* load & store */                                    \
   e(Ld) e(LdVar) e(LdReg) e(St) e(StVar) e(StVarP)      \
   e(StReg) e(StRegP) e(Imm) e(ImmHi)                    \
+  /* load & store (frame slots) */                      \
+  e(LdSlot) e(StSlot) e(StSlotP)                        \
+  /* load & store (global segment) */                   \
+  e(LdGlobal) e(StGlobal) e(StGlobalP)                  \
   /* control transfer (with absolute target address) */ \
   e(Bnz) e(Jmp)                                         \
   /* function call, with absolute target address        \
      or symbol name (external function) */              \
   e(Call) e(CallExt) e(Ret)                             \
+  /* function prologue, with frame slot count */        \
+  e(Enter)                                              \
   /* debugging */                                       \
   e(Break) e(Error)                                     \
   /* logical operations */                              \
@@ -25,8 +33,35 @@
   e(Eq) e(Ne) e(Gt) e(Lt) e(Ge) e(Le)                   \
   /* arithmetic operations */                           \
   e(Neg) e(Add) e(Sub) e(Mul) e(Div) e(Mod)             \
+  /* bitwise operations */                              \
+  e(And) e(Shl) e(Shr)                                  \
   /* operand stack operations */                        \
-  e(Pop) e(Clear)
+  e(Pop) e(Clear)                                       \
+  /* superinstructions, with operands in the following  \
+     instructions */                                    \
+  e(ImmW) e(AddI) e(SubI)                               \
+  e(AddSS) e(SubSS) e(MulSS) e(AddSI) e(SubSI) e(MulSI) \
+  e(AddSSS) e(SubSSS) e(MulSSS)                         \
+  e(AddSSI) e(SubSSI) e(MulSSI)                         \
+  e(BeqSS) e(BneSS) e(BltSS) e(BleSS) e(BgtSS) e(BgeSS) \
+  e(BeqSI) e(BneSI) e(BltSI) e(BleSI) e(BgtSI) e(BgeSI) \
+  /* register instructions (Tigger mode), with packed   \
+     register ids and immediates */                     \
+  e(MovRR) e(MovRI)                                     \
+  e(LAndRRR) e(LOrRRR) e(EqRRR) e(NeRRR) e(GtRRR)       \
+  e(LtRRR) e(GeRRR) e(LeRRR) e(AddRRR) e(SubRRR)        \
+  e(MulRRR) e(DivRRR) e(ModRRR)                         \
+  e(LAndRRI) e(LOrRRI) e(EqRRI) e(NeRRI) e(GtRRI)       \
+  e(LtRRI) e(GeRRI) e(LeRRI) e(AddRRI) e(SubRRI)        \
+  e(MulRRI) e(DivRRI) e(ModRRI)                         \
+  e(BeqRR) e(BneRR) e(BltRR) e(BleRR) e(BgtRR) e(BgeRR) \
+  /* intrinsics of SysY runtime library, substituted    \
+     for 'CallExt' when sealing */                      \
+  e(GetInt) e(GetCh) e(GetArray)                        \
+  e(PutInt) e(PutCh) e(PutArray)                        \
+  /* tail call, substituted for 'Call' followed by      \
+     'Ret' when sealing */                              \
+  e(TailCall)
 // expand macro to comma-separated list
 #define VM_EXPAND_LIST(i)         i,
 // expand macro to comma-separated string array
@@ -37,6 +72,8 @@
 #define VM_LABEL(l)               VML_##l:
 // goto a label of VM threading
 #define VM_GOTO(l)                goto VML_##l
+// get address of a label of VM threading
+#define VM_LABEL_ADDR(l)          &&VML_##l
 
 namespace minivm::vm {
 
@@ -46,6 +83,8 @@ constexpr std::size_t kVMInstLen = 32;
 constexpr std::size_t kVMInstOpLen = 8;
 // length of operand field (in bits)
 constexpr std::size_t kVMInstImmLen = kVMInstLen - kVMInstOpLen;
+// length of register id field in register instructions (in bits)
+constexpr std::size_t kVMInstRegLen = 6;
 
 // opcode of VM instructions
 enum class InstOp { VM_INSTS(VM_EXPAND_LIST) };
@@ -54,10 +93,22 @@ enum class InstOp { VM_INSTS(VM_EXPAND_LIST) };
 struct VMInst {
   // opcode
   std::uint32_t op : kVMInstOpLen;
-  // symbol reference/immediate/absolute target address
+  // symbol reference/immediate/absolute target address/slot index
   std::uint32_t opr : kVMInstImmLen;
 };
 
+// unpacked VM instruction, with the full-width operand
+// operands of pc addresses and symbols that do not fit in the 'opr' field
+// of 'VMInst' are stored in the wide operand table of the container,
+// and the 'opr' field is set to 'kVMInstWideOpr'
+struct VMUnpackedInst {
+  std::uint32_t op;
+  std::uint32_t opr;
+};
+
+// operand of packed instructions whose operand is in the wide operand table
+constexpr std::uint32_t kVMInstWideOpr = (1u << kVMInstImmLen) - 1;
+
 // symbol identifiers
 using SymId = std::uint32_t;
 // static register identifiers
@@ -67,6 +118,58 @@ using VMAddr = std::uint32_t;
 // operands
 using VMOpr = std::int32_t;
 
+// get sign-extended value of immediate operand
+inline VMOpr ExtendImm(std::uint32_t opr) {
+  constexpr auto kSignBit = 1u << (kVMInstImmLen - 1);
+  constexpr auto kUpperOnes = (1u << (32 - kVMInstImmLen)) - 1;
+  if (opr & kSignBit) opr |= kUpperOnes << kVMInstImmLen;
+  return opr;
+}
+
+// get the full-width immediate of 'Imm lo; ImmHi hi'
+inline VMOpr MergeImm(std::uint32_t lo, std::uint32_t hi) {
+  constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+  constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
+  return (lo & kMaskLo) | ((hi & kMaskHi) << kVMInstImmLen);
+}
+
+// get the i-th register id of register instructions
+inline RegId GetRegOpr(std::uint32_t opr, std::size_t i) {
+  constexpr auto kRegMask = (1u << kVMInstRegLen) - 1;
+  return (opr >> (i * kVMInstRegLen)) & kRegMask;
+}
+
+// get sign-extended immediate after the first 'n' register ids
+// of register instructions
+inline VMOpr GetRegImm(std::uint32_t opr, std::size_t n) {
+  constexpr auto kUnused = kVMInstLen - kVMInstImmLen;
+  auto imm = static_cast<VMOpr>(opr << kUnused);
+  return imm >> (kUnused + n * kVMInstRegLen);
+}
+
+// check if register id can be packed into register instructions
+inline bool IsPackableReg(RegId reg_id) {
+  return reg_id < (1u << kVMInstRegLen);
+}
+
+// check if immediate can be packed after 'n' register ids
+inline bool IsPackableImm(VMOpr imm, std::size_t n) {
+  auto len = kVMInstImmLen - n * kVMInstRegLen;
+  return imm >= -(1 << (len - 1)) && imm < (1 << (len - 1));
+}
+
+// pack register ids and immediate into operand of register instructions
+inline std::uint32_t PackRegOpr(std::initializer_list<RegId> reg_ids,
+                                VMOpr imm) {
+  std::uint32_t opr = 0, shift = 0;
+  for (const auto &id : reg_ids) {
+    opr |= id << shift;
+    shift += kVMInstRegLen;
+  }
+  opr |= static_cast<std::uint32_t>(imm) << shift;
+  return opr & ((1u << kVMInstImmLen) - 1);
+}
+
 // name of entry point
 constexpr const char *kVMEntry = "$entry";
 // name of frame area
@@ -76,6 +179,11 @@ constexpr const char *kVMDebugger = "$debugger";
 // name of main function
 constexpr const char *kVMMain = "f_main";
 
+// capacity of operand stack (in elements)
+constexpr std::size_t kVMOprStackSize = 1 << 16;
+// default capacity of each segment of frame stack (in elements)
+constexpr std::size_t kVMFrameSegmentSize = 1 << 22;
+
 // error codes
 //
 // no error
@@ -96,6 +204,10 @@ constexpr std::size_t kVMErrorInvalidExtFunc = 155;
 constexpr std::size_t kVMErrorExtFuncError = 156;
 // invalid PC address
 constexpr std::size_t kVMErrorInvalidPCAddr = 157;
+// operand stack overflow
+constexpr std::size_t kVMErrorOprStackOverflow = 158;
+// frame stack overflow
+constexpr std::size_t kVMErrorFrameStackOverflow = 159;
 // VM irrelevant error
 constexpr std::size_t kVMErrorVMIrrelevant = 255;
 
@@ -0,0 +1,53 @@
+#ifndef MINIVM_VM_EXTAPI_H_
+#define MINIVM_VM_EXTAPI_H_
+
+// registration API of native extension modules, which are shared objects
+// loaded by option '--load-ext', this header can be included by both C
+// and C++ code, and does not depend on any other headers of MiniVM
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// version of the API, increased when the API changes incompatibly
+#define MINIVM_EXT_API_VERSION 1
+// name of the entry point of extension modules
+#define MINIVM_EXT_ENTRY "MiniVMExtInit"
+// maximum count of parameters of native functions
+#define MINIVM_EXT_MAX_PARAMS 8
+
+typedef struct MiniVMExtApi MiniVMExtApi;
+
+// native function of extension modules
+// 'data' is the pointer passed when registering, 'params' are values
+// of parameters, the return value should be stored to 'ret' (zero by
+// default), returns zero if failed
+typedef int (*MiniVMExtFunc)(const MiniVMExtApi *api, void *data,
+                             const int32_t *params, int32_t *ret);
+
+// registration API, passed to the entry point of extension modules
+struct MiniVMExtApi {
+  // version of the API
+  uint32_t version;
+  // opaque context of the VM instance
+  void *ctx;
+  // register a native function with 'param_count' parameters as the
+  // external function 'name' (e.g. "f_foo"), returns zero if failed
+  int (*register_func)(void *ctx, const char *name, uint32_t param_count,
+                       MiniVMExtFunc func, void *data);
+  // get address of memory pool, returns 'NULL' if invalid
+  void *(*get_addr)(void *ctx, int32_t id);
+};
+
+// entry point of extension modules, should be exported with the name
+// 'MINIVM_EXT_ENTRY' and register all native functions, the API is
+// valid until the module is unloaded, returns zero if failed
+typedef int (*MiniVMExtEntry)(const MiniVMExtApi *api);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MINIVM_VM_EXTAPI_H_
@@ -0,0 +1,82 @@
+#include "vm/extmod.h"
+
+#include <iostream>
+#include <string>
+
+#include "xstl/style.h"
+
+#if defined(__unix__)
+#include <dlfcn.h>
+#define VM_EXT_SUPPORTED
+#endif
+
+using namespace minivm::vm;
+
+ExtModuleLoader::ExtModuleLoader(VM &vm) : vm_(vm) {
+  api_.version = MINIVM_EXT_API_VERSION;
+  api_.ctx = this;
+  api_.register_func = RegisterFunc;
+  api_.get_addr = GetAddr;
+}
+
+ExtModuleLoader::~ExtModuleLoader() {
+#ifdef VM_EXT_SUPPORTED
+  for (const auto &handle : handles_) dlclose(handle);
+#endif
+}
+
+void ExtModuleLoader::LogError(std::string_view path,
+                               std::string_view message) {
+  using namespace xstl;
+  std::cerr << style("Br") << "error " << style("B") << "(extension \""
+            << path << "\"): " << message << std::endl;
+}
+
+bool ExtModuleLoader::Load(std::string_view path) {
+#ifdef VM_EXT_SUPPORTED
+  // open shared object
+  auto handle = dlopen(std::string(path).c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    LogError(path, dlerror());
+    return false;
+  }
+  handles_.push_back(handle);
+  // find and call the entry point
+  auto entry = reinterpret_cast<MiniVMExtEntry>(
+      dlsym(handle, MINIVM_EXT_ENTRY));
+  if (!entry) {
+    LogError(path, "entry point '" MINIVM_EXT_ENTRY "' not found");
+    return false;
+  }
+  if (!entry(&api_)) {
+    LogError(path, "failed to initialize the extension module");
+    return false;
+  }
+  return true;
+#else
+  LogError(path, "extension modules are not supported on this host");
+  return false;
+#endif
+}
+
+int ExtModuleLoader::RegisterFunc(void *ctx, const char *name,
+                                  uint32_t param_count, MiniVMExtFunc func,
+                                  void *data) {
+  auto loader = static_cast<ExtModuleLoader *>(ctx);
+  if (!name || !func || param_count > MINIVM_EXT_MAX_PARAMS) return 0;
+  const auto api = &loader->api_;
+  return loader->vm_.RegisterFunction(
+      name, [api, param_count, func, data](VM &vm) {
+        VMOpr params[MINIVM_EXT_MAX_PARAMS], ret = 0;
+        if (!vm.GetExtParams(params, param_count)) return false;
+        if (!func(api, data, params, &ret)) return false;
+        vm.SetExtRet(ret);
+        return true;
+      },
+      true);
+}
+
+void *ExtModuleLoader::GetAddr(void *ctx, int32_t id) {
+  auto loader = static_cast<ExtModuleLoader *>(ctx);
+  return loader->vm_.mem_pool()->GetAddress(id);
+}
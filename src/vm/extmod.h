@@ -0,0 +1,47 @@
+#ifndef MINIVM_VM_EXTMOD_H_
+#define MINIVM_VM_EXTMOD_H_
+
+#include <string_view>
+#include <vector>
+
+#include "vm/extapi.h"
+#include "vm/vm.h"
+
+namespace minivm::vm {
+
+// loader of native extension modules
+// loads shared objects and calls their entry points, which register
+// native functions to the VM instance through 'MiniVMExtApi'
+// all modules are unloaded when the loader is destructed, so the VM
+// instance must not be run after that
+class ExtModuleLoader {
+ public:
+  ExtModuleLoader(VM &vm);
+  ExtModuleLoader(const ExtModuleLoader &) = delete;
+  ~ExtModuleLoader();
+
+  // load the specific extension module, print error messages to stderr
+  // returns 'false' if failed
+  bool Load(std::string_view path);
+
+ private:
+  // print error message to stderr
+  void LogError(std::string_view path, std::string_view message);
+
+  // callbacks of 'MiniVMExtApi'
+  static int RegisterFunc(void *ctx, const char *name,
+                          uint32_t param_count, MiniVMExtFunc func,
+                          void *data);
+  static void *GetAddr(void *ctx, int32_t id);
+
+  // VM instance
+  VM &vm_;
+  // registration API passed to extension modules
+  MiniVMExtApi api_;
+  // handles of loaded shared objects
+  std::vector<void *> handles_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_EXTMOD_H_
@@ -0,0 +1,222 @@
+#ifndef MINIVM_VM_FRAMESTACK_H_
+#define MINIVM_VM_FRAMESTACK_H_
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <cstddef>
+
+#include "vm/define.h"
+
+namespace minivm::vm {
+
+// stack of function call frames
+// frames are stored in a chain of contiguous segments, each frame
+// consists of a header and slots of parameters & local variables:
+//
+//   ... | ret addr | pool state | prev frame | slot 0 | slot 1 | ...
+//                                            ^ frame pointer
+//
+// a new segment is appended when the current one is full, so frames
+// below the current one never move, and the stack only fails to grow
+// if the memory allocation fails
+class FrameStack {
+ public:
+  // offsets of frame header, relative to the frame pointer
+  enum HeaderOffset : int {
+    kRetAddr = -3,
+    kPoolState = -2,
+    kPrevFrame = -1,
+  };
+  // size of frame header
+  static constexpr std::size_t kHeaderSize = 3;
+
+  // 'segment_size' is the default capacity of segments
+  FrameStack(std::size_t segment_size)
+      : segment_size_(segment_size), segs_(1) {
+    auto &seg = segs_.front();
+    seg.base = std::make_unique<VMOpr[]>(segment_size);
+    seg.limit = seg.base.get() + segment_size;
+    clear();
+  }
+
+  // clear the stack, and make an empty frame for the entry point
+  void clear() {
+    depth_ = entry_depth_ = 0;
+    SwitchSegment(0);
+    fp_ = sp_ = base_ + kHeaderSize;
+    std::fill(base_, fp_, 0);
+  }
+  // push a new frame, and move parameters to its first slots
+  // returns 'false' if failed to allocate a new segment
+  bool Push(VMAddr ret_addr, VMOpr pool_state, const VMOpr *params,
+            std::size_t param_count) {
+    // the previous frame is addressed by its offset in its segment
+    VMOpr prev = fp_ - base_;
+    auto size = kHeaderSize + param_count;
+    if (size > static_cast<std::size_t>(limit_ - sp_) &&
+        !PushSegment(size)) {
+      return false;
+    }
+    auto fp = sp_ + kHeaderSize;
+    fp[kRetAddr] = ret_addr;
+    fp[kPoolState] = pool_state;
+    fp[kPrevFrame] = prev;
+    std::copy(params, params + param_count, fp);
+    fp_ = fp;
+    sp_ = fp + param_count;
+    ++depth_;
+    return true;
+  }
+  // reuse current frame for a tail call, replace all slots with
+  // the specific parameters, the frame may be moved to a new segment
+  // returns 'false' if failed to allocate a new segment
+  bool Reuse(const VMOpr *params, std::size_t param_count) {
+    if (param_count > static_cast<std::size_t>(limit_ - fp_)) {
+      // parameters may be slots of the current frame
+      std::vector<VMOpr> copied(params, params + param_count);
+      sp_ = fp_;
+      if (!MoveFrame(param_count)) return false;
+      std::copy(copied.begin(), copied.end(), fp_);
+    }
+    else {
+      std::copy(params, params + param_count, fp_);
+    }
+    sp_ = fp_ + param_count;
+    return true;
+  }
+  // extend current frame to hold at least 'slot_count' slots, the frame
+  // may be moved to a new segment, so the frame pointer must be reloaded
+  // returns 'false' if failed to allocate a new segment
+  bool Extend(std::size_t slot_count) {
+    if (slot_count > static_cast<std::size_t>(limit_ - fp_) &&
+        !MoveFrame(slot_count)) {
+      return false;
+    }
+    for (auto end = fp_ + slot_count; sp_ < end; ++sp_) *sp_ = 0xdeadc0de;
+    return true;
+  }
+  // pop current frame
+  void Pop() {
+    auto prev = fp_[kPrevFrame];
+    if (fp_ - kHeaderSize == base_) {
+      // the first frame of the current segment
+      SwitchSegment(cur_seg_ - 1);
+      sp_ = segs_[cur_seg_].top;
+    }
+    else {
+      sp_ = fp_ - kHeaderSize;
+    }
+    fp_ = base_ + prev;
+    --depth_;
+  }
+
+  // check if current frame is the frame of entry point
+  bool is_entry() const { return depth_ == entry_depth_; }
+  // getter, depth of current frame (zero for the entry point)
+  std::size_t depth() const { return depth_; }
+  // getter/setter, depth of the frame that is treated as entry point,
+  // returning from that frame stops the execution
+  std::size_t entry_depth() const { return entry_depth_; }
+  void set_entry_depth(std::size_t depth) { entry_depth_ = depth; }
+  // getter, frame pointer (pointer to the first slot)
+  VMOpr *fp() const { return fp_; }
+  // getter, slot count of current frame
+  std::size_t slot_count() const { return sp_ - fp_; }
+  // getter, return address of current frame
+  VMAddr ret_addr() const { return fp_[kRetAddr]; }
+  // getter/setter, saved memory pool state of current frame
+  VMOpr pool_state() const { return fp_[kPoolState]; }
+  void set_pool_state(VMOpr pool_state) { fp_[kPoolState] = pool_state; }
+
+ private:
+  // segment of frame stack
+  struct Segment {
+    // buffer of the segment
+    std::unique_ptr<VMOpr[]> base;
+    // end of the buffer
+    VMOpr *limit;
+    // top of the segment when the next segment was pushed
+    VMOpr *top;
+  };
+
+  // allocate a segment that can hold at least 'size' elements
+  // returns 'false' if failed
+  bool AllocSegment(Segment &seg, std::size_t size) {
+    size = std::max(size, segment_size_);
+    seg.base.reset(new (std::nothrow) VMOpr[size]);
+    if (!seg.base) return false;
+    seg.limit = seg.base.get() + size;
+    return true;
+  }
+  // make the specific segment the current one
+  void SwitchSegment(std::size_t index) {
+    cur_seg_ = index;
+    base_ = segs_[index].base.get();
+    limit_ = segs_[index].limit;
+  }
+  // switch to the next segment which can hold at least 'size' elements,
+  // segments above the current one hold no frames, and are reused
+  // returns 'false' if failed
+  bool PushSegment(std::size_t size) {
+    auto next = cur_seg_ + 1;
+    if (next == segs_.size()) segs_.emplace_back();
+    auto &seg = segs_[next];
+    if ((!seg.base || static_cast<std::size_t>(seg.limit - seg.base.get()) <
+                          size) &&
+        !AllocSegment(seg, size)) {
+      return false;
+    }
+    segs_[cur_seg_].top = sp_;
+    SwitchSegment(next);
+    sp_ = base_;
+    return true;
+  }
+  // move the current frame to a segment which can hold 'slot_count'
+  // slots, the current frame pointer is updated
+  // returns 'false' if failed
+  bool MoveFrame(std::size_t slot_count) {
+    auto frame = fp_ - kHeaderSize;
+    auto size = kHeaderSize + slot_count;
+    if (frame == base_) {
+      // the first frame of the current segment, replace the segment,
+      // the previous frame is still in the previous segment
+      Segment seg = {};
+      if (!AllocSegment(seg, size)) return false;
+      auto top = std::copy(frame, sp_, seg.base.get());
+      segs_[cur_seg_] = std::move(seg);
+      SwitchSegment(cur_seg_);
+      sp_ = top;
+    }
+    else {
+      // remove the frame from the current segment, and push it to the
+      // next one, the previous frame is in the current segment
+      auto count = sp_ - frame;
+      sp_ = frame;
+      if (!PushSegment(size)) {
+        sp_ = frame + count;
+        return false;
+      }
+      sp_ = std::copy(frame, frame + count, base_);
+    }
+    fp_ = base_ + kHeaderSize;
+    return true;
+  }
+
+  // default capacity of segments
+  std::size_t segment_size_;
+  // all allocated segments, and the index of the current one
+  std::vector<Segment> segs_;
+  std::size_t cur_seg_;
+  // base and end of the current segment
+  VMOpr *base_, *limit_;
+  // frame pointer and top of the current frame
+  VMOpr *fp_, *sp_;
+  // depth of the current frame, and the frame of entry point
+  std::size_t depth_, entry_depth_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_FRAMESTACK_H_
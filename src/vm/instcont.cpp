@@ -17,6 +17,89 @@ const char *kInstOpStr[] = {VM_INSTS(VM_EXPAND_STR_ARRAY)};
 // a 'Break' instruction
 const VMInst kBreakInst = {static_cast<std::uint32_t>(InstOp::Break)};
 
+// maximum length of fused instruction sequences
+constexpr std::uint32_t kMaxFuseLen = 4;
+
+// table of superinstructions, 'op' -> {'*SS' opcode, '*SI' opcode}
+using FuseTable = std::unordered_map<InstOp, std::pair<InstOp, InstOp>>;
+
+// superinstructions of 'LdSlot; LdSlot/Imm; op; StSlot'
+const FuseTable kFuseStore = {
+    {InstOp::Add, {InstOp::AddSSS, InstOp::AddSSI}},
+    {InstOp::Sub, {InstOp::SubSSS, InstOp::SubSSI}},
+    {InstOp::Mul, {InstOp::MulSSS, InstOp::MulSSI}},
+};
+
+// superinstructions of 'LdSlot; LdSlot/Imm; op'
+const FuseTable kFusePush = {
+    {InstOp::Add, {InstOp::AddSS, InstOp::AddSI}},
+    {InstOp::Sub, {InstOp::SubSS, InstOp::SubSI}},
+    {InstOp::Mul, {InstOp::MulSS, InstOp::MulSI}},
+};
+
+// superinstructions of 'LdSlot; LdSlot/Imm; op; Bnz'
+const FuseTable kFuseBranch = {
+    {InstOp::Eq, {InstOp::BeqSS, InstOp::BeqSI}},
+    {InstOp::Ne, {InstOp::BneSS, InstOp::BneSI}},
+    {InstOp::Lt, {InstOp::BltSS, InstOp::BltSI}},
+    {InstOp::Le, {InstOp::BleSS, InstOp::BleSI}},
+    {InstOp::Gt, {InstOp::BgtSS, InstOp::BgtSI}},
+    {InstOp::Ge, {InstOp::BgeSS, InstOp::BgeSI}},
+};
+
+// superinstructions of 'Imm; op'
+const std::unordered_map<InstOp, InstOp> kFuseImm = {
+    {InstOp::Add, InstOp::AddI},
+    {InstOp::Sub, InstOp::SubI},
+};
+
+// intrinsics of SysY runtime library functions
+const std::unordered_map<std::string_view, InstOp> kIntrinsics = {
+    {"f_getint", InstOp::GetInt},
+    {"f_getch", InstOp::GetCh},
+    {"f_getarray", InstOp::GetArray},
+    {"f_putint", InstOp::PutInt},
+    {"f_putch", InstOp::PutCh},
+    {"f_putarray", InstOp::PutArray},
+};
+
+// register instructions, 'op' -> {'*RRR' opcode, '*RRI' opcode}
+const std::unordered_map<InstOp, std::pair<InstOp, InstOp>> kRegOps = {
+    {InstOp::LAnd, {InstOp::LAndRRR, InstOp::LAndRRI}},
+    {InstOp::LOr, {InstOp::LOrRRR, InstOp::LOrRRI}},
+    {InstOp::Eq, {InstOp::EqRRR, InstOp::EqRRI}},
+    {InstOp::Ne, {InstOp::NeRRR, InstOp::NeRRI}},
+    {InstOp::Gt, {InstOp::GtRRR, InstOp::GtRRI}},
+    {InstOp::Lt, {InstOp::LtRRR, InstOp::LtRRI}},
+    {InstOp::Ge, {InstOp::GeRRR, InstOp::GeRRI}},
+    {InstOp::Le, {InstOp::LeRRR, InstOp::LeRRI}},
+    {InstOp::Add, {InstOp::AddRRR, InstOp::AddRRI}},
+    {InstOp::Sub, {InstOp::SubRRR, InstOp::SubRRI}},
+    {InstOp::Mul, {InstOp::MulRRR, InstOp::MulRRI}},
+    {InstOp::Div, {InstOp::DivRRR, InstOp::DivRRI}},
+    {InstOp::Mod, {InstOp::ModRRR, InstOp::ModRRI}},
+};
+
+// register branch instructions
+const std::unordered_map<InstOp, InstOp> kRegBranchOps = {
+    {InstOp::Eq, InstOp::BeqRR}, {InstOp::Ne, InstOp::BneRR},
+    {InstOp::Lt, InstOp::BltRR}, {InstOp::Le, InstOp::BleRR},
+    {InstOp::Gt, InstOp::BgtRR}, {InstOp::Ge, InstOp::BgeRR},
+};
+
+// check if the operand of the specific instruction is a pc address
+// or a symbol, which can be stored in the wide operand table
+bool HasWideOpr(InstOp op) {
+  switch (op) {
+    case InstOp::Var: case InstOp::Arr: case InstOp::LdVar:
+    case InstOp::StVar: case InstOp::StVarP: case InstOp::Bnz:
+    case InstOp::Jmp: case InstOp::Call: case InstOp::CallExt: {
+      return true;
+    }
+    default: return false;
+  }
+}
+
 }  // namespace
 
 void VMInstContainer::PushInst(InstOp op) {
@@ -24,9 +107,37 @@ void VMInstContainer::PushInst(InstOp op) {
 }
 
 void VMInstContainer::PushInst(InstOp op, std::uint32_t opr) {
-  auto &insts = cur_env_ == &global_env_ ? global_insts_ : insts_;
-  VMInst inst = {static_cast<std::uint32_t>(op), opr};
-  insts.push_back(inst);
+  bool is_global = cur_env_ == &global_env_;
+  auto &insts = is_global ? global_insts_ : insts_;
+  insts.push_back({});
+  StoreInst(insts, is_global ? global_wide_oprs_ : wide_oprs_,
+            insts.size() - 1, op, opr);
+}
+
+void VMInstContainer::StoreInst(std::vector<VMInst> &insts,
+                                WideOprTable &wide_oprs, VMAddr pc,
+                                InstOp op, std::uint32_t opr) {
+  auto &inst = insts[pc];
+  if (inst.opr == kVMInstWideOpr) wide_oprs.erase(pc);
+  inst.op = static_cast<std::uint32_t>(op);
+  if (HasWideOpr(op) && opr >= kVMInstWideOpr) {
+    inst.opr = kVMInstWideOpr;
+    wide_oprs[pc] = opr;
+  }
+  else {
+    inst.opr = opr;
+  }
+}
+
+void VMInstContainer::PackInsts(const std::vector<VMUnpackedInst> &insts) {
+  insts_.resize(insts.size());
+  wide_oprs_.clear();
+  for (VMAddr pc = 0; pc < insts.size(); ++pc) {
+    const auto &inst = insts[pc];
+    insts_[pc] = {};
+    StoreInst(insts_, wide_oprs_, pc, static_cast<InstOp>(inst.op),
+              inst.opr);
+  }
 }
 
 VMInst *VMInstContainer::GetLastInst() {
@@ -49,6 +160,13 @@ SymId VMInstContainer::DefSymbol(std::string_view sym) {
     LogError("symbol has already been defined", sym);
     return -1;
   }
+  // log symbol to slot table of current function or global segment
+  if (cur_env_ == &local_env_) {
+    slot_tables_.begin()->second.push_back(id);
+  }
+  else {
+    global_slots_.push_back(id);
+  }
   return id;
 }
 
@@ -79,9 +197,14 @@ void VMInstContainer::Reset(std::string_view src_file) {
   pc_defs_.clear();
   label_defs_.clear();
   func_pcs_.clear();
+  slot_tables_.clear();
+  global_slots_.clear();
   insts_.clear();
   global_insts_.clear();
+  wide_oprs_.clear();
+  global_wide_oprs_.clear();
   breakpoints_.clear();
+  fused_insts_.clear();
   trap_mode_ = false;
   while (!step_counters_.empty()) step_counters_.pop();
   // insert jump instruction to entry point
@@ -128,8 +251,8 @@ void VMInstContainer::PushLoad(std::string_view sym) {
    */
   if (auto last = GetLastInst();
       last && last->op == static_cast<std::uint32_t>(InstOp::StVar)) {
-    // check if is the same symbol
-    if (last->opr == sym_id) {
+    // check if is the same symbol, wide symbols are not compared
+    if (sym_id < kVMInstWideOpr && last->opr == sym_id) {
       // just rewrite last instruction as 'StVarP'
       last->op = static_cast<std::uint32_t>(InstOp::StVarP);
       return;
@@ -235,6 +358,74 @@ void VMInstContainer::PushOp(InstOp op) {
   PushInst(op);
 }
 
+void VMInstContainer::PushRegMove(RegId dst, RegId src) {
+  // 'x0' can not be the destination
+  if (dst && IsPackableReg(dst) && IsPackableReg(src)) {
+    PushInst(InstOp::MovRR, PackRegOpr({dst, src}, 0));
+  }
+  else {
+    PushLdReg(src);
+    PushStReg(dst);
+  }
+}
+
+void VMInstContainer::PushRegImm(RegId dst, VMOpr imm) {
+  if (dst && IsPackableReg(dst) && IsPackableImm(imm, 1)) {
+    PushInst(InstOp::MovRI, PackRegOpr({dst}, imm));
+  }
+  else {
+    PushLoad(imm);
+    PushStReg(dst);
+  }
+}
+
+void VMInstContainer::PushRegOp(InstOp op, RegId dst, RegId lhs,
+                                RegId rhs) {
+  auto it = kRegOps.find(op);
+  if (it != kRegOps.end() && dst && IsPackableReg(dst) &&
+      IsPackableReg(lhs) && IsPackableReg(rhs)) {
+    PushInst(it->second.first, PackRegOpr({dst, lhs, rhs}, 0));
+  }
+  else {
+    PushLdReg(lhs);
+    PushLdReg(rhs);
+    PushOp(op);
+    PushStReg(dst);
+  }
+}
+
+void VMInstContainer::PushRegOpImm(InstOp op, RegId dst, RegId lhs,
+                                   VMOpr imm) {
+  auto it = kRegOps.find(op);
+  if (it != kRegOps.end() && dst && IsPackableReg(dst) &&
+      IsPackableReg(lhs) && IsPackableImm(imm, 2)) {
+    PushInst(it->second.second, PackRegOpr({dst, lhs}, imm));
+  }
+  else {
+    PushLdReg(lhs);
+    PushLoad(imm);
+    PushOp(op);
+    PushStReg(dst);
+  }
+}
+
+void VMInstContainer::PushRegBranch(InstOp op, RegId lhs, RegId rhs,
+                                    std::string_view label) {
+  auto it = kRegBranchOps.find(op);
+  if (it != kRegBranchOps.end() && IsPackableReg(lhs) &&
+      IsPackableReg(rhs)) {
+    // target address is stored in the following 'Jmp'
+    PushInst(it->second, PackRegOpr({lhs, rhs}, 0));
+    PushJump(label);
+  }
+  else {
+    PushLdReg(lhs);
+    PushLdReg(rhs);
+    PushOp(op);
+    PushBnz(label);
+  }
+}
+
 void VMInstContainer::LogError(std::string_view message) {
   LogError(message, cur_line_num_);
 }
@@ -268,8 +459,12 @@ void VMInstContainer::LogLineNum(std::uint32_t line_num) {
   cur_line_num_ = line_num;
   // store local line number definitions only
   if (cur_env_ == &global_env_) return;
-  line_defs_[line_num] = insts_.size();
-  pc_defs_[insts_.size()] = line_num;
+  // the function prologue ('Enter') has no line number of its own,
+  // it belongs to the first line of the function body
+  VMAddr pc = insts_.size();
+  if (pc && func_pcs_.count(pc - 1)) --pc;
+  line_defs_[line_num] = pc;
+  pc_defs_[pc] = line_num;
 }
 
 void VMInstContainer::EnterFunc(std::uint32_t param_count) {
@@ -278,13 +473,17 @@ void VMInstContainer::EnterFunc(std::uint32_t param_count) {
     return LogError("nested function is unsupported");
   }
   cur_env_ = &local_env_;
+  // log function definition
+  func_pcs_.insert(insts_.size());
+  slot_tables_[insts_.size()];
   // initialize parameters
   for (std::uint32_t i = 0; i < param_count; ++i) {
     auto param = "p" + std::to_string(i);
     DefSymbol(param);
   }
-  // log function definition
-  func_pcs_.insert(insts_.size());
+  // generate function prologue,
+  // slot count will be filled in during slot allocation
+  PushInst(InstOp::Enter);
 }
 
 void VMInstContainer::EnterFunc(std::uint32_t param_count,
@@ -310,8 +509,13 @@ void VMInstContainer::SealContainer() {
   // insert label for entry point
   PushLabel(kVMEntry);
   // insert all global instructions
+  VMAddr global_base = insts_.size();
   insts_.insert(insts_.end(), global_insts_.begin(), global_insts_.end());
+  for (const auto &[pc, opr] : global_wide_oprs_) {
+    wide_oprs_.insert({global_base + pc, opr});
+  }
   global_insts_.clear();
+  global_wide_oprs_.clear();
   // insert main function call & return
   cur_env_ = &local_env_;
   PushCall(kVMMain);
@@ -322,7 +526,8 @@ void VMInstContainer::SealContainer() {
     if (info.defined) {
       // backfill pc to 'imm' field of all related instructions
       for (const auto &pc : info.related_insts) {
-        insts_[pc].opr = info.pc;
+        auto op = static_cast<InstOp>(insts_[pc].op);
+        StoreInst(insts_, wide_oprs_, pc, op, info.pc);
       }
       info.related_insts.clear();
       ++it;
@@ -330,11 +535,10 @@ void VMInstContainer::SealContainer() {
     else {
       // check to see if there are any non-function call instructions
       for (const auto &pc : info.related_insts) {
-        auto &inst = insts_[pc];
-        if (inst.op == static_cast<std::uint32_t>(InstOp::Call)) {
+        if (insts_[pc].op == static_cast<std::uint32_t>(InstOp::Call)) {
           // function call found, convert to external function call
-          inst.op = static_cast<std::uint32_t>(InstOp::CallExt);
-          inst.opr = sym_pool_.LogId(label);
+          StoreInst(insts_, wide_oprs_, pc, InstOp::CallExt,
+                    sym_pool_.LogId(label));
         }
         else {
           // current label is indeed undefined
@@ -349,16 +553,389 @@ void VMInstContainer::SealContainer() {
   }
   // exit if error occurred
   if (has_error_) std::exit(-1);
+  // allocate frame slots
+  AllocateSlots();
+  // run optimizers on the unfused instructions
+  if (opt_callback_) opt_callback_(*this);
+  // perform superinstruction fusion
+  FuseInsts();
+  FuseTailCalls();
   // release resources
   global_env_.clear();
   local_env_.clear();
 }
 
+void VMInstContainer::SetInst(VMAddr pc, InstOp op, std::uint32_t opr) {
+  assert(fused_insts_.empty() && breakpoints_.empty());
+  StoreInst(insts_, wide_oprs_, pc, op, opr);
+}
+
+void VMInstContainer::RemoveInsts(const std::vector<bool> &removed) {
+  assert(fused_insts_.empty() && breakpoints_.empty());
+  assert(removed.size() == insts_.size());
+  // compact instructions, and get new pc addresses of all instructions,
+  // removed instructions are mapped to the next remaining one
+  std::vector<VMAddr> new_pcs(insts_.size() + 1);
+  std::vector<VMUnpackedInst> insts;
+  for (VMAddr pc = 0; pc < insts_.size(); ++pc) {
+    new_pcs[pc] = insts.size();
+    if (!removed[pc]) insts.push_back(GetOrigInst(pc));
+  }
+  new_pcs[insts_.size()] = insts.size();
+  // update branch targets & function addresses
+  for (auto &inst : insts) {
+    auto op = static_cast<InstOp>(inst.op);
+    if (op == InstOp::Bnz || op == InstOp::Jmp || op == InstOp::Call) {
+      inst.opr = new_pcs[inst.opr];
+    }
+  }
+  PackInsts(insts);
+  std::unordered_set<VMAddr> func_pcs;
+  for (const auto &pc : func_pcs_) func_pcs.insert(new_pcs[pc]);
+  func_pcs_ = std::move(func_pcs);
+  decltype(slot_tables_) slot_tables;
+  for (auto &&[pc, table] : slot_tables_) {
+    slot_tables.insert({new_pcs[pc], std::move(table)});
+  }
+  slot_tables_ = std::move(slot_tables);
+  for (auto &&[label, info] : label_defs_) info.pc = new_pcs[info.pc];
+  // update line definitions, lines whose instructions are all removed
+  // are mapped to the next line
+  for (auto &&[line_num, pc] : line_defs_) pc = new_pcs[pc];
+  decltype(pc_defs_) pc_defs;
+  for (auto it = pc_defs_.rbegin(); it != pc_defs_.rend(); ++it) {
+    // the later line wins if lines are merged to the same pc
+    pc_defs[new_pcs[it->first]] = it->second;
+  }
+  pc_defs_ = std::move(pc_defs);
+}
+
+void VMInstContainer::ReplaceFuncs(const std::vector<FuncCode> &funcs) {
+  assert(fused_insts_.empty() && breakpoints_.empty());
+  constexpr auto kNoPC = static_cast<VMAddr>(-1);
+  // get line number of the specific pc address before replacing
+  auto line_of = [this](VMAddr pc) -> std::optional<std::uint32_t> {
+    auto it = pc_defs_.lower_bound(pc);
+    if (it == pc_defs_.end()) return {};
+    return it->second;
+  };
+  std::vector<const FuncCode *> codes;
+  for (const auto &func : funcs) codes.push_back(&func);
+  std::sort(codes.begin(), codes.end(), [](auto lhs, auto rhs) {
+    return lhs->begin < rhs->begin;
+  });
+  // build new instructions, and get new pc addresses of all original
+  // instructions, replaced instructions are mapped to the first new
+  // instruction generated from them, or the next mapped instruction
+  std::vector<VMUnpackedInst> insts;
+  std::vector<std::optional<std::uint32_t>> lines;
+  std::vector<VMAddr> bases, new_pcs(insts_.size() + 1, kNoPC);
+  auto code = codes.begin();
+  for (VMAddr pc = 0; pc < insts_.size();) {
+    if (code == codes.end() || pc < (*code)->begin) {
+      new_pcs[pc] = insts.size();
+      insts.push_back(GetOrigInst(pc));
+      lines.push_back(line_of(pc));
+      bases.push_back(kNoPC);
+      ++pc;
+      continue;
+    }
+    VMAddr base = insts.size();
+    const auto &func = **code;
+    for (std::size_t i = 0; i < func.insts.size(); ++i) {
+      auto orig_pc = func.orig_pcs[i];
+      if (new_pcs[orig_pc] == kNoPC) new_pcs[orig_pc] = base + i;
+      insts.push_back(func.insts[i]);
+      lines.push_back(line_of(orig_pc));
+      bases.push_back(base);
+    }
+    pc = func.end;
+    ++code;
+  }
+  new_pcs[insts_.size()] = insts.size();
+  for (auto pc = insts_.size(); pc-- > 0;) {
+    if (new_pcs[pc] == kNoPC) new_pcs[pc] = new_pcs[pc + 1];
+  }
+  // update branch targets, targets of new branches are relative to
+  // the beginning of function
+  for (VMAddr pc = 0; pc < insts.size(); ++pc) {
+    auto &inst = insts[pc];
+    auto op = static_cast<InstOp>(inst.op);
+    if (op == InstOp::Bnz || op == InstOp::Jmp) {
+      inst.opr = bases[pc] != kNoPC ? bases[pc] + inst.opr
+                                    : new_pcs[inst.opr];
+    }
+    else if (op == InstOp::Call) {
+      inst.opr = new_pcs[inst.opr];
+    }
+  }
+  PackInsts(insts);
+  // update function addresses and slot tables, new frame slots are
+  // named by their indices
+  std::unordered_set<VMAddr> func_pcs;
+  for (const auto &pc : func_pcs_) func_pcs.insert(new_pcs[pc]);
+  func_pcs_ = std::move(func_pcs);
+  decltype(slot_tables_) slot_tables;
+  for (auto &&[pc, table] : slot_tables_) {
+    slot_tables.insert({new_pcs[pc], std::move(table)});
+  }
+  slot_tables_ = std::move(slot_tables);
+  for (const auto &func : funcs) {
+    auto &table = slot_tables_.at(new_pcs[func.begin]);
+    for (std::uint32_t i = 0; i < func.temp_count; ++i) {
+      auto name = "$t" + std::to_string(table.size());
+      table.push_back(sym_pool_.LogId(name));
+    }
+  }
+  // update labels and line definitions
+  for (auto &&[label, info] : label_defs_) info.pc = new_pcs[info.pc];
+  for (auto &&[line_num, pc] : line_defs_) pc = new_pcs[pc];
+  pc_defs_.clear();
+  for (VMAddr pc = 0; pc < lines.size(); ++pc) {
+    if (lines[pc] && (!pc || lines[pc] != lines[pc - 1])) {
+      pc_defs_[pc] = *lines[pc];
+    }
+  }
+}
+
+void VMInstContainer::AllocateSlots() {
+  // build slot map of global segment
+  std::unordered_map<SymId, std::uint32_t> globals;
+  for (std::uint32_t i = 0; i < global_slots_.size(); ++i) {
+    globals.insert({global_slots_[i], i});
+  }
+  // NOTE: all functions are placed before the entry point
+  auto entry_pc = FindPC(kVMEntry);
+  assert(entry_pc);
+  auto it = slot_tables_.rbegin();
+  std::unordered_map<SymId, std::uint32_t> slots;
+  for (VMAddr pc = 0; pc < insts_.size(); ++pc) {
+    // update slot map when entering a new function or the entry point
+    if (it != slot_tables_.rend() && it->first == pc) {
+      slots.clear();
+      const auto &table = it->second;
+      for (std::uint32_t i = 0; i < table.size(); ++i) {
+        slots.insert({table[i], i});
+      }
+      ++it;
+    }
+    else if (pc == *entry_pc) {
+      slots.clear();
+    }
+    // rewrite instruction
+    auto inst = GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    if (op == InstOp::Enter) {
+      insts_[pc].opr = slots.size();
+      continue;
+    }
+    if (op != InstOp::Var && op != InstOp::Arr && op != InstOp::LdVar &&
+        op != InstOp::StVar && op != InstOp::StVarP) {
+      continue;
+    }
+    // find in local slots first
+    if (auto slot = slots.find(inst.opr); slot != slots.end()) {
+      switch (op) {
+        case InstOp::Var: op = InstOp::VarSlot; break;
+        case InstOp::Arr: op = InstOp::ArrSlot; break;
+        case InstOp::LdVar: op = InstOp::LdSlot; break;
+        case InstOp::StVar: op = InstOp::StSlot; break;
+        case InstOp::StVarP: op = InstOp::StSlotP; break;
+        default: assert(false);
+      }
+      inst.opr = slot->second;
+    }
+    else {
+      // symbols have been checked during instruction generation,
+      // so it must be a global symbol
+      auto global = globals.find(inst.opr);
+      assert(global != globals.end());
+      switch (op) {
+        case InstOp::Var: op = InstOp::VarGlobal; break;
+        case InstOp::Arr: op = InstOp::ArrGlobal; break;
+        case InstOp::LdVar: op = InstOp::LdGlobal; break;
+        case InstOp::StVar: op = InstOp::StGlobal; break;
+        case InstOp::StVarP: op = InstOp::StGlobalP; break;
+        default: assert(false);
+      }
+      inst.opr = global->second;
+    }
+    StoreInst(insts_, wide_oprs_, pc, op, inst.opr);
+  }
+}
+
+void VMInstContainer::FuseInsts() {
+  for (VMAddr pc = 0; pc < insts_.size();) {
+    auto len = TryFuseInsts(pc);
+    pc += len ? len : 1;
+  }
+}
+
+std::uint32_t VMInstContainer::TryFuseInsts(VMAddr pc) {
+  auto op_at = [this](VMAddr pc) {
+    return static_cast<InstOp>(insts_[pc].op);
+  };
+  // check if the sequence is in the same line,
+  // to make sure line stepping of debugger still works
+  auto in_line = [this](VMAddr pc, std::uint32_t len) {
+    if (pc + len > insts_.size()) return false;
+    for (std::uint32_t i = 1; i < len; ++i) {
+      if (pc_defs_.count(pc + i)) return false;
+    }
+    return true;
+  };
+  // get the fused opcode
+  std::optional<InstOp> fused;
+  std::uint32_t len = 0;
+  if (in_line(pc, 3) && op_at(pc) == InstOp::LdSlot &&
+      (op_at(pc + 1) == InstOp::LdSlot || op_at(pc + 1) == InstOp::Imm)) {
+    bool is_imm = op_at(pc + 1) == InstOp::Imm;
+    auto select = [&](const FuseTable &table, std::uint32_t n) {
+      auto it = table.find(op_at(pc + 2));
+      if (it == table.end()) return false;
+      fused = is_imm ? it->second.second : it->second.first;
+      len = n;
+      return true;
+    };
+    // try 'LdSlot; LdSlot/Imm; op; StSlot/Bnz' first
+    bool succ = false;
+    if (in_line(pc, 4)) {
+      if (op_at(pc + 3) == InstOp::StSlot) succ = select(kFuseStore, 4);
+      if (op_at(pc + 3) == InstOp::Bnz) succ = select(kFuseBranch, 4);
+    }
+    // then 'LdSlot; LdSlot/Imm; op'
+    if (!succ) select(kFusePush, 3);
+  }
+  if (!fused && in_line(pc, 2) && op_at(pc) == InstOp::Imm) {
+    if (op_at(pc + 1) == InstOp::ImmHi) {
+      // 'Imm; ImmHi', wide immediate
+      fused = InstOp::ImmW;
+      len = 2;
+    }
+    else if (auto it = kFuseImm.find(op_at(pc + 1)); it != kFuseImm.end()) {
+      // 'Imm; op'
+      fused = it->second;
+      len = 2;
+    }
+  }
+  if (!fused && op_at(pc) == InstOp::CallExt) {
+    // 'CallExt' of SysY library functions
+    if (auto sym = sym_pool_.FindSymbol(GetOrigInst(pc).opr)) {
+      auto it = kIntrinsics.find(*sym);
+      if (it != kIntrinsics.end()) {
+        fused = it->second;
+        len = 1;
+      }
+    }
+  }
+  // rewrite the first instruction
+  if (!fused) return 0;
+  fused_insts_[pc] = {insts_[pc].op, len};
+  insts_[pc].op = static_cast<std::uint32_t>(*fused);
+  return len;
+}
+
+void VMInstContainer::FuseTailCalls() {
+  // NOTE: all functions are placed before the entry point
+  auto end = FindPC(kVMEntry);
+  assert(end);
+  auto op_at = [this](VMAddr pc) {
+    return static_cast<InstOp>(GetOrigInst(pc).op);
+  };
+  for (const auto &[begin, slots] : slot_tables_) {
+    if (!MayEscape(begin, *end)) {
+      for (VMAddr pc = begin; pc + 1 < *end; ++pc) {
+        if (op_at(pc) != InstOp::Call) continue;
+        // 'Call; Ret', 'Call; StSlotP x; Ret' or 'Call; StSlot x;
+        // LdSlot x; Ret', sequences are fused across lines, since tail
+        // calls are executed as normal calls by the debug variant of
+        // the interpreter
+        std::uint32_t len = 0;
+        if (op_at(pc + 1) == InstOp::Ret) {
+          len = 2;
+        }
+        else if (pc + 2 < *end && op_at(pc + 1) == InstOp::StSlotP &&
+                 op_at(pc + 2) == InstOp::Ret) {
+          len = 3;
+        }
+        else if (pc + 3 < *end && op_at(pc + 1) == InstOp::StSlot &&
+                 op_at(pc + 2) == InstOp::LdSlot &&
+                 insts_[pc + 1].opr == insts_[pc + 2].opr &&
+                 op_at(pc + 3) == InstOp::Ret) {
+          len = 4;
+        }
+        if (!len) continue;
+        fused_insts_[pc] = {insts_[pc].op, len};
+        insts_[pc].op = static_cast<std::uint32_t>(InstOp::TailCall);
+      }
+    }
+    *end = begin;
+  }
+}
+
+bool VMInstContainer::MayEscape(VMAddr begin, VMAddr end) const {
+  // get slot of the stack frame (Tigger mode)
+  const auto &slots = slot_tables_.at(begin);
+  std::optional<std::uint32_t> frame_slot;
+  if (auto id = sym_pool_.FindId(kVMFrame)) {
+    auto it = std::find(slots.begin(), slots.end(), *id);
+    if (it != slots.end()) frame_slot = it - slots.begin();
+  }
+  for (VMAddr pc = begin; pc < end; ++pc) {
+    auto inst = GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    if (op == InstOp::ArrSlot && inst.opr != frame_slot) {
+      // local arrays (Eeyore mode) may be passed to callees
+      return true;
+    }
+    if (op == InstOp::LdSlot && inst.opr == frame_slot) {
+      // the address of stack frame must be used by 'load' or 'store',
+      // otherwise it may be passed to callees by 'loadaddr'
+      if (pc + 2 >= end ||
+          static_cast<InstOp>(GetOrigInst(pc + 1).op) != InstOp::Add) {
+        return true;
+      }
+      auto next = static_cast<InstOp>(GetOrigInst(pc + 2).op);
+      if (next != InstOp::Ld && next != InstOp::St) return true;
+    }
+  }
+  return false;
+}
+
+std::optional<VMAddr> VMInstContainer::FindFusedHead(VMAddr pc) const {
+  // NOTE: fused sequences never overlap
+  auto first = pc >= kMaxFuseLen ? pc - kMaxFuseLen + 1 : 0;
+  for (auto head = first; head < pc; ++head) {
+    auto it = fused_insts_.find(head);
+    if (it != fused_insts_.end() && head + it->second.len > pc) return head;
+  }
+  return {};
+}
+
+void VMInstContainer::UnfuseInsts(VMAddr pc) {
+  auto head = FindFusedHead(pc);
+  if (!head) return;
+  auto it = fused_insts_.find(*head);
+  // restore the original opcode
+  auto bp = breakpoints_.find(*head);
+  if (bp != breakpoints_.end()) {
+    bp->second = it->second.orig_op;
+  }
+  else {
+    insts_[*head].op = it->second.orig_op;
+    NotifyPatch(*head);
+  }
+  fused_insts_.erase(it);
+}
+
 void VMInstContainer::ToggleBreakpoint(VMAddr pc, bool enable) {
   if (enable) {
+    // make sure the breakpoint will not be skipped by superinstructions
+    UnfuseInsts(pc);
     // set breakpoint
     breakpoints_[pc] = insts_[pc].op;
     insts_[pc].op = static_cast<std::uint32_t>(InstOp::Break);
+    NotifyPatch(pc);
   }
   else {
     // remove breakpoint
@@ -366,22 +943,23 @@ void VMInstContainer::ToggleBreakpoint(VMAddr pc, bool enable) {
     if (it != breakpoints_.end()) {
       insts_[pc].op = it->second;
       breakpoints_.erase(it);
+      NotifyPatch(pc);
     }
   }
 }
 
+void VMInstContainer::ToggleTrapMode(bool enable) {
+  trap_mode_ = enable;
+  if (enable && hook_callback_) hook_callback_();
+}
+
 void VMInstContainer::AddStepCounter(std::size_t n, StepCallback callback) {
   step_counters_.push({n, callback});
+  if (hook_callback_) hook_callback_();
 }
 
-bool VMInstContainer::Dump(std::ostream &os, VMAddr pc) const {
-  if (pc >= insts_.size()) return false;
-  // get the actual instruction
-  auto inst = insts_[pc];
-  auto it = breakpoints_.find(pc);
-  if (it != breakpoints_.end()) inst.op = it->second;
-  // dump instruction
-  os << kInstOpStr[static_cast<int>(inst.op)] << '\t';
+void VMInstContainer::DumpOpr(std::ostream &os, VMAddr pc) const {
+  auto inst = GetOrigInst(pc);
   // NOTE: the order of 'case' statements is important
   switch (static_cast<InstOp>(inst.op)) {
     case InstOp::Var: case InstOp::Arr: case InstOp::LdVar:
@@ -392,15 +970,100 @@ bool VMInstContainer::Dump(std::ostream &os, VMAddr pc) const {
       os << *sym;
       break;
     }
+    case InstOp::VarSlot: case InstOp::ArrSlot: case InstOp::LdSlot:
+    case InstOp::StSlot: case InstOp::StSlotP: {
+      // dump as 'slot (sym)'
+      os << inst.opr;
+      auto slots = FindSlotTable(pc);
+      assert(slots && inst.opr < slots->size());
+      auto sym = sym_pool_.FindSymbol((*slots)[inst.opr]);
+      assert(sym);
+      os << " (" << *sym << ')';
+      break;
+    }
+    case InstOp::VarGlobal: case InstOp::ArrGlobal: case InstOp::LdGlobal:
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      // dump as 'slot (sym)'
+      os << inst.opr;
+      assert(inst.opr < global_slots_.size());
+      auto sym = sym_pool_.FindSymbol(global_slots_[inst.opr]);
+      assert(sym);
+      os << " (" << *sym << ')';
+      break;
+    }
     case InstOp::LdReg: case InstOp::StReg: case InstOp::StRegP:
     case InstOp::Imm: case InstOp::ImmHi: case InstOp::Bnz:
-    case InstOp::Jmp: case InstOp::Call: case InstOp::Error: {
+    case InstOp::Jmp: case InstOp::Call: case InstOp::Enter:
+    case InstOp::Error: {
       // dump 'opr' field directly
       os << inst.opr;
       break;
     }
-    default:;
+    case InstOp::MovRI: {
+      // dump as 'reg, imm'
+      os << GetRegOpr(inst.opr, 0) << ", " << GetRegImm(inst.opr, 1);
+      break;
+    }
+    case InstOp::MovRR: case InstOp::BeqRR: case InstOp::BneRR:
+    case InstOp::BltRR: case InstOp::BleRR: case InstOp::BgtRR:
+    case InstOp::BgeRR: {
+      // dump as 'reg, reg'
+      os << GetRegOpr(inst.opr, 0) << ", " << GetRegOpr(inst.opr, 1);
+      break;
+    }
+    default: {
+      auto op = static_cast<InstOp>(inst.op);
+      if (op >= InstOp::LAndRRR && op <= InstOp::ModRRR) {
+        // dump as 'reg, reg, reg'
+        os << GetRegOpr(inst.opr, 0) << ", " << GetRegOpr(inst.opr, 1)
+           << ", " << GetRegOpr(inst.opr, 2);
+      }
+      else if (op >= InstOp::LAndRRI && op <= InstOp::ModRRI) {
+        // dump as 'reg, reg, imm'
+        os << GetRegOpr(inst.opr, 0) << ", " << GetRegOpr(inst.opr, 1)
+           << ", " << GetRegImm(inst.opr, 2);
+      }
+    }
   }
+}
+
+bool VMInstContainer::Dump(std::ostream &os, VMAddr pc) const {
+  if (pc >= insts_.size()) return false;
+  // get the actual instruction
+  auto inst = insts_[pc];
+  auto it = breakpoints_.find(pc);
+  if (it != breakpoints_.end()) inst.op = it->second;
+  // dump instruction
+  os << kInstOpStr[static_cast<int>(inst.op)] << '\t';
+  auto fused = fused_insts_.find(pc);
+  if (fused == fused_insts_.end()) {
+    DumpOpr(os, pc);
+  }
+  else if (fused->second.len <= 2 ||
+           static_cast<InstOp>(inst.op) == InstOp::TailCall) {
+    // 'CallExt', dump as 'sym'
+    // 'Imm; op', dump as 'imm'
+    // 'Imm; ImmHi', dump as 'imm' (lower bits)
+    // 'Call; ...; Ret', dump as 'pc'
+    DumpOpr(os, pc);
+  }
+  else if (fused->second.len == 3) {
+    // 'LdSlot; LdSlot/Imm; op', dump as 'slot, slot/imm'
+    DumpOpr(os, pc);
+    os << ", ";
+    DumpOpr(os, pc + 1);
+  }
+  else {
+    // 'LdSlot; LdSlot/Imm; op; StSlot/Bnz',
+    // dump as 'slot, slot/imm, slot/pc'
+    DumpOpr(os, pc);
+    os << ", ";
+    DumpOpr(os, pc + 1);
+    os << ", ";
+    DumpOpr(os, pc + 3);
+  }
+  // instructions absorbed by a fused sequence are never executed
+  if (auto head = FindFusedHead(pc)) os << "\t; fused into " << *head;
   return true;
 }
 
@@ -436,6 +1099,29 @@ std::optional<std::uint32_t> VMInstContainer::FindLineNum(
   return it->second;
 }
 
+const VMInstContainer::SlotTable *VMInstContainer::FindSlotTable(
+    VMAddr pc) const {
+  auto entry_pc = FindPC(kVMEntry);
+  assert(entry_pc);
+  if (pc >= *entry_pc) return nullptr;
+  auto it = slot_tables_.lower_bound(pc);
+  if (it == slot_tables_.end()) return nullptr;
+  return &it->second;
+}
+
+VMUnpackedInst VMInstContainer::GetOrigInst(VMAddr pc) const {
+  VMUnpackedInst inst = {insts_[pc].op, insts_[pc].opr};
+  auto bp = breakpoints_.find(pc);
+  if (bp != breakpoints_.end()) inst.op = bp->second;
+  auto fused = fused_insts_.find(pc);
+  if (fused != fused_insts_.end()) inst.op = fused->second.orig_op;
+  if (inst.opr == kVMInstWideOpr) {
+    auto it = wide_oprs_.find(pc);
+    if (it != wide_oprs_.end()) inst.opr = it->second;
+  }
+  return inst;
+}
+
 const VMInst *VMInstContainer::GetInst(VMAddr pc) {
   auto inst = insts_.data() + pc;
   bool break_flag = false;
@@ -23,6 +23,30 @@ class VMInstContainer {
  public:
   // callback for step counters
   using StepCallback = std::function<void(VMInstContainer &)>;
+  // callback for instruction patching, will be called after the
+  // instruction on the specific pc address has been modified
+  using PatchCallback = std::function<void(VMAddr)>;
+  // callback for debugging hooks, will be called after trap mode
+  // has been enabled or a step counter has been added
+  using HookCallback = std::function<void()>;
+  // callback for optimizers, will be called after slot allocation
+  // and before superinstruction fusion when sealing the container
+  using OptCallback = std::function<void(VMInstContainer &)>;
+  // slot table of function, the i-th element is the symbol id
+  // of the local variable (or parameter) stored in the i-th slot
+  using SlotTable = std::vector<SymId>;
+  // code of a function generated by optimizers, which replaces
+  // instructions in range ['begin', 'end')
+  struct FuncCode {
+    VMAddr begin, end;
+    // targets of 'Bnz' and 'Jmp' are indices of 'insts',
+    // targets of 'Call' are original pc addresses
+    std::vector<VMUnpackedInst> insts;
+    // original pc address of each instruction, for debugging
+    std::vector<VMAddr> orig_pcs;
+    // count of new frame slots, appended to the slot table
+    std::uint32_t temp_count;
+  };
 
   VMInstContainer(SymbolPool &sym_pool, std::string_view src_file)
       : sym_pool_(sym_pool) {
@@ -52,6 +76,14 @@ class VMInstContainer {
   void PushCall(std::string_view label);
   void PushError(std::size_t code);
   void PushOp(InstOp op);
+  // register instruction generators (Tigger mode), generate stack
+  // instructions instead if operands can not be packed
+  void PushRegMove(RegId dst, RegId src);
+  void PushRegImm(RegId dst, VMOpr imm);
+  void PushRegOp(InstOp op, RegId dst, RegId lhs, RegId rhs);
+  void PushRegOpImm(InstOp op, RegId dst, RegId lhs, VMOpr imm);
+  void PushRegBranch(InstOp op, RegId lhs, RegId rhs,
+                     std::string_view label);
 
   // instruction metadata logger, for frontends
   //
@@ -71,9 +103,29 @@ class VMInstContainer {
                  std::uint32_t line_num);
   // exit function environment
   void ExitFunc();
-  // perform label backfilling, and seal current container
+  // perform label backfilling, slot allocation, optimization &
+  // superinstruction fusion, and seal current container
   // exit if any error occurred
   void SealContainer();
+  // set callback for optimizers
+  void set_opt_callback(OptCallback callback) {
+    opt_callback_ = callback;
+  }
+
+  // instruction rewriter, for optimizers
+  //
+  // replace the instruction on the specific pc address
+  void SetInst(VMAddr pc, InstOp op, std::uint32_t opr);
+  // remove all marked instructions ('removed[pc]' is set), and update
+  // branch targets, function addresses, labels and line definitions,
+  // references to removed instructions are moved to the next
+  // remaining instruction
+  void RemoveInsts(const std::vector<bool> &removed);
+  // replace instructions of functions by the specific code, and update
+  // branch targets, function addresses, labels, line definitions and
+  // slot tables, references to replaced instructions are moved to the
+  // first new instruction generated from them
+  void ReplaceFuncs(const std::vector<FuncCode> &funcs);
 
   // debug information queryer, for debuggers
   //
@@ -82,7 +134,7 @@ class VMInstContainer {
   // enable/disable trap mode
   // in trap mode, when MiniVM tries to fetch instructions from
   // the container, a 'Break' instruction will always be returned
-  void ToggleTrapMode(bool enable) { trap_mode_ = enable; }
+  void ToggleTrapMode(bool enable);
   // add a new step counter for stepping debugging
   // after next 'n' (n >= 0) steps, MiniVM will be breaked
   // if 'callback' is null, otherwise the callback will be called
@@ -99,6 +151,10 @@ class VMInstContainer {
   std::optional<VMAddr> FindPC(std::string_view label) const;
   // query line number by pc
   std::optional<std::uint32_t> FindLineNum(VMAddr pc) const;
+  // get the original instruction on the specific pc address,
+  // without breakpoints and superinstruction fusion, the operand
+  // is read from the wide operand table if it does not fit
+  VMUnpackedInst GetOrigInst(VMAddr pc) const;
   // getter, symbol pool
   const SymbolPool &sym_pool() const { return sym_pool_; }
   // getter, path to source file
@@ -109,11 +165,29 @@ class VMInstContainer {
   std::size_t inst_count() const { return insts_.size(); }
   // getter, pc of all defined functions
   const std::unordered_set<VMAddr> func_pcs() const { return func_pcs_; }
+  // query slot table of the function that contains the specific pc
+  // returns 'nullptr' if pc is not in any function
+  const SlotTable *FindSlotTable(VMAddr pc) const;
+  // getter, slot table of global segment
+  const SlotTable &global_slots() const { return global_slots_; }
 
   // instruction fetcher, for MiniVM instances
   //
   // get pointer of the specific instruction
+  // debugging hooks (trap mode & step counters) will be handled
   const VMInst *GetInst(VMAddr pc);
+  // check if there are any debugging hooks
+  bool has_debug_hooks() const {
+    return trap_mode_ || !step_counters_.empty();
+  }
+  // set callback for instruction patching
+  void set_patch_callback(PatchCallback callback) {
+    patch_callback_ = callback;
+  }
+  // set callback for debugging hooks
+  void set_hook_callback(HookCallback callback) {
+    hook_callback_ = callback;
+  }
 
  private:
   struct BackfillInfo {
@@ -125,6 +199,23 @@ class VMInstContainer {
     std::vector<VMAddr> related_insts;
   };
 
+  struct FuseInfo {
+    // original opcode of the first instruction
+    std::uint32_t orig_op;
+    // length of the fused instruction sequence
+    std::uint32_t len;
+  };
+
+  // table of operands that do not fit in the 'opr' field, indexed by pc
+  using WideOprTable = std::unordered_map<VMAddr, std::uint32_t>;
+
+  // store instruction to the specific pc address of 'insts', operands
+  // of pc addresses and symbols that do not fit are stored in 'wide_oprs'
+  static void StoreInst(std::vector<VMInst> &insts, WideOprTable &wide_oprs,
+                        VMAddr pc, InstOp op, std::uint32_t opr);
+  // replace all instructions by the specific unpacked instructions
+  void PackInsts(const std::vector<VMUnpackedInst> &insts);
+
   // push instruction to container
   void PushInst(InstOp op);
   void PushInst(InstOp op, std::uint32_t opr);
@@ -138,6 +229,33 @@ class VMInstContainer {
   // add next pc address to backfill list
   // should be used before instruction insertion
   void LogRelatedInsts(std::string_view label);
+  // assign all local variables & parameters to frame slots,
+  // all global variables to global segment,
+  // and rewrite related instructions
+  void AllocateSlots();
+  // fuse frequent instruction sequences into superinstructions
+  void FuseInsts();
+  // try to fuse the instruction sequence starting at the specific pc
+  // returns length of the fused sequence, or zero if failed
+  std::uint32_t TryFuseInsts(VMAddr pc);
+  // substitute 'TailCall' for function calls followed by returns,
+  // in functions whose allocated memory can not be referenced by callees
+  void FuseTailCalls();
+  // check if memory allocated by the specific function (in range
+  // ['begin', 'end')) may be referenced after it calls another function
+  bool MayEscape(VMAddr begin, VMAddr end) const;
+  // find the first instruction of the fused sequence that absorbed
+  // the specific pc, returns empty if the pc is not absorbed
+  std::optional<VMAddr> FindFusedHead(VMAddr pc) const;
+  // restore the fused sequence that contains the specific pc
+  // (except the first instruction of sequences)
+  void UnfuseInsts(VMAddr pc);
+  // dump operand of the specific instruction (before fusion)
+  void DumpOpr(std::ostream &os, VMAddr pc) const;
+  // notify MiniVM instance that the specific instruction is modified
+  void NotifyPatch(VMAddr pc) {
+    if (patch_callback_) patch_callback_(pc);
+  }
 
   // symbol pool
   SymbolPool &sym_pool_;
@@ -159,14 +277,27 @@ class VMInstContainer {
   std::string_view last_label_;
   // pc of all defined functions
   std::unordered_set<VMAddr> func_pcs_;
+  // slot tables of all defined functions
+  std::map<VMAddr, SlotTable, std::greater<VMAddr>> slot_tables_;
+  // slot table of global segment
+  SlotTable global_slots_;
   // all instructions
   std::vector<VMInst> insts_, global_insts_;
+  // wide operands of all instructions
+  WideOprTable wide_oprs_, global_wide_oprs_;
   // all breakpoints
   std::unordered_map<VMAddr, std::uint32_t> breakpoints_;
+  // all fused instruction sequences
+  std::unordered_map<VMAddr, FuseInfo> fused_insts_;
   // whether the container is in trap mode
   bool trap_mode_;
   // queue for step counters
   std::queue<std::pair<std::size_t, StepCallback>> step_counters_;
+  // callbacks for notifying MiniVM instances
+  PatchCallback patch_callback_;
+  HookCallback hook_callback_;
+  // callback for optimizers
+  OptCallback opt_callback_;
 };
 
 }  // namespace minivm::vm
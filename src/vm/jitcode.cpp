@@ -0,0 +1,850 @@
+#include "vm/jitcode.h"
+
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+#include "vm/framestack.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define VM_JIT_SUPPORTED
+#endif
+
+using namespace minivm::vm;
+using namespace minivm::vm::x64;
+
+namespace {
+
+// register allocation of native code
+//
+// pointer to the context
+constexpr Reg kCtx = RBX;
+// cached top of the operand stack
+constexpr Reg kTos = RBP;
+// operand stack pointer, points to the top of stack
+constexpr Reg kSp = R12;
+// frame pointer
+constexpr Reg kFp = R13;
+// pointer to the global segment
+constexpr Reg kGp = R14;
+// pointer to static registers
+constexpr Reg kRegs = R15;
+// host registers for holding values on the operand stack
+constexpr Reg kHostRegs[] = {RCX, RSI, RDI, R8, R9, R10};
+constexpr std::size_t kHostRegCount = sizeof(kHostRegs) / sizeof(Reg);
+// scratch register, 'rax' and 'rdx' are also used as scratch registers
+constexpr Reg kScratch = R11;
+
+// maximum count of pending values
+constexpr std::size_t kMaxPending = 16;
+
+// operations of register instructions ('xxxRRR' and 'xxxRRI')
+constexpr InstOp kRegOps[] = {
+    InstOp::LAnd, InstOp::LOr, InstOp::Eq,  InstOp::Ne,  InstOp::Gt,
+    InstOp::Lt,   InstOp::Ge,  InstOp::Le,  InstOp::Add, InstOp::Sub,
+    InstOp::Mul,  InstOp::Div, InstOp::Mod,
+};
+
+// comparisons of register branch instructions ('BxxRR')
+constexpr InstOp kRegBranchOps[] = {
+    InstOp::Eq, InstOp::Ne, InstOp::Lt, InstOp::Le, InstOp::Gt, InstOp::Ge,
+};
+
+// check if the specific opcode is a comparison
+inline bool IsCompare(InstOp op) {
+  return op >= InstOp::Eq && op <= InstOp::Le;
+}
+
+// get condition code of comparison
+Cond GetCond(InstOp op) {
+  switch (op) {
+    case InstOp::Eq: return kCondE;
+    case InstOp::Ne: return kCondNE;
+    case InstOp::Gt: return kCondG;
+    case InstOp::Lt: return kCondL;
+    case InstOp::Ge: return kCondGE;
+    case InstOp::Le: return kCondLE;
+    default: assert(false); return kCondE;
+  }
+}
+
+// get displacement of member in context
+#define VM_CTX(m) \
+  static_cast<std::int32_t>(offsetof(minivm::vm::JitContext, m))
+
+}  // namespace
+
+JitCode::~JitCode() {
+#ifdef VM_JIT_SUPPORTED
+  if (code_) munmap(code_, code_size_);
+#endif
+}
+
+bool JitCode::Translate() {
+#ifndef VM_JIT_SUPPORTED
+  return false;
+#else
+  auto inst_count = cont_.inst_count();
+  asm_ = Assembler();
+  offsets_.assign(inst_count, 0);
+  // address of the table is used by the native code,
+  // so the table must be allocated before translation
+  targets_.assign(inst_count, nullptr);
+  fixups_.clear();
+  errors_.clear();
+  error_exits_.clear();
+  ret_exits_.clear();
+  pending_.clear();
+  host_used_.assign(kHostRegCount, false);
+  // translate all instructions
+  CollectBlocks();
+  EmitPrologue();
+  for (VMAddr pc = 0; pc < inst_count;) {
+    // all values must be in memory at the start of basic blocks
+    if (blocks_[pc]) Flush();
+    offsets_[pc] = asm_.size();
+    auto len = TranslateInst(pc);
+    for (VMAddr i = 1; i < len; ++i) offsets_[pc + i] = asm_.size();
+    pc += len;
+  }
+  Flush();
+  EmitEpilogue();
+  EmitErrorStubs();
+  // backfill jumps
+  for (const auto &fixup : fixups_) {
+    asm_.Patch(fixup.at, offsets_[fixup.target]);
+  }
+  return Install();
+#endif
+}
+
+void JitCode::CollectBlocks() {
+  blocks_.assign(cont_.inst_count() + 1, false);
+  blocks_[0] = true;
+  for (const auto &pc : cont_.func_pcs()) blocks_[pc] = true;
+  auto entry_pc = cont_.FindPC(kVMEntry);
+  assert(entry_pc);
+  blocks_[*entry_pc] = true;
+  for (VMAddr pc = 0; pc < cont_.inst_count(); ++pc) {
+    auto inst = cont_.GetOrigInst(pc);
+    switch (static_cast<InstOp>(inst.op)) {
+      case InstOp::Bnz: case InstOp::Jmp: {
+        blocks_[inst.opr] = true;
+        break;
+      }
+      case InstOp::Call: {
+        // function entry & return address
+        blocks_[inst.opr] = true;
+        blocks_[pc + 1] = true;
+        break;
+      }
+      case InstOp::CallExt: {
+        blocks_[pc + 1] = true;
+        break;
+      }
+      default:;
+    }
+  }
+}
+
+VMAddr JitCode::TranslateInst(VMAddr pc) {
+  auto inst = cont_.GetOrigInst(pc);
+  auto op = static_cast<InstOp>(inst.op);
+  // try to fuse comparison with the following 'Bnz'
+  if (IsCompare(op) && pc + 1 < cont_.inst_count() && !blocks_[pc + 1]) {
+    auto next = cont_.GetOrigInst(pc + 1);
+    if (static_cast<InstOp>(next.op) == InstOp::Bnz) {
+      CompareBranch(op, next.opr);
+      return 2;
+    }
+  }
+  switch (op) {
+    case InstOp::VarSlot: case InstOp::VarGlobal: {
+      auto is_slot = op == InstOp::VarSlot;
+      Value var = {is_slot ? Value::Kind::Slot : Value::Kind::Global,
+                   static_cast<VMOpr>(inst.opr)};
+      Invalidate(var.kind, var.val);
+      asm_.Mov(GetMem(var), is_slot ? static_cast<VMOpr>(0xdeadc0de) : 0);
+      break;
+    }
+    case InstOp::ArrSlot: case InstOp::ArrGlobal: {
+      auto is_slot = op == InstOp::ArrSlot;
+      Value var = {is_slot ? Value::Kind::Slot : Value::Kind::Global,
+                   static_cast<VMOpr>(inst.opr)};
+      auto size = Pop();
+      Flush();
+      Load(RSI, size);
+      FreeHost(size);
+      asm_.Mov(RDX, is_slot ? 0 : 1);
+      CallRuntime(VM_CTX(alloc));
+      asm_.Mov(GetMem(var), RAX);
+      break;
+    }
+    case InstOp::Ld: {
+      auto addr = Pop();
+      Flush();
+      Load(RSI, addr);
+      FreeHost(addr);
+      CallRuntime(VM_CTX(get_addr));
+      asm_.Test64(RAX, RAX);
+      JumpToError(kCondE, pc, kVMErrorInvalidMemPoolAddr);
+      auto reg = AllocHost();
+      asm_.Mov(reg, Mem{RAX, 0});
+      Push({Value::Kind::Host, reg});
+      break;
+    }
+    case InstOp::St: {
+      auto addr = Pop(), val = Pop();
+      Flush();
+      // host registers are not preserved during calls,
+      // so the value must be saved to the native stack
+      if (val.kind == Value::Kind::Host) asm_.Mov(Mem{RSP, 0}, Reg(val.val));
+      Load(RSI, addr);
+      FreeHost(addr);
+      FreeHost(val);
+      CallRuntime(VM_CTX(get_addr));
+      asm_.Test64(RAX, RAX);
+      JumpToError(kCondE, pc, kVMErrorInvalidMemPoolAddr);
+      if (val.kind == Value::Kind::Imm) {
+        asm_.Mov(Mem{RAX, 0}, val.val);
+      }
+      else {
+        if (val.kind == Value::Kind::Host) {
+          asm_.Mov(RCX, Mem{RSP, 0});
+        }
+        else {
+          asm_.Mov(RCX, GetMem(val));
+        }
+        asm_.Mov(Mem{RAX, 0}, RCX);
+      }
+      break;
+    }
+    case InstOp::LdSlot: {
+      Push({Value::Kind::Slot, static_cast<VMOpr>(inst.opr)});
+      break;
+    }
+    case InstOp::StSlot: case InstOp::StSlotP: {
+      StoreVar(Value::Kind::Slot, inst.opr, op == InstOp::StSlotP);
+      break;
+    }
+    case InstOp::LdGlobal: {
+      Push({Value::Kind::Global, static_cast<VMOpr>(inst.opr)});
+      break;
+    }
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      StoreVar(Value::Kind::Global, inst.opr, op == InstOp::StGlobalP);
+      break;
+    }
+    case InstOp::LdReg: {
+      Push({Value::Kind::Reg, static_cast<VMOpr>(inst.opr)});
+      break;
+    }
+    case InstOp::StReg: case InstOp::StRegP: {
+      StoreVar(Value::Kind::Reg, inst.opr, op == InstOp::StRegP);
+      break;
+    }
+    case InstOp::Imm: {
+      Push({Value::Kind::Imm, ExtendImm(inst.opr)});
+      break;
+    }
+    case InstOp::ImmHi: {
+      constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+      constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
+      auto hi = (inst.opr & kMaskHi) << kVMInstImmLen;
+      auto val = Pop();
+      if (val.kind == Value::Kind::Imm) {
+        val.val = (static_cast<std::uint32_t>(val.val) & kMaskLo) | hi;
+        Push(val);
+      }
+      else {
+        auto reg = ToHost(val);
+        asm_.Alu(AluOp::And, reg, static_cast<VMOpr>(kMaskLo));
+        asm_.Alu(AluOp::Or, reg, static_cast<VMOpr>(hi));
+        Push({Value::Kind::Host, reg});
+      }
+      break;
+    }
+    case InstOp::Bnz: {
+      auto cond = Pop();
+      Flush();
+      if (cond.kind == Value::Kind::Imm) {
+        if (cond.val) JumpTo(inst.opr);
+        break;
+      }
+      if (cond.kind == Value::Kind::Host) {
+        asm_.Test(Reg(cond.val), Reg(cond.val));
+        FreeHost(cond);
+      }
+      else {
+        asm_.Alu(AluOp::Cmp, GetMem(cond), 0);
+      }
+      JumpTo(kCondNE, inst.opr);
+      break;
+    }
+    case InstOp::Jmp: {
+      Flush();
+      JumpTo(inst.opr);
+      break;
+    }
+    case InstOp::Call: {
+      // spill the operand stack, parameters are moved by the VM
+      Flush();
+      asm_.Mov(Mem{kSp, 0}, kTos);
+      asm_.Mov64(RSI, kSp);
+      asm_.Mov(RDX, static_cast<VMOpr>(pc));
+      // instructions absorbed by 'TailCall' are still translated,
+      // but never executed
+      auto cur = static_cast<InstOp>(cont_.insts()[pc].op);
+      CallRuntime(cur == InstOp::TailCall ? VM_CTX(tail_call)
+                                          : VM_CTX(call));
+      asm_.Test64(RAX, RAX);
+      error_exits_.push_back(asm_.Jcc(kCondE));
+      // switch to the new frame with an empty operand stack
+      asm_.Mov64(kFp, RAX);
+      asm_.Mov64(kSp, Mem{kCtx, VM_CTX(opr_base)});
+      asm_.Mov(kTos, Mem{kSp, 0});
+      JumpTo(inst.opr);
+      break;
+    }
+    case InstOp::CallExt: {
+      Flush();
+      asm_.Mov(Mem{kSp, 0}, kTos);
+      asm_.Mov64(RSI, kSp);
+      asm_.Mov(RDX, static_cast<VMOpr>(pc));
+      asm_.Mov(RCX, static_cast<VMOpr>(inst.opr));
+      CallRuntime(VM_CTX(call_ext));
+      asm_.Test64(RAX, RAX);
+      error_exits_.push_back(asm_.Jcc(kCondE));
+      // the return value may be pushed to the operand stack, the frame
+      // of external function has been popped
+      asm_.Mov64(kSp, RAX);
+      asm_.Mov(kTos, Mem{kSp, 0});
+      break;
+    }
+    case InstOp::Ret: {
+      Flush();
+      EmitRet();
+      break;
+    }
+    case InstOp::Enter: {
+      Flush();
+      asm_.Mov(RSI, static_cast<VMOpr>(inst.opr));
+      CallRuntime(VM_CTX(enter));
+      asm_.Test64(RAX, RAX);
+      JumpToError(kCondE, pc, kVMErrorFrameStackOverflow);
+      // the frame may be moved to a new segment of the frame stack
+      asm_.Mov64(kFp, RAX);
+      break;
+    }
+    case InstOp::Error: {
+      Flush();
+      JumpToError(pc, inst.opr);
+      break;
+    }
+    case InstOp::LNot: case InstOp::Neg: {
+      auto val = Pop();
+      if (val.kind == Value::Kind::Imm) {
+        if (op == InstOp::LNot) {
+          val.val = !val.val;
+        }
+        else {
+          val.val = -static_cast<std::uint32_t>(val.val);
+        }
+        Push(val);
+        break;
+      }
+      auto reg = ToHost(val);
+      if (op == InstOp::LNot) {
+        asm_.Test(reg, reg);
+        asm_.Setcc(kCondE, reg);
+        asm_.Movzx8(reg, reg);
+      }
+      else {
+        asm_.Neg(reg);
+      }
+      Push({Value::Kind::Host, reg});
+      break;
+    }
+    case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+    case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+    case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::Div:
+    case InstOp::Mod: case InstOp::And: case InstOp::Shl: case InstOp::Shr: {
+      Binary(op);
+      break;
+    }
+    case InstOp::Pop: {
+      FreeHost(Pop());
+      break;
+    }
+    case InstOp::Clear: {
+      for (const auto &val : pending_) FreeHost(val);
+      pending_.clear();
+      asm_.Mov64(kSp, Mem{kCtx, VM_CTX(opr_base)});
+      break;
+    }
+    case InstOp::MovRR: {
+      Push({Value::Kind::Reg, static_cast<VMOpr>(GetRegOpr(inst.opr, 1))});
+      StoreVar(Value::Kind::Reg, GetRegOpr(inst.opr, 0), false);
+      break;
+    }
+    case InstOp::MovRI: {
+      Push({Value::Kind::Imm, GetRegImm(inst.opr, 1)});
+      StoreVar(Value::Kind::Reg, GetRegOpr(inst.opr, 0), false);
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      // target is stored in the following 'Jmp'
+      auto index = inst.op - static_cast<std::uint32_t>(InstOp::BeqRR);
+      Push({Value::Kind::Reg, static_cast<VMOpr>(GetRegOpr(inst.opr, 0))});
+      Push({Value::Kind::Reg, static_cast<VMOpr>(GetRegOpr(inst.opr, 1))});
+      CompareBranch(kRegBranchOps[index], cont_.GetOrigInst(pc + 1).opr);
+      // skip the 'Jmp', unless it can be reached by other jumps
+      if (!blocks_[pc + 1]) return 2;
+      JumpTo(pc + 2);
+      break;
+    }
+    default: {
+      if (op >= InstOp::LAndRRR && op <= InstOp::ModRRR) {
+        auto index = inst.op - static_cast<std::uint32_t>(InstOp::LAndRRR);
+        auto rhs = static_cast<VMOpr>(GetRegOpr(inst.opr, 2));
+        Push({Value::Kind::Reg, static_cast<VMOpr>(GetRegOpr(inst.opr, 1))});
+        Push({Value::Kind::Reg, rhs});
+        Binary(kRegOps[index]);
+        StoreVar(Value::Kind::Reg, GetRegOpr(inst.opr, 0), false);
+      }
+      else if (op >= InstOp::LAndRRI && op <= InstOp::ModRRI) {
+        auto index = inst.op - static_cast<std::uint32_t>(InstOp::LAndRRI);
+        Push({Value::Kind::Reg, static_cast<VMOpr>(GetRegOpr(inst.opr, 1))});
+        Push({Value::Kind::Imm, GetRegImm(inst.opr, 2)});
+        Binary(kRegOps[index]);
+        StoreVar(Value::Kind::Reg, GetRegOpr(inst.opr, 0), false);
+      }
+      else {
+        // symbol-addressed instructions, all of them should have been
+        // resolved to slot-addressed ones when sealing the container
+        assert(op == InstOp::Var || op == InstOp::Arr ||
+               op == InstOp::LdVar || op == InstOp::StVar ||
+               op == InstOp::StVarP);
+        Flush();
+        JumpToError(pc, kVMErrorSymbolNotFound);
+      }
+    }
+  }
+  return 1;
+}
+
+void JitCode::EmitPrologue() {
+  // save callee-saved registers, and keep the stack aligned,
+  // the extra 8 bytes at '[rsp]' are used for saving values
+  for (auto reg : {RBX, RBP, R12, R13, R14, R15}) asm_.Push(reg);
+  asm_.Sub64(RSP, 8);
+  // initialize registers by arguments
+  asm_.Mov64(kCtx, RDI);
+  asm_.Mov64(kSp, RDX);
+  asm_.Mov(kTos, Mem{kSp, 0});
+  asm_.Mov64(kFp, RCX);
+  asm_.Mov64(kGp, R8);
+  asm_.Mov64(kRegs, R9);
+  asm_.Jmp(RSI);
+}
+
+void JitCode::EmitEpilogue() {
+  // returned from the entry point, write back the top of stack
+  auto ret_exit = asm_.size();
+  asm_.Mov(Mem{kSp, 0}, kTos);
+  asm_.Mov64(RAX, kSp);
+  auto to_done = asm_.Jmp();
+  // failed
+  auto error_exit = asm_.size();
+  asm_.Alu(AluOp::Xor, RAX, RAX);
+  asm_.Patch(to_done, asm_.size());
+  // restore callee-saved registers
+  asm_.Add64(RSP, 8);
+  for (auto reg : {R15, R14, R13, R12, RBP, RBX}) asm_.Pop(reg);
+  asm_.Ret();
+  // backfill exits
+  for (const auto &at : ret_exits_) asm_.Patch(at, ret_exit);
+  for (const auto &at : error_exits_) asm_.Patch(at, error_exit);
+  error_exits_.assign({error_exit});
+}
+
+void JitCode::EmitErrorStubs() {
+  auto error_exit = error_exits_.front();
+  for (const auto &stub : errors_) {
+    asm_.Patch(stub.at, asm_.size());
+    asm_.Mov(RSI, static_cast<VMOpr>(stub.pc));
+    asm_.Mov(RDX, static_cast<VMOpr>(stub.code));
+    CallRuntime(VM_CTX(error));
+    asm_.Patch(asm_.Jmp(), error_exit);
+  }
+}
+
+void JitCode::EmitRet() {
+  CallRuntime(VM_CTX(ret));
+  asm_.Test64(RAX, RAX);
+  ret_exits_.push_back(asm_.Jcc(kCondE));
+  // read return address from the popped frame,
+  // and jump to its native address
+  asm_.Mov(RCX, Mem{kFp, FrameStack::kRetAddr * 4});
+  asm_.Mov64(kFp, RAX);
+  asm_.Mov64(RAX, reinterpret_cast<std::uint64_t>(targets_.data()));
+  asm_.JmpTable(RAX, RCX);
+}
+
+bool JitCode::Install() {
+#ifndef VM_JIT_SUPPORTED
+  return false;
+#else
+  // release the previous code
+  if (code_) {
+    munmap(code_, code_size_);
+    code_ = nullptr;
+  }
+  // copy to executable memory
+  auto size = asm_.size();
+  auto mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) return false;
+  std::memcpy(mem, asm_.data(), size);
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC)) {
+    munmap(mem, size);
+    return false;
+  }
+  code_ = mem;
+  code_size_ = size;
+  // get native address of all instructions
+  auto base = reinterpret_cast<const std::uint8_t *>(code_);
+  for (VMAddr pc = 0; pc < offsets_.size(); ++pc) {
+    targets_[pc] = base + offsets_[pc];
+  }
+  return true;
+#endif
+}
+
+void JitCode::Push(const Value &val) {
+  pending_.push_back(val);
+  if (pending_.size() > kMaxPending) SpillBottom();
+}
+
+JitCode::Value JitCode::Pop() {
+  if (!pending_.empty()) {
+    auto val = pending_.back();
+    pending_.pop_back();
+    return val;
+  }
+  // pop from the operand stack in memory
+  auto reg = AllocHost();
+  asm_.Mov(reg, kTos);
+  asm_.Mov(kTos, Mem{kSp, -4});
+  asm_.Lea64(kSp, Mem{kSp, -4});
+  return {Value::Kind::Host, reg};
+}
+
+void JitCode::Flush() {
+  while (!pending_.empty()) SpillBottom();
+}
+
+void JitCode::SpillBottom() {
+  auto val = pending_.front();
+  pending_.erase(pending_.begin());
+  // same as 'VM_PUSH' of the stack-based engine
+  asm_.Mov(Mem{kSp, 0}, kTos);
+  asm_.Lea64(kSp, Mem{kSp, 4});
+  Load(kTos, val);
+  FreeHost(val);
+}
+
+std::optional<Reg> JitCode::TryAllocHost() {
+  for (std::size_t i = 0; i < kHostRegCount; ++i) {
+    if (!host_used_[i]) {
+      host_used_[i] = true;
+      return kHostRegs[i];
+    }
+  }
+  return {};
+}
+
+Reg JitCode::AllocHost() {
+  for (;;) {
+    if (auto reg = TryAllocHost()) return *reg;
+    // spill pending values until a host register is released
+    assert(!pending_.empty());
+    SpillBottom();
+  }
+}
+
+void JitCode::FreeHost(const Value &val) {
+  if (val.kind != Value::Kind::Host) return;
+  for (std::size_t i = 0; i < kHostRegCount; ++i) {
+    if (kHostRegs[i] == val.val) host_used_[i] = false;
+  }
+}
+
+Mem JitCode::GetMem(const Value &val) const {
+  auto disp = val.val * static_cast<VMOpr>(sizeof(VMOpr));
+  switch (val.kind) {
+    case Value::Kind::Slot: return {kFp, disp};
+    case Value::Kind::Global: return {kGp, disp};
+    case Value::Kind::Reg: return {kRegs, disp};
+    default: assert(false); return {RAX, 0};
+  }
+}
+
+void JitCode::Load(Reg reg, const Value &val) {
+  switch (val.kind) {
+    case Value::Kind::Imm: {
+      asm_.Mov(reg, val.val);
+      break;
+    }
+    case Value::Kind::Host: {
+      if (val.val != reg) asm_.Mov(reg, Reg(val.val));
+      break;
+    }
+    default: {
+      asm_.Mov(reg, GetMem(val));
+      break;
+    }
+  }
+}
+
+Reg JitCode::ToHost(const Value &val) {
+  if (val.kind == Value::Kind::Host) return Reg(val.val);
+  auto reg = AllocHost();
+  Load(reg, val);
+  return reg;
+}
+
+void JitCode::Invalidate(Value::Kind kind, VMOpr index) {
+  for (auto &val : pending_) {
+    if (val.kind != kind || val.val != index) continue;
+    auto reg = TryAllocHost();
+    if (!reg) {
+      // no more host registers, just write all values to memory
+      Flush();
+      return;
+    }
+    Load(*reg, val);
+    val = {Value::Kind::Host, *reg};
+  }
+}
+
+void JitCode::Store(const Mem &mem, const Value &val) {
+  switch (val.kind) {
+    case Value::Kind::Imm: {
+      asm_.Mov(mem, val.val);
+      break;
+    }
+    case Value::Kind::Host: {
+      asm_.Mov(mem, Reg(val.val));
+      break;
+    }
+    default: {
+      asm_.Mov(RAX, GetMem(val));
+      asm_.Mov(mem, RAX);
+      break;
+    }
+  }
+}
+
+void JitCode::StoreVar(Value::Kind kind, VMOpr index, bool preserve) {
+  auto val = Pop();
+  Value var = {kind, index};
+  Invalidate(kind, index);
+  Store(GetMem(var), val);
+  if (!preserve) {
+    FreeHost(val);
+  }
+  else if (val.kind == Value::Kind::Imm || val.kind == Value::Kind::Host) {
+    Push(val);
+  }
+  else {
+    Push(var);
+  }
+}
+
+bool JitCode::FoldBinary(InstOp op, VMOpr lhs, VMOpr rhs, VMOpr &ret) {
+  auto ul = static_cast<std::uint32_t>(lhs);
+  auto ur = static_cast<std::uint32_t>(rhs);
+  switch (op) {
+    case InstOp::LAnd: ret = lhs && rhs; break;
+    case InstOp::LOr: ret = lhs || rhs; break;
+    case InstOp::Eq: ret = lhs == rhs; break;
+    case InstOp::Ne: ret = lhs != rhs; break;
+    case InstOp::Gt: ret = lhs > rhs; break;
+    case InstOp::Lt: ret = lhs < rhs; break;
+    case InstOp::Ge: ret = lhs >= rhs; break;
+    case InstOp::Le: ret = lhs <= rhs; break;
+    case InstOp::Add: ret = ul + ur; break;
+    case InstOp::Sub: ret = ul - ur; break;
+    case InstOp::Mul: ret = ul * ur; break;
+    case InstOp::And: ret = lhs & rhs; break;
+    case InstOp::Shl: ret = ul << (rhs & 31); break;
+    case InstOp::Shr: ret = lhs >> (rhs & 31); break;
+    case InstOp::Div: case InstOp::Mod: {
+      // keep the runtime behavior of invalid divisions
+      if (!rhs || (lhs == INT_MIN && rhs == -1)) return false;
+      ret = op == InstOp::Div ? lhs / rhs : lhs % rhs;
+      break;
+    }
+    default: return false;
+  }
+  return true;
+}
+
+void JitCode::Binary(InstOp op) {
+  auto rhs = Pop(), lhs = Pop();
+  VMOpr ret;
+  if (lhs.kind == Value::Kind::Imm && rhs.kind == Value::Kind::Imm &&
+      FoldBinary(op, lhs.val, rhs.val, ret)) {
+    Push({Value::Kind::Imm, ret});
+    return;
+  }
+  auto dst = ToHost(lhs);
+  // perform 'dst = dst op rhs'
+  auto alu = [this, &dst, &rhs](AluOp op) {
+    switch (rhs.kind) {
+      case Value::Kind::Imm: asm_.Alu(op, dst, rhs.val); break;
+      case Value::Kind::Host: asm_.Alu(op, dst, Reg(rhs.val)); break;
+      default: asm_.Alu(op, dst, GetMem(rhs)); break;
+    }
+  };
+  switch (op) {
+    case InstOp::Add: alu(AluOp::Add); break;
+    case InstOp::Sub: alu(AluOp::Sub); break;
+    case InstOp::And: alu(AluOp::And); break;
+    case InstOp::Shl: case InstOp::Shr: {
+      auto shift = op == InstOp::Shl ? ShiftOp::Shl : ShiftOp::Sar;
+      if (rhs.kind == Value::Kind::Imm) {
+        asm_.Shift(shift, dst, rhs.val & 31);
+        break;
+      }
+      // the count must be placed in 'cl', and 'rcx' is also a host
+      // register, which is saved in 'rax' (and shifted there if it is
+      // the destination)
+      Load(RDX, rhs);
+      asm_.Mov(RAX, RCX);
+      asm_.Mov(RCX, RDX);
+      asm_.ShiftCl(shift, dst == RCX ? RAX : dst);
+      asm_.Mov(RCX, RAX);
+      break;
+    }
+    case InstOp::Mul: {
+      switch (rhs.kind) {
+        case Value::Kind::Imm: asm_.Imul(dst, dst, rhs.val); break;
+        case Value::Kind::Host: asm_.Imul(dst, Reg(rhs.val)); break;
+        default: asm_.Imul(dst, GetMem(rhs)); break;
+      }
+      break;
+    }
+    case InstOp::Div: case InstOp::Mod: {
+      if (rhs.kind == Value::Kind::Imm && rhs.val > 1 &&
+          !(rhs.val & (rhs.val - 1))) {
+        // division by 2^k, negative dividends are biased by '2^k - 1'
+        // to round towards zero
+        std::uint8_t shift = 0;
+        while ((1 << shift) != rhs.val) ++shift;
+        asm_.Mov(RAX, dst);
+        asm_.Shift(ShiftOp::Sar, RAX, 31);
+        asm_.Alu(AluOp::And, RAX, rhs.val - 1);
+        if (op == InstOp::Div) {
+          asm_.Alu(AluOp::Add, dst, RAX);
+          asm_.Shift(ShiftOp::Sar, dst, shift);
+        }
+        else {
+          asm_.Alu(AluOp::Add, RAX, dst);
+          asm_.Alu(AluOp::And, RAX, -rhs.val);
+          asm_.Alu(AluOp::Sub, dst, RAX);
+        }
+        break;
+      }
+      asm_.Mov(RAX, dst);
+      asm_.Cdq();
+      switch (rhs.kind) {
+        case Value::Kind::Imm: {
+          asm_.Mov(kScratch, rhs.val);
+          asm_.Idiv(kScratch);
+          break;
+        }
+        case Value::Kind::Host: asm_.Idiv(Reg(rhs.val)); break;
+        default: asm_.Idiv(GetMem(rhs)); break;
+      }
+      asm_.Mov(dst, op == InstOp::Div ? RAX : RDX);
+      break;
+    }
+    case InstOp::LAnd: case InstOp::LOr: {
+      Load(RAX, rhs);
+      asm_.Test(RAX, RAX);
+      asm_.Setcc(kCondNE, RAX);
+      asm_.Test(dst, dst);
+      asm_.Setcc(kCondNE, dst);
+      asm_.Alu8(op == InstOp::LAnd ? AluOp::And : AluOp::Or, dst, RAX);
+      asm_.Movzx8(dst, dst);
+      break;
+    }
+    default: {
+      alu(AluOp::Cmp);
+      asm_.Setcc(GetCond(op), dst);
+      asm_.Movzx8(dst, dst);
+      break;
+    }
+  }
+  FreeHost(rhs);
+  Push({Value::Kind::Host, dst});
+}
+
+void JitCode::CompareBranch(InstOp op, VMAddr target) {
+  auto rhs = Pop(), lhs = Pop();
+  Flush();
+  VMOpr ret;
+  if (lhs.kind == Value::Kind::Imm && rhs.kind == Value::Kind::Imm &&
+      FoldBinary(op, lhs.val, rhs.val, ret)) {
+    if (ret) JumpTo(target);
+    return;
+  }
+  if (lhs.kind != Value::Kind::Imm && lhs.kind != Value::Kind::Host &&
+      rhs.kind == Value::Kind::Imm) {
+    // compare memory with immediate directly
+    asm_.Alu(AluOp::Cmp, GetMem(lhs), rhs.val);
+  }
+  else {
+    auto reg = RAX;
+    if (lhs.kind == Value::Kind::Host) {
+      reg = Reg(lhs.val);
+    }
+    else {
+      Load(reg, lhs);
+    }
+    switch (rhs.kind) {
+      case Value::Kind::Imm: asm_.Alu(AluOp::Cmp, reg, rhs.val); break;
+      case Value::Kind::Host: asm_.Alu(AluOp::Cmp, reg, Reg(rhs.val)); break;
+      default: asm_.Alu(AluOp::Cmp, reg, GetMem(rhs)); break;
+    }
+  }
+  FreeHost(lhs);
+  FreeHost(rhs);
+  JumpTo(GetCond(op), target);
+}
+
+void JitCode::CallRuntime(std::int32_t offset) {
+  asm_.Mov64(RDI, Mem{kCtx, VM_CTX(vm)});
+  asm_.Call(Mem{kCtx, offset});
+}
+
+void JitCode::JumpTo(VMAddr target) {
+  fixups_.push_back({asm_.Jmp(), target});
+}
+
+void JitCode::JumpTo(Cond cond, VMAddr target) {
+  fixups_.push_back({asm_.Jcc(cond), target});
+}
+
+void JitCode::JumpToError(Cond cond, VMAddr pc, std::uint32_t code) {
+  errors_.push_back({asm_.Jcc(cond), pc, code});
+}
+
+void JitCode::JumpToError(VMAddr pc, std::uint32_t code) {
+  errors_.push_back({asm_.Jmp(), pc, code});
+}
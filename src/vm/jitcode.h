@@ -0,0 +1,186 @@
+#ifndef MINIVM_VM_JITCODE_H_
+#define MINIVM_VM_JITCODE_H_
+
+#include <vector>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+#include "vm/x64asm.h"
+
+namespace minivm::vm {
+
+class VM;
+
+// context of native code, holds the VM instance and runtime functions,
+// all runtime functions are implemented by the VM, and return 'nullptr'
+// or 'false' if failed (the error has already been logged)
+struct JitContext {
+  // VM instance
+  VM *vm;
+  // push a new frame for calling function at 'pc', returns frame pointer
+  VMOpr *(*call)(VM *vm, VMOpr *sp, VMAddr pc);
+  // reuse current frame for tail calling function at 'pc',
+  // returns frame pointer
+  VMOpr *(*tail_call)(VM *vm, VMOpr *sp, VMAddr pc);
+  // call external function 'sym' at 'pc', returns stack pointer
+  VMOpr *(*call_ext)(VM *vm, VMOpr *sp, VMAddr pc, SymId sym);
+  // pop current frame, returns frame pointer of the caller,
+  // or 'nullptr' if returning from the entry point
+  VMOpr *(*ret)(VM *vm);
+  // extend current frame, returns frame pointer of the current frame
+  // (which may be moved), or 'nullptr' if failed
+  VMOpr *(*enter)(VM *vm, std::uint32_t slot_count);
+  // allocate memory in memory pool, returns memory id
+  VMOpr (*alloc)(VM *vm, VMOpr size, bool init);
+  // get address of memory pool, returns 'nullptr' if invalid
+  void *(*get_addr)(VM *vm, VMOpr id);
+  // log error at 'pc'
+  void (*error)(VM *vm, VMAddr pc, std::uint32_t code);
+  // base of operand stack
+  VMOpr *opr_base;
+};
+
+// native code, translated from sealed Gopher instructions by a
+// template-based JIT compiler (x86-64 only)
+// the operand stack is cached by registers during translation,
+// the layout of the operand stack and the frame stack is the same
+// as the one used by the stack-based engine
+class JitCode {
+ public:
+  // entry of native code, returns stack pointer (success),
+  // or 'nullptr' (failed)
+  using Entry = VMOpr *(*)(const JitContext *ctx, const void *target,
+                           VMOpr *sp, VMOpr *fp, VMOpr *gp, VMOpr *regs);
+
+  JitCode(const VMInstContainer &cont)
+      : cont_(cont), code_(nullptr), code_size_(0) {}
+  JitCode(const JitCode &) = delete;
+  ~JitCode();
+
+  // translate all instructions in the container
+  // returns 'false' if the host is not supported
+  bool Translate();
+
+  // getter, entry of native code
+  Entry entry() const { return reinterpret_cast<Entry>(code_); }
+  // get native address of the specific pc address
+  const void *GetTarget(VMAddr pc) const { return targets_[pc]; }
+
+ private:
+  // value on the operand stack during translation
+  struct Value {
+    enum class Kind {
+      // immediate
+      Imm,
+      // frame slot, global segment slot or static register,
+      // not loaded until used
+      Slot, Global, Reg,
+      // host register
+      Host,
+    } kind;
+    VMOpr val;
+  };
+  // jumps to be backfilled
+  struct Fixup {
+    // offset of the displacement field
+    std::size_t at;
+    // target pc address
+    VMAddr target;
+  };
+  // branches to error handlers
+  struct ErrorStub {
+    std::size_t at;
+    VMAddr pc;
+    std::uint32_t code;
+  };
+
+  // collect all pc addresses that may be reached by jumps or returns
+  void CollectBlocks();
+  // translate the specific Gopher instruction
+  // returns number of translated instructions
+  VMAddr TranslateInst(VMAddr pc);
+  // emit prologue & epilogue of native code
+  void EmitPrologue();
+  void EmitEpilogue();
+  // emit all error handlers
+  void EmitErrorStubs();
+  // emit return operation, current frame will be popped by the VM
+  void EmitRet();
+  // copy generated code to executable memory
+  // returns 'false' if failed
+  bool Install();
+
+  // push value to the operand stack
+  void Push(const Value &val);
+  // pop a value from the operand stack
+  Value Pop();
+  // write all pending values to the operand stack in memory
+  void Flush();
+  // write the bottom pending value to the operand stack in memory
+  void SpillBottom();
+  // allocate a free host register without spilling
+  std::optional<x64::Reg> TryAllocHost();
+  // allocate a free host register, spill values if necessary
+  x64::Reg AllocHost();
+  // release host register of the specific value
+  void FreeHost(const Value &val);
+  // get memory operand of slot/global/static register value
+  x64::Mem GetMem(const Value &val) const;
+  // load value to the specific host register
+  void Load(x64::Reg reg, const Value &val);
+  // move value to an allocated host register
+  x64::Reg ToHost(const Value &val);
+  // load pending values that refer to the specific memory, should be
+  // called before the memory is modified
+  void Invalidate(Value::Kind kind, VMOpr index);
+  // store value to memory
+  void Store(const x64::Mem &mem, const Value &val);
+  // pop and store to slot/global/static register,
+  // push the value back if 'preserve' is set
+  void StoreVar(Value::Kind kind, VMOpr index, bool preserve);
+  // try to fold constant of binary operation
+  bool FoldBinary(InstOp op, VMOpr lhs, VMOpr rhs, VMOpr &ret);
+  // translate binary operation
+  void Binary(InstOp op);
+  // translate comparison followed by 'Bnz'
+  void CompareBranch(InstOp op, VMAddr target);
+  // call runtime function in context
+  void CallRuntime(std::int32_t offset);
+  // emit a jump to the specific pc address
+  void JumpTo(VMAddr target);
+  void JumpTo(x64::Cond cond, VMAddr target);
+  // emit a conditional jump to error handler
+  void JumpToError(x64::Cond cond, VMAddr pc, std::uint32_t code);
+  void JumpToError(VMAddr pc, std::uint32_t code);
+
+  // instruction container
+  const VMInstContainer &cont_;
+  // assembler
+  x64::Assembler asm_;
+  // executable memory
+  void *code_;
+  std::size_t code_size_;
+  // offset of native code of all pc addresses
+  std::vector<std::size_t> offsets_;
+  // native address of all pc addresses
+  std::vector<const void *> targets_;
+  // start of basic blocks
+  std::vector<bool> blocks_;
+  // jumps to be backfilled
+  std::vector<Fixup> fixups_;
+  // branches to error handlers
+  std::vector<ErrorStub> errors_;
+  // branches to exits (failed/returned from entry point)
+  std::vector<std::size_t> error_exits_, ret_exits_;
+  // values that have not been written to the operand stack in memory
+  std::vector<Value> pending_;
+  // whether host registers are allocated
+  std::vector<bool> host_used_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_JITCODE_H_
@@ -0,0 +1,81 @@
+#include "vm/vm.h"
+
+using namespace minivm::vm;
+
+std::optional<VMOpr> VM::Run(const JitCode &code) {
+  const JitContext ctx = {
+      this,     JitCall,  JitTailCall, JitCallExt, JitRet,
+      JitEnter, JitAlloc, JitGetAddr,  JitError,   oprs_.base(),
+  };
+  // run native code until returning from the entry point
+  auto sp = code.entry()(&ctx, code.GetTarget(pc_), oprs_.sp(),
+                         frames_.fp(), global_env_.data(), regs_.data());
+  if (!sp) return {};
+  oprs_.set_sp(sp);
+  // get return value
+  if (!regs_.empty()) return regs_[ret_reg_id_];
+  if (oprs_.empty()) {
+    LogError(kVMErrorEmptyOprStack);
+    return {};
+  }
+  auto ret = oprs_.top();
+  oprs_.pop();
+  return ret;
+}
+
+VMOpr *VM::JitCall(VM *vm, VMOpr *sp, VMAddr pc) {
+  vm->pc_ = pc;
+  vm->oprs_.set_sp(sp);
+  if (!vm->InitFuncCall()) return nullptr;
+  return vm->frames_.fp();
+}
+
+VMOpr *VM::JitTailCall(VM *vm, VMOpr *sp, VMAddr pc) {
+  vm->pc_ = pc;
+  vm->oprs_.set_sp(sp);
+  // memory allocated by the current function is not referenced by
+  // the callee, which is guaranteed when sealing
+  vm->mem_pool_->RestoreState(vm->frames_.pool_state());
+  auto &oprs = vm->oprs_;
+  if (!vm->frames_.Reuse(&oprs[0], oprs.size())) {
+    vm->LogError(kVMErrorFrameStackOverflow);
+    return nullptr;
+  }
+  oprs.clear();
+  return vm->frames_.fp();
+}
+
+VMOpr *VM::JitCallExt(VM *vm, VMOpr *sp, VMAddr pc, SymId sym) {
+  vm->pc_ = pc;
+  vm->oprs_.set_sp(sp);
+  auto &oprs = vm->oprs_;
+  if (!vm->CallExtFunc(sym, &oprs[0], oprs.size())) return nullptr;
+  return oprs.sp();
+}
+
+VMOpr *VM::JitRet(VM *vm) {
+  // restore the state of memory pool
+  vm->mem_pool_->RestoreState(vm->frames_.pool_state());
+  if (vm->frames_.is_entry()) return nullptr;
+  // the return address is read by native code before popping
+  vm->frames_.Pop();
+  return vm->frames_.fp();
+}
+
+VMOpr *VM::JitEnter(VM *vm, std::uint32_t slot_count) {
+  if (!vm->frames_.Extend(slot_count)) return nullptr;
+  return vm->frames_.fp();
+}
+
+VMOpr VM::JitAlloc(VM *vm, VMOpr size, bool init) {
+  return vm->mem_pool_->Allocate(size, init);
+}
+
+void *VM::JitGetAddr(VM *vm, VMOpr id) {
+  return vm->mem_pool_->GetAddress(id);
+}
+
+void VM::JitError(VM *vm, VMAddr pc, std::uint32_t code) {
+  vm->pc_ = pc;
+  vm->LogError(code);
+}
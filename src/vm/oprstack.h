@@ -0,0 +1,72 @@
+#ifndef MINIVM_VM_OPRSTACK_H_
+#define MINIVM_VM_OPRSTACK_H_
+
+#include <memory>
+#include <cstddef>
+
+#include "vm/define.h"
+
+namespace minivm::vm {
+
+// operand stack of MiniVM
+// all elements are stored in a preallocated contiguous array,
+// the first element of the array is a sentinel, so the stack
+// pointer always points to the top of stack (or the sentinel)
+class OprStack {
+ public:
+  OprStack(std::size_t capacity)
+      : base_(std::make_unique<VMOpr[]>(capacity + 1)),
+        limit_(base_.get() + capacity), sp_(base_.get()),
+        overflowed_(false) {}
+
+  // 'std::stack' compatible interfaces, for external functions
+  //
+  // push value to stack, the value is dropped if the stack is full,
+  // and the stack is marked as overflowed
+  void push(VMOpr val) {
+    if (sp_ == limit_) {
+      overflowed_ = true;
+    }
+    else {
+      *++sp_ = val;
+    }
+  }
+  // pop the top value
+  void pop() { --sp_; }
+  // get reference of the top of stack
+  VMOpr &top() { return *sp_; }
+  const VMOpr &top() const { return *sp_; }
+  // check if stack is empty
+  bool empty() const { return sp_ == base_.get(); }
+  // get size of stack
+  std::size_t size() const { return sp_ - base_.get(); }
+
+  // raw interfaces, for MiniVM instances
+  //
+  // clear the stack, and reset the overflow mark
+  void clear() {
+    sp_ = base_.get();
+    overflowed_ = false;
+  }
+  // get the i-th element, from bottom to top
+  VMOpr &operator[](std::size_t i) { return base_[i + 1]; }
+  // getter/setter, stack pointer
+  VMOpr *sp() const { return sp_; }
+  void set_sp(VMOpr *sp) { sp_ = sp; }
+  // getter, pointer to the sentinel element
+  VMOpr *base() const { return base_.get(); }
+  // getter, pointer to the last available element
+  VMOpr *limit() const { return limit_; }
+  // getter, whether any value has been dropped by 'push'
+  // since the last 'clear'
+  bool overflowed() const { return overflowed_; }
+
+ private:
+  std::unique_ptr<VMOpr[]> base_;
+  VMOpr *limit_, *sp_;
+  bool overflowed_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_OPRSTACK_H_
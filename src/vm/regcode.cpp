@@ -0,0 +1,406 @@
+#include "vm/regcode.h"
+
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+
+using namespace minivm::vm;
+
+namespace {
+
+// binary operations, 'op' -> {register & register, register & immediate}
+const std::unordered_map<InstOp, std::pair<RegOp, RegOp>> kBinaryOps = {
+    {InstOp::LAnd, {RegOp::LAnd, RegOp::LAndI}},
+    {InstOp::LOr, {RegOp::LOr, RegOp::LOrI}},
+    {InstOp::Eq, {RegOp::Eq, RegOp::EqI}},
+    {InstOp::Ne, {RegOp::Ne, RegOp::NeI}},
+    {InstOp::Gt, {RegOp::Gt, RegOp::GtI}},
+    {InstOp::Lt, {RegOp::Lt, RegOp::LtI}},
+    {InstOp::Ge, {RegOp::Ge, RegOp::GeI}},
+    {InstOp::Le, {RegOp::Le, RegOp::LeI}},
+    {InstOp::Add, {RegOp::Add, RegOp::AddI}},
+    {InstOp::Sub, {RegOp::Sub, RegOp::SubI}},
+    {InstOp::Mul, {RegOp::Mul, RegOp::MulI}},
+    {InstOp::Div, {RegOp::Div, RegOp::DivI}},
+    {InstOp::Mod, {RegOp::Mod, RegOp::ModI}},
+    {InstOp::And, {RegOp::And, RegOp::AndI}},
+    {InstOp::Shl, {RegOp::Shl, RegOp::ShlI}},
+    {InstOp::Shr, {RegOp::Shr, RegOp::ShrI}},
+};
+
+// comparisons that can be fused with the following 'Bnz'
+const std::unordered_map<RegOp, RegOp> kBranchOps = {
+    {RegOp::Eq, RegOp::Beq},   {RegOp::Ne, RegOp::Bne},
+    {RegOp::Gt, RegOp::Bgt},   {RegOp::Lt, RegOp::Blt},
+    {RegOp::Ge, RegOp::Bge},   {RegOp::Le, RegOp::Ble},
+    {RegOp::EqI, RegOp::BeqI}, {RegOp::NeI, RegOp::BneI},
+    {RegOp::GtI, RegOp::BgtI}, {RegOp::LtI, RegOp::BltI},
+    {RegOp::GeI, RegOp::BgeI}, {RegOp::LeI, RegOp::BleI},
+};
+
+// check if the destination of the specific instruction can be
+// replaced with another register
+inline bool IsRetargetable(RegOp op) {
+  // unary & binary operations
+  if (op >= RegOp::LNot && op <= RegOp::ShrI) return true;
+  return op == RegOp::Mov || op == RegOp::Li || op == RegOp::Ld ||
+         op == RegOp::LdGlobal;
+}
+
+}  // namespace
+
+bool RegCode::Translate() {
+  insts_.clear();
+  pcs_.clear();
+  pc_map_.assign(cont_.inst_count(), 0);
+  related_insts_.clear();
+  label_depths_.clear();
+  // collect all jump targets
+  std::unordered_set<VMAddr> targets;
+  for (VMAddr pc = 0; pc < cont_.inst_count(); ++pc) {
+    auto inst = cont_.GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    if (op == InstOp::Bnz || op == InstOp::Jmp) targets.insert(inst.opr);
+  }
+  // translate all instructions
+  auto entry_pc = cont_.FindPC(kVMEntry);
+  assert(entry_pc);
+  auto func_pcs = cont_.func_pcs();
+  cur_pc_ = 0;
+  EnterFunc(0);
+  for (VMAddr pc = 0; pc < cont_.inst_count(); ++pc) {
+    cur_pc_ = pc;
+    if (func_pcs.count(pc) || pc == *entry_pc) {
+      // functions are only reachable by 'Call'
+      ExitFunc();
+      stack_.clear();
+      reachable_ = false;
+    }
+    if (targets.count(pc) && !MergeLabel(pc)) return false;
+    pc_map_[pc] = insts_.size();
+    // the entry point shares the frame with pc 0
+    if (pc == *entry_pc) EnterFunc(0);
+    if (!TranslateInst(cont_.GetOrigInst(pc))) return false;
+  }
+  ExitFunc();
+  // convert Gopher pc addresses to instruction indices
+  for (const auto &i : related_insts_) {
+    auto &inst = insts_[i];
+    inst.dst = pc_map_[inst.dst];
+  }
+  return true;
+}
+
+bool RegCode::TranslateInst(const VMUnpackedInst &inst) {
+  Value val, addr;
+  auto depth = stack_.size();
+  switch (static_cast<InstOp>(inst.op)) {
+    case InstOp::VarSlot: {
+      Invalidate(inst.opr);
+      Emit(RegOp::VarSlot, inst.opr);
+      break;
+    }
+    case InstOp::ArrSlot: {
+      if (!Pop(val)) return false;
+      Invalidate(inst.opr);
+      Emit(RegOp::ArrSlot, inst.opr, ToReg(val, depth - 1));
+      break;
+    }
+    case InstOp::VarGlobal: {
+      Emit(RegOp::VarGlobal, inst.opr);
+      break;
+    }
+    case InstOp::ArrGlobal: {
+      if (!Pop(val)) return false;
+      Emit(RegOp::ArrGlobal, inst.opr, ToReg(val, depth - 1));
+      break;
+    }
+    case InstOp::Ld: {
+      if (!Pop(addr)) return false;
+      Emit(RegOp::Ld, Temp(depth - 1), ToReg(addr, depth - 1));
+      stack_.push_back({false, Temp(depth - 1)});
+      break;
+    }
+    case InstOp::St: {
+      if (!Pop(addr) || !Pop(val)) return false;
+      auto addr_reg = ToReg(addr, depth - 1);
+      Emit(RegOp::St, 0, ToReg(val, depth - 2), addr_reg);
+      break;
+    }
+    case InstOp::Imm: {
+      stack_.push_back({true, ExtendImm(inst.opr)});
+      break;
+    }
+    case InstOp::ImmHi: {
+      constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+      constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
+      VMOpr hi = (inst.opr & kMaskHi) << kVMInstImmLen;
+      if (!Pop(val)) return false;
+      if (val.is_imm) {
+        stack_.push_back({true, static_cast<VMOpr>(
+                                    (val.val & kMaskLo) | hi)});
+      }
+      else {
+        // modify the temporary instead of the original register
+        if (val.val != Temp(depth - 1)) {
+          Emit(RegOp::Mov, Temp(depth - 1), val.val);
+        }
+        Emit(RegOp::ImmHi, Temp(depth - 1), hi);
+        stack_.push_back({false, Temp(depth - 1)});
+      }
+      break;
+    }
+    case InstOp::LdSlot: {
+      stack_.push_back({false, static_cast<VMOpr>(inst.opr)});
+      break;
+    }
+    case InstOp::StSlot: {
+      if (!Pop(val)) return false;
+      Store(inst.opr, val, depth - 1);
+      break;
+    }
+    case InstOp::StSlotP: {
+      if (!Pop(val)) return false;
+      Store(inst.opr, val, depth - 1);
+      if (!val.is_imm) val.val = inst.opr;
+      stack_.push_back(val);
+      break;
+    }
+    case InstOp::LdGlobal: {
+      Emit(RegOp::LdGlobal, Temp(depth), inst.opr);
+      stack_.push_back({false, Temp(depth)});
+      break;
+    }
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      if (!Pop(val)) return false;
+      auto reg = ToReg(val, depth - 1);
+      Emit(RegOp::StGlobal, inst.opr, reg);
+      if (static_cast<InstOp>(inst.op) == InstOp::StGlobalP) {
+        stack_.push_back({false, reg});
+      }
+      break;
+    }
+    case InstOp::Bnz: {
+      return Branch(inst.opr);
+    }
+    case InstOp::Jmp: {
+      Flush();
+      if (!LogJump(inst.opr)) return false;
+      related_insts_.push_back(insts_.size());
+      Emit(RegOp::Jmp, inst.opr);
+      stack_.clear();
+      reachable_ = false;
+      break;
+    }
+    case InstOp::Call: case InstOp::CallExt: {
+      // all values on the stack are parameters,
+      // and the return value will be stored to the first temporary
+      Flush();
+      auto is_ext = static_cast<InstOp>(inst.op) == InstOp::CallExt;
+      auto op = is_ext ? RegOp::CallExt : RegOp::Call;
+      if (!is_ext) {
+        related_insts_.push_back(insts_.size());
+        // instructions absorbed by 'TailCall' are still translated,
+        // but never executed
+        auto cur = static_cast<InstOp>(cont_.insts()[cur_pc_].op);
+        if (cur == InstOp::TailCall) op = RegOp::TailCall;
+      }
+      Emit(op, inst.opr, Temp(0), depth);
+      stack_.clear();
+      stack_.push_back({false, Temp(0)});
+      break;
+    }
+    case InstOp::Ret: {
+      if (stack_.empty()) {
+        Emit(RegOp::RetVoid, 0);
+      }
+      else {
+        Emit(RegOp::Ret, 0, ToReg(stack_.back(), depth - 1));
+      }
+      stack_.clear();
+      reachable_ = false;
+      break;
+    }
+    case InstOp::Enter: {
+      EnterFunc(inst.opr);
+      break;
+    }
+    case InstOp::Error: {
+      Emit(RegOp::Error, inst.opr);
+      stack_.clear();
+      reachable_ = false;
+      break;
+    }
+    case InstOp::LNot: case InstOp::Neg: {
+      auto is_lnot = static_cast<InstOp>(inst.op) == InstOp::LNot;
+      if (!Pop(val)) return false;
+      if (val.is_imm) {
+        val.val = is_lnot ? !val.val : -val.val;
+        stack_.push_back(val);
+      }
+      else {
+        Emit(is_lnot ? RegOp::LNot : RegOp::Neg, Temp(depth - 1),
+             val.val);
+        stack_.push_back({false, Temp(depth - 1)});
+      }
+      break;
+    }
+    case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+    case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+    case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::Div:
+    case InstOp::Mod: case InstOp::And: case InstOp::Shl: case InstOp::Shr: {
+      const auto &ops = kBinaryOps.at(static_cast<InstOp>(inst.op));
+      return Binary(ops.first, ops.second);
+    }
+    case InstOp::Pop: {
+      if (!Pop(val)) return false;
+      break;
+    }
+    case InstOp::Clear: {
+      stack_.clear();
+      break;
+    }
+    default: {
+      // symbol-addressed instructions, static registers (Tigger mode)
+      // and breakpoints are not supported
+      return false;
+    }
+  }
+  return true;
+}
+
+void RegCode::EnterFunc(VMOpr slot_count) {
+  stack_.clear();
+  temp_base_ = slot_count;
+  temp_count_ = 0;
+  enter_index_ = insts_.size();
+  block_start_ = insts_.size();
+  reachable_ = true;
+  // frame size will be filled in when exiting function
+  Emit(RegOp::Enter, 0);
+}
+
+void RegCode::ExitFunc() {
+  insts_[enter_index_].dst = temp_base_ + temp_count_;
+}
+
+bool RegCode::MergeLabel(VMAddr pc) {
+  if (reachable_) {
+    // fall through, all values must be in their temporaries
+    Flush();
+    if (!LogJump(pc)) return false;
+  }
+  else {
+    // only reachable by jumps
+    auto it = label_depths_.insert({pc, 0}).first;
+    stack_.clear();
+    for (std::size_t i = 0; i < it->second; ++i) {
+      stack_.push_back({false, Temp(i)});
+    }
+    reachable_ = true;
+  }
+  block_start_ = insts_.size();
+  return true;
+}
+
+bool RegCode::LogJump(VMAddr target) {
+  auto ret = label_depths_.insert({target, stack_.size()});
+  return ret.second || ret.first->second == stack_.size();
+}
+
+void RegCode::Emit(RegOp op, VMOpr dst, VMOpr lhs, VMOpr rhs) {
+  insts_.push_back({op, dst, lhs, rhs});
+  pcs_.push_back(cur_pc_);
+}
+
+VMOpr RegCode::Temp(std::size_t depth) {
+  temp_count_ = std::max(temp_count_, depth + 1);
+  return temp_base_ + depth;
+}
+
+bool RegCode::Pop(Value &val) {
+  if (stack_.empty()) return false;
+  val = stack_.back();
+  stack_.pop_back();
+  return true;
+}
+
+VMOpr RegCode::ToReg(const Value &val, std::size_t depth) {
+  if (!val.is_imm) return val.val;
+  Emit(RegOp::Li, Temp(depth), val.val);
+  return Temp(depth);
+}
+
+void RegCode::Flush() {
+  for (std::size_t i = 0; i < stack_.size(); ++i) {
+    auto &val = stack_[i];
+    if (val.is_imm || val.val != Temp(i)) {
+      Emit(val.is_imm ? RegOp::Li : RegOp::Mov, Temp(i), val.val);
+      val = {false, Temp(i)};
+    }
+  }
+}
+
+void RegCode::Invalidate(VMOpr reg) {
+  for (std::size_t i = 0; i < stack_.size(); ++i) {
+    auto &val = stack_[i];
+    if (!val.is_imm && val.val == reg && reg != Temp(i)) {
+      Emit(RegOp::Mov, Temp(i), reg);
+      val.val = Temp(i);
+    }
+  }
+}
+
+void RegCode::Store(VMOpr reg, const Value &val, std::size_t depth) {
+  if (!val.is_imm && val.val == reg) return;
+  Invalidate(reg);
+  // try to write the result of the last instruction to 'reg' directly
+  if (!val.is_imm && val.val == Temp(depth) &&
+      insts_.size() > block_start_) {
+    auto &last = insts_.back();
+    if (last.dst == val.val && IsRetargetable(last.op)) {
+      last.dst = reg;
+      return;
+    }
+  }
+  Emit(val.is_imm ? RegOp::Li : RegOp::Mov, reg, val.val);
+}
+
+bool RegCode::Binary(RegOp op_rr, RegOp op_ri) {
+  Value lhs, rhs;
+  if (!Pop(rhs) || !Pop(lhs)) return false;
+  auto depth = stack_.size();
+  auto lhs_reg = ToReg(lhs, depth);
+  if (rhs.is_imm) {
+    Emit(op_ri, Temp(depth), lhs_reg, rhs.val);
+  }
+  else {
+    Emit(op_rr, Temp(depth), lhs_reg, rhs.val);
+  }
+  stack_.push_back({false, Temp(depth)});
+  return true;
+}
+
+bool RegCode::Branch(VMAddr target) {
+  Value cond;
+  if (!Pop(cond)) return false;
+  auto depth = stack_.size();
+  Flush();
+  if (!LogJump(target)) return false;
+  related_insts_.push_back(insts_.size());
+  // try to fuse with the last comparison
+  if (!cond.is_imm && cond.val == Temp(depth) &&
+      insts_.size() > block_start_) {
+    auto &last = insts_.back();
+    auto it = kBranchOps.find(last.op);
+    if (last.dst == cond.val && it != kBranchOps.end()) {
+      last.op = it->second;
+      last.dst = target;
+      related_insts_.back() = insts_.size() - 1;
+      return true;
+    }
+  }
+  Emit(RegOp::Bnz, target, ToReg(cond, depth));
+  return true;
+}
@@ -0,0 +1,149 @@
+#ifndef MINIVM_VM_REGCODE_H_
+#define MINIVM_VM_REGCODE_H_
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+
+// all instructions of the register-based engine
+// for more details, see `src/vm/README.md`
+#define VM_REG_INSTS(e)                                      \
+  /* move & load immediate */                                \
+  e(Mov) e(Li) e(ImmHi)                                      \
+  /* memory allocation */                                    \
+  e(VarSlot) e(ArrSlot) e(VarGlobal) e(ArrGlobal)            \
+  /* load & store */                                         \
+  e(Ld) e(St) e(LdGlobal) e(StGlobal)                        \
+  /* control transfer */                                     \
+  e(Bnz) e(Jmp)                                              \
+  /* function call & prologue */                             \
+  e(Call) e(TailCall) e(CallExt) e(Ret) e(RetVoid) e(Enter)  \
+  /* debugging */                                            \
+  e(Error)                                                   \
+  /* unary operations */                                     \
+  e(LNot) e(Neg)                                             \
+  /* binary operations, register & register */               \
+  e(LAnd) e(LOr) e(Eq) e(Ne) e(Gt) e(Lt) e(Ge) e(Le)         \
+  e(Add) e(Sub) e(Mul) e(Div) e(Mod) e(And) e(Shl) e(Shr)    \
+  /* binary operations, register & immediate */              \
+  e(LAndI) e(LOrI) e(EqI) e(NeI) e(GtI) e(LtI) e(GeI) e(LeI) \
+  e(AddI) e(SubI) e(MulI) e(DivI) e(ModI)                    \
+  e(AndI) e(ShlI) e(ShrI)                                    \
+  /* compare & branch, register & register */                \
+  e(Beq) e(Bne) e(Bgt) e(Blt) e(Bge) e(Ble)                  \
+  /* compare & branch, register & immediate */               \
+  e(BeqI) e(BneI) e(BgtI) e(BltI) e(BgeI) e(BleI)
+
+namespace minivm::vm {
+
+// opcode of register-based instructions
+enum class RegOp { VM_REG_INSTS(VM_EXPAND_LIST) };
+
+// register-based instruction, in three-address form
+// operands can be register ids, immediates, global slot indices,
+// target addresses or symbols, depending on the opcode
+struct RegInst {
+  RegOp op;
+  VMOpr dst, lhs, rhs;
+};
+
+// register-based code, translated from sealed Gopher instructions
+// all parameters, local variables and temporaries (elements of the
+// operand stack) of a function are mapped to registers in its frame,
+// temporaries are placed after slots of local variables
+class RegCode {
+ public:
+  RegCode(const VMInstContainer &cont) : cont_(cont) {}
+
+  // translate all instructions in the container (Eeyore mode only)
+  // returns 'false' if instructions can not be translated
+  bool Translate();
+
+  // getter, instruction data
+  const RegInst *insts() const { return insts_.data(); }
+  // getter, instruction count
+  std::size_t inst_count() const { return insts_.size(); }
+  // get pc address of the Gopher instruction that generated
+  // the specific register-based instruction
+  VMAddr GetPC(std::size_t index) const { return pcs_[index]; }
+
+ private:
+  // value on the operand stack during translation
+  struct Value {
+    // 'true' if value is an immediate, otherwise a register
+    bool is_imm;
+    VMOpr val;
+  };
+
+  // translate the specific Gopher instruction
+  // returns 'false' if failed
+  bool TranslateInst(const VMUnpackedInst &inst);
+  // start translating a new function (or the entry point)
+  void EnterFunc(VMOpr slot_count);
+  // finish translating current function
+  void ExitFunc();
+  // merge states at the specific jump target
+  // returns 'false' if stack depths are mismatched
+  bool MergeLabel(VMAddr pc);
+  // log stack depth for jumping to the specific target
+  // returns 'false' if stack depths are mismatched
+  bool LogJump(VMAddr target);
+
+  // emit a new instruction
+  void Emit(RegOp op, VMOpr dst, VMOpr lhs, VMOpr rhs);
+  void Emit(RegOp op, VMOpr dst, VMOpr lhs) { Emit(op, dst, lhs, 0); }
+  void Emit(RegOp op, VMOpr dst) { Emit(op, dst, 0, 0); }
+  // get register of temporary at the specific stack depth
+  VMOpr Temp(std::size_t depth);
+  // pop a value from stack, returns 'false' if stack is empty
+  bool Pop(Value &val);
+  // move value to a register if it's an immediate
+  // the temporary at the specific depth will be used
+  VMOpr ToReg(const Value &val, std::size_t depth);
+  // move all values on the stack to their temporaries
+  void Flush();
+  // move values that refer to the specific register to temporaries,
+  // should be called before the register is modified
+  void Invalidate(VMOpr reg);
+  // store value to the specific register
+  void Store(VMOpr reg, const Value &val, std::size_t depth);
+  // translate binary operation
+  // returns 'false' if failed
+  bool Binary(RegOp op_rr, RegOp op_ri);
+  // translate branch
+  // returns 'false' if failed
+  bool Branch(VMAddr target);
+
+  // instruction container
+  const VMInstContainer &cont_;
+  // generated instructions
+  std::vector<RegInst> insts_;
+  // Gopher pc address of generated instructions
+  std::vector<VMAddr> pcs_;
+  // index of the first generated instruction of Gopher instructions
+  std::vector<std::size_t> pc_map_;
+  // instructions that refer to Gopher pc addresses
+  std::vector<std::size_t> related_insts_;
+  // stack depth of all jump targets
+  std::unordered_map<VMAddr, std::size_t> label_depths_;
+  // operand stack of current function
+  std::vector<Value> stack_;
+  // current Gopher pc address
+  VMAddr cur_pc_;
+  // base register of temporaries, and temporary count
+  VMOpr temp_base_;
+  std::size_t temp_count_;
+  // index of 'Enter' instruction of current function
+  std::size_t enter_index_;
+  // index of the first instruction of current basic block
+  std::size_t block_start_;
+  // whether current instruction is reachable
+  bool reachable_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_REGCODE_H_
@@ -0,0 +1,452 @@
+#include "vm/vm.h"
+
+using namespace minivm::vm;
+
+std::optional<VMOpr> VM::Run(const RegCode &code) {
+#define VM_NEXT(ofs)                                       \
+  do {                                                     \
+    inst += ofs;                                           \
+    goto *kInstLabels[static_cast<std::size_t>(inst->op)]; \
+  } while (0)
+#define VM_JUMP(target)    \
+  do {                     \
+    inst = insts + (target); \
+    VM_NEXT(0);            \
+  } while (0)
+#define VM_ERROR(err)               \
+  do {                              \
+    pc_ = code.GetPC(inst - insts); \
+    LogError(err);                  \
+    return {};                      \
+  } while (0)
+#define VM_BINARY(op)                               \
+  do {                                              \
+    fp[inst->dst] = fp[inst->lhs] op fp[inst->rhs]; \
+    VM_NEXT(1);                                     \
+  } while (0)
+#define VM_BINARY_I(op)                         \
+  do {                                          \
+    fp[inst->dst] = fp[inst->lhs] op inst->rhs; \
+    VM_NEXT(1);                                 \
+  } while (0)
+#define VM_BRANCH(op)                                       \
+  do {                                                      \
+    if (fp[inst->lhs] op fp[inst->rhs]) VM_JUMP(inst->dst); \
+    VM_NEXT(1);                                             \
+  } while (0)
+#define VM_BRANCH_I(op)                                 \
+  do {                                                  \
+    if (fp[inst->lhs] op inst->rhs) VM_JUMP(inst->dst); \
+    VM_NEXT(1);                                         \
+  } while (0)
+
+  const void *kInstLabels[] = {VM_REG_INSTS(VM_EXPAND_LABEL_LIST)};
+  const RegInst *insts = code.insts(), *inst = insts;
+  VMOpr *fp = frames_.fp(), *gp = global_env_.data();
+  VM_NEXT(0);
+
+  // move register
+  VM_LABEL(Mov) {
+    fp[inst->dst] = fp[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // load immediate
+  VM_LABEL(Li) {
+    fp[inst->dst] = inst->lhs;
+    VM_NEXT(1);
+  }
+
+  // load immediate to upper bits
+  VM_LABEL(ImmHi) {
+    constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+    fp[inst->dst] = (fp[inst->dst] & kMaskLo) | inst->lhs;
+    VM_NEXT(1);
+  }
+
+  // allocate memory for variable (frame slot)
+  VM_LABEL(VarSlot) {
+    fp[inst->dst] = 0xdeadc0de;
+    VM_NEXT(1);
+  }
+
+  // allocate memory for array (frame slot)
+  VM_LABEL(ArrSlot) {
+    fp[inst->dst] = mem_pool_->Allocate(fp[inst->lhs], false);
+    VM_NEXT(1);
+  }
+
+  // allocate memory for variable (global segment)
+  VM_LABEL(VarGlobal) {
+    gp[inst->dst] = 0;
+    VM_NEXT(1);
+  }
+
+  // allocate memory for array (global segment)
+  VM_LABEL(ArrGlobal) {
+    gp[inst->dst] = mem_pool_->Allocate(fp[inst->lhs], true);
+    VM_NEXT(1);
+  }
+
+  // load value from address
+  VM_LABEL(Ld) {
+    auto ptr = mem_pool_->GetAddress(fp[inst->lhs]);
+    if (!ptr) VM_ERROR(kVMErrorInvalidMemPoolAddr);
+    fp[inst->dst] = *reinterpret_cast<VMOpr *>(ptr);
+    VM_NEXT(1);
+  }
+
+  // store value to address
+  VM_LABEL(St) {
+    auto ptr = mem_pool_->GetAddress(fp[inst->rhs]);
+    if (!ptr) VM_ERROR(kVMErrorInvalidMemPoolAddr);
+    *reinterpret_cast<VMOpr *>(ptr) = fp[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // load global variable
+  VM_LABEL(LdGlobal) {
+    fp[inst->dst] = gp[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // store global variable
+  VM_LABEL(StGlobal) {
+    gp[inst->dst] = fp[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // branch if not zero
+  VM_LABEL(Bnz) {
+    if (fp[inst->lhs]) VM_JUMP(inst->dst);
+    VM_NEXT(1);
+  }
+
+  // jump to target
+  VM_LABEL(Jmp) {
+    VM_JUMP(inst->dst);
+  }
+
+  // call function, parameters are stored in consecutive registers
+  VM_LABEL(Call) {
+    auto state = mem_pool_->SaveState();
+    VMAddr ret_addr = inst - insts + 1;
+    if (!frames_.Push(ret_addr, state, fp + inst->lhs, inst->rhs)) {
+      VM_ERROR(kVMErrorFrameStackOverflow);
+    }
+    fp = frames_.fp();
+    VM_JUMP(inst->dst);
+  }
+
+  // tail call, reuse the current frame
+  VM_LABEL(TailCall) {
+    // memory allocated by the current function is not referenced by
+    // the callee, which is guaranteed when sealing
+    mem_pool_->RestoreState(frames_.pool_state());
+    if (!frames_.Reuse(fp + inst->lhs, inst->rhs)) {
+      VM_ERROR(kVMErrorFrameStackOverflow);
+    }
+    fp = frames_.fp();
+    VM_JUMP(inst->dst);
+  }
+
+  // call external function
+  VM_LABEL(CallExt) {
+    pc_ = code.GetPC(inst - insts);
+    if (!CallExtFunc(inst->dst, fp + inst->lhs, inst->rhs)) return {};
+    if (!oprs_.empty()) fp[inst->lhs] = oprs_.top();
+    VM_NEXT(1);
+  }
+
+  // return from function call, with return value
+  VM_LABEL(Ret) {
+    auto ret = fp[inst->lhs];
+    // restore the state of memory pool
+    mem_pool_->RestoreState(frames_.pool_state());
+    // check if need to stop execution
+    if (frames_.is_entry()) {
+      if (!regs_.empty()) return regs_[ret_reg_id_];
+      return ret;
+    }
+    // write return value to the register of the caller's 'Call'
+    inst = insts + frames_.ret_addr();
+    frames_.Pop();
+    fp = frames_.fp();
+    fp[inst[-1].lhs] = ret;
+    VM_NEXT(0);
+  }
+
+  // return from function call, without return value
+  VM_LABEL(RetVoid) {
+    mem_pool_->RestoreState(frames_.pool_state());
+    if (frames_.is_entry()) {
+      if (!regs_.empty()) return regs_[ret_reg_id_];
+      VM_ERROR(kVMErrorEmptyOprStack);
+    }
+    inst = insts + frames_.ret_addr();
+    frames_.Pop();
+    fp = frames_.fp();
+    VM_NEXT(0);
+  }
+
+  // function prologue
+  VM_LABEL(Enter) {
+    // allocate registers for local variables and temporaries
+    if (!frames_.Extend(inst->dst)) {
+      VM_ERROR(kVMErrorFrameStackOverflow);
+    }
+    fp = frames_.fp();
+    VM_NEXT(1);
+  }
+
+  // error
+  VM_LABEL(Error) {
+    VM_ERROR(inst->dst);
+  }
+
+  // logical negation
+  VM_LABEL(LNot) {
+    fp[inst->dst] = !fp[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // negation
+  VM_LABEL(Neg) {
+    fp[inst->dst] = -fp[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // logical AND
+  VM_LABEL(LAnd) {
+    VM_BINARY(&&);
+  }
+
+  // logical OR
+  VM_LABEL(LOr) {
+    VM_BINARY(||);
+  }
+
+  // set if equal
+  VM_LABEL(Eq) {
+    VM_BINARY(==);
+  }
+
+  // set if not equal
+  VM_LABEL(Ne) {
+    VM_BINARY(!=);
+  }
+
+  // set if greater than
+  VM_LABEL(Gt) {
+    VM_BINARY(>);
+  }
+
+  // set if less than
+  VM_LABEL(Lt) {
+    VM_BINARY(<);
+  }
+
+  // set if greater than or equal
+  VM_LABEL(Ge) {
+    VM_BINARY(>=);
+  }
+
+  // set if less than or equal
+  VM_LABEL(Le) {
+    VM_BINARY(<=);
+  }
+
+  // addition
+  VM_LABEL(Add) {
+    VM_BINARY(+);
+  }
+
+  // subtraction
+  VM_LABEL(Sub) {
+    VM_BINARY(-);
+  }
+
+  // multiplication
+  VM_LABEL(Mul) {
+    VM_BINARY(*);
+  }
+
+  // division
+  VM_LABEL(Div) {
+    VM_BINARY(/);
+  }
+
+  // modulo operation
+  VM_LABEL(Mod) {
+    VM_BINARY(%);
+  }
+
+  // bitwise AND
+  VM_LABEL(And) {
+    VM_BINARY(&);
+  }
+
+  // shift left
+  VM_LABEL(Shl) {
+    fp[inst->dst] = static_cast<std::uint32_t>(fp[inst->lhs])
+                    << (fp[inst->rhs] & 31);
+    VM_NEXT(1);
+  }
+
+  // arithmetic shift right
+  VM_LABEL(Shr) {
+    fp[inst->dst] = fp[inst->lhs] >> (fp[inst->rhs] & 31);
+    VM_NEXT(1);
+  }
+
+  // logical AND (immediate)
+  VM_LABEL(LAndI) {
+    VM_BINARY_I(&&);
+  }
+
+  // logical OR (immediate)
+  VM_LABEL(LOrI) {
+    VM_BINARY_I(||);
+  }
+
+  // set if equal (immediate)
+  VM_LABEL(EqI) {
+    VM_BINARY_I(==);
+  }
+
+  // set if not equal (immediate)
+  VM_LABEL(NeI) {
+    VM_BINARY_I(!=);
+  }
+
+  // set if greater than (immediate)
+  VM_LABEL(GtI) {
+    VM_BINARY_I(>);
+  }
+
+  // set if less than (immediate)
+  VM_LABEL(LtI) {
+    VM_BINARY_I(<);
+  }
+
+  // set if greater than or equal (immediate)
+  VM_LABEL(GeI) {
+    VM_BINARY_I(>=);
+  }
+
+  // set if less than or equal (immediate)
+  VM_LABEL(LeI) {
+    VM_BINARY_I(<=);
+  }
+
+  // addition (immediate)
+  VM_LABEL(AddI) {
+    VM_BINARY_I(+);
+  }
+
+  // subtraction (immediate)
+  VM_LABEL(SubI) {
+    VM_BINARY_I(-);
+  }
+
+  // multiplication (immediate)
+  VM_LABEL(MulI) {
+    VM_BINARY_I(*);
+  }
+
+  // division (immediate)
+  VM_LABEL(DivI) {
+    VM_BINARY_I(/);
+  }
+
+  // modulo operation (immediate)
+  VM_LABEL(ModI) {
+    VM_BINARY_I(%);
+  }
+
+  // bitwise AND (immediate)
+  VM_LABEL(AndI) {
+    VM_BINARY_I(&);
+  }
+
+  // shift left (immediate)
+  VM_LABEL(ShlI) {
+    fp[inst->dst] = static_cast<std::uint32_t>(fp[inst->lhs])
+                    << (inst->rhs & 31);
+    VM_NEXT(1);
+  }
+
+  // arithmetic shift right (immediate)
+  VM_LABEL(ShrI) {
+    fp[inst->dst] = fp[inst->lhs] >> (inst->rhs & 31);
+    VM_NEXT(1);
+  }
+
+  // branch if equal
+  VM_LABEL(Beq) {
+    VM_BRANCH(==);
+  }
+
+  // branch if not equal
+  VM_LABEL(Bne) {
+    VM_BRANCH(!=);
+  }
+
+  // branch if greater than
+  VM_LABEL(Bgt) {
+    VM_BRANCH(>);
+  }
+
+  // branch if less than
+  VM_LABEL(Blt) {
+    VM_BRANCH(<);
+  }
+
+  // branch if greater than or equal
+  VM_LABEL(Bge) {
+    VM_BRANCH(>=);
+  }
+
+  // branch if less than or equal
+  VM_LABEL(Ble) {
+    VM_BRANCH(<=);
+  }
+
+  // branch if equal (immediate)
+  VM_LABEL(BeqI) {
+    VM_BRANCH_I(==);
+  }
+
+  // branch if not equal (immediate)
+  VM_LABEL(BneI) {
+    VM_BRANCH_I(!=);
+  }
+
+  // branch if greater than (immediate)
+  VM_LABEL(BgtI) {
+    VM_BRANCH_I(>);
+  }
+
+  // branch if less than (immediate)
+  VM_LABEL(BltI) {
+    VM_BRANCH_I(<);
+  }
+
+  // branch if greater than or equal (immediate)
+  VM_LABEL(BgeI) {
+    VM_BRANCH_I(>=);
+  }
+
+  // branch if less than or equal (immediate)
+  VM_LABEL(BleI) {
+    VM_BRANCH_I(<=);
+  }
+
+#undef VM_BRANCH_I
+#undef VM_BRANCH
+#undef VM_BINARY_I
+#undef VM_BINARY
+#undef VM_ERROR
+#undef VM_JUMP
+#undef VM_NEXT
+}
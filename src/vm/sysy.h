@@ -0,0 +1,49 @@
+#ifndef MINIVM_VM_SYSY_H_
+#define MINIVM_VM_SYSY_H_
+
+#include <iostream>
+
+#include "vm/define.h"
+#include "mem/pool.h"
+
+// implementations of SysY runtime library functions that access
+// the memory pool, shared by external functions and intrinsics
+
+namespace minivm::vm::sysy {
+
+// read the length and elements of an array from stdin
+// returns 'false' if the array address is invalid
+inline bool GetArray(mem::MemoryPoolInterface &pool, VMOpr &len,
+                     mem::MemId arr) {
+  // get length
+  std::cin >> len;
+  // get address of array
+  auto ptr = pool.GetAddress(arr);
+  if (!ptr) return false;
+  // read elements
+  for (int i = 0; i < len; ++i) {
+    std::cin >> reinterpret_cast<VMOpr *>(ptr)[i];
+  }
+  return true;
+}
+
+// print the length and elements of an array to stdout
+// returns 'false' if the array address is invalid
+inline bool PutArray(mem::MemoryPoolInterface &pool, VMOpr len,
+                     mem::MemId arr) {
+  // put length
+  std::cout << len << ':';
+  // get address of array
+  auto ptr = pool.GetAddress(arr);
+  if (!ptr) return false;
+  // put elements
+  for (int i = 0; i < len; ++i) {
+    std::cout << ' ' << reinterpret_cast<VMOpr *>(ptr)[i];
+  }
+  std::cout << std::endl;
+  return true;
+}
+
+}  // namespace minivm::vm::sysy
+
+#endif  // MINIVM_VM_SYSY_H_
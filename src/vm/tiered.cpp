@@ -0,0 +1,169 @@
+#include "vm/tiered.h"
+
+#include <sstream>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+
+#include "back/c/funcgen.h"
+
+#if defined(__unix__)
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#define VM_TIER_SUPPORTED
+#endif
+
+using namespace minivm::vm;
+
+namespace {
+
+// count of calls & back-edges that makes a function hot
+constexpr std::uint32_t kHotThreshold = 1 << 14;
+// default size of native stack
+constexpr std::size_t kDefaultStackSize = 8 << 20;
+// maximum size of native stack that can be used by native functions
+constexpr std::size_t kMaxStackSize = 1 << 30;
+// name of the function that registers all native functions
+constexpr const char *kRegisterFunc = "VMTierRegister";
+
+// get size of the native stack that can be used by native functions
+std::size_t GetStackSize() {
+  std::size_t size = kDefaultStackSize;
+#ifdef VM_TIER_SUPPORTED
+  rlimit limit;
+  if (!getrlimit(RLIMIT_STACK, &limit)) {
+    size = limit.rlim_cur == RLIM_INFINITY ? kMaxStackSize
+                                           : limit.rlim_cur;
+  }
+#endif
+  // reserve half of the stack for the VM itself
+  return std::min(size, kMaxStackSize) / 2;
+}
+
+}  // namespace
+
+TieredCompiler::TieredCompiler(const VMInstContainer &cont,
+                               bool tigger_mode)
+    : cont_(cont), tigger_mode_(tigger_mode), ctx_({}),
+      funcs_(cont.inst_count(), nullptr), owners_(cont.inst_count(), 0),
+      counters_(cont.inst_count(), 0), failed_(cont.inst_count(), false) {
+  ctx_.stack_left = GetStackSize();
+  ctx_.funcs = funcs_.data();
+  // find function of each instruction, the first instruction
+  // (Jmp kVMEntry) and the entry point belong to no function
+  auto entry_pc = cont_.FindPC(kVMEntry);
+  auto func_pcs = cont_.func_pcs();
+  VMAddr cur_func = 0;
+  for (VMAddr pc = 1; pc < cont_.inst_count(); ++pc) {
+    if (entry_pc && pc == *entry_pc) {
+      cur_func = 0;
+    }
+    else if (func_pcs.count(pc)) {
+      cur_func = pc;
+    }
+    owners_[pc] = cur_func;
+  }
+}
+
+TieredCompiler::~TieredCompiler() {
+#ifdef VM_TIER_SUPPORTED
+  for (const auto &handle : handles_) dlclose(handle);
+#endif
+}
+
+NativeFunc TieredCompiler::CountCall(VMAddr func) {
+  return Count(func);
+}
+
+NativeFunc TieredCompiler::CountBackEdge(VMAddr pc) {
+  auto func = owners_[pc];
+  return func ? Count(func) : nullptr;
+}
+
+NativeFunc TieredCompiler::Count(VMAddr func) {
+  if (funcs_[func]) return funcs_[func];
+  if (failed_[func] || ++counters_[func] < kHotThreshold) return nullptr;
+  if (!Compile(func)) {
+    failed_[func] = true;
+    return nullptr;
+  }
+  return funcs_[func];
+}
+
+bool TieredCompiler::Compile(VMAddr func) {
+  // collect functions to be compiled
+  std::unordered_set<VMAddr> funcs;
+  if (!CollectFuncs(func, funcs)) return false;
+  // generate C code
+  back::c::CFuncGen gen(cont_, tigger_mode_, funcs);
+  gen.Generate();
+  if (gen.has_error()) return false;
+  if (!gen.failed_funcs().empty()) {
+    for (const auto &pc : gen.failed_funcs()) failed_[pc] = true;
+    return false;
+  }
+  std::ostringstream oss;
+  gen.Dump(oss);
+  // compile & load
+  return LoadCode(oss.str());
+}
+
+bool TieredCompiler::CollectFuncs(VMAddr func,
+                                  std::unordered_set<VMAddr> &funcs) {
+  if (funcs_[func] || funcs.count(func)) return true;
+  if (failed_[func]) return false;
+  funcs.insert(func);
+  // visit all callees
+  for (auto pc = func; pc < cont_.inst_count() && owners_[pc] == func;
+       ++pc) {
+    auto inst = cont_.GetOrigInst(pc);
+    if (static_cast<InstOp>(inst.op) == InstOp::Call &&
+        !CollectFuncs(inst.opr, funcs)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TieredCompiler::LoadCode(const std::string &code) {
+#ifdef VM_TIER_SUPPORTED
+  // write code to a temporary directory
+  char dir[] = "/tmp/minivm-XXXXXX";
+  if (!mkdtemp(dir)) return false;
+  auto src = std::string(dir) + "/tier.c";
+  auto lib = std::string(dir) + "/tier.so";
+  std::ofstream ofs(src);
+  ofs << code;
+  ofs.close();
+  // invoke the system C compiler
+  void *handle = nullptr;
+  if (ofs) {
+    auto cc = std::getenv("CC");
+    std::string cmd = cc && *cc ? cc : "cc";
+    cmd += " -O2 -shared -fPIC -w -o " + lib + ' ' + src +
+           " >/dev/null 2>&1";
+    if (!std::system(cmd.c_str())) {
+      handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+    }
+  }
+  std::remove(src.c_str());
+  std::remove(lib.c_str());
+  rmdir(dir);
+  if (!handle) return false;
+  // register all native functions
+  auto reg = reinterpret_cast<void (*)(NativeFunc *)>(
+      dlsym(handle, kRegisterFunc));
+  if (!reg) {
+    dlclose(handle);
+    return false;
+  }
+  reg(funcs_.data());
+  handles_.push_back(handle);
+  return true;
+#else
+  static_cast<void>(code);
+  return false;
+#endif
+}
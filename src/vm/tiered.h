@@ -0,0 +1,132 @@
+#ifndef MINIVM_VM_TIERED_H_
+#define MINIVM_VM_TIERED_H_
+
+#include <vector>
+#include <unordered_set>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+
+namespace minivm::vm {
+
+class VM;
+
+// status of native functions
+enum class NativeStatus : int {
+  // error occurred, the error has already been logged
+  Error,
+  // returned without return value
+  Ret,
+  // returned with a return value
+  RetValue,
+  // the specific entry is not available
+  NoEntry,
+  // the native stack has run out, nothing has been executed
+  NoStack,
+};
+
+struct TierContext;
+
+// native function, compiled from a Gopher function
+// parameters are the values on the operand stack when calling, or
+// slots of the current frame when entering at the label 'entry'
+// ('entry' is zero when calling from the first instruction)
+using NativeFunc = int (*)(TierContext *ctx, const VMOpr *params,
+                           std::uint32_t count, VMAddr entry, VMOpr *ret);
+
+// context of native functions, holds the VM instance and runtime
+// functions, must be consistent with the one in 'back/c/embed/tier.c'
+struct TierContext {
+  // VM instance
+  VM *vm;
+  // global segment
+  VMOpr *gp;
+  // static registers
+  VMOpr *regs;
+  // size of the available native stack
+  std::size_t stack_left;
+  // get address of memory pool, returns 'nullptr' if invalid
+  void *(*get_addr)(VM *vm, VMOpr id);
+  // allocate memory in memory pool, returns memory id
+  VMOpr (*alloc)(VM *vm, VMOpr size, bool init);
+  // save/restore the state of memory pool
+  std::uint32_t (*save_state)(VM *vm);
+  void (*restore_state)(VM *vm, std::uint32_t state);
+  // call external function 'sym' at 'pc', returns 'NativeStatus'
+  int (*call_ext)(VM *vm, VMAddr pc, SymId sym, const VMOpr *params,
+                  std::uint32_t count, VMOpr *ret);
+  // call function 'func' at 'pc' by the interpreter, returns 'NativeStatus'
+  int (*call_vm)(VM *vm, VMAddr pc, VMAddr func, const VMOpr *params,
+                 std::uint32_t count, VMOpr *ret);
+  // log error at 'pc'
+  void (*error)(VM *vm, VMAddr pc, std::uint32_t code);
+  // native functions, indexed by pc address of Gopher functions
+  const NativeFunc *funcs;
+};
+
+// compiler of tiered execution
+// counts calls and loop back-edges of functions, compiles hot functions
+// (and their callees) to native code by the system C compiler
+class TieredCompiler {
+ public:
+  TieredCompiler(const VMInstContainer &cont, bool tigger_mode);
+  TieredCompiler(const TieredCompiler &) = delete;
+  ~TieredCompiler();
+
+  // check if the function containing the specific pc may be compiled
+  bool IsCandidate(VMAddr pc) const {
+    auto func = owners_[pc];
+    return func && !failed_[func];
+  }
+  // count a call to the specific function
+  // returns the native function if it has been compiled
+  NativeFunc CountCall(VMAddr func);
+  // count a loop back-edge at the specific pc
+  // returns the native function if it has been compiled
+  NativeFunc CountBackEdge(VMAddr pc);
+  // call the specific native function
+  NativeStatus Call(NativeFunc func, const VMOpr *params,
+                    std::uint32_t count, VMAddr entry, VMOpr &ret) {
+    return static_cast<NativeStatus>(
+        func(&ctx_, params, count, entry, &ret));
+  }
+
+  // getter, context of native functions
+  TierContext &ctx() { return ctx_; }
+
+ private:
+  // count the specific function, compile it if it gets hot
+  NativeFunc Count(VMAddr func);
+  // compile the specific function and its callees
+  // returns 'false' if failed
+  bool Compile(VMAddr func);
+  // collect the specific function and its uncompiled callees
+  // returns 'false' if there are failed functions
+  bool CollectFuncs(VMAddr func, std::unordered_set<VMAddr> &funcs);
+  // compile & load the specific C code, returns 'false' if failed
+  bool LoadCode(const std::string &code);
+
+  // instruction container
+  const VMInstContainer &cont_;
+  // generate Tigger mode code
+  bool tigger_mode_;
+  // context of native functions
+  TierContext ctx_;
+  // native functions, indexed by pc address of Gopher functions
+  std::vector<NativeFunc> funcs_;
+  // function containing each pc address, zero for the entry point
+  std::vector<VMAddr> owners_;
+  // counters of calls & back-edges, indexed by function
+  std::vector<std::uint32_t> counters_;
+  // set if the function can not be compiled, indexed by function
+  std::vector<bool> failed_;
+  // handles of loaded shared objects
+  std::vector<void *> handles_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_TIERED_H_
@@ -0,0 +1,51 @@
+#include "vm/vm.h"
+
+using namespace minivm::vm;
+
+std::optional<VMOpr> VM::Run(TieredCompiler &tier) {
+  auto &ctx = tier.ctx();
+  ctx.vm = this;
+  ctx.gp = global_env_.data();
+  ctx.regs = regs_.data();
+  ctx.get_addr = JitGetAddr;
+  ctx.alloc = JitAlloc;
+  ctx.save_state = TierSaveState;
+  ctx.restore_state = TierRestoreState;
+  ctx.call_ext = TierCallExt;
+  ctx.call_vm = TierCallVM;
+  ctx.error = JitError;
+  // run interpreter, calls and back-edges are counted by the
+  // substituted handlers in the threaded stream
+  tier_ = &tier;
+  auto ret = Run();
+  tier_ = nullptr;
+  return ret;
+}
+
+std::uint32_t VM::TierSaveState(VM *vm) {
+  return vm->mem_pool_->SaveState();
+}
+
+void VM::TierRestoreState(VM *vm, std::uint32_t state) {
+  vm->mem_pool_->RestoreState(state);
+}
+
+int VM::TierCallExt(VM *vm, VMAddr pc, SymId sym, const VMOpr *params,
+                    std::uint32_t count, VMOpr *ret) {
+  vm->pc_ = pc;
+  if (!vm->CallExtFunc(sym, params, count)) {
+    return static_cast<int>(NativeStatus::Error);
+  }
+  auto status = NativeStatus::Ret;
+  if (!vm->oprs_.empty()) {
+    *ret = vm->oprs_.top();
+    status = NativeStatus::RetValue;
+  }
+  vm->oprs_.clear();
+  return static_cast<int>(status);
+}
+
+int VM::TierCallVM(VM *vm, VMAddr pc, VMAddr func, const VMOpr *params,
+                   std::uint32_t count, VMOpr *ret) {
+  return static_cast<int>(vm->CallFromNative(pc, func, params, count, *ret));
+}
@@ -0,0 +1,462 @@
+#include "vm/trace.h"
+
+#include <utility>
+#include <cassert>
+
+using namespace minivm::vm;
+
+namespace {
+
+// count of arrivals that makes a loop hot
+constexpr std::uint32_t kHotThreshold = 1 << 10;
+// maximum length of recorded instruction sequence
+constexpr std::size_t kMaxTraceLength = 1 << 10;
+// maximum count of aborted recordings of a loop header
+constexpr std::uint32_t kMaxAborts = 4;
+
+// offset between opcode of binary operations and the one of
+// binary operations with immediate
+constexpr int kImmOpOffset =
+    static_cast<int>(TraceOp::LAndI) - static_cast<int>(TraceOp::LAnd);
+
+// add offset to the specific opcode
+inline TraceOp OffsetOp(TraceOp op, int offset) {
+  return static_cast<TraceOp>(static_cast<int>(op) + offset);
+}
+
+// check if the specific opcode is a comparison
+inline bool IsCompare(TraceOp op) {
+  return (op >= TraceOp::Eq && op <= TraceOp::Le) ||
+         (op >= TraceOp::EqI && op <= TraceOp::LeI);
+}
+
+// get the negated comparison
+TraceOp NegateCompare(TraceOp op) {
+  switch (op) {
+    case TraceOp::Eq: return TraceOp::Ne;
+    case TraceOp::Ne: return TraceOp::Eq;
+    case TraceOp::Gt: return TraceOp::Le;
+    case TraceOp::Lt: return TraceOp::Ge;
+    case TraceOp::Ge: return TraceOp::Lt;
+    case TraceOp::Le: return TraceOp::Gt;
+    default: assert(false); return op;
+  }
+}
+
+// get the binary operation with swapped operands
+// returns 'false' if the operation can not be swapped
+bool SwapOperands(TraceOp &op) {
+  switch (op) {
+    case TraceOp::Gt: op = TraceOp::Lt; return true;
+    case TraceOp::Lt: op = TraceOp::Gt; return true;
+    case TraceOp::Ge: op = TraceOp::Le; return true;
+    case TraceOp::Le: op = TraceOp::Ge; return true;
+    case TraceOp::LAnd: case TraceOp::LOr: case TraceOp::Eq:
+    case TraceOp::Ne: case TraceOp::Add: case TraceOp::Mul:
+    case TraceOp::And: return true;
+    default: return false;
+  }
+}
+
+// get the guard of the specific comparison
+// both comparisons with and without immediate are accepted
+TraceOp GetGuard(TraceOp cmp) {
+  auto is_imm = cmp >= TraceOp::EqI;
+  if (is_imm) cmp = OffsetOp(cmp, -kImmOpOffset);
+  auto guard = OffsetOp(TraceOp::GuardEq, static_cast<int>(cmp) -
+                                              static_cast<int>(TraceOp::Eq));
+  if (is_imm) {
+    guard = OffsetOp(guard, static_cast<int>(TraceOp::GuardEqI) -
+                                static_cast<int>(TraceOp::GuardEq));
+  }
+  return guard;
+}
+
+// get the trace operation of the specific Gopher binary operation
+TraceOp GetBinaryOp(InstOp op) {
+  static const TraceOp kOps[] = {
+      TraceOp::LAnd, TraceOp::LOr, TraceOp::Eq,  TraceOp::Ne,  TraceOp::Gt,
+      TraceOp::Lt,   TraceOp::Ge,  TraceOp::Le,  TraceOp::Add, TraceOp::Sub,
+      TraceOp::Mul,  TraceOp::Div, TraceOp::Mod,
+  };
+  switch (op) {
+    case InstOp::LAnd: return TraceOp::LAnd;
+    case InstOp::LOr: return TraceOp::LOr;
+    case InstOp::Eq: return TraceOp::Eq;
+    case InstOp::Ne: return TraceOp::Ne;
+    case InstOp::Gt: return TraceOp::Gt;
+    case InstOp::Lt: return TraceOp::Lt;
+    case InstOp::Ge: return TraceOp::Ge;
+    case InstOp::Le: return TraceOp::Le;
+    case InstOp::Add: return TraceOp::Add;
+    case InstOp::Sub: return TraceOp::Sub;
+    case InstOp::Mul: return TraceOp::Mul;
+    case InstOp::Div: return TraceOp::Div;
+    case InstOp::Mod: return TraceOp::Mod;
+    case InstOp::And: return TraceOp::And;
+    case InstOp::Shl: return TraceOp::Shl;
+    case InstOp::Shr: return TraceOp::Shr;
+    default:;
+  }
+  // register instructions
+  if (op >= InstOp::LAndRRR && op <= InstOp::ModRRR) {
+    return kOps[static_cast<int>(op) - static_cast<int>(InstOp::LAndRRR)];
+  }
+  assert(op >= InstOp::LAndRRI && op <= InstOp::ModRRI);
+  return kOps[static_cast<int>(op) - static_cast<int>(InstOp::LAndRRI)];
+}
+
+// get the comparison of the specific register branch
+TraceOp GetBranchCompare(InstOp op) {
+  switch (op) {
+    case InstOp::BeqRR: return TraceOp::Eq;
+    case InstOp::BneRR: return TraceOp::Ne;
+    case InstOp::BltRR: return TraceOp::Lt;
+    case InstOp::BleRR: return TraceOp::Le;
+    case InstOp::BgtRR: return TraceOp::Gt;
+    case InstOp::BgeRR: return TraceOp::Ge;
+    default: assert(false); return TraceOp::Eq;
+  }
+}
+
+}  // namespace
+
+TraceCompiler::TraceCompiler(const VMInstContainer &cont)
+    : cont_(cont), headers_(cont.inst_count(), false),
+      counters_(cont.inst_count(), 0), aborts_(cont.inst_count(), 0),
+      traces_(cont.inst_count()), recording_(false) {
+  // targets of backward branches are loop headers, except the entry
+  for (VMAddr pc = 1; pc < cont_.inst_count(); ++pc) {
+    auto inst = cont_.GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    if ((op == InstOp::Bnz || op == InstOp::Jmp) && inst.opr <= pc) {
+      headers_[inst.opr] = true;
+    }
+  }
+}
+
+Trace *TraceCompiler::CountHeader(VMAddr pc) {
+  if (traces_[pc]) return traces_[pc].get();
+  // loop headers are removed after too many aborted recordings
+  if (!headers_[pc]) return nullptr;
+  if (++counters_[pc] >= kHotThreshold) {
+    recording_ = true;
+    header_ = pc;
+    pcs_.clear();
+  }
+  return nullptr;
+}
+
+TraceCompiler::RecordStatus TraceCompiler::Record(VMAddr pc) {
+  // back to the loop header, finish recording
+  if (!pcs_.empty() && pc == header_) {
+    return Stop(Compile() ? RecordStatus::Finished : RecordStatus::Aborted);
+  }
+  // function calls and returns leave the loop, stop recording
+  switch (static_cast<InstOp>(cont_.GetOrigInst(pc).op)) {
+    case InstOp::Var: case InstOp::Arr: case InstOp::LdVar:
+    case InstOp::StVar: case InstOp::StVarP: case InstOp::ArrSlot:
+    case InstOp::ArrGlobal: case InstOp::Call: case InstOp::CallExt:
+    case InstOp::Ret: case InstOp::Enter: case InstOp::Break:
+    case InstOp::Error: {
+      return Stop(RecordStatus::Aborted);
+    }
+    default:;
+  }
+  if (pcs_.size() >= kMaxTraceLength) return Stop(RecordStatus::Aborted);
+  pcs_.push_back(pc);
+  return RecordStatus::Continue;
+}
+
+TraceCompiler::RecordStatus TraceCompiler::Stop(RecordStatus status) {
+  recording_ = false;
+  pcs_.clear();
+  if (status == RecordStatus::Aborted) {
+    // record again when the loop gets hot again
+    counters_[header_] = 0;
+    if (++aborts_[header_] >= kMaxAborts) headers_[header_] = false;
+  }
+  return status;
+}
+
+bool TraceCompiler::Compile() {
+  trace_ = std::make_unique<Trace>();
+  stack_.clear();
+  temps_.clear();
+  last_temp_ = false;
+  // compile all recorded instructions, the operand stack
+  // must be empty at the start and the end of the trace
+  for (std::size_t i = 0; i < pcs_.size(); ++i) {
+    auto next = i + 1 < pcs_.size() ? pcs_[i + 1] : header_;
+    if (!CompileInst(pcs_[i], cont_.GetOrigInst(pcs_[i]), next)) {
+      return false;
+    }
+  }
+  if (!stack_.empty()) return false;
+  Emit(TraceOp::Loop, 0, 0, 0);
+  traces_[header_] = std::move(trace_);
+  return true;
+}
+
+bool TraceCompiler::CompileInst(VMAddr pc, const VMUnpackedInst &inst,
+                                VMAddr next) {
+  using Kind = TraceLoc::Kind;
+  TraceValue val, addr;
+  auto op = static_cast<InstOp>(inst.op);
+  switch (op) {
+    case InstOp::VarSlot: {
+      Store(Loc(Kind::Slot, inst.opr), {true, static_cast<VMOpr>(0xdeadc0de)});
+      break;
+    }
+    case InstOp::VarGlobal: {
+      Store(Loc(Kind::Global, inst.opr), {true, 0});
+      break;
+    }
+    case InstOp::Ld: {
+      if (!Pop(addr)) return false;
+      auto depth = stack_.size();
+      auto ptr = ToVal(addr, depth);
+      Emit(TraceOp::Ld, Temp(depth), ptr, pc);
+      stack_.push_back({false, Temp(depth)});
+      last_temp_ = true;
+      break;
+    }
+    case InstOp::St: {
+      if (!Pop(addr) || !Pop(val)) return false;
+      auto depth = stack_.size();
+      auto value = ToVal(val, depth);
+      Emit(TraceOp::St, pc, value, ToVal(addr, depth + 1));
+      break;
+    }
+    case InstOp::LdSlot: case InstOp::LdGlobal: case InstOp::LdReg: {
+      auto kind = op == InstOp::LdSlot     ? Kind::Slot
+                  : op == InstOp::LdGlobal ? Kind::Global
+                                           : Kind::Reg;
+      stack_.push_back({false, Loc(kind, inst.opr)});
+      break;
+    }
+    case InstOp::StSlot: case InstOp::StGlobal: case InstOp::StReg: {
+      auto kind = op == InstOp::StSlot     ? Kind::Slot
+                  : op == InstOp::StGlobal ? Kind::Global
+                                           : Kind::Reg;
+      if (!Pop(val)) return false;
+      Store(Loc(kind, inst.opr), val);
+      break;
+    }
+    case InstOp::StSlotP: case InstOp::StGlobalP: case InstOp::StRegP: {
+      auto kind = op == InstOp::StSlotP     ? Kind::Slot
+                  : op == InstOp::StGlobalP ? Kind::Global
+                                            : Kind::Reg;
+      if (stack_.empty()) return false;
+      val = stack_.back();
+      auto loc = Loc(kind, inst.opr);
+      Store(loc, val);
+      // the top of stack may be retargeted, refer to the location
+      if (!val.is_imm) stack_.back() = {false, loc};
+      break;
+    }
+    case InstOp::Imm: {
+      stack_.push_back({true, ExtendImm(inst.opr)});
+      break;
+    }
+    case InstOp::ImmHi: {
+      if (stack_.empty() || !stack_.back().is_imm) return false;
+      constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
+      constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
+      auto &top = stack_.back();
+      top.val &= kMaskLo;
+      top.val |= (inst.opr & kMaskHi) << kVMInstImmLen;
+      break;
+    }
+    case InstOp::Bnz: {
+      if (!Pop(val)) return false;
+      // branch to the next instruction, no guard needed
+      if (inst.opr == pc + 1) break;
+      auto taken = next == inst.opr;
+      if (!taken && next != pc + 1) return false;
+      return Guard(val, taken, taken ? pc + 1 : inst.opr);
+    }
+    case InstOp::Jmp: {
+      if (next != inst.opr) return false;
+      break;
+    }
+    case InstOp::LNot: return Unary(TraceOp::LNot);
+    case InstOp::Neg: return Unary(TraceOp::Neg);
+    case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+    case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+    case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::Div:
+    case InstOp::Mod: case InstOp::And: case InstOp::Shl: case InstOp::Shr: {
+      return Binary(GetBinaryOp(op));
+    }
+    case InstOp::Pop: {
+      if (!Pop(val)) return false;
+      break;
+    }
+    case InstOp::Clear: {
+      stack_.clear();
+      break;
+    }
+    case InstOp::MovRR: {
+      Store(Loc(Kind::Reg, GetRegOpr(inst.opr, 0)),
+            {false, Loc(Kind::Reg, GetRegOpr(inst.opr, 1))});
+      break;
+    }
+    case InstOp::MovRI: {
+      Store(Loc(Kind::Reg, GetRegOpr(inst.opr, 0)),
+            {true, GetRegImm(inst.opr, 1)});
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      // target is stored in the following 'Jmp'
+      auto target = cont_.GetOrigInst(pc + 1).opr;
+      if (target == pc + 2) break;
+      auto taken = next == target;
+      if (!taken && next != pc + 2) return false;
+      auto cmp = GetBranchCompare(op);
+      if (!taken) cmp = NegateCompare(cmp);
+      auto exit = AddExit(taken ? pc + 2 : target);
+      Emit(GetGuard(cmp), exit, Loc(Kind::Reg, GetRegOpr(inst.opr, 0)),
+           Loc(Kind::Reg, GetRegOpr(inst.opr, 1)));
+      break;
+    }
+    default: {
+      if (op >= InstOp::LAndRRR && op <= InstOp::ModRRI) {
+        // register & register or register & immediate
+        auto dst = Loc(Kind::Reg, GetRegOpr(inst.opr, 0));
+        auto lhs = Loc(Kind::Reg, GetRegOpr(inst.opr, 1));
+        Invalidate(dst);
+        if (op <= InstOp::ModRRR) {
+          Emit(GetBinaryOp(op), dst, lhs,
+               Loc(Kind::Reg, GetRegOpr(inst.opr, 2)));
+        }
+        else {
+          Emit(OffsetOp(GetBinaryOp(op), kImmOpOffset), dst, lhs,
+               GetRegImm(inst.opr, 2));
+        }
+        break;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+void TraceCompiler::Emit(TraceOp op, VMOpr dst, VMOpr lhs, VMOpr rhs) {
+  trace_->insts.push_back({op, dst, lhs, rhs});
+  last_temp_ = false;
+}
+
+VMOpr TraceCompiler::AddExit(VMAddr pc) {
+  trace_->exits.push_back({pc, stack_});
+  return trace_->exits.size() - 1;
+}
+
+VMOpr TraceCompiler::Loc(TraceLoc::Kind kind, std::uint32_t index) {
+  for (const auto &loc : trace_->locs) {
+    if (loc.kind == kind && loc.index == index) return loc.val;
+  }
+  VMOpr val = trace_->vals.size();
+  trace_->vals.push_back(0);
+  trace_->locs.push_back({kind, index, val});
+  return val;
+}
+
+VMOpr TraceCompiler::Temp(std::size_t depth) {
+  while (temps_.size() <= depth) {
+    temps_.push_back(trace_->vals.size());
+    trace_->vals.push_back(0);
+  }
+  return temps_[depth];
+}
+
+bool TraceCompiler::Pop(TraceValue &val) {
+  if (stack_.empty()) return false;
+  val = stack_.back();
+  stack_.pop_back();
+  return true;
+}
+
+VMOpr TraceCompiler::ToVal(const TraceValue &val, std::size_t depth) {
+  if (!val.is_imm) return val.val;
+  auto temp = Temp(depth);
+  Emit(TraceOp::Li, temp, 0, val.val);
+  return temp;
+}
+
+void TraceCompiler::Invalidate(VMOpr val) {
+  for (std::size_t i = 0; i < stack_.size(); ++i) {
+    auto &v = stack_[i];
+    if (!v.is_imm && v.val == val && val != Temp(i)) {
+      Emit(TraceOp::Mov, Temp(i), val, 0);
+      v.val = Temp(i);
+    }
+  }
+}
+
+void TraceCompiler::Store(VMOpr dst, const TraceValue &val) {
+  Invalidate(dst);
+  if (val.is_imm) {
+    Emit(TraceOp::Li, dst, 0, val.val);
+  }
+  else if (last_temp_ && trace_->insts.back().dst == val.val) {
+    // write the result of the last instruction to 'dst' directly
+    trace_->insts.back().dst = dst;
+    last_temp_ = false;
+  }
+  else if (val.val != dst) {
+    Emit(TraceOp::Mov, dst, val.val, 0);
+  }
+}
+
+bool TraceCompiler::Unary(TraceOp op) {
+  TraceValue val;
+  if (!Pop(val)) return false;
+  auto depth = stack_.size();
+  auto src = ToVal(val, depth);
+  Emit(op, Temp(depth), src, 0);
+  stack_.push_back({false, Temp(depth)});
+  last_temp_ = true;
+  return true;
+}
+
+bool TraceCompiler::Binary(TraceOp op) {
+  TraceValue lhs, rhs;
+  if (!Pop(rhs) || !Pop(lhs)) return false;
+  auto depth = stack_.size();
+  // move the immediate to the right hand side if possible
+  if (lhs.is_imm && !rhs.is_imm && SwapOperands(op)) std::swap(lhs, rhs);
+  auto l = ToVal(lhs, depth);
+  if (rhs.is_imm) {
+    Emit(OffsetOp(op, kImmOpOffset), Temp(depth), l, rhs.val);
+  }
+  else {
+    Emit(op, Temp(depth), l, rhs.val);
+  }
+  stack_.push_back({false, Temp(depth)});
+  last_temp_ = true;
+  return true;
+}
+
+bool TraceCompiler::Guard(const TraceValue &cond, bool taken,
+                          VMAddr exit) {
+  // constant condition, the recorded path must be the only path
+  if (cond.is_imm) return !cond.val != taken;
+  auto id = AddExit(exit);
+  if (last_temp_ && trace_->insts.back().dst == cond.val &&
+      IsCompare(trace_->insts.back().op)) {
+    // fuse the comparison with the guard
+    auto &last = trace_->insts.back();
+    auto is_imm = last.op >= TraceOp::EqI;
+    auto cmp = is_imm ? OffsetOp(last.op, -kImmOpOffset) : last.op;
+    if (!taken) cmp = NegateCompare(cmp);
+    if (is_imm) cmp = OffsetOp(cmp, kImmOpOffset);
+    last.op = GetGuard(cmp);
+    last.dst = id;
+    last_temp_ = false;
+  }
+  else {
+    Emit(taken ? TraceOp::GuardNz : TraceOp::GuardZ, id, cond.val, 0);
+  }
+  return true;
+}
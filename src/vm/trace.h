@@ -0,0 +1,172 @@
+#ifndef MINIVM_VM_TRACE_H_
+#define MINIVM_VM_TRACE_H_
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+
+// all instructions of compiled traces
+// for more details, see `src/vm/README.md`
+#define VM_TRACE_INSTS(e)                                          \
+  /* move & load immediate */                                      \
+  e(Mov) e(Li)                                                     \
+  /* load & store */                                               \
+  e(Ld) e(St)                                                      \
+  /* guards, exit trace if the condition is not satisfied */       \
+  e(GuardZ) e(GuardNz)                                             \
+  e(GuardEq) e(GuardNe) e(GuardGt) e(GuardLt) e(GuardGe) e(GuardLe) \
+  e(GuardEqI) e(GuardNeI) e(GuardGtI) e(GuardLtI) e(GuardGeI)      \
+  e(GuardLeI)                                                      \
+  /* jump back to the start of trace */                            \
+  e(Loop)                                                          \
+  /* unary operations */                                           \
+  e(LNot) e(Neg)                                                   \
+  /* binary operations, value & value */                           \
+  e(LAnd) e(LOr) e(Eq) e(Ne) e(Gt) e(Lt) e(Ge) e(Le)               \
+  e(Add) e(Sub) e(Mul) e(Div) e(Mod) e(And) e(Shl) e(Shr)          \
+  /* binary operations, value & immediate */                       \
+  e(LAndI) e(LOrI) e(EqI) e(NeI) e(GtI) e(LtI) e(GeI) e(LeI)       \
+  e(AddI) e(SubI) e(MulI) e(DivI) e(ModI) e(AndI) e(ShlI) e(ShrI)
+
+namespace minivm::vm {
+
+// opcode of trace instructions
+enum class TraceOp { VM_TRACE_INSTS(VM_EXPAND_LIST) };
+
+// trace instruction, in three-address form
+// operands are indices of trace values, immediates, indices of
+// exits (guards) or pc addresses (memory accesses), depending on
+// the opcode
+struct TraceInst {
+  TraceOp op;
+  VMOpr dst, lhs, rhs;
+};
+
+// value on the operand stack during trace compilation
+struct TraceValue {
+  // 'true' if value is an immediate, otherwise a trace value
+  bool is_imm;
+  VMOpr val;
+};
+
+// location of frame slots, global segment slots or static registers,
+// which are loaded to trace values when entering the trace, and are
+// written back when exiting
+struct TraceLoc {
+  enum class Kind { Slot, Global, Reg } kind;
+  std::uint32_t index;
+  // index of the related trace value
+  VMOpr val;
+};
+
+// side exit of trace
+struct TraceExit {
+  // pc address that the interpreter continues at
+  VMAddr pc;
+  // values that should be pushed to the operand stack
+  std::vector<TraceValue> stack;
+};
+
+// compiled trace, a linear instruction sequence of a loop iteration
+// the operand stack must be empty when entering the trace
+struct Trace {
+  std::vector<TraceInst> insts;
+  std::vector<TraceLoc> locs;
+  std::vector<TraceExit> exits;
+  // buffer of trace values
+  std::vector<VMOpr> vals;
+};
+
+// compiler of trace-based execution
+// counts arrivals at loop headers (targets of backward branches),
+// records the instruction sequence of an iteration of hot loops,
+// and compiles the sequence to a trace
+class TraceCompiler {
+ public:
+  // status of recording
+  enum class RecordStatus { Continue, Finished, Aborted };
+
+  TraceCompiler(const VMInstContainer &cont);
+
+  // check if the specific pc address is a loop header
+  bool IsHeader(VMAddr pc) const { return headers_[pc]; }
+  // count an arrival at the specific loop header with empty operand
+  // stack, start recording if the loop gets hot
+  // returns the compiled trace of the loop, or 'nullptr'
+  Trace *CountHeader(VMAddr pc);
+  // record the specific instruction, which is going to be executed,
+  // compile the trace if the recording is finished
+  RecordStatus Record(VMAddr pc);
+
+  // getter, check if is recording
+  bool recording() const { return recording_; }
+
+ private:
+  // stop recording, returns the specific status
+  RecordStatus Stop(RecordStatus status);
+  // compile the recorded instruction sequence
+  // returns 'false' if failed
+  bool Compile();
+  // compile the specific Gopher instruction, 'next' is the pc address
+  // of the next recorded instruction
+  // returns 'false' if failed
+  bool CompileInst(VMAddr pc, const VMUnpackedInst &inst, VMAddr next);
+
+  // emit a new instruction
+  void Emit(TraceOp op, VMOpr dst, VMOpr lhs, VMOpr rhs);
+  // add a new side exit at the specific pc address, returns its index
+  VMOpr AddExit(VMAddr pc);
+  // get trace value of the specific location
+  VMOpr Loc(TraceLoc::Kind kind, std::uint32_t index);
+  // get trace value of temporary at the specific stack depth
+  VMOpr Temp(std::size_t depth);
+  // pop a value from stack, returns 'false' if stack is empty
+  bool Pop(TraceValue &val);
+  // move value to a trace value if it's an immediate
+  // the temporary at the specific depth will be used
+  VMOpr ToVal(const TraceValue &val, std::size_t depth);
+  // move values that refer to the specific trace value to temporaries,
+  // should be called before the trace value is modified
+  void Invalidate(VMOpr val);
+  // store value to the specific trace value
+  void Store(VMOpr dst, const TraceValue &val);
+  // compile unary/binary operation
+  // returns 'false' if failed
+  bool Unary(TraceOp op);
+  bool Binary(TraceOp op);
+  // compile guard, 'cond' is the popped value
+  // returns 'false' if failed
+  bool Guard(const TraceValue &cond, bool taken, VMAddr exit);
+
+  // instruction container
+  const VMInstContainer &cont_;
+  // loop headers
+  std::vector<bool> headers_;
+  // counters of arrivals, and counts of aborted recordings
+  std::vector<std::uint32_t> counters_, aborts_;
+  // compiled traces, indexed by pc address of loop headers
+  std::vector<std::unique_ptr<Trace>> traces_;
+  // set if is recording
+  bool recording_;
+  // loop header of the current recording
+  VMAddr header_;
+  // recorded pc addresses
+  std::vector<VMAddr> pcs_;
+  // trace being compiled
+  std::unique_ptr<Trace> trace_;
+  // operand stack during compilation
+  std::vector<TraceValue> stack_;
+  // trace values of temporaries
+  std::vector<VMOpr> temps_;
+  // set if the last instruction writes a temporary that can be
+  // retargeted to another trace value
+  bool last_temp_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_TRACE_H_
@@ -0,0 +1,385 @@
+#include "vm/vm.h"
+
+using namespace minivm::vm;
+
+std::optional<VMOpr> VM::Run(TraceCompiler &trace) {
+  // run interpreter, loop headers are counted and traces are recorded
+  // by the substituted handlers in the threaded stream
+  trace_ = &trace;
+  auto ret = Run();
+  trace_ = nullptr;
+  return ret;
+}
+
+bool VM::RunTrace(Trace &trace, VMAddr &exit) {
+#define VM_NEXT(ofs)                                       \
+  do {                                                     \
+    inst += ofs;                                           \
+    goto *kInstLabels[static_cast<std::size_t>(inst->op)]; \
+  } while (0)
+#define VM_EXIT(id)   \
+  do {                \
+    exit_id = (id);   \
+    goto trace_exit;  \
+  } while (0)
+#define VM_UNARY(op)                        \
+  do {                                      \
+    vals[inst->dst] = op vals[inst->lhs];   \
+    VM_NEXT(1);                             \
+  } while (0)
+#define VM_BINARY(op)                                       \
+  do {                                                      \
+    vals[inst->dst] = vals[inst->lhs] op vals[inst->rhs];   \
+    VM_NEXT(1);                                             \
+  } while (0)
+#define VM_BINARY_I(op)                             \
+  do {                                              \
+    vals[inst->dst] = vals[inst->lhs] op inst->rhs; \
+    VM_NEXT(1);                                     \
+  } while (0)
+#define VM_GUARD(op)                                              \
+  do {                                                            \
+    if (!(vals[inst->lhs] op vals[inst->rhs])) VM_EXIT(inst->dst); \
+    VM_NEXT(1);                                                   \
+  } while (0)
+#define VM_GUARD_I(op)                                        \
+  do {                                                        \
+    if (!(vals[inst->lhs] op inst->rhs)) VM_EXIT(inst->dst);  \
+    VM_NEXT(1);                                               \
+  } while (0)
+
+  const void *kInstLabels[] = {VM_TRACE_INSTS(VM_EXPAND_LABEL_LIST)};
+  const TraceInst *insts = trace.insts.data(), *inst = insts;
+  VMOpr *vals = trace.vals.data(), *fp = frames_.fp();
+  VMOpr *gp = global_env_.data(), *regs = regs_.data();
+  std::uint32_t exit_id = 0;
+  bool success = true;
+  // get address of the specific location
+  auto loc_addr = [fp, gp, regs](const TraceLoc &loc) {
+    switch (loc.kind) {
+      case TraceLoc::Kind::Slot: return fp + loc.index;
+      case TraceLoc::Kind::Global: return gp + loc.index;
+      default: return regs + loc.index;
+    }
+  };
+  // load all locations
+  for (const auto &loc : trace.locs) vals[loc.val] = *loc_addr(loc);
+  VM_NEXT(0);
+
+  // move value
+  VM_LABEL(Mov) {
+    vals[inst->dst] = vals[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // load immediate
+  VM_LABEL(Li) {
+    vals[inst->dst] = inst->rhs;
+    VM_NEXT(1);
+  }
+
+  // load value from address
+  VM_LABEL(Ld) {
+    auto ptr = mem_pool_->GetAddress(vals[inst->lhs]);
+    if (!ptr) {
+      pc_ = inst->rhs;
+      success = false;
+      goto trace_exit;
+    }
+    vals[inst->dst] = *reinterpret_cast<VMOpr *>(ptr);
+    VM_NEXT(1);
+  }
+
+  // store value to address
+  VM_LABEL(St) {
+    auto ptr = mem_pool_->GetAddress(vals[inst->rhs]);
+    if (!ptr) {
+      pc_ = inst->dst;
+      success = false;
+      goto trace_exit;
+    }
+    *reinterpret_cast<VMOpr *>(ptr) = vals[inst->lhs];
+    VM_NEXT(1);
+  }
+
+  // exit if not zero
+  VM_LABEL(GuardZ) {
+    if (vals[inst->lhs]) VM_EXIT(inst->dst);
+    VM_NEXT(1);
+  }
+
+  // exit if zero
+  VM_LABEL(GuardNz) {
+    if (!vals[inst->lhs]) VM_EXIT(inst->dst);
+    VM_NEXT(1);
+  }
+
+  // exit if not equal
+  VM_LABEL(GuardEq) {
+    VM_GUARD(==);
+  }
+
+  // exit if equal
+  VM_LABEL(GuardNe) {
+    VM_GUARD(!=);
+  }
+
+  // exit if less than or equal
+  VM_LABEL(GuardGt) {
+    VM_GUARD(>);
+  }
+
+  // exit if greater than or equal
+  VM_LABEL(GuardLt) {
+    VM_GUARD(<);
+  }
+
+  // exit if less than
+  VM_LABEL(GuardGe) {
+    VM_GUARD(>=);
+  }
+
+  // exit if greater than
+  VM_LABEL(GuardLe) {
+    VM_GUARD(<=);
+  }
+
+  // exit if not equal (immediate)
+  VM_LABEL(GuardEqI) {
+    VM_GUARD_I(==);
+  }
+
+  // exit if equal (immediate)
+  VM_LABEL(GuardNeI) {
+    VM_GUARD_I(!=);
+  }
+
+  // exit if less than or equal (immediate)
+  VM_LABEL(GuardGtI) {
+    VM_GUARD_I(>);
+  }
+
+  // exit if greater than or equal (immediate)
+  VM_LABEL(GuardLtI) {
+    VM_GUARD_I(<);
+  }
+
+  // exit if less than (immediate)
+  VM_LABEL(GuardGeI) {
+    VM_GUARD_I(>=);
+  }
+
+  // exit if greater than (immediate)
+  VM_LABEL(GuardLeI) {
+    VM_GUARD_I(<=);
+  }
+
+  // jump back to the start of trace
+  VM_LABEL(Loop) {
+    inst = insts;
+    VM_NEXT(0);
+  }
+
+  // logical negation
+  VM_LABEL(LNot) {
+    VM_UNARY(!);
+  }
+
+  // negation
+  VM_LABEL(Neg) {
+    VM_UNARY(-);
+  }
+
+  // logical AND
+  VM_LABEL(LAnd) {
+    VM_BINARY(&&);
+  }
+
+  // logical OR
+  VM_LABEL(LOr) {
+    VM_BINARY(||);
+  }
+
+  // set if equal
+  VM_LABEL(Eq) {
+    VM_BINARY(==);
+  }
+
+  // set if not equal
+  VM_LABEL(Ne) {
+    VM_BINARY(!=);
+  }
+
+  // set if greater than
+  VM_LABEL(Gt) {
+    VM_BINARY(>);
+  }
+
+  // set if less than
+  VM_LABEL(Lt) {
+    VM_BINARY(<);
+  }
+
+  // set if greater than or equal
+  VM_LABEL(Ge) {
+    VM_BINARY(>=);
+  }
+
+  // set if less than or equal
+  VM_LABEL(Le) {
+    VM_BINARY(<=);
+  }
+
+  // addition
+  VM_LABEL(Add) {
+    VM_BINARY(+);
+  }
+
+  // subtraction
+  VM_LABEL(Sub) {
+    VM_BINARY(-);
+  }
+
+  // multiplication
+  VM_LABEL(Mul) {
+    VM_BINARY(*);
+  }
+
+  // division
+  VM_LABEL(Div) {
+    VM_BINARY(/);
+  }
+
+  // modulo operation
+  VM_LABEL(Mod) {
+    VM_BINARY(%);
+  }
+
+  // bitwise AND
+  VM_LABEL(And) {
+    VM_BINARY(&);
+  }
+
+  // shift left
+  VM_LABEL(Shl) {
+    vals[inst->dst] = static_cast<std::uint32_t>(vals[inst->lhs])
+                      << (vals[inst->rhs] & 31);
+    VM_NEXT(1);
+  }
+
+  // arithmetic shift right
+  VM_LABEL(Shr) {
+    vals[inst->dst] = vals[inst->lhs] >> (vals[inst->rhs] & 31);
+    VM_NEXT(1);
+  }
+
+  // logical AND (immediate)
+  VM_LABEL(LAndI) {
+    VM_BINARY_I(&&);
+  }
+
+  // logical OR (immediate)
+  VM_LABEL(LOrI) {
+    VM_BINARY_I(||);
+  }
+
+  // set if equal (immediate)
+  VM_LABEL(EqI) {
+    VM_BINARY_I(==);
+  }
+
+  // set if not equal (immediate)
+  VM_LABEL(NeI) {
+    VM_BINARY_I(!=);
+  }
+
+  // set if greater than (immediate)
+  VM_LABEL(GtI) {
+    VM_BINARY_I(>);
+  }
+
+  // set if less than (immediate)
+  VM_LABEL(LtI) {
+    VM_BINARY_I(<);
+  }
+
+  // set if greater than or equal (immediate)
+  VM_LABEL(GeI) {
+    VM_BINARY_I(>=);
+  }
+
+  // set if less than or equal (immediate)
+  VM_LABEL(LeI) {
+    VM_BINARY_I(<=);
+  }
+
+  // addition (immediate)
+  VM_LABEL(AddI) {
+    VM_BINARY_I(+);
+  }
+
+  // subtraction (immediate)
+  VM_LABEL(SubI) {
+    VM_BINARY_I(-);
+  }
+
+  // multiplication (immediate)
+  VM_LABEL(MulI) {
+    VM_BINARY_I(*);
+  }
+
+  // division (immediate)
+  VM_LABEL(DivI) {
+    VM_BINARY_I(/);
+  }
+
+  // modulo operation (immediate)
+  VM_LABEL(ModI) {
+    VM_BINARY_I(%);
+  }
+
+  // bitwise AND (immediate)
+  VM_LABEL(AndI) {
+    VM_BINARY_I(&);
+  }
+
+  // shift left (immediate)
+  VM_LABEL(ShlI) {
+    vals[inst->dst] = static_cast<std::uint32_t>(vals[inst->lhs])
+                      << (inst->rhs & 31);
+    VM_NEXT(1);
+  }
+
+  // arithmetic shift right (immediate)
+  VM_LABEL(ShrI) {
+    vals[inst->dst] = vals[inst->lhs] >> (inst->rhs & 31);
+    VM_NEXT(1);
+  }
+
+trace_exit:
+  // write back all locations
+  for (const auto &loc : trace.locs) *loc_addr(loc) = vals[loc.val];
+  if (!success) {
+    LogError(kVMErrorInvalidMemPoolAddr);
+    return false;
+  }
+  // push values on the stack of exit
+  const auto &side_exit = trace.exits[exit_id];
+  for (const auto &val : side_exit.stack) {
+    oprs_.push(val.is_imm ? val.val : vals[val.val]);
+  }
+  if (oprs_.overflowed()) {
+    LogError(kVMErrorOprStackOverflow);
+    return false;
+  }
+  exit = side_exit.pc;
+  return true;
+
+#undef VM_GUARD_I
+#undef VM_GUARD
+#undef VM_BINARY_I
+#undef VM_BINARY
+#undef VM_UNARY
+#undef VM_EXIT
+#undef VM_NEXT
+}
@@ -0,0 +1,360 @@
+#include "vm/verifier.h"
+
+#include <iostream>
+#include <algorithm>
+
+#include "xstl/style.h"
+
+using namespace minivm::vm;
+
+Verifier::Verifier(const VMInstContainer &cont, std::uint32_t reg_count,
+                   ExtFuncChecker ext_func_checker)
+    : cont_(cont), reg_count_(reg_count),
+      ext_func_checker_(ext_func_checker), has_error_(false),
+      owners_(cont.inst_count(), 0), max_depth_(0) {
+  // find function of each instruction
+  auto entry_pc = cont_.FindPC(kVMEntry);
+  auto func_pcs = cont_.func_pcs();
+  VMAddr cur_func = 0;
+  for (VMAddr pc = 1; pc < cont_.inst_count(); ++pc) {
+    if (entry_pc && pc == *entry_pc) {
+      cur_func = 0;
+    }
+    else if (func_pcs.count(pc)) {
+      cur_func = pc;
+    }
+    owners_[pc] = cur_func;
+  }
+  // get slot counts of all functions, the entry point has no slots
+  slot_counts_.insert({0, 0});
+  for (const auto &pc : func_pcs) {
+    auto slots = cont_.FindSlotTable(pc);
+    slot_counts_.insert({pc, slots ? slots->size() : 0});
+  }
+}
+
+void Verifier::LogError(std::string_view message, VMAddr pc) {
+  LogError(message, {}, pc);
+}
+
+void Verifier::LogError(std::string_view message, std::string_view sym,
+                        VMAddr pc) {
+  using namespace xstl;
+  std::cerr << style("Br") << "error ";
+  // try to get line number
+  if (auto line_num = cont_.FindLineNum(pc)) {
+    std::cerr << style("B") << "(line " << *line_num;
+  }
+  else {
+    std::cerr << style("B") << "(pc " << pc;
+  }
+  if (!sym.empty()) std::cerr << ", sym \"" << sym << '"';
+  // print error message
+  std::cerr << "): " << message << std::endl;
+  has_error_ = true;
+}
+
+bool Verifier::Verify() {
+  // check operands first, since the computation of stack depths
+  // relies on valid branch targets
+  for (VMAddr pc = 0; pc < cont_.inst_count(); ++pc) CheckOperands(pc);
+  if (has_error_) return false;
+  // stack depths after function calls depend on return depths of
+  // callees, iterate until all return depths are known
+  while (ComputeDepths(false)) {}
+  ComputeDepths(true);
+  return !has_error_;
+}
+
+void Verifier::CheckOperands(VMAddr pc) {
+  auto inst = cont_.GetOrigInst(pc);
+  auto func = owners_[pc];
+  // check if the first 'n' register ids are valid
+  auto check_regs = [this, &inst, pc](std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      if (GetRegOpr(inst.opr, i) >= reg_count_) {
+        return LogError("invalid register number", pc);
+      }
+    }
+  };
+  switch (static_cast<InstOp>(inst.op)) {
+    case InstOp::Var: case InstOp::Arr: case InstOp::LdVar:
+    case InstOp::StVar: case InstOp::StVarP: {
+      LogError("unresolved symbol reference", pc);
+      break;
+    }
+    case InstOp::VarSlot: case InstOp::ArrSlot: case InstOp::LdSlot:
+    case InstOp::StSlot: case InstOp::StSlotP: {
+      if (inst.opr >= slot_counts_[func]) {
+        LogError("invalid frame slot", pc);
+      }
+      break;
+    }
+    case InstOp::VarGlobal: case InstOp::ArrGlobal: case InstOp::LdGlobal:
+    case InstOp::StGlobal: case InstOp::StGlobalP: {
+      if (inst.opr >= cont_.global_slots().size()) {
+        LogError("invalid global slot", pc);
+      }
+      break;
+    }
+    case InstOp::LdReg: case InstOp::StReg: case InstOp::StRegP: {
+      if (inst.opr >= reg_count_) LogError("invalid register number", pc);
+      break;
+    }
+    case InstOp::Bnz: case InstOp::Jmp: {
+      CheckTarget(pc, func, inst.opr);
+      break;
+    }
+    case InstOp::Call: {
+      if (!cont_.func_pcs().count(inst.opr)) {
+        LogError("invalid function address", pc);
+      }
+      break;
+    }
+    case InstOp::CallExt: {
+      auto sym = cont_.sym_pool().FindSymbol(inst.opr);
+      if (!sym) {
+        LogError("invalid external function", pc);
+      }
+      else if (!ext_func_checker_(inst.opr).has_value()) {
+        LogError("using undefined external function", *sym, pc);
+      }
+      break;
+    }
+    case InstOp::Ld: case InstOp::St: case InstOp::Imm: case InstOp::ImmHi:
+    case InstOp::Ret: case InstOp::Enter: case InstOp::Error:
+    case InstOp::LNot: case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq:
+    case InstOp::Ne: case InstOp::Gt: case InstOp::Lt: case InstOp::Ge:
+    case InstOp::Le: case InstOp::Neg: case InstOp::Add: case InstOp::Sub:
+    case InstOp::Mul: case InstOp::Div: case InstOp::Mod: case InstOp::And:
+    case InstOp::Shl: case InstOp::Shr: case InstOp::Pop: case InstOp::Clear: {
+      break;
+    }
+    case InstOp::MovRR: {
+      check_regs(2);
+      break;
+    }
+    case InstOp::MovRI: {
+      check_regs(1);
+      break;
+    }
+    case InstOp::LAndRRR: case InstOp::LOrRRR: case InstOp::EqRRR:
+    case InstOp::NeRRR: case InstOp::GtRRR: case InstOp::LtRRR:
+    case InstOp::GeRRR: case InstOp::LeRRR: case InstOp::AddRRR:
+    case InstOp::SubRRR: case InstOp::MulRRR: case InstOp::DivRRR:
+    case InstOp::ModRRR: {
+      check_regs(3);
+      break;
+    }
+    case InstOp::LAndRRI: case InstOp::LOrRRI: case InstOp::EqRRI:
+    case InstOp::NeRRI: case InstOp::GtRRI: case InstOp::LtRRI:
+    case InstOp::GeRRI: case InstOp::LeRRI: case InstOp::AddRRI:
+    case InstOp::SubRRI: case InstOp::MulRRI: case InstOp::DivRRI:
+    case InstOp::ModRRI: {
+      check_regs(2);
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      check_regs(2);
+      // target is stored in the following 'Jmp'
+      if (pc + 1 >= cont_.inst_count() ||
+          static_cast<InstOp>(cont_.GetOrigInst(pc + 1).op) !=
+              InstOp::Jmp) {
+        LogError("branch target not found", pc);
+      }
+      break;
+    }
+    default: {
+      // breakpoints and superinstructions never appear
+      // in the original instructions
+      LogError("invalid instruction", pc);
+      break;
+    }
+  }
+}
+
+void Verifier::CheckTarget(VMAddr pc, VMAddr func, VMAddr target) {
+  if (target >= cont_.inst_count() || owners_[target] != func) {
+    LogError("invalid branch target", pc);
+  }
+}
+
+bool Verifier::ComputeDepths(bool report) {
+  depths_.assign(cont_.inst_count(), kUnreachable);
+  // visit the entry point and all functions
+  bool changed = ComputeDepths(0, report);
+  for (const auto &pc : cont_.func_pcs()) {
+    if (ComputeDepths(pc, report)) changed = true;
+  }
+  // update the maximum stack depth of the whole program,
+  // make sure that the return value of external functions fits
+  max_depth_ = 1;
+  for (const auto &[func, depth] : max_depths_) {
+    max_depth_ = std::max(max_depth_, depth);
+  }
+  return changed;
+}
+
+bool Verifier::ComputeDepths(VMAddr func, bool report) {
+  bool changed = false;
+  auto &max_depth = max_depths_[func];
+  max_depth = 0;
+  // the first instruction belongs to the entry point
+  Propagate(func, func, 0, report);
+  while (!worklist_.empty()) {
+    auto pc = worklist_.back();
+    worklist_.pop_back();
+    auto depth = depths_[pc];
+    auto inst = cont_.GetOrigInst(pc);
+    auto op = static_cast<InstOp>(inst.op);
+    // get count of required, popped and pushed values,
+    // and successors of the current instruction
+    std::uint32_t req = 0, pop = 0, push = 0;
+    bool fall = true, branch = false;
+    VMAddr target = inst.opr;
+    switch (op) {
+      case InstOp::ArrSlot: case InstOp::ArrGlobal: case InstOp::StSlot:
+      case InstOp::StGlobal: case InstOp::StReg: case InstOp::Pop: {
+        req = pop = 1;
+        break;
+      }
+      case InstOp::Ld: case InstOp::StSlotP: case InstOp::StGlobalP:
+      case InstOp::StRegP: case InstOp::ImmHi: case InstOp::LNot:
+      case InstOp::Neg: {
+        req = 1;
+        break;
+      }
+      case InstOp::LdReg: case InstOp::LdSlot: case InstOp::LdGlobal:
+      case InstOp::Imm: {
+        push = 1;
+        break;
+      }
+      case InstOp::St: {
+        req = pop = 2;
+        break;
+      }
+      case InstOp::LAnd: case InstOp::LOr: case InstOp::Eq: case InstOp::Ne:
+      case InstOp::Gt: case InstOp::Lt: case InstOp::Ge: case InstOp::Le:
+      case InstOp::Add: case InstOp::Sub: case InstOp::Mul: case InstOp::Div:
+      case InstOp::Mod: case InstOp::And: case InstOp::Shl: case InstOp::Shr: {
+        req = 2;
+        pop = 1;
+        break;
+      }
+      case InstOp::Bnz: {
+        req = pop = 1;
+        branch = true;
+        break;
+      }
+      case InstOp::Jmp: {
+        fall = false;
+        branch = true;
+        break;
+      }
+      case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+      case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+        // fall through to the following 'Jmp', or skip it
+        branch = true;
+        target = pc + 2;
+        break;
+      }
+      case InstOp::Clear: {
+        pop = depth;
+        break;
+      }
+      case InstOp::Call: {
+        // all values are passed to the callee as parameters, and values
+        // on the stack of callee are left when returning
+        pop = depth;
+        auto it = ret_depths_.find(inst.opr);
+        if (it == ret_depths_.end()) {
+          // callee never returns, or has not been visited yet
+          fall = false;
+        }
+        else if (it->second == kUnknownDepth) {
+          // the following stack depths are unknown
+          if (report) MarkUnverified(pc);
+          fall = false;
+        }
+        else {
+          push = it->second;
+        }
+        break;
+      }
+      case InstOp::CallExt: {
+        // external functions return values through the operand stack
+        // in Eeyore mode, and through registers in Tigger mode
+        pop = depth;
+        if (!reg_count_) {
+          auto ret = ext_func_checker_(inst.opr);
+          if (ret == ExtRet::Value) {
+            push = 1;
+          }
+          else if (ret != ExtRet::None) {
+            // the following stack depths are unknown
+            if (report) MarkUnverified(pc);
+            fall = false;
+          }
+        }
+        break;
+      }
+      case InstOp::Ret: {
+        // return value is popped from the stack when exiting
+        // from the entry point in Eeyore mode
+        if (!func && !reg_count_) req = 1;
+        fall = false;
+        break;
+      }
+      case InstOp::Error: {
+        fall = false;
+        break;
+      }
+      default:;
+    }
+    // check & update stack depth, accessing empty stack is checked
+    // at runtime, since the instruction may never be executed
+    if (depth < req) {
+      if (report) MarkUnverified(pc);
+      continue;
+    }
+    auto next = depth - pop + push;
+    max_depth = std::max(max_depth, std::max(depth, next));
+    // record the return depth, which is unknown if it's inconsistent
+    if (op == InstOp::Ret && func) {
+      auto [it, succ] = ret_depths_.insert({func, depth});
+      if (succ) {
+        changed = true;
+      }
+      else if (it->second != depth && it->second != kUnknownDepth) {
+        it->second = kUnknownDepth;
+        changed = true;
+      }
+      if (report && it->second == kUnknownDepth) MarkUnverified(pc);
+    }
+    // visit successors
+    auto visit = [&](VMAddr succ) {
+      if (succ >= cont_.inst_count() || owners_[succ] != func) {
+        if (report) MarkUnverified(pc);
+      }
+      else {
+        Propagate(pc, succ, next, report);
+      }
+    };
+    if (branch) visit(target);
+    if (fall) visit(pc + 1);
+  }
+  return changed;
+}
+
+void Verifier::Propagate(VMAddr pc, VMAddr target, std::uint32_t depth,
+                         bool report) {
+  auto &cur = depths_[target];
+  if (cur == kUnreachable) {
+    cur = depth;
+    worklist_.push_back(target);
+  }
+  else if (cur != depth && report) {
+    MarkUnverified(pc);
+  }
+}
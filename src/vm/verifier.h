@@ -0,0 +1,112 @@
+#ifndef MINIVM_VM_VERIFIER_H_
+#define MINIVM_VM_VERIFIER_H_
+
+#include <string_view>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <optional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "vm/define.h"
+#include "vm/instcont.h"
+
+namespace minivm::vm {
+
+// static verifier of sealed Gopher instructions
+// checks operands (register ids, slot indices, branch targets and
+// symbol references) of all instructions, computes the operand stack
+// depth of each reachable instruction over the control flow graph,
+// and records the maximum stack depth of each function
+// functions whose stack depths can not be determined statically (e.g.
+// returning different counts of values) are not rejected, since they
+// may still run correctly, but are marked as unverified
+class Verifier {
+ public:
+  // return value of external functions (Eeyore mode)
+  enum class ExtRet { None, Value, Unknown };
+  // callback for getting the return value of the specific external
+  // function, returns 'nullopt' if the function is not defined
+  using ExtFuncChecker = std::function<std::optional<ExtRet>(SymId)>;
+
+  // 'reg_count' is the count of static registers, which should be
+  // non-zero in Tigger mode only
+  Verifier(const VMInstContainer &cont, std::uint32_t reg_count,
+           ExtFuncChecker ext_func_checker);
+
+  // verify all instructions in the container, print error messages
+  // to stderr if failed
+  // returns 'false' if any error occurred
+  bool Verify();
+
+  // getter, maximum stack depth of all functions,
+  // the entry point is indexed by zero
+  const std::unordered_map<VMAddr, std::uint32_t> &max_depths() const {
+    return max_depths_;
+  }
+  // getter, maximum stack depth of the whole program,
+  // valid only if there are no unverified functions
+  std::uint32_t max_depth() const { return max_depth_; }
+  // getter, functions whose stack depths can not be determined
+  const std::unordered_set<VMAddr> &unverified_funcs() const {
+    return unverified_funcs_;
+  }
+
+ private:
+  // stack depth of unreachable instructions
+  static constexpr std::uint32_t kUnreachable = -1;
+  // return depth of functions returning different counts of values
+  static constexpr std::uint32_t kUnknownDepth = -2;
+
+  // print error message of the specific instruction to stderr
+  void LogError(std::string_view message, VMAddr pc);
+  void LogError(std::string_view message, std::string_view sym,
+                VMAddr pc);
+  // check operands of the specific instruction
+  void CheckOperands(VMAddr pc);
+  // check if the specific pc address is a valid branch target
+  // of the specific function, log error if not
+  void CheckTarget(VMAddr pc, VMAddr func, VMAddr target);
+  // mark the function of the specific instruction as unverified
+  void MarkUnverified(VMAddr pc) { unverified_funcs_.insert(owners_[pc]); }
+  // compute stack depths of all instructions, unverified functions are
+  // marked only if 'report' is set
+  // returns 'true' if the return depth of any function changed
+  bool ComputeDepths(bool report);
+  // compute stack depths of instructions in the specific function
+  bool ComputeDepths(VMAddr func, bool report);
+  // propagate stack depth from the specific instruction to the target
+  void Propagate(VMAddr pc, VMAddr target, std::uint32_t depth,
+                 bool report);
+
+  // instruction container
+  const VMInstContainer &cont_;
+  // count of static registers
+  std::uint32_t reg_count_;
+  // checker of external functions
+  ExtFuncChecker ext_func_checker_;
+  // set if any error occurred
+  bool has_error_;
+  // function of each instruction, the first instruction (Jmp kVMEntry)
+  // and the entry point belong to function zero
+  std::vector<VMAddr> owners_;
+  // slot counts of all functions
+  std::unordered_map<VMAddr, std::uint32_t> slot_counts_;
+  // stack depths of all instructions (before execution)
+  std::vector<std::uint32_t> depths_;
+  // instructions to be visited
+  std::vector<VMAddr> worklist_;
+  // stack depths of all functions when returning
+  std::unordered_map<VMAddr, std::uint32_t> ret_depths_;
+  // functions whose stack depths can not be determined
+  std::unordered_set<VMAddr> unverified_funcs_;
+  // maximum stack depths
+  std::unordered_map<VMAddr, std::uint32_t> max_depths_;
+  std::uint32_t max_depth_;
+};
+
+}  // namespace minivm::vm
+
+#endif  // MINIVM_VM_VERIFIER_H_
@@ -1,10 +1,12 @@
 #include "vm/vm.h"
 
 #include <iostream>
-#include <string>
+#include <algorithm>
 #include <cstdlib>
 #include <cassert>
 
+#include "vm/verifier.h"
+#include "vm/sysy.h"
 #include "xstl/style.h"
 
 using namespace minivm::vm;
@@ -21,11 +23,15 @@ using namespace minivm::vm;
       std::cerr << "assertion failed: " #e                               \
                    ", file " VM_STR(__FILE__) ", line " VM_STR(__LINE__) \
                 << std::endl;                                            \
+      VM_SYNC_PC();                                                      \
       LogError(code);                                                    \
       std::_Exit(code);                                                  \
     }                                                                    \
   } while (0)
 #endif
+// assertion that has been proved by the verifier,
+// skipped if instructions have been verified
+#define VM_CHECK(e, code) VM_ASSERT(verified_ || (e), code)
 
 void VM::LogError(std::size_t code) {
   using namespace xstl;
@@ -70,6 +76,14 @@ void VM::LogError(std::size_t code) {
       std::cerr << "invalid PC address (function without 'return'?)";
       break;
     }
+    case kVMErrorOprStackOverflow: {
+      std::cerr << "operand stack overflow";
+      break;
+    }
+    case kVMErrorFrameStackOverflow: {
+      std::cerr << "frame stack overflow";
+      break;
+    }
     default: assert(false);
   }
   std::cerr << std::endl;
@@ -77,89 +91,302 @@ void VM::LogError(std::size_t code) {
   error_code_ = code;
 }
 
-VMOpr VM::PopValue() {
-  VM_ASSERT(!oprs_.empty(), kVMErrorEmptyOprStack);
-  auto ret = oprs_.top();
-  oprs_.pop();
-  return ret;
+void VM::InitContCallbacks() {
+  cont_.set_patch_callback([this](VMAddr pc) { PatchInst(pc); });
+  cont_.set_hook_callback([this] { ToggleHooks(true); });
 }
 
-VMOpr &VM::GetOpr() {
-  VM_ASSERT(!oprs_.empty(), kVMErrorEmptyOprStack);
-  return oprs_.top();
+void VM::DecodeInsts() {
+  threaded_insts_.resize(cont_.inst_count());
+  hooked_ = cont_.has_debug_hooks();
+  for (VMAddr pc = 0; pc < threaded_insts_.size(); ++pc) DecodeInst(pc);
 }
 
-VMOpr *VM::GetAddrById(mem::MemId id) {
-  // find in memory pool
-  auto ptr = mem_pool_->GetAddress(id);
-  if (!ptr) {
-    LogError(kVMErrorInvalidMemPoolAddr);
-    return nullptr;
+void VM::DecodeInst(VMAddr pc) {
+  const auto &inst = cont_.insts()[pc];
+  auto &threaded = threaded_insts_[pc];
+  auto base = threaded_insts_.data();
+  // select handler by the current opcode (may be a breakpoint or
+  // a superinstruction), and decode operand by the original opcode
+  threaded.handler = hooked_ ? hook_label_ : inst_labels_[inst.op];
+  threaded.target = nullptr;
+  auto orig = cont_.GetOrigInst(pc);
+  threaded.opr = orig.opr;
+  switch (static_cast<InstOp>(orig.op)) {
+    case InstOp::Imm: {
+      // wide immediates are merged with the following 'ImmHi'
+      if (inst.op == static_cast<std::uint32_t>(InstOp::ImmW)) {
+        threaded.opr = MergeImm(orig.opr, cont_.insts()[pc + 1].opr);
+      }
+      else {
+        threaded.opr = ExtendImm(orig.opr);
+      }
+      break;
+    }
+    case InstOp::Bnz: case InstOp::Jmp: case InstOp::Call: {
+      threaded.target = base + orig.opr;
+      break;
+    }
+    case InstOp::BeqRR: case InstOp::BneRR: case InstOp::BltRR:
+    case InstOp::BleRR: case InstOp::BgtRR: case InstOp::BgeRR: {
+      // target is stored in the following 'Jmp',
+      // step to the 'Jmp' if it has been replaced by 'Break'
+      const auto &next = cont_.insts()[pc + 1];
+      if (next.op == static_cast<std::uint32_t>(InstOp::Jmp)) {
+        threaded.target = base + cont_.GetOrigInst(pc + 1).opr;
+      }
+      else {
+        threaded.target = base + pc + 1;
+      }
+      break;
+    }
+    default:;
   }
-  return reinterpret_cast<VMOpr *>(ptr);
-}
-
-VMOpr *VM::GetAddrBySym(SymId sym) {
-  // find in current environment
-  const auto &env = envs_.top().first;
-  auto it = env->find(sym);
-  if (it == env->end()) {
-    // find in global environment
-    it = global_env_->find(sym);
-    if (it == global_env_->end()) {
-      LogError(kVMErrorSymbolNotFound);
-      return nullptr;
+  // count calls and loop back-edges (backward jumps) of functions
+  // that may be compiled when running with tiered execution
+  auto is_tail = inst.op == static_cast<std::uint32_t>(InstOp::TailCall);
+  if (tier_ && !hooked_ && (inst.op == orig.op || is_tail)) {
+    auto op = static_cast<InstOp>(orig.op);
+    if (op == InstOp::Call && tier_->IsCandidate(orig.opr)) {
+      threaded.handler = is_tail ? tier_tail_call_label_ : tier_call_label_;
+    }
+    else if (op == InstOp::Jmp && orig.opr <= pc && tier_->IsCandidate(pc)) {
+      threaded.handler = tier_jmp_label_;
+    }
+  }
+  // count loop headers and record traces when running with
+  // trace-based execution
+  if (trace_ && !hooked_) {
+    if (trace_->recording()) {
+      threaded.handler = record_label_;
+    }
+    else if (trace_->IsHeader(pc)) {
+      threaded.handler = trace_head_label_;
     }
   }
-  return &it->second;
 }
 
-VM::EnvPtr VM::MakeEnv() {
-  return std::make_shared<Environment>();
+void VM::PatchInst(VMAddr pc) {
+  if (threaded_insts_.empty()) return;
+  DecodeInst(pc);
+  // the previous instruction may read target from the current one
+  if (pc) DecodeInst(pc - 1);
 }
 
-void VM::InitFuncCall() {
+void VM::ToggleHooks(bool enable) {
+  if (hooked_ == enable) return;
+  hooked_ = enable;
+  for (VMAddr pc = 0; pc < threaded_insts_.size(); ++pc) {
+    auto op = cont_.insts()[pc].op;
+    threaded_insts_[pc].handler = enable ? hook_label_ : inst_labels_[op];
+  }
+}
+
+bool VM::InitFuncCall() {
   // save the state of memory pool
-  mem_pool_->SaveState();
-  // add a new environment & return address to stack
-  envs_.push({MakeEnv(), pc_ + 1});
-  auto &env = envs_.top().first;
-  // push parameters
-  while (!oprs_.empty()) {
-    // get symbol id of parameter
-    auto sym = sym_pool_.LogId("p" + std::to_string(oprs_.size() - 1));
-    // write value
-    auto ret = env->insert({sym, PopValue()}).second;
-    static_cast<void>(ret);
-    VM_ASSERT(ret, kVMErrorSymbolRedef);
+  auto state = mem_pool_->SaveState();
+  // push a new frame, and move parameters to the first slots
+  if (!frames_.Push(pc_ + 1, state, &oprs_[0], oprs_.size())) {
+    LogError(kVMErrorFrameStackOverflow);
+    return false;
   }
+  oprs_.clear();
+  return true;
 }
 
-bool VM::RegisterFunction(std::string_view name, ExtFunc func) {
+const VM::ExtFunc *VM::FindExtFunc(SymId sym) const {
+  if (sym >= ext_funcs_.size() || !ext_funcs_[sym]) return nullptr;
+  return &ext_funcs_[sym];
+}
+
+bool VM::CallExtFunc(SymId sym, const VMOpr *params, std::size_t count) {
+  // get external function
+  auto func = FindExtFunc(sym);
+  if (!func) {
+    LogError(kVMErrorInvalidExtFunc);
+    return false;
+  }
+  // push a new frame, and move parameters to the first slots
+  auto state = mem_pool_->SaveState();
+  if (!frames_.Push(pc_ + 1, state, params, count)) {
+    LogError(kVMErrorFrameStackOverflow);
+    return false;
+  }
+  oprs_.clear();
+  // perform function call
+  if (!(*func)(*this)) {
+    LogError(kVMErrorExtFuncError);
+    return false;
+  }
+  // values pushed by the external function must fit in the stack
+  if (oprs_.overflowed()) {
+    LogError(kVMErrorOprStackOverflow);
+    return false;
+  }
+  // perform return operation, the memory pool is restored only if
+  // the external function allocated any memory
+  if (mem_pool_->SaveState() != state) mem_pool_->RestoreState(state);
+  frames_.Pop();
+  return true;
+}
+
+bool VM::GetIntrinsicParams(VMOpr *params, std::size_t count) {
+  if (regs_.empty()) {
+    // all values on the operand stack are parameters
+    if (oprs_.size() < count) return false;
+    std::copy(&oprs_[0], &oprs_[0] + count, params);
+  }
+  else {
+    std::copy(regs_.begin() + ret_reg_id_,
+              regs_.begin() + ret_reg_id_ + count, params);
+    ResetCallerSavedRegs();
+  }
+  oprs_.clear();
+  return true;
+}
+
+bool VM::GetExtParams(VMOpr *params, std::size_t count) {
+  if (regs_.empty()) {
+    if (count > frames_.slot_count()) return false;
+    std::copy(frames_.fp(), frames_.fp() + count, params);
+  }
+  else {
+    if (ret_reg_id_ + count > regs_.size()) return false;
+    std::copy(regs_.begin() + ret_reg_id_,
+              regs_.begin() + ret_reg_id_ + count, params);
+    ResetCallerSavedRegs();
+  }
+  return true;
+}
+
+void VM::SetExtRet(VMOpr ret) {
+  if (regs_.empty()) {
+    oprs_.push(ret);
+  }
+  else {
+    regs_[ret_reg_id_] = ret;
+  }
+}
+
+NativeStatus VM::CallNative(NativeFunc func) {
+  VMOpr ret;
+  auto status = tier_->Call(func, &oprs_[0], oprs_.size(), 0, ret);
+  if (status == NativeStatus::Error || status == NativeStatus::NoStack) {
+    return status;
+  }
+  oprs_.clear();
+  if (status == NativeStatus::RetValue) oprs_.push(ret);
+  return status;
+}
+
+NativeStatus VM::EnterNative(NativeFunc func, VMAddr entry) {
+  VMOpr ret;
+  auto status = tier_->Call(func, frames_.fp(), frames_.slot_count(),
+                            entry, ret);
+  if (status == NativeStatus::RetValue) oprs_.push(ret);
+  return status;
+}
+
+NativeStatus VM::CallFromNative(VMAddr pc, VMAddr func,
+                                const VMOpr *params, std::uint32_t count,
+                                VMOpr &ret) {
+  // push a new frame, and make it the frame of entry point
+  pc_ = pc;
+  if (!frames_.Push(pc_ + 1, mem_pool_->SaveState(), params, count)) {
+    LogError(kVMErrorFrameStackOverflow);
+    return NativeStatus::Error;
+  }
+  auto entry_depth = frames_.entry_depth();
+  frames_.set_entry_depth(frames_.depth());
+  // run the callee, with no native stack left for native functions
+  auto &ctx = tier_->ctx();
+  auto stack_left = ctx.stack_left;
+  ctx.stack_left = 0;
+  pc_ = func;
+  oprs_.clear();
+  auto succ = RunThreaded<false>().has_value();
+  ctx.stack_left = stack_left;
+  frames_.set_entry_depth(entry_depth);
+  if (!succ) return NativeStatus::Error;
+  frames_.Pop();
+  // get the return value (Eeyore mode)
+  auto status = NativeStatus::Ret;
+  if (!oprs_.empty()) {
+    ret = oprs_.top();
+    status = NativeStatus::RetValue;
+  }
+  oprs_.clear();
+  return status;
+}
+
+bool VM::RegisterFunction(std::string_view name, ExtFunc func,
+                          std::optional<bool> has_ret) {
   auto id = sym_pool_.LogId(name);
-  return ext_funcs_.insert({id, func}).second;
+  if (id >= ext_funcs_.size()) {
+    ext_funcs_.resize(id + 1);
+    ext_rets_.resize(id + 1);
+  }
+  if (ext_funcs_[id]) return false;
+  ext_funcs_[id] = func;
+  ext_rets_[id] = has_ret;
+  return true;
 }
 
 std::optional<VMOpr> VM::GetParamFromCurPool(std::size_t param_id) const {
-  auto sym = sym_pool_.FindId("p" + std::to_string(param_id));
-  if (!sym) return {};
-  const auto &env = envs_.top().first;
-  auto it = env->find(*sym);
-  if (it == env->end()) return {};
-  return it->second;
+  if (param_id >= frames_.slot_count()) return {};
+  return frames_.fp()[param_id];
+}
+
+VMOpr *VM::GetLocalAddr(SymId sym) {
+  // get slot table of current function
+  auto slots = cont_.FindSlotTable(pc_);
+  if (!slots) return nullptr;
+  // find in current environment
+  auto count = std::min(slots->size(), frames_.slot_count());
+  for (std::size_t i = 0; i < count; ++i) {
+    if ((*slots)[i] == sym) return frames_.fp() + i;
+  }
+  return nullptr;
+}
+
+VMOpr *VM::GetGlobalAddr(SymId sym) {
+  const auto &slots = cont_.global_slots();
+  auto count = std::min(slots.size(), global_env_.size());
+  for (std::size_t i = 0; i < count; ++i) {
+    if (slots[i] == sym) return &global_env_[i];
+  }
+  return nullptr;
+}
+
+bool VM::Verify() {
+  using ExtRet = Verifier::ExtRet;
+  Verifier verifier(cont_, regs_.size(),
+                    [this](SymId sym) -> std::optional<ExtRet> {
+                      if (!FindExtFunc(sym)) return {};
+                      const auto &has_ret = ext_rets_[sym];
+                      if (!has_ret) return ExtRet::Unknown;
+                      return *has_ret ? ExtRet::Value : ExtRet::None;
+                    });
+  if (!verifier.Verify()) return false;
+  // keep runtime checks if any function can not be verified
+  if (!verifier.unverified_funcs().empty()) return true;
+  // values of callers are moved to frames when calling functions,
+  // so the operand stack only holds values of the current function
+  oprs_ = OprStack(verifier.max_depth());
+  verified_ = true;
+  return true;
 }
 
 void VM::Reset() {
   // reset pc to zero
   pc_ = 0;
   // clear all stacks
-  while (!oprs_.empty()) oprs_.pop();
-  while (!envs_.empty()) envs_.pop();
-  // make a new environment for global environment
-  envs_.push({MakeEnv(), 0});
-  global_env_ = envs_.top().first;
+  oprs_.clear();
+  frames_.clear();
+  // allocate global segment
+  global_env_.assign(cont_.global_slots().size(), 0);
   // save current state of memory pool
-  mem_pool_->SaveState();
+  frames_.set_pool_state(mem_pool_->SaveState());
   // reset all static registers
   regs_.assign(regs_.size(), 0xdeadc0de);
   // reset error code
@@ -167,119 +394,219 @@ void VM::Reset() {
 }
 
 std::optional<VMOpr> VM::Run() {
-#define VM_NEXT(pc_ofs)          \
-  do {                           \
-    pc_ += pc_ofs;               \
-    inst = cont_.GetInst(pc_);   \
-    goto *kInstLabels[inst->op]; \
+  // run the fast variant if there are no debugging hooks
+  if (!cont_.has_debug_hooks()) {
+    switch_to_debug_ = false;
+    auto ret = RunThreaded<false>();
+    if (!switch_to_debug_) return ret;
+  }
+  // hooks appeared, continue running with the debug variant
+  return RunThreaded<true>();
+}
+
+template <bool kDebug>
+std::optional<VMOpr> VM::RunThreaded() {
+  // instructions are fetched from the threaded stream, and 'pc_' is
+  // updated only when it is observable (calls, errors and debugging)
+#define VM_NEXT(pc_ofs)  \
+  do {                   \
+    inst += pc_ofs;      \
+    goto *inst->handler; \
+  } while (0)
+#define VM_JUMP(target)  \
+  do {                   \
+    inst = target;       \
+    goto *inst->handler; \
+  } while (0)
+#define VM_SYNC_PC() pc_ = inst - insts
+#define VM_ERROR(err) \
+  do {                \
+    VM_SYNC_PC();     \
+    LogError(err);    \
+    return {};        \
+  } while (0)
+  // the top of operand stack is cached in 'tos', and the stack pointer
+  // is cached in 'sp', the slot pointed by 'sp' is valid only after
+  // the cached values are written back by 'VM_SPILL'
+#define VM_SPILL()    \
+  do {                \
+    *sp = tos;        \
+    oprs_.set_sp(sp); \
+  } while (0)
+#define VM_RELOAD()  \
+  do {               \
+    sp = oprs_.sp(); \
+    tos = *sp;       \
+  } while (0)
+  // overflow is checked even if assertions are disabled, since
+  // it corrupts the heap, and the check is omitted only if the
+  // stack has been sized by the verifier
+#define VM_PUSH(val)                                \
+  do {                                              \
+    if (!verified_ && sp == oprs_.limit()) {        \
+      VM_ERROR(kVMErrorOprStackOverflow);           \
+    }                                               \
+    *sp++ = tos;                                    \
+    tos = (val);                                    \
+  } while (0)
+#define VM_POP_TO(val)                                    \
+  do {                                                    \
+    VM_CHECK(sp != oprs_.base(), kVMErrorEmptyOprStack);  \
+    (val) = tos;                                          \
+    tos = *--sp;                                          \
+  } while (0)
+#define VM_CHECK_TOP() \
+  VM_CHECK(sp != oprs_.base(), kVMErrorEmptyOprStack)
+#define VM_BINARY(op)                                         \
+  do {                                                        \
+    VM_CHECK(sp - oprs_.base() >= 2, kVMErrorEmptyOprStack);  \
+    --sp;                                                     \
+    tos = *sp op tos;                                         \
   } while (0)
 
-  const void *kInstLabels[] = {VM_INSTS(VM_EXPAND_LABEL_LIST)};
-  const VMInst *inst;
+  static const void *const kInstLabels[] = {
+      VM_INSTS(VM_EXPAND_LABEL_LIST)};
+  // decode all instructions to the threaded stream
+  inst_labels_ = kInstLabels;
+  hook_label_ = VM_LABEL_ADDR(Hook);
+  tier_call_label_ = VM_LABEL_ADDR(TierCall);
+  tier_tail_call_label_ = VM_LABEL_ADDR(TierTailCall);
+  tier_jmp_label_ = VM_LABEL_ADDR(TierJmp);
+  trace_head_label_ = VM_LABEL_ADDR(TraceHead);
+  record_label_ = VM_LABEL_ADDR(Record);
+  // the threaded stream is in use when called from native functions
+  if (!frames_.entry_depth()) DecodeInsts();
+  const ThreadedInst *insts = threaded_insts_.data(), *inst = insts + pc_;
+  VMOpr *sp, tos, *fp = frames_.fp();
+  VMOpr *gp = global_env_.data();
+  VM_RELOAD();
   VM_NEXT(0);
 
-  // allocate memory for variable
-  VM_LABEL(Var) {
-    // initialize variable if is in global environment
-    auto init = envs_.size() == 1 ? 0 : 0xdeadc0de;
-    auto succ = envs_.top().first->insert({inst->opr, init}).second;
-    VM_ASSERT(succ, kVMErrorSymbolRedef);
-    static_cast<void>(succ);
-    VM_NEXT(1);
-  }
-
-  // allocate memory for array
-  VM_LABEL(Arr) {
-    // add a new entry to environment
-    auto ret = envs_.top().first->insert({inst->opr, 0});
-    VM_ASSERT(ret.second, kVMErrorSymbolRedef);
-    // allocate a new memory if success
-    if (ret.second) {
-      // allocate initialized memory if is in global environment
-      ret.first->second =
-          mem_pool_->Allocate(PopValue(), envs_.size() == 1);
-    }
+  // symbol-addressed instructions, all of them should have been
+  // resolved to slot-addressed ones when sealing the container
+  VM_LABEL(Var) VM_LABEL(Arr) VM_LABEL(LdVar) VM_LABEL(StVar)
+  VM_LABEL(StVarP) {
+    VM_ERROR(kVMErrorSymbolNotFound);
+  }
+
+  // allocate memory for variable (frame slot)
+  VM_LABEL(VarSlot) {
+    fp[inst->opr] = 0xdeadc0de;
     VM_NEXT(1);
   }
 
-  // load value from address
-  VM_LABEL(Ld) {
-    // get address from memory pool
-    auto ptr = GetAddrById(PopValue());
-    if (!ptr) return {};
-    // push to stack
-    oprs_.push(*ptr);
+  // allocate memory for array (frame slot)
+  VM_LABEL(ArrSlot) {
+    VMOpr size;
+    VM_POP_TO(size);
+    fp[inst->opr] = mem_pool_->Allocate(size, false);
+    VM_NEXT(1);
+  }
+
+  // allocate memory for variable (global segment)
+  VM_LABEL(VarGlobal) {
+    gp[inst->opr] = 0;
+    VM_NEXT(1);
+  }
+
+  // allocate memory for array (global segment)
+  VM_LABEL(ArrGlobal) {
+    VMOpr size;
+    VM_POP_TO(size);
+    gp[inst->opr] = mem_pool_->Allocate(size, true);
     VM_NEXT(1);
   }
 
-  // load variable
-  VM_LABEL(LdVar) {
+  // load value from address
+  VM_LABEL(Ld) {
+    VM_CHECK_TOP();
     // get address from memory pool
-    auto ptr = GetAddrBySym(inst->opr);
-    if (!ptr) return {};
-    // push to stack
-    oprs_.push(*ptr);
+    auto ptr = mem_pool_->GetAddress(tos);
+    if (!ptr) VM_ERROR(kVMErrorInvalidMemPoolAddr);
+    // replace the top of stack
+    tos = *reinterpret_cast<VMOpr *>(ptr);
     VM_NEXT(1);
   }
 
   // load static register
   VM_LABEL(LdReg) {
-    VM_ASSERT(inst->opr < regs_.size(), kVMErrorInvalidRegNum);
-    oprs_.push(regs_[inst->opr]);
+    VM_CHECK(static_cast<std::size_t>(inst->opr) < regs_.size(),
+             kVMErrorInvalidRegNum);
+    VM_PUSH(regs_[inst->opr]);
     VM_NEXT(1);
   }
 
   // store value to address
   VM_LABEL(St) {
+    VM_CHECK(sp - oprs_.base() >= 2, kVMErrorEmptyOprStack);
     // get address from memory pool
-    auto ptr = GetAddrById(PopValue());
-    if (!ptr) return {};
+    auto ptr = mem_pool_->GetAddress(tos);
+    if (!ptr) VM_ERROR(kVMErrorInvalidMemPoolAddr);
     // write value
-    *ptr = PopValue();
+    *reinterpret_cast<VMOpr *>(ptr) = sp[-1];
+    sp -= 2;
+    tos = *sp;
     VM_NEXT(1);
   }
 
-  // store variable
-  VM_LABEL(StVar) {
-    // get address from memory pool
-    auto ptr = GetAddrBySym(inst->opr);
-    if (!ptr) return {};
-    // write value
-    *ptr = PopValue();
+  // load frame slot
+  VM_LABEL(LdSlot) {
+    VM_PUSH(fp[inst->opr]);
     VM_NEXT(1);
   }
 
-  // store variable and preserve
-  VM_LABEL(StVarP) {
-    // get address from memory pool
-    auto ptr = GetAddrBySym(inst->opr);
-    if (!ptr) return {};
-    // write value
-    *ptr = GetOpr();
+  // store frame slot
+  VM_LABEL(StSlot) {
+    VM_POP_TO(fp[inst->opr]);
+    VM_NEXT(1);
+  }
+
+  // store frame slot and preserve
+  VM_LABEL(StSlotP) {
+    VM_CHECK_TOP();
+    fp[inst->opr] = tos;
+    VM_NEXT(1);
+  }
+
+  // load global variable
+  VM_LABEL(LdGlobal) {
+    VM_PUSH(gp[inst->opr]);
+    VM_NEXT(1);
+  }
+
+  // store global variable
+  VM_LABEL(StGlobal) {
+    VM_POP_TO(gp[inst->opr]);
+    VM_NEXT(1);
+  }
+
+  // store global variable and preserve
+  VM_LABEL(StGlobalP) {
+    VM_CHECK_TOP();
+    gp[inst->opr] = tos;
     VM_NEXT(1);
   }
 
   // store static register
   VM_LABEL(StReg) {
-    VM_ASSERT(inst->opr < regs_.size(), kVMErrorInvalidRegNum);
-    regs_[inst->opr] = PopValue();
+    VM_CHECK(static_cast<std::size_t>(inst->opr) < regs_.size(),
+             kVMErrorInvalidRegNum);
+    VM_POP_TO(regs_[inst->opr]);
     VM_NEXT(1);
   }
 
   // store static register and preserve
   VM_LABEL(StRegP) {
-    VM_ASSERT(inst->opr < regs_.size(), kVMErrorInvalidRegNum);
-    regs_[inst->opr] = GetOpr();
+    VM_CHECK(static_cast<std::size_t>(inst->opr) < regs_.size(),
+             kVMErrorInvalidRegNum);
+    VM_CHECK_TOP();
+    regs_[inst->opr] = tos;
     VM_NEXT(1);
   }
 
   // load immediate (sign-extended)
   VM_LABEL(Imm) {
-    constexpr auto kSignBit = 1u << (kVMInstImmLen - 1);
-    constexpr auto kUpperOnes = (1u << (32 - kVMInstImmLen)) - 1;
-    auto val = inst->opr;
-    if (val & kSignBit) val |= kUpperOnes << kVMInstImmLen;
-    oprs_.push(val);
+    VM_PUSH(inst->opr);
     VM_NEXT(1);
   }
 
@@ -287,16 +614,18 @@ std::optional<VMOpr> VM::Run() {
   VM_LABEL(ImmHi) {
     constexpr auto kMaskLo = (1u << kVMInstImmLen) - 1;
     constexpr auto kMaskHi = (1u << (32 - kVMInstImmLen)) - 1;
-    GetOpr() &= kMaskLo;
-    GetOpr() |= (inst->opr & kMaskHi) << kVMInstImmLen;
+    VM_CHECK_TOP();
+    tos &= kMaskLo;
+    tos |= (inst->opr & kMaskHi) << kVMInstImmLen;
     VM_NEXT(1);
   }
 
   // branch if not zero
   VM_LABEL(Bnz) {
-    if (PopValue()) {
-      pc_ = inst->opr;
-      VM_NEXT(0);
+    VMOpr cond;
+    VM_POP_TO(cond);
+    if (cond) {
+      VM_JUMP(inst->target);
     }
     else {
       VM_NEXT(1);
@@ -305,58 +634,243 @@ std::optional<VMOpr> VM::Run() {
 
   // jump to target
   VM_LABEL(Jmp) {
-    pc_ = inst->opr;
-    VM_NEXT(0);
+    VM_JUMP(inst->target);
   }
 
   // call function
   VM_LABEL(Call) {
-    InitFuncCall();
-    pc_ = inst->opr;
+    VM_SYNC_PC();
+    VM_SPILL();
+    if (!InitFuncCall()) return {};
+    VM_RELOAD();
+    VM_JUMP(inst->target);
+  }
+
+  // tail call, reuse the current frame
+  VM_LABEL(TailCall) {
+    // execute as a normal call when debugging, to keep all frames
+    if constexpr (kDebug) VM_GOTO(Call);
+    VM_SPILL();
+    // memory allocated by the current function is not referenced by
+    // the callee, which is guaranteed when sealing
+    mem_pool_->RestoreState(frames_.pool_state());
+    if (!frames_.Reuse(&oprs_[0], oprs_.size())) {
+      VM_ERROR(kVMErrorFrameStackOverflow);
+    }
+    oprs_.clear();
+    VM_RELOAD();
+    fp = frames_.fp();
+    VM_JUMP(inst->target);
+  }
+
+  // call function, and count the call for tiered execution
+  VM_LABEL(TierCall) {
+    if (!tier_->CountCall(inst->opr)) VM_GOTO(Call);
+    // the callee has been compiled, call the native one from now on
+    threaded_insts_[inst - insts].handler = VM_LABEL_ADDR(NativeCall);
+    VM_GOTO(NativeCall);
+  }
+
+  // tail call, and count the call for tiered execution
+  VM_LABEL(TierTailCall) {
+    auto func = tier_->CountCall(inst->opr);
+    if (!func) VM_GOTO(TailCall);
+    // call the native one and return its result, native functions
+    // have no tail calls, so the frame is reused if the stack has run out
+    VM_SYNC_PC();
+    VM_SPILL();
+    auto status = CallNative(func);
+    if (status == NativeStatus::Error) return {};
+    if (status == NativeStatus::NoStack) VM_GOTO(TailCall);
+    VM_RELOAD();
+    VM_GOTO(Ret);
+  }
+
+  // call native function
+  VM_LABEL(NativeCall) {
+    VM_SYNC_PC();
+    VM_SPILL();
+    auto status = CallNative(tier_->CountCall(inst->opr));
+    if (status == NativeStatus::Error) return {};
+    // call the interpreted one if the native stack has run out
+    if (status == NativeStatus::NoStack) VM_GOTO(Call);
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // backward jump, and count the back-edge for tiered execution
+  VM_LABEL(TierJmp) {
+    // the rest of the function is run by the native one
+    // if the function has been compiled and the stack is empty
+    NativeFunc func;
+    if (sp == oprs_.base() && (func = tier_->CountBackEdge(inst - insts))) {
+      VM_SPILL();
+      auto status = EnterNative(func, inst->target - insts);
+      if (status == NativeStatus::Error) return {};
+      if (status == NativeStatus::Ret || status == NativeStatus::RetValue) {
+        VM_RELOAD();
+        VM_GOTO(Ret);
+      }
+      // the target can not be entered, do not count it any more,
+      // or the native stack has run out, just continue
+      if (status == NativeStatus::NoEntry) {
+        threaded_insts_[inst - insts].handler = VM_LABEL_ADDR(Jmp);
+      }
+    }
+    VM_JUMP(inst->target);
+  }
+
+  // loop header, count the arrival for trace-based execution
+  VM_LABEL(TraceHead) {
+    if (sp == oprs_.base()) {
+      if (auto trace = trace_->CountHeader(inst - insts)) {
+        // run the compiled trace until a side exit
+        VMAddr exit;
+        VM_SPILL();
+        if (!RunTrace(*trace, exit)) return {};
+        VM_RELOAD();
+        VM_JUMP(insts + exit);
+      }
+      if (trace_->recording()) {
+        // redirect all instructions in the threaded stream to the recorder
+        DecodeInsts();
+        VM_NEXT(0);
+      }
+    }
+    goto *inst_labels_[cont_.insts()[inst - insts].op];
+  }
+
+  // record instruction for trace-based execution
+  VM_LABEL(Record) {
+    auto pc = inst - insts;
+    if (trace_->Record(pc) == TraceCompiler::RecordStatus::Continue) {
+      // run the original instruction, superinstructions are not used
+      goto *inst_labels_[cont_.GetOrigInst(pc).op];
+    }
+    // recording is finished or aborted, restore the threaded stream
+    DecodeInsts();
     VM_NEXT(0);
   }
 
   // call external function
   VM_LABEL(CallExt) {
-    // get external function
-    auto it = ext_funcs_.find(inst->opr);
-    if (it == ext_funcs_.end()) {
-      LogError(kVMErrorInvalidExtFunc);
-      return {};
+    VM_SYNC_PC();
+    VM_SPILL();
+    if (!CallExtFunc(inst->opr, &oprs_[0], oprs_.size())) return {};
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // intrinsic, read an integer
+  VM_LABEL(GetInt) {
+    VMOpr val;
+    VM_SPILL();
+    GetIntrinsicParams(nullptr, 0);
+    std::cin >> val;
+    SetExtRet(val);
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // intrinsic, read a character
+  VM_LABEL(GetCh) {
+    VM_SPILL();
+    GetIntrinsicParams(nullptr, 0);
+    SetExtRet(std::cin.get());
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // intrinsic, read an array
+  VM_LABEL(GetArray) {
+    VMOpr arr, len;
+    VM_SPILL();
+    if (!GetIntrinsicParams(&arr, 1) ||
+        !sysy::GetArray(*mem_pool_, len, arr)) {
+      VM_ERROR(kVMErrorExtFuncError);
     }
-    // perform function call
-    InitFuncCall();
-    if (!it->second(*this)) {
-      LogError(kVMErrorExtFuncError);
-      return {};
+    SetExtRet(len);
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // intrinsic, print an integer
+  VM_LABEL(PutInt) {
+    VMOpr val;
+    VM_SPILL();
+    if (!GetIntrinsicParams(&val, 1)) VM_ERROR(kVMErrorExtFuncError);
+    std::cout << val;
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // intrinsic, print a character
+  VM_LABEL(PutCh) {
+    VMOpr val;
+    VM_SPILL();
+    if (!GetIntrinsicParams(&val, 1)) VM_ERROR(kVMErrorExtFuncError);
+    std::cout.put(val);
+    VM_RELOAD();
+    VM_NEXT(1);
+  }
+
+  // intrinsic, print an array
+  VM_LABEL(PutArray) {
+    VMOpr params[2];
+    VM_SPILL();
+    if (!GetIntrinsicParams(params, 2) ||
+        !sysy::PutArray(*mem_pool_, params[0], params[1])) {
+      VM_ERROR(kVMErrorExtFuncError);
     }
-    // perform return operation
-    VM_GOTO(Ret);
+    VM_RELOAD();
+    VM_NEXT(1);
   }
 
   // return from function call
   VM_LABEL(Ret) {
     // restore the state of memory pool
-    mem_pool_->RestoreState();
-    // get offset of return address
-    auto addr_ofs = envs_.top().second - pc_;
-    envs_.pop();
+    mem_pool_->RestoreState(frames_.pool_state());
     // check if need to stop execution
-    if (envs_.empty()) {
-      return regs_.empty() ? PopValue() : regs_[ret_reg_id_];
+    if (frames_.is_entry()) {
+      if (!regs_.empty()) return regs_[ret_reg_id_];
+      // functions called from native functions may return nothing,
+      // the return value is left on the operand stack
+      if (frames_.entry_depth()) {
+        VM_SPILL();
+        return 0;
+      }
+      VMOpr ret;
+      VM_POP_TO(ret);
+      return ret;
     }
-    VM_NEXT(addr_ofs);
+    // jump to return address
+    inst = insts + frames_.ret_addr();
+    frames_.Pop();
+    fp = frames_.fp();
+    VM_NEXT(0);
+  }
+
+  // function prologue
+  VM_LABEL(Enter) {
+    // allocate frame slots for local variables
+    if (!frames_.Extend(inst->opr)) VM_ERROR(kVMErrorFrameStackOverflow);
+    fp = frames_.fp();
+    VM_NEXT(1);
   }
 
   // breakpoint
   VM_LABEL(Break) {
+    // breakpoints are handled by the debug variant
+    if constexpr (!kDebug) VM_GOTO(Hook);
+    VM_SYNC_PC();
     // find debugger callback symbol
     if (auto id = sym_pool_.FindId(kVMDebugger)) {
       // find debugger callback
-      auto it = ext_funcs_.find(*id);
-      if (it != ext_funcs_.end()) {
+      if (auto func = FindExtFunc(*id)) {
         // call debugger
-        if (!it->second(*this)) return 0;
+        VM_SPILL();
+        if (!(*func)(*this)) return 0;
+        VM_RELOAD();
       }
     }
     VM_NEXT(0);
@@ -364,124 +878,523 @@ std::optional<VMOpr> VM::Run() {
 
   // error
   VM_LABEL(Error) {
-    LogError(inst->opr);
-    return {};
+    VM_ERROR(inst->opr);
+  }
+
+  // debugging hooks
+  VM_LABEL(Hook) {
+    VM_SYNC_PC();
+    if constexpr (kDebug) {
+      // fetch instruction from the container
+      auto fetched = cont_.GetInst(pc_);
+      // restore the threaded stream if there are no more hooks
+      if (!cont_.has_debug_hooks()) ToggleHooks(false);
+      goto *kInstLabels[fetched->op];
+    }
+    else {
+      // stop and switch to the debug variant
+      VM_SPILL();
+      switch_to_debug_ = true;
+      return {};
+    }
   }
 
   // logical negation
   VM_LABEL(LNot) {
-    GetOpr() = !GetOpr();
+    VM_CHECK_TOP();
+    tos = !tos;
     VM_NEXT(1);
   }
 
   // logical AND
   VM_LABEL(LAnd) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() && rhs;
+    VM_BINARY(&&);
     VM_NEXT(1);
   }
 
   // logical OR
   VM_LABEL(LOr) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() || rhs;
+    VM_BINARY(||);
     VM_NEXT(1);
   }
 
   // set if equal
   VM_LABEL(Eq) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() == rhs;
+    VM_BINARY(==);
     VM_NEXT(1);
   }
 
   // set if not equal
   VM_LABEL(Ne) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() != rhs;
+    VM_BINARY(!=);
     VM_NEXT(1);
   }
 
   // set if greater than
   VM_LABEL(Gt) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() > rhs;
+    VM_BINARY(>);
     VM_NEXT(1);
   }
 
   // set if less than
   VM_LABEL(Lt) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() < rhs;
+    VM_BINARY(<);
     VM_NEXT(1);
   }
 
   // set if greater than or equal
   VM_LABEL(Ge) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() >= rhs;
+    VM_BINARY(>=);
     VM_NEXT(1);
   }
 
   // set if less than or equal
   VM_LABEL(Le) {
-    auto rhs = PopValue();
-    GetOpr() = GetOpr() <= rhs;
+    VM_BINARY(<=);
     VM_NEXT(1);
   }
 
   // negation
   VM_LABEL(Neg) {
-    GetOpr() = -GetOpr();
+    VM_CHECK_TOP();
+    tos = -tos;
     VM_NEXT(1);
   }
 
   // addition
   VM_LABEL(Add) {
-    auto rhs = PopValue();
-    GetOpr() += rhs;
+    VM_BINARY(+);
     VM_NEXT(1);
   }
 
   // subtraction
   VM_LABEL(Sub) {
-    auto rhs = PopValue();
-    GetOpr() -= rhs;
+    VM_BINARY(-);
     VM_NEXT(1);
   }
 
   // multiplication
   VM_LABEL(Mul) {
-    auto rhs = PopValue();
-    GetOpr() *= rhs;
+    VM_BINARY(*);
     VM_NEXT(1);
   }
 
   // division
   VM_LABEL(Div) {
-    auto rhs = PopValue();
-    GetOpr() /= rhs;
+    VM_BINARY(/);
     VM_NEXT(1);
   }
 
   // modulo operation
   VM_LABEL(Mod) {
-    auto rhs = PopValue();
-    GetOpr() %= rhs;
+    VM_BINARY(%);
+    VM_NEXT(1);
+  }
+
+  // bitwise AND
+  VM_LABEL(And) {
+    VM_BINARY(&);
+    VM_NEXT(1);
+  }
+
+  // shift left, by the lower 5 bits of rhs
+  VM_LABEL(Shl) {
+    VM_CHECK(sp - oprs_.base() >= 2, kVMErrorEmptyOprStack);
+    --sp;
+    tos = static_cast<std::uint32_t>(*sp) << (tos & 31);
+    VM_NEXT(1);
+  }
+
+  // arithmetic shift right, by the lower 5 bits of rhs
+  VM_LABEL(Shr) {
+    VM_CHECK(sp - oprs_.base() >= 2, kVMErrorEmptyOprStack);
+    --sp;
+    tos = *sp >> (tos & 31);
     VM_NEXT(1);
   }
 
   // discard the top value on the stack
   VM_LABEL(Pop) {
-    PopValue();
+    VM_CHECK_TOP();
+    tos = *--sp;
     VM_NEXT(1);
   }
 
   // clear operand stack
   VM_LABEL(Clear) {
-    while (!oprs_.empty()) oprs_.pop();
+    sp = oprs_.base();
     VM_NEXT(1);
   }
 
+  // superinstructions, operands are stored in the following instructions
+#define VM_FUSED_PUSH(op, rhs)       \
+  do {                               \
+    VM_PUSH(fp[inst->opr] op (rhs)); \
+    VM_NEXT(3);                      \
+  } while (0)
+#define VM_FUSED_STORE(op, rhs)               \
+  do {                                        \
+    fp[inst[3].opr] = fp[inst->opr] op (rhs); \
+    VM_NEXT(4);                               \
+  } while (0)
+#define VM_FUSED_BRANCH(op, rhs)  \
+  do {                            \
+    if (fp[inst->opr] op (rhs)) { \
+      VM_JUMP(inst[3].target);    \
+    }                             \
+    VM_NEXT(4);                   \
+  } while (0)
+
+  // push wide immediate
+  VM_LABEL(ImmW) {
+    VM_PUSH(inst->opr);
+    VM_NEXT(2);
+  }
+
+  // add immediate
+  VM_LABEL(AddI) {
+    VM_CHECK_TOP();
+    tos += inst->opr;
+    VM_NEXT(2);
+  }
+
+  // subtract immediate
+  VM_LABEL(SubI) {
+    VM_CHECK_TOP();
+    tos -= inst->opr;
+    VM_NEXT(2);
+  }
+
+  // push slot + slot
+  VM_LABEL(AddSS) {
+    VM_FUSED_PUSH(+, fp[inst[1].opr]);
+  }
+
+  // push slot - slot
+  VM_LABEL(SubSS) {
+    VM_FUSED_PUSH(-, fp[inst[1].opr]);
+  }
+
+  // push slot * slot
+  VM_LABEL(MulSS) {
+    VM_FUSED_PUSH(*, fp[inst[1].opr]);
+  }
+
+  // push slot + imm
+  VM_LABEL(AddSI) {
+    VM_FUSED_PUSH(+, inst[1].opr);
+  }
+
+  // push slot - imm
+  VM_LABEL(SubSI) {
+    VM_FUSED_PUSH(-, inst[1].opr);
+  }
+
+  // push slot * imm
+  VM_LABEL(MulSI) {
+    VM_FUSED_PUSH(*, inst[1].opr);
+  }
+
+  // slot = slot + slot
+  VM_LABEL(AddSSS) {
+    VM_FUSED_STORE(+, fp[inst[1].opr]);
+  }
+
+  // slot = slot - slot
+  VM_LABEL(SubSSS) {
+    VM_FUSED_STORE(-, fp[inst[1].opr]);
+  }
+
+  // slot = slot * slot
+  VM_LABEL(MulSSS) {
+    VM_FUSED_STORE(*, fp[inst[1].opr]);
+  }
+
+  // slot = slot + imm
+  VM_LABEL(AddSSI) {
+    VM_FUSED_STORE(+, inst[1].opr);
+  }
+
+  // slot = slot - imm
+  VM_LABEL(SubSSI) {
+    VM_FUSED_STORE(-, inst[1].opr);
+  }
+
+  // slot = slot * imm
+  VM_LABEL(MulSSI) {
+    VM_FUSED_STORE(*, inst[1].opr);
+  }
+
+  // branch if slot == slot
+  VM_LABEL(BeqSS) {
+    VM_FUSED_BRANCH(==, fp[inst[1].opr]);
+  }
+
+  // branch if slot != slot
+  VM_LABEL(BneSS) {
+    VM_FUSED_BRANCH(!=, fp[inst[1].opr]);
+  }
+
+  // branch if slot < slot
+  VM_LABEL(BltSS) {
+    VM_FUSED_BRANCH(<, fp[inst[1].opr]);
+  }
+
+  // branch if slot <= slot
+  VM_LABEL(BleSS) {
+    VM_FUSED_BRANCH(<=, fp[inst[1].opr]);
+  }
+
+  // branch if slot > slot
+  VM_LABEL(BgtSS) {
+    VM_FUSED_BRANCH(>, fp[inst[1].opr]);
+  }
+
+  // branch if slot >= slot
+  VM_LABEL(BgeSS) {
+    VM_FUSED_BRANCH(>=, fp[inst[1].opr]);
+  }
+
+  // branch if slot == imm
+  VM_LABEL(BeqSI) {
+    VM_FUSED_BRANCH(==, inst[1].opr);
+  }
+
+  // branch if slot != imm
+  VM_LABEL(BneSI) {
+    VM_FUSED_BRANCH(!=, inst[1].opr);
+  }
+
+  // branch if slot < imm
+  VM_LABEL(BltSI) {
+    VM_FUSED_BRANCH(<, inst[1].opr);
+  }
+
+  // branch if slot <= imm
+  VM_LABEL(BleSI) {
+    VM_FUSED_BRANCH(<=, inst[1].opr);
+  }
+
+  // branch if slot > imm
+  VM_LABEL(BgtSI) {
+    VM_FUSED_BRANCH(>, inst[1].opr);
+  }
+
+  // branch if slot >= imm
+  VM_LABEL(BgeSI) {
+    VM_FUSED_BRANCH(>=, inst[1].opr);
+  }
+
+#undef VM_FUSED_BRANCH
+#undef VM_FUSED_STORE
+#undef VM_FUSED_PUSH
+
+  // register instructions, operands are packed in 'opr'
+#define VM_REG(i) regs_[GetRegOpr(inst->opr, i)]
+#define VM_REG_RRR(op)                  \
+  do {                                  \
+    VM_REG(0) = VM_REG(1) op VM_REG(2); \
+    VM_NEXT(1);                         \
+  } while (0)
+#define VM_REG_RRI(op)                                \
+  do {                                                \
+    VM_REG(0) = VM_REG(1) op GetRegImm(inst->opr, 2); \
+    VM_NEXT(1);                                       \
+  } while (0)
+  // the target address is resolved from the following 'Jmp'
+#define VM_REG_BRANCH(cmp)         \
+  do {                             \
+    if (VM_REG(0) cmp VM_REG(1)) { \
+      VM_JUMP(inst->target);       \
+    }                              \
+    VM_NEXT(2);                    \
+  } while (0)
+
+  // move register
+  VM_LABEL(MovRR) {
+    VM_REG(0) = VM_REG(1);
+    VM_NEXT(1);
+  }
+
+  // load immediate to register
+  VM_LABEL(MovRI) {
+    VM_REG(0) = GetRegImm(inst->opr, 1);
+    VM_NEXT(1);
+  }
+
+  // logical AND (register)
+  VM_LABEL(LAndRRR) {
+    VM_REG_RRR(&&);
+  }
+
+  // logical OR (register)
+  VM_LABEL(LOrRRR) {
+    VM_REG_RRR(||);
+  }
+
+  // set if equal (register)
+  VM_LABEL(EqRRR) {
+    VM_REG_RRR(==);
+  }
+
+  // set if not equal (register)
+  VM_LABEL(NeRRR) {
+    VM_REG_RRR(!=);
+  }
+
+  // set if greater than (register)
+  VM_LABEL(GtRRR) {
+    VM_REG_RRR(>);
+  }
+
+  // set if less than (register)
+  VM_LABEL(LtRRR) {
+    VM_REG_RRR(<);
+  }
+
+  // set if greater than or equal (register)
+  VM_LABEL(GeRRR) {
+    VM_REG_RRR(>=);
+  }
+
+  // set if less than or equal (register)
+  VM_LABEL(LeRRR) {
+    VM_REG_RRR(<=);
+  }
+
+  // addition (register)
+  VM_LABEL(AddRRR) {
+    VM_REG_RRR(+);
+  }
+
+  // subtraction (register)
+  VM_LABEL(SubRRR) {
+    VM_REG_RRR(-);
+  }
+
+  // multiplication (register)
+  VM_LABEL(MulRRR) {
+    VM_REG_RRR(*);
+  }
+
+  // division (register)
+  VM_LABEL(DivRRR) {
+    VM_REG_RRR(/);
+  }
+
+  // modulo operation (register)
+  VM_LABEL(ModRRR) {
+    VM_REG_RRR(%);
+  }
+
+  // logical AND (register & immediate)
+  VM_LABEL(LAndRRI) {
+    VM_REG_RRI(&&);
+  }
+
+  // logical OR (register & immediate)
+  VM_LABEL(LOrRRI) {
+    VM_REG_RRI(||);
+  }
+
+  // set if equal (register & immediate)
+  VM_LABEL(EqRRI) {
+    VM_REG_RRI(==);
+  }
+
+  // set if not equal (register & immediate)
+  VM_LABEL(NeRRI) {
+    VM_REG_RRI(!=);
+  }
+
+  // set if greater than (register & immediate)
+  VM_LABEL(GtRRI) {
+    VM_REG_RRI(>);
+  }
+
+  // set if less than (register & immediate)
+  VM_LABEL(LtRRI) {
+    VM_REG_RRI(<);
+  }
+
+  // set if greater than or equal (register & immediate)
+  VM_LABEL(GeRRI) {
+    VM_REG_RRI(>=);
+  }
+
+  // set if less than or equal (register & immediate)
+  VM_LABEL(LeRRI) {
+    VM_REG_RRI(<=);
+  }
+
+  // addition (register & immediate)
+  VM_LABEL(AddRRI) {
+    VM_REG_RRI(+);
+  }
+
+  // subtraction (register & immediate)
+  VM_LABEL(SubRRI) {
+    VM_REG_RRI(-);
+  }
+
+  // multiplication (register & immediate)
+  VM_LABEL(MulRRI) {
+    VM_REG_RRI(*);
+  }
+
+  // division (register & immediate)
+  VM_LABEL(DivRRI) {
+    VM_REG_RRI(/);
+  }
+
+  // modulo operation (register & immediate)
+  VM_LABEL(ModRRI) {
+    VM_REG_RRI(%);
+  }
+
+  // branch if register == register
+  VM_LABEL(BeqRR) {
+    VM_REG_BRANCH(==);
+  }
+
+  // branch if register != register
+  VM_LABEL(BneRR) {
+    VM_REG_BRANCH(!=);
+  }
+
+  // branch if register < register
+  VM_LABEL(BltRR) {
+    VM_REG_BRANCH(<);
+  }
+
+  // branch if register <= register
+  VM_LABEL(BleRR) {
+    VM_REG_BRANCH(<=);
+  }
+
+  // branch if register > register
+  VM_LABEL(BgtRR) {
+    VM_REG_BRANCH(>);
+  }
+
+  // branch if register >= register
+  VM_LABEL(BgeRR) {
+    VM_REG_BRANCH(>=);
+  }
+
+#undef VM_REG_BRANCH
+#undef VM_REG_RRI
+#undef VM_REG_RRR
+#undef VM_REG
+
+#undef VM_BINARY
+#undef VM_CHECK_TOP
+#undef VM_POP_TO
+#undef VM_PUSH
+#undef VM_RELOAD
+#undef VM_SPILL
+#undef VM_ERROR
+#undef VM_SYNC_PC
+#undef VM_JUMP
 #undef VM_NEXT
 }
@@ -1,19 +1,25 @@
 #ifndef MINIVM_VM_VM_H_
 #define MINIVM_VM_VM_H_
 
-#include <unordered_map>
 #include <memory>
 #include <utility>
 #include <functional>
 #include <string_view>
 #include <optional>
-#include <stack>
 #include <vector>
+#include <algorithm>
+#include <type_traits>
 #include <cstddef>
 
 #include "vm/define.h"
 #include "vm/symbol.h"
 #include "vm/instcont.h"
+#include "vm/regcode.h"
+#include "vm/jitcode.h"
+#include "vm/tiered.h"
+#include "vm/trace.h"
+#include "vm/oprstack.h"
+#include "vm/framestack.h"
 #include "mem/pool.h"
 
 namespace minivm::vm {
@@ -21,28 +27,83 @@ namespace minivm::vm {
 // MiniVM instance
 class VM {
  public:
-  // environment
-  using Environment = std::unordered_map<SymId, VMOpr>;
-  using EnvPtr = std::shared_ptr<Environment>;
-  // pair of environment and function return address
-  using EnvAddrPair = std::pair<EnvPtr, VMAddr>;
   // static registers
   // external functions
   using ExtFunc = std::function<bool(VM &)>;
 
   VM(SymbolPool &sym_pool, VMInstContainer &cont)
-      : sym_pool_(sym_pool), cont_(cont) {}
+      : sym_pool_(sym_pool), cont_(cont), oprs_(kVMOprStackSize),
+        frames_(kVMFrameSegmentSize), ret_reg_id_(0), caller_saved_first_(0),
+        caller_saved_last_(0), inst_labels_(nullptr),
+        hook_label_(nullptr), tier_call_label_(nullptr),
+        tier_tail_call_label_(nullptr), tier_jmp_label_(nullptr),
+        trace_head_label_(nullptr),
+        record_label_(nullptr), hooked_(false), switch_to_debug_(false),
+        verified_(false), tier_(nullptr), trace_(nullptr) {
+    InitContCallbacks();
+  }
 
-  // register an external function
-  bool RegisterFunction(std::string_view name, ExtFunc func);
+  // register an external function, 'has_ret' indicates if the function
+  // always returns a value, or 'nullopt' if unknown
+  bool RegisterFunction(std::string_view name, ExtFunc func,
+                        std::optional<bool> has_ret = {});
+  // bind a native function with signature 'Sig' (e.g. 'int(int, int)')
+  // as an external function, marshalling of parameters and return value
+  // is generated at compile time, and the mode is selected by the count
+  // of static registers, which must be set before binding
+  // parameters must be integers, except that the first one can be
+  // 'VM &', return type can be 'void', 'bool' (returns 'false' if
+  // failed), integer or 'std::optional' of integer ('nullopt' if failed)
+  // returns 'false' if failed
+  template <typename Sig, typename F>
+  bool Bind(std::string_view name, F func);
   // read the value of the parameter in current memory pool
   std::optional<VMOpr> GetParamFromCurPool(std::size_t param_id) const;
+  // read parameters of the current external function call, from slots
+  // of the current frame (Eeyore mode), or from registers starting from
+  // the return value register and reset caller-saved registers (Tigger
+  // mode), returns 'false' if failed
+  bool GetExtParams(VMOpr *params, std::size_t count);
+  // set return value of the current external function call or intrinsic
+  void SetExtRet(VMOpr ret);
+  // get address of the specific local symbol in current environment
+  // returns 'nullptr' if not found
+  VMOpr *GetLocalAddr(SymId sym);
+  // get address of the specific global symbol in global segment
+  // returns 'nullptr' if not found
+  VMOpr *GetGlobalAddr(SymId sym);
 
+  // verify all instructions in the container, print error messages
+  // to stderr if failed, otherwise resize the operand stack to the
+  // maximum stack depth, and omit runtime checks of stack accesses
+  // and register ids in the interpreter, if stack depths of all
+  // functions are determined
+  // returns 'false' if failed
+  bool Verify();
   // reset internal states
   void Reset();
   // run VM, 'Reset' method must be called before
   // returns top of stack (success) or 'nullopt' (failed)
   std::optional<VMOpr> Run();
+  // run VM with the register-based engine, 'Reset' method must be
+  // called before, code must be translated from current container
+  // returns return value (success) or 'nullopt' (failed)
+  std::optional<VMOpr> Run(const RegCode &code);
+  // run VM with the native code generated by the JIT compiler, 'Reset'
+  // method must be called before, code must be translated from current
+  // container, debugging hooks and breakpoints are ignored
+  // returns return value (success) or 'nullopt' (failed)
+  std::optional<VMOpr> Run(const JitCode &code);
+  // run VM with tiered execution, hot functions are compiled to native
+  // code by the specific compiler, 'Reset' method must be called before,
+  // the compiler must be created from current container
+  // returns return value (success) or 'nullopt' (failed)
+  std::optional<VMOpr> Run(TieredCompiler &tier);
+  // run VM with trace-based execution, hot loops are recorded and
+  // compiled to traces by the specific compiler, 'Reset' method must be
+  // called before, the compiler must be created from current container
+  // returns return value (success) or 'nullopt' (failed)
+  std::optional<VMOpr> Run(TraceCompiler &trace);
 
   // setters
   // set memory pool
@@ -56,6 +117,12 @@ class VM {
   }
   // set id of return value register
   void set_ret_reg_id(RegId ret_reg_id) { ret_reg_id_ = ret_reg_id; }
+  // set range [first, last) of caller-saved registers, which will be
+  // reset when calling intrinsics in Tigger mode
+  void set_caller_saved_regs(RegId first, RegId last) {
+    caller_saved_first_ = first;
+    caller_saved_last_ = last;
+  }
 
   // getters
   // symbol pool
@@ -65,33 +132,109 @@ class VM {
   // program counter
   VMAddr pc() const { return pc_; }
   // operand stack
-  std::stack<VMOpr> &oprs() { return oprs_; }
+  OprStack &oprs() { return oprs_; }
   // memory pool
   const mem::MemPoolPtr &mem_pool() const { return mem_pool_; }
-  // current environment & return address
-  EnvAddrPair &env_addr_pair() { return envs_.top(); }
-  // global environment
-  const EnvPtr &global_env() const { return global_env_; }
+  // frame stack (environments & return addresses)
+  const FrameStack &frames() const { return frames_; }
+  // global environment (global segment)
+  const std::vector<VMOpr> &global_env() const { return global_env_; }
   // static registers
   VMOpr &regs(RegId id) { return regs_[id]; }
   // error code
   std::size_t error_code() const { return error_code_; }
+  // if stack depths of all functions have been verified
+  bool verified() const { return verified_; }
 
  private:
+  // pre-decoded instruction, for direct-threaded dispatching
+  struct ThreadedInst {
+    // address of the instruction handler
+    const void *handler;
+    // resolved target of control transfer instructions
+    const ThreadedInst *target;
+    // full-width operand, immediates are sign-extended
+    VMOpr opr;
+  };
+
+  // run VM with the threaded stream, the debug variant handles
+  // debugging hooks and breakpoints, the fast variant does not,
+  // and stops at the current instruction when they appear
+  template <bool kDebug>
+  std::optional<VMOpr> RunThreaded();
+  // register callbacks of instruction container
+  void InitContCallbacks();
+  // decode all instructions in the container to the threaded stream
+  void DecodeInsts();
+  // decode the specific instruction in the container
+  void DecodeInst(VMAddr pc);
+  // patch the threaded stream after the specific instruction
+  // in the container has been modified
+  void PatchInst(VMAddr pc);
+  // redirect all instructions in the threaded stream to the
+  // hook handler, or restore them
+  void ToggleHooks(bool enable);
   // update the error code, and print the related error message to stderr
   void LogError(std::size_t code);
-  // pop value from stack and return it
-  VMOpr PopValue();
-  // get reference of the top of stack
-  VMOpr &GetOpr();
-  // get address of memory by id
-  VMOpr *GetAddrById(mem::MemId id);
-  // get address of memory by symbol
-  VMOpr *GetAddrBySym(SymId sym);
-  // make a new environment
-  EnvPtr MakeEnv();
+  // marshaller of native functions bound by 'Bind'
+  template <typename Sig>
+  struct Binder;
+
   // perform initialization before function call
-  void InitFuncCall();
+  // returns 'false' if failed
+  bool InitFuncCall();
+  // get the specific external function, returns 'nullptr' if not found
+  const ExtFunc *FindExtFunc(SymId sym) const;
+  // call the specific external function with the specific parameters,
+  // values pushed by the external function are left on the operand stack
+  // returns 'false' if failed
+  bool CallExtFunc(SymId sym, const VMOpr *params, std::size_t count);
+  // read parameters of intrinsics from the operand stack (Eeyore mode),
+  // or from registers starting from the return value register and reset
+  // caller-saved registers (Tigger mode), the operand stack is cleared
+  // returns 'false' if failed
+  bool GetIntrinsicParams(VMOpr *params, std::size_t count);
+  // reset all caller-saved registers
+  void ResetCallerSavedRegs() {
+    std::fill(regs_.begin() + caller_saved_first_,
+              regs_.begin() + caller_saved_last_, 0xdeadc0de);
+  }
+  // call the specific native function with values on the operand stack,
+  // the return value will be pushed to the operand stack
+  // returns the status of the native function, the operand stack is
+  // not changed if the native stack has run out
+  NativeStatus CallNative(NativeFunc func);
+  // enter the specific native function at label 'entry' with slots of
+  // the current frame, the return value will be pushed to the operand
+  // stack, returns the status of the native function
+  NativeStatus EnterNative(NativeFunc func, VMAddr entry);
+  // call function 'func' at 'pc' from native functions by the interpreter,
+  // native functions are not called until the callee returns
+  // returns the status of the callee
+  NativeStatus CallFromNative(VMAddr pc, VMAddr func, const VMOpr *params,
+                              std::uint32_t count, VMOpr &ret);
+  // run the specific trace until a side exit, values on the stack of
+  // the exit will be pushed to the operand stack
+  // returns 'false' if failed, otherwise updates 'exit' to the pc
+  // address that the interpreter should continue at
+  bool RunTrace(Trace &trace, VMAddr &exit);
+
+  // runtime functions of native code, see 'JitContext'
+  static VMOpr *JitCall(VM *vm, VMOpr *sp, VMAddr pc);
+  static VMOpr *JitTailCall(VM *vm, VMOpr *sp, VMAddr pc);
+  static VMOpr *JitCallExt(VM *vm, VMOpr *sp, VMAddr pc, SymId sym);
+  static VMOpr *JitRet(VM *vm);
+  static VMOpr *JitEnter(VM *vm, std::uint32_t slot_count);
+  static VMOpr JitAlloc(VM *vm, VMOpr size, bool init);
+  static void *JitGetAddr(VM *vm, VMOpr id);
+  static void JitError(VM *vm, VMAddr pc, std::uint32_t code);
+  // runtime functions of tiered execution, see 'TierContext'
+  static std::uint32_t TierSaveState(VM *vm);
+  static void TierRestoreState(VM *vm, std::uint32_t state);
+  static int TierCallExt(VM *vm, VMAddr pc, SymId sym, const VMOpr *params,
+                         std::uint32_t count, VMOpr *ret);
+  static int TierCallVM(VM *vm, VMAddr pc, VMAddr func, const VMOpr *params,
+                        std::uint32_t count, VMOpr *ret);
 
   // symbol pool
   SymbolPool &sym_pool_;
@@ -100,23 +243,150 @@ class VM {
   // program counter
   VMAddr pc_;
   // operand stack
-  std::stack<VMOpr> oprs_;
+  OprStack oprs_;
   // memory pool
   mem::MemPoolPtr mem_pool_;
-  // environment stack
-  std::stack<EnvAddrPair> envs_;
-  // global environment
-  EnvPtr global_env_;
+  // frame stack
+  FrameStack frames_;
+  // global environment (global segment)
+  std::vector<VMOpr> global_env_;
   // static registers
   std::vector<VMOpr> regs_;
   // id of return value register
   RegId ret_reg_id_;
-  // external function table
-  std::unordered_map<SymId, ExtFunc> ext_funcs_;
+  // range of caller-saved registers
+  RegId caller_saved_first_, caller_saved_last_;
+  // external function table, indexed by symbol ids
+  std::vector<ExtFunc> ext_funcs_;
+  // if external functions always return values, indexed by symbol ids
+  std::vector<std::optional<bool>> ext_rets_;
   // error code
   std::size_t error_code_;
+  // threaded instruction stream
+  std::vector<ThreadedInst> threaded_insts_;
+  // addresses of instruction handlers
+  const void *const *inst_labels_;
+  // address of hook handler
+  const void *hook_label_;
+  // addresses of handlers that count calls and back-edges
+  const void *tier_call_label_, *tier_tail_call_label_, *tier_jmp_label_;
+  // addresses of handlers that count loop headers and record traces
+  const void *trace_head_label_, *record_label_;
+  // whether the threaded stream is redirected to the hook handler
+  bool hooked_;
+  // set if the fast variant stopped for switching to the debug variant
+  bool switch_to_debug_;
+  // set if instructions in the container have been verified
+  bool verified_;
+  // compiler of tiered execution, 'nullptr' if disabled
+  TieredCompiler *tier_;
+  // compiler of trace-based execution, 'nullptr' if disabled
+  TraceCompiler *trace_;
+};
+
+template <typename Ret, typename... Args>
+struct VM::Binder<Ret(Args...)> {
+  // check if the first parameter is the VM instance
+  template <typename... Ts>
+  struct TakesVM : std::false_type {};
+  template <typename... Ts>
+  struct TakesVM<VM &, Ts...> : std::true_type {};
+  // check if the type is 'std::optional' of integer
+  template <typename T>
+  struct IsOptInt : std::false_type {};
+  template <typename T>
+  struct IsOptInt<std::optional<T>> : std::is_integral<T> {};
+
+  // count of parameters passed by the VM
+  static constexpr std::size_t kVMParams = TakesVM<Args...>::value;
+  static constexpr std::size_t kParamCount = sizeof...(Args) - kVMParams;
+  // set if the native function returns a value
+  static constexpr bool kHasRet =
+      !std::is_void_v<Ret> && !std::is_same_v<Ret, bool>;
+
+  static_assert(((std::is_integral_v<Args> || std::is_same_v<Args, VM &>) &&
+                 ...), "parameters must be integers or 'VM &'");
+  static_assert(((std::is_same_v<Args, VM &> ? 1 : 0) + ... + 0) ==
+                    kVMParams, "only the first parameter can be 'VM &'");
+  static_assert(std::is_void_v<Ret> || std::is_integral_v<Ret> ||
+                    IsOptInt<Ret>::value,
+                "return type must be 'void', integer or optional integer");
+
+  // get the 'I'th argument of the native function
+  template <typename T, std::size_t I>
+  static decltype(auto) GetArg(VM &vm, const VMOpr *params) {
+    if constexpr (std::is_same_v<T, VM &>) {
+      return (vm);
+    }
+    else {
+      return static_cast<T>(params[I - kVMParams]);
+    }
+  }
+
+  // call the native function with the specific parameters, the return
+  // value is passed to 'set_ret', returns 'false' if failed
+  template <typename F, typename SetRet, std::size_t... I>
+  static bool Call(VM &vm, F &func, const VMOpr *params, SetRet set_ret,
+                   std::index_sequence<I...>) {
+    if constexpr (std::is_void_v<Ret>) {
+      func(GetArg<Args, I>(vm, params)...);
+    }
+    else if constexpr (std::is_same_v<Ret, bool>) {
+      return func(GetArg<Args, I>(vm, params)...);
+    }
+    else if constexpr (IsOptInt<Ret>::value) {
+      auto ret = func(GetArg<Args, I>(vm, params)...);
+      if (!ret) return false;
+      set_ret(*ret);
+    }
+    else {
+      set_ret(func(GetArg<Args, I>(vm, params)...));
+    }
+    return true;
+  }
+
+  // Eeyore mode, parameters are stored in the first slots of the
+  // current frame, return value is pushed to the operand stack
+  template <typename F>
+  static bool CallEeyore(VM &vm, F &func) {
+    if (vm.frames_.slot_count() < kParamCount) return false;
+    auto set_ret = [&vm](VMOpr ret) { vm.oprs_.push(ret); };
+    return Call(vm, func, vm.frames_.fp(), set_ret,
+                std::index_sequence_for<Args...>());
+  }
+
+  // Tigger mode, parameters are stored in registers starting from
+  // the return value register, which are read before resetting
+  // caller-saved registers
+  template <typename F>
+  static bool CallTigger(VM &vm, F &func) {
+    VMOpr params[kParamCount + 1];
+    auto first = vm.regs_.begin() + vm.ret_reg_id_;
+    std::copy(first, first + kParamCount, params);
+    vm.ResetCallerSavedRegs();
+    auto set_ret = [&vm](VMOpr ret) { vm.regs_[vm.ret_reg_id_] = ret; };
+    return Call(vm, func, params, set_ret,
+                std::index_sequence_for<Args...>());
+  }
 };
 
+template <typename Sig, typename F>
+bool VM::Bind(std::string_view name, F func) {
+  using SigBinder = Binder<Sig>;
+  if (regs_.empty()) {
+    return RegisterFunction(
+        name,
+        [func](VM &vm) mutable { return SigBinder::CallEeyore(vm, func); },
+        SigBinder::kHasRet);
+  }
+  // make sure that all parameters fit in registers
+  if (ret_reg_id_ + SigBinder::kParamCount > regs_.size()) return false;
+  return RegisterFunction(
+      name,
+      [func](VM &vm) mutable { return SigBinder::CallTigger(vm, func); },
+      SigBinder::kHasRet);
+}
+
 }  // namespace minivm::vm
 
 #endif  // MINIVM_VM_VM_H_
@@ -0,0 +1,225 @@
+#ifndef MINIVM_VM_X64ASM_H_
+#define MINIVM_VM_X64ASM_H_
+
+#include <vector>
+#include <initializer_list>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace minivm::vm::x64 {
+
+// general purpose registers
+enum Reg : std::uint8_t {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+// condition codes
+enum Cond : std::uint8_t {
+  kCondE = 0x4, kCondNE = 0x5, kCondL = 0xc,
+  kCondGE = 0xd, kCondLE = 0xe, kCondG = 0xf,
+};
+
+// opcode extensions of ALU instructions
+enum class AluOp : std::uint8_t {
+  Add = 0, Or = 1, And = 4, Sub = 5, Xor = 6, Cmp = 7,
+};
+
+// opcode extensions of shift instructions
+enum class ShiftOp : std::uint8_t {
+  Shl = 4, Sar = 7,
+};
+
+// memory operand, '[base + disp]'
+struct Mem {
+  Reg base;
+  std::int32_t disp;
+};
+
+// a minimal x86-64 assembler, for generating templates of the JIT compiler
+// all instructions operate on 32-bit operands unless the name ends with
+// '64' or '8', branches are always encoded with 32-bit displacements
+class Assembler {
+ public:
+  // move instructions
+  //
+  void Mov(Reg dst, Reg src) { Op({0x89}, false, src, dst); }
+  void Mov(Reg dst, Mem src) { Op({0x8b}, false, dst, src); }
+  void Mov(Mem dst, Reg src) { Op({0x89}, false, src, dst); }
+  void Mov(Reg dst, std::int32_t imm) {
+    Rex(false, 0, 0, dst, false);
+    Byte(0xb8 + (dst & 7));
+    Imm32(imm);
+  }
+  void Mov(Mem dst, std::int32_t imm) {
+    Op({0xc7}, false, 0, dst);
+    Imm32(imm);
+  }
+  void Mov64(Reg dst, Reg src) { Op({0x89}, true, src, dst); }
+  void Mov64(Reg dst, Mem src) { Op({0x8b}, true, dst, src); }
+  void Mov64(Reg dst, std::uint64_t imm) {
+    Rex(true, 0, 0, dst, false);
+    Byte(0xb8 + (dst & 7));
+    for (int i = 0; i < 8; ++i) Byte(imm >> (i * 8));
+  }
+  void Lea64(Reg dst, Mem src) { Op({0x8d}, true, dst, src); }
+  // zero-extend the lower 8 bits of 'src' to 'dst'
+  void Movzx8(Reg dst, Reg src) { Op({0x0f, 0xb6}, false, dst, src, true); }
+
+  // arithmetic & logical instructions
+  //
+  void Alu(AluOp op, Reg dst, Reg src) {
+    Op({AluOpcode(op, 0x01)}, false, src, dst);
+  }
+  void Alu(AluOp op, Reg dst, Mem src) {
+    Op({AluOpcode(op, 0x03)}, false, dst, src);
+  }
+  void Alu(AluOp op, Reg dst, std::int32_t imm) { AluImm(op, dst, imm); }
+  void Alu(AluOp op, Mem dst, std::int32_t imm) { AluImm(op, dst, imm); }
+  void Alu8(AluOp op, Reg dst, Reg src) {
+    Op({AluOpcode(op, 0x00)}, false, src, dst, true);
+  }
+  void Imul(Reg dst, Reg src) { Op({0x0f, 0xaf}, false, dst, src); }
+  void Imul(Reg dst, Mem src) { Op({0x0f, 0xaf}, false, dst, src); }
+  void Imul(Reg dst, Reg src, std::int32_t imm) {
+    Op({0x69}, false, dst, src);
+    Imm32(imm);
+  }
+  void Test(Reg lhs, Reg rhs) { Op({0x85}, false, rhs, lhs); }
+  void Test8(Reg lhs, Reg rhs) { Op({0x84}, false, rhs, lhs, true); }
+  void Neg(Reg reg) { Op({0xf7}, false, 3, reg); }
+  // shift by immediate, or by 'cl'
+  void Shift(ShiftOp op, Reg dst, std::uint8_t imm) {
+    Op({0xc1}, false, static_cast<int>(op), dst);
+    Byte(imm);
+  }
+  void ShiftCl(ShiftOp op, Reg dst) {
+    Op({0xd3}, false, static_cast<int>(op), dst);
+  }
+  // sign-extend 'eax' to 'edx:eax'
+  void Cdq() { Byte(0x99); }
+  // signed division of 'edx:eax'
+  void Idiv(Reg src) { Op({0xf7}, false, 7, src); }
+  void Idiv(Mem src) { Op({0xf7}, false, 7, src); }
+  // set the lower 8 bits of 'dst' by condition
+  void Setcc(Cond cond, Reg dst) {
+    Op({0x0f, static_cast<std::uint8_t>(0x90 + cond)}, false, 0, dst, true);
+  }
+  void Add64(Reg dst, std::int32_t imm) { AluImm(AluOp::Add, dst, imm, true); }
+  void Sub64(Reg dst, std::int32_t imm) { AluImm(AluOp::Sub, dst, imm, true); }
+  void Test64(Reg lhs, Reg rhs) { Op({0x85}, true, rhs, lhs); }
+
+  // stack & control transfer instructions
+  //
+  void Push(Reg reg) {
+    Rex(false, 0, 0, reg, false);
+    Byte(0x50 + (reg & 7));
+  }
+  void Pop(Reg reg) {
+    Rex(false, 0, 0, reg, false);
+    Byte(0x58 + (reg & 7));
+  }
+  void Ret() { Byte(0xc3); }
+  // indirect call through memory operand
+  void Call(Mem target) { Op({0xff}, false, 2, target); }
+  // indirect jump to address in register
+  void Jmp(Reg target) { Op({0xff}, false, 4, target); }
+  // indirect jump through table, 'jmp [base + index * 8]',
+  // 'base' can not be 'rbp' or 'r13'
+  void JmpTable(Reg base, Reg index) {
+    Rex(false, 0, index, base, false);
+    Byte(0xff);
+    Byte(0x24);  // ModRM, 'mod' = 00, 'reg' = 4, 'rm' = SIB
+    Byte(0xc0 | ((index & 7) << 3) | (base & 7));
+  }
+  // direct jumps, returns offset of the displacement field,
+  // which should be filled in by 'Patch'
+  std::size_t Jmp() {
+    Byte(0xe9);
+    return Rel32();
+  }
+  std::size_t Jcc(Cond cond) {
+    Byte(0x0f);
+    Byte(0x80 + cond);
+    return Rel32();
+  }
+  // fill in the displacement field at offset 'at' with 'target'
+  void Patch(std::size_t at, std::size_t target) {
+    auto rel = static_cast<std::int32_t>(target - (at + 4));
+    std::memcpy(buf_.data() + at, &rel, sizeof(rel));
+  }
+
+  // getter, current offset
+  std::size_t size() const { return buf_.size(); }
+  // getter, generated machine code
+  const std::uint8_t *data() const { return buf_.data(); }
+
+ private:
+  void Byte(std::uint32_t b) { buf_.push_back(b & 0xff); }
+  void Imm32(std::int32_t imm) {
+    auto val = static_cast<std::uint32_t>(imm);
+    for (int i = 0; i < 4; ++i) Byte(val >> (i * 8));
+  }
+  std::size_t Rel32() {
+    auto at = buf_.size();
+    Imm32(0);
+    return at;
+  }
+
+  // emit REX prefix if necessary, 'force' is used by 8-bit instructions
+  // to access 'spl', 'bpl', 'sil' and 'dil'
+  void Rex(bool w, int reg, int index, int base, bool force) {
+    std::uint8_t rex = 0x40 | (w << 3) | (((reg >> 3) & 1) << 2) |
+                       (((index >> 3) & 1) << 1) | ((base >> 3) & 1);
+    if (rex != 0x40 || force) Byte(rex);
+  }
+
+  // emit instruction with register operand in 'rm' field
+  void Op(std::initializer_list<std::uint8_t> opcode, bool w, int reg,
+          Reg rm, bool byte_op = false) {
+    bool force = byte_op && ((reg >= 4 && reg < 8) || (rm >= 4 && rm < 8));
+    Rex(w, reg, 0, rm, force);
+    for (const auto &b : opcode) Byte(b);
+    Byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+  }
+  // emit instruction with memory operand in 'rm' field
+  void Op(std::initializer_list<std::uint8_t> opcode, bool w, int reg,
+          const Mem &rm, bool byte_op = false) {
+    Rex(w, reg, 0, rm.base, byte_op && reg >= 4 && reg < 8);
+    for (const auto &b : opcode) Byte(b);
+    auto base = rm.base & 7;
+    bool is_disp8 = rm.disp >= -128 && rm.disp <= 127;
+    // 'rbp' and 'r13' always require a displacement
+    auto mod = !rm.disp && base != RBP ? 0 : is_disp8 ? 1 : 2;
+    Byte((mod << 6) | ((reg & 7) << 3) | base);
+    // 'rsp' and 'r12' always require a SIB byte
+    if (base == RSP) Byte(0x24);
+    if (mod == 1) Byte(rm.disp);
+    if (mod == 2) Imm32(rm.disp);
+  }
+
+  // get opcode of ALU instructions, 'base' is the opcode of 'add'
+  static std::uint8_t AluOpcode(AluOp op, std::uint8_t base) {
+    return (static_cast<std::uint8_t>(op) << 3) | base;
+  }
+  // emit ALU instruction with immediate operand
+  template <typename RM>
+  void AluImm(AluOp op, const RM &dst, std::int32_t imm, bool w = false) {
+    auto ext = static_cast<int>(op);
+    if (imm >= -128 && imm <= 127) {
+      Op({0x83}, w, ext, dst);
+      Byte(imm);
+    }
+    else {
+      Op({0x81}, w, ext, dst);
+      Imm32(imm);
+    }
+  }
+
+  std::vector<std::uint8_t> buf_;
+};
+
+}  // namespace minivm::vm::x64
+
+#endif  // MINIVM_VM_X64ASM_H_
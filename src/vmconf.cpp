@@ -3,10 +3,12 @@
 #include <iostream>
 #include <iomanip>
 #include <chrono>
+#include <optional>
 #include <cstddef>
 #include <cstdint>
 
 #include "front/token.h"
+#include "vm/sysy.h"
 #include "mem/sparse.h"
 #include "mem/dense.h"
 
@@ -15,16 +17,17 @@ using namespace minivm::mem;
 using namespace minivm::front;
 
 // add all library functions to a VM instance
-#define ADD_LIBS(vm)                                     \
-  do {                                                   \
-    vm.RegisterFunction("f_getint", GetInt);             \
-    vm.RegisterFunction("f_getch", GetCh);               \
-    vm.RegisterFunction("f_getarray", GetArray);         \
-    vm.RegisterFunction("f_putint", PutInt);             \
-    vm.RegisterFunction("f_putch", PutCh);               \
-    vm.RegisterFunction("f_putarray", PutArray);         \
-    vm.RegisterFunction("f__sysy_starttime", StartTime); \
-    vm.RegisterFunction("f__sysy_stoptime", StopTime);   \
+#define ADD_LIBS(vm)                                             \
+  do {                                                           \
+    vm.Bind<VMOpr()>("f_getint", GetInt);                        \
+    vm.Bind<VMOpr()>("f_getch", GetCh);                          \
+    vm.Bind<std::optional<VMOpr>(VM &, VMOpr)>("f_getarray",     \
+                                               GetArray);        \
+    vm.Bind<void(VMOpr)>("f_putint", PutInt);                    \
+    vm.Bind<void(VMOpr)>("f_putch", PutCh);                      \
+    vm.Bind<bool(VM &, VMOpr, VMOpr)>("f_putarray", PutArray);   \
+    vm.Bind<bool(VMOpr)>("f__sysy_starttime", StartTime);        \
+    vm.Bind<bool(VMOpr)>("f__sysy_stoptime", StopTime);          \
   } while (0)
 
 namespace {
@@ -70,33 +73,6 @@ static struct TimerGuard {
   }
 } timer_guard;
 
-bool GetArray(VM &vm, VMOpr &ret, MemId arr) {
-  // get length
-  std::cin >> ret;
-  // get address of array
-  auto ptr = vm.mem_pool()->GetAddress(arr);
-  if (!ptr) return false;
-  // read elements
-  for (int i = 0; i < ret; ++i) {
-    std::cin >> reinterpret_cast<VMOpr *>(ptr)[i];
-  }
-  return true;
-}
-
-bool PutArray(VM &vm, VMOpr len, MemId arr) {
-  // put length
-  std::cout << len << ':';
-  // get address of array
-  auto ptr = vm.mem_pool()->GetAddress(arr);
-  if (!ptr) return false;
-  // put elements
-  for (int i = 0; i < len; ++i) {
-    std::cout << ' ' << reinterpret_cast<VMOpr *>(ptr)[i];
-  }
-  std::cout << std::endl;
-  return true;
-}
-
 bool StartTime(VMOpr line_num) {
   last_line_num = line_num;
   last_time_point = std::chrono::high_resolution_clock::now();
@@ -121,138 +97,39 @@ bool StopTime(VMOpr line_num) {
   return true;
 }
 
-}  // namespace impl
-
-// Eeyore mode wrapper
-namespace eeyore {
-
-bool GetInt(VM &vm) {
+VMOpr GetInt() {
   VMOpr val;
   std::cin >> val;
-  vm.oprs().push(val);
-  return true;
-}
-
-bool GetCh(VM &vm) {
-  vm.oprs().push(std::cin.get());
-  return true;
+  return val;
 }
 
-bool GetArray(VM &vm) {
-  VMOpr ret;
-  auto arr = vm.GetParamFromCurPool(0);
-  if (!arr) return false;
-  if (!impl::GetArray(vm, ret, *arr)) return false;
-  vm.oprs().push(ret);
-  return true;
+VMOpr GetCh() {
+  return std::cin.get();
 }
 
-bool PutInt(VM &vm) {
-  auto val = vm.GetParamFromCurPool(0);
-  if (!val) return false;
-  std::cout << *val;
-  return true;
-}
-
-bool PutCh(VM &vm) {
-  auto val = vm.GetParamFromCurPool(0);
-  if (!val) return false;
-  std::cout.put(*val);
-  return true;
+std::optional<VMOpr> GetArray(VM &vm, VMOpr arr) {
+  VMOpr len;
+  if (!sysy::GetArray(*vm.mem_pool(), len, arr)) return {};
+  return len;
 }
 
-bool PutArray(VM &vm) {
-  auto len = vm.GetParamFromCurPool(0);
-  auto arr = vm.GetParamFromCurPool(1);
-  if (!len || !arr) return false;
-  return impl::PutArray(vm, *len, *arr);
+void PutInt(VMOpr val) {
+  std::cout << val;
 }
 
-bool StartTime(VM &vm) {
-  auto line_num = vm.GetParamFromCurPool(0);
-  if (!line_num) return false;
-  return impl::StartTime(*line_num);
-}
-
-bool StopTime(VM &vm) {
-  auto line_num = vm.GetParamFromCurPool(0);
-  if (!line_num) return false;
-  return impl::StopTime(*line_num);
-}
-
-}  // namespace eeyore
-
-// Tigger mode wrapper
-namespace tigger {
-
-inline VMOpr &GetRetVal(VM &vm) {
-  return vm.regs(static_cast<RegId>(TokenReg::A0));
+void PutCh(VMOpr val) {
+  std::cout.put(val);
 }
 
-inline VMOpr &GetParam(VM &vm, std::size_t param_id) {
-  return vm.regs(static_cast<RegId>(TokenReg::A0) + param_id);
+bool PutArray(VM &vm, VMOpr len, VMOpr arr) {
+  return sysy::PutArray(*vm.mem_pool(), len, arr);
 }
 
-void ResetCallerSaveRegs(VM &vm) {
-  for (RegId i = static_cast<RegId>(TokenReg::T0);
-       i < static_cast<RegId>(TokenReg::A7); ++i) {
-    vm.regs(i) = 0xdeadc0de;
-  }
-}
-
-bool GetInt(VM &vm) {
-  ResetCallerSaveRegs(vm);
-  std::cin >> GetRetVal(vm);
-  return true;
-}
-
-bool GetCh(VM &vm) {
-  ResetCallerSaveRegs(vm);
-  GetRetVal(vm) = std::cin.get();
-  return true;
-}
-
-bool GetArray(VM &vm) {
-  auto arr = GetParam(vm, 0);
-  ResetCallerSaveRegs(vm);
-  return impl::GetArray(vm, GetRetVal(vm), arr);
-}
-
-bool PutInt(VM &vm) {
-  std::cout << GetParam(vm, 0);
-  ResetCallerSaveRegs(vm);
-  return true;
-}
-
-bool PutCh(VM &vm) {
-  std::cout.put(GetParam(vm, 0));
-  ResetCallerSaveRegs(vm);
-  return true;
-}
-
-bool PutArray(VM &vm) {
-  auto len = GetParam(vm, 0), arr = GetParam(vm, 1);
-  ResetCallerSaveRegs(vm);
-  return impl::PutArray(vm, len, arr);
-}
-
-bool StartTime(VM &vm) {
-  auto line_num = GetParam(vm, 0);
-  ResetCallerSaveRegs(vm);
-  return impl::StartTime(line_num);
-}
-
-bool StopTime(VM &vm) {
-  auto line_num = GetParam(vm, 0);
-  ResetCallerSaveRegs(vm);
-  return impl::StopTime(line_num);
-}
-
-}  // namespace tigger
+}  // namespace impl
 }  // namespace
 
 void InitEeyoreVM(VM &vm) {
-  using namespace eeyore;
+  using namespace impl;
   // set memory pool factory function
   vm.set_mem_pool(std::make_unique<SparseMemoryPool>());
   // add library functions
@@ -261,13 +138,15 @@ void InitEeyoreVM(VM &vm) {
 }
 
 void InitTiggerVM(VM &vm) {
-  using namespace tigger;
+  using namespace impl;
   // set memory pool factory function
   vm.set_mem_pool(std::make_unique<DenseMemoryPool>());
   // initialize static registers
   vm.set_static_reg_count(TOKEN_COUNT(TOKEN_REGISTERS));
   vm.set_ret_reg_id(static_cast<RegId>(TokenReg::A0));
-  // add library functions
+  vm.set_caller_saved_regs(static_cast<RegId>(TokenReg::T0),
+                           static_cast<RegId>(TokenReg::A7));
+  // add library functions, after setting static registers
   ADD_LIBS(vm);
   vm.Reset();
   vm.regs(static_cast<RegId>(TokenReg::X0)) = 0;